@@ -69,6 +69,7 @@ void runProgram(char* argv[]){
     TIMER_START("Creating the combinatorial mesh.");
     mcGeometry::MCGeometry Geo;
     CreateMesh(numCells, Geo);
+    Geo.completedGeometryInput();
     TIMER_STOP("Creating the combinatorial mesh.");
 
     TallyVec combPL1;
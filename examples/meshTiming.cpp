@@ -28,13 +28,14 @@ void MeshTiming(int, mcGeometry::MCGeometry&, bool);
 
 int main(int argc, char* argv[]){
 
-    if (argc != 2) {
-        cout << "Syntax: meshTiming numDivisions."
+    if (argc != 2 && argc != 3) {
+        cout << "Syntax: meshTiming numDivisions [precompute]."
              << endl;
         return 1;
     }
 
     int N( std::atoi(argv[1]) );
+    bool precompute = (argc == 3 && std::atoi(argv[2]) != 0);
 
     Insist( N > 0, "Number of divisions should be positive." );
 
@@ -49,8 +50,16 @@ int main(int argc, char* argv[]){
     cout << "Creating the mesh..." << endl;
     TIMER_START("0 Create the mesh");
     CreateMesh(N, Geo);
+    Geo.completedGeometryInput();
     TIMER_STOP("0 Create the mesh");
 
+    if (precompute) {
+        cout << "Finding connectivity..." << endl;
+        TIMER_START("0 Find connectivity");
+        Geo.findAllConnectivity();
+        TIMER_STOP("0 Find connectivity");
+    }
+
 //    Geo.debugPrint();
 
     cout << "Running forward sweep..." << endl;
@@ -0,0 +1,250 @@
+/*!
+ * \file senseTiming.cpp
+ * \brief  Measure what carrying surface senses across crossings saves
+ * \author Seth R. Johnson
+ */
+
+/*----------------------------------------------------------------------------*/
+
+#include "mcgeometry/MCGeometry.hpp"
+#include "mcgeometry/GeometryCounters.hpp"
+#include "mcgeometry/Cylinder.hpp"
+#include "mcgeometry/Plane.hpp"
+#include "mcgeometry/TrackState.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include "transupport/dbc.hpp"
+#include "transupport/SuperTimer.hpp"
+
+using std::cout;
+using std::endl;
+
+using mcGeometry::GeometryCounters;
+using mcGeometry::MCGeometry;
+using mcGeometry::TrackState;
+
+//! Blitz++ TinyVector of length D stores position/direction/etc.
+typedef blitz::TinyVector<double, 3> TVecDbl;
+
+namespace {
+//! Axis of the bundle, tilted so nothing is axis-aligned
+const TVecDbl bundleAxis(0.26726124191242440, 0.53452248382484879,
+                         0.80178372573727319);
+//! Two directions perpendicular to the axis and each other
+const TVecDbl acrossA(0.89442719099991586, -0.44721359549995793, 0.0);
+const TVecDbl acrossB(0.35856858280031811, 0.71713716560063623,
+                      -0.59761430466719678);
+
+//! Distance between pin centers
+const double pinPitch  = 1.26;
+//! Radius of each pin
+const double pinRadius = 0.475;
+
+//! Uniform random number in [0, 1)
+double randomUnit() {
+    return std::rand() / (RAND_MAX + 1.0);
+}
+
+//! User ID of a pin's cell in a slice, or of a moderator cell after them
+MCGeometry::UserCellIdType cellId(int numPins, int slice, int pinOrQuadrant)
+{
+    return 1 + pinOrQuadrant + (numPins + 4) * slice;
+}
+}
+
+/*!
+ * \brief A tilted square bundle of pins, cut into slices across its axis.
+ *
+ * Each slice has a cell for every pin, and moderator around them bounded by
+ * the outside of every pin's cylinder. In every other slice (as at a spacer
+ * grid) the moderator is split into quadrants by two planes through the
+ * axis, listed after the pins.
+ *
+ * A particle leaving a whole moderator cell through the top of its slice
+ * may enter any of the quadrants above, each bounded by the same cylinders
+ * that the old cell was, so remembering which side of them it was on saves
+ * evaluating them again for each candidate.
+ */
+void createPinBundle(int pinsAcross, int numSlices, MCGeometry& geo)
+{
+    const int    numPins   = pinsAcross * pinsAcross;
+    const double halfWidth = 0.5 * pinsAcross * pinPitch;
+
+    for (int p = 0; p < numPins; ++p) {
+        const TVecDbl center(
+                acrossA * (pinPitch * (p % pinsAcross + 0.5) - halfWidth)
+                + acrossB * (pinPitch * (p / pinsAcross + 0.5) - halfWidth));
+        geo.addSurface(1 + p,
+                mcGeometry::Cylinder(center, bundleAxis, pinRadius));
+    }
+    geo.addSurface(997, mcGeometry::Plane(acrossA, TVecDbl(0.0)));
+    geo.addSurface(998, mcGeometry::Plane(acrossB, TVecDbl(0.0)));
+    geo.addSurface(999, mcGeometry::Cylinder(TVecDbl(0.0), bundleAxis,
+                                             halfWidth * std::sqrt(2.0)));
+    for (int j = 0; j <= numSlices; ++j) {
+        geo.addSurface(1000 + j,
+                mcGeometry::Plane(bundleAxis, bundleAxis * (1.0 * j)));
+    }
+
+    MCGeometry::IntVec surfaces;
+    for (int j = 0; j < numSlices; ++j) {
+        for (int p = 0; p < numPins; ++p) {
+            surfaces.clear();
+            surfaces.push_back(1000 + j);
+            surfaces.push_back(-(1000 + j + 1));
+            surfaces.push_back(-(1 + p));
+            geo.addCell(cellId(numPins, j, p), surfaces);
+        }
+
+        const int numQuadrants = (j % 2 == 0 ? 1 : 4);
+        for (int q = 0; q < numQuadrants; ++q) {
+            surfaces.clear();
+            surfaces.push_back(1000 + j);
+            surfaces.push_back(-(1000 + j + 1));
+            surfaces.push_back(-999);
+            for (int p = 0; p < numPins; ++p)
+                surfaces.push_back(1 + p);
+            if (numQuadrants > 1) {
+                surfaces.push_back(q % 2 == 0 ? -997 : 997);
+                surfaces.push_back(q / 2 == 0 ? -998 : 998);
+            }
+            geo.addCell(cellId(numPins, j, numPins + q), surfaces);
+        }
+    }
+
+    // everything outside the bundle
+    surfaces.clear();
+    surfaces.push_back(1000);
+    surfaces.push_back(-(1000 + numSlices));
+    surfaces.push_back(-999);
+    geo.addCell(100000, surfaces,
+                mcGeometry::Cell::generateFlags(true, true));
+
+    geo.completedGeometryInput();
+}
+
+/*!
+ * \brief Track particles from random points in the bundle until they leave.
+ *
+ * The same random seed is used every time, so every run tracks the same
+ * histories. As in a particle bank, one TrackState is reused for them all.
+ * Returns the number of crossings.
+ */
+unsigned long trackParticles(int pinsAcross, int numSlices, int numParticles,
+                             bool trackSenses, const MCGeometry& geo)
+{
+    const int    numPins   = pinsAcross * pinsAcross;
+    const double halfWidth = 0.5 * pinsAcross * pinPitch;
+
+    unsigned long numCrossings = 0;
+    std::srand(12345);
+    TrackState state;
+    state.trackSenses = trackSenses;
+
+    for (int n = 0; n < numParticles; ++n) {
+        // a random point in the square around the pins, whose cell we work
+        // out here so no time is spent searching for it
+        const int    slice = std::rand() % numSlices;
+        const double a = 2 * halfWidth * randomUnit() - halfWidth;
+        const double b = 2 * halfWidth * randomUnit() - halfWidth;
+        TVecDbl position(bundleAxis * (slice + randomUnit())
+                         + acrossA * a + acrossB * b);
+
+        const int i = static_cast<int>((a + halfWidth) / pinPitch);
+        const int j = static_cast<int>((b + halfWidth) / pinPitch);
+        const double toCenterA = a + halfWidth - pinPitch * (i + 0.5);
+        const double toCenterB = b + halfWidth - pinPitch * (j + 0.5);
+
+        int pinOrQuadrant = i + pinsAcross * j;
+        if (toCenterA * toCenterA + toCenterB * toCenterB
+                >= pinRadius * pinRadius)
+        {
+            pinOrQuadrant = numPins;
+            if (slice % 2 == 1)
+                pinOrQuadrant += (a < 0 ? 0 : 1) + (b < 0 ? 0 : 2);
+        }
+        unsigned int cellIndex = geo.getCellIndexFromUserId(
+                cellId(numPins, slice, pinOrQuadrant));
+
+        const double cosTheta = 2 * randomUnit() - 1;
+        const double sinTheta = std::sqrt(1 - cosTheta * cosTheta);
+        const double phi      = 2 * M_PI * randomUnit();
+        const TVecDbl direction(sinTheta * std::cos(phi),
+                                sinTheta * std::sin(phi), cosTheta);
+
+        MCGeometry::ReturnStatus returnStatus = MCGeometry::NORMAL;
+
+        while (returnStatus == MCGeometry::NORMAL) {
+            TVecDbl      newPosition;
+            unsigned int newCellIndex;
+            double       distance;
+
+            geo.findNewCell(position, direction, cellIndex, newPosition,
+                            newCellIndex, distance, returnStatus, state);
+
+            position  = newPosition;
+            cellIndex = newCellIndex;
+            ++numCrossings;
+        }
+    }
+    return numCrossings;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 2 && argc != 4) {
+        cout << "Syntax: senseTiming numParticles [pinsAcross numSlices]"
+             << endl;
+        return 1;
+    }
+
+    const int numParticles = std::atoi(argv[1]);
+    const int pinsAcross   = (argc == 4 ? std::atoi(argv[2]) : 4);
+    const int numSlices    = (argc == 4 ? std::atoi(argv[3]) : 64);
+
+    Insist(numParticles > 0 && pinsAcross > 0 && numSlices > 0,
+            "Counts should be positive.");
+
+    cout << "===============================" << endl
+         << "Tracking through a sliced bundle of pins" << endl
+         << "===============================" << endl;
+
+    MCGeometry geo;
+    createPinBundle(pinsAcross, numSlices, geo);
+
+    // learn every neighborhood first, so both runs only look them up
+    cout << "Learning neighborhoods..." << endl;
+    trackParticles(pinsAcross, numSlices, numParticles, false, geo);
+
+    // alternate, so both see the same machine load
+    const int numPasses = 5;
+    unsigned long numCrossings = 0;
+    for (int pass = 0; pass < numPasses; ++pass) {
+        TIMER_START("1 Evaluate every surface");
+        numCrossings
+            = trackParticles(pinsAcross, numSlices, numParticles, false, geo);
+        TIMER_STOP("1 Evaluate every surface");
+
+        TIMER_START("2 Carry senses across crossings");
+        trackParticles(pinsAcross, numSlices, numParticles, true, geo);
+        TIMER_STOP("2 Carry senses across crossings");
+    }
+
+    if (GeometryCounters::isEnabled()) {
+        GeometryCounters& counters = GeometryCounters::getThreadCounters();
+        for (int senses = 0; senses < 2; ++senses) {
+            counters.clear();
+            trackParticles(pinsAcross, numSlices, numParticles, senses != 0,
+                           geo);
+            cout << (senses ? "With" : "Without") << " senses: ";
+            counters.print(cout);
+        }
+    }
+
+    cout << numCrossings << " crossings in each of " << numPasses
+         << " runs" << endl;
+    TIMER_PRINT();
+    return 0;
+}
@@ -0,0 +1,167 @@
+/*!
+ * \file   BoundingVolumeHierarchy.cpp
+ * \brief  Contains implementation for the \c BoundingVolumeHierarchy class
+ * \author Seth R. Johnson
+ */
+/*----------------------------------------------------------------------------*/
+#include "BoundingVolumeHierarchy.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include <blitz/tinyvec-et.h>
+
+#include "transupport/dbc.hpp"
+
+namespace mcGeometry {
+/*============================================================================*/
+//! \cond
+namespace {
+//! Relative amount to grow each box so points on its faces are inside
+const double GROWTH_TOLERANCE = 1.0e-12;
+
+//! Whether a coordinate is finite
+inline bool isFinite(const double value)
+{
+    return (std::fabs(value) < std::numeric_limits<double>::infinity());
+}
+
+//! Sort box indices by their center along one axis
+class CenterLess {
+public:
+    CenterLess(const std::vector< blitz::TinyVector<double, 3> >& centers,
+               const unsigned int axis)
+        : _centers(centers), _axis(axis)
+    { /* * */ }
+
+    bool operator()(const unsigned int a, const unsigned int b) const {
+        return (_centers[a][_axis] < _centers[b][_axis]);
+    }
+
+private:
+    const std::vector< blitz::TinyVector<double, 3> >& _centers;
+    const unsigned int _axis;
+};
+} // end anonymous namespace
+//! \endcond
+
+/*----------------------------------------------------------------------------*/
+void BoundingVolumeHierarchy::build(
+        const TVecDblVec& lower,
+        const TVecDblVec& upper)
+{
+    Require(lower.size() == upper.size());
+
+    _nodes.clear();
+    _indices.clear();
+    _unbounded.clear();
+
+    _lower = lower;
+    _upper = upper;
+
+    const unsigned int numBoxes = lower.size();
+    TVecDblVec centers(numBoxes);
+
+    for (unsigned int i = 0; i < numBoxes; ++i) {
+        bool isBounded = true;
+
+        for (int d = 0; d < 3; ++d) {
+            // grow by a tolerance relative to the box's position
+            double scale = 1.0;
+            if (isFinite(_lower[i][d]))
+                scale = std::max(scale, std::fabs(_lower[i][d]));
+            if (isFinite(_upper[i][d]))
+                scale = std::max(scale, std::fabs(_upper[i][d]));
+
+            _lower[i][d] -= GROWTH_TOLERANCE * scale;
+            _upper[i][d] += GROWTH_TOLERANCE * scale;
+
+            if (!isFinite(_lower[i][d]) || !isFinite(_upper[i][d]))
+                isBounded = false;
+        }
+
+        if (isBounded) {
+            centers[i] = 0.5 * (_lower[i] + _upper[i]);
+            _indices.push_back(i);
+        }
+        else {
+            _unbounded.push_back(i);
+        }
+    }
+
+    if (_indices.empty())
+        return;
+
+    // a balanced tree has fewer than twice as many nodes as leaves
+    _nodes.reserve(2 * (_indices.size() / MAX_LEAF_SIZE + 1));
+
+    _buildNode(0, _indices.size(), centers, 0);
+
+    Ensure(!_nodes.empty());
+}
+
+/*----------------------------------------------------------------------------*/
+void BoundingVolumeHierarchy::_buildNode(
+        const unsigned int begin,
+        const unsigned int end,
+        const TVecDblVec& centers,
+        const unsigned int depth)
+{
+    Require(begin < end);
+    Insist(depth < MAX_DEPTH, "Bounding volume hierarchy is too deep.");
+
+    const unsigned int nodeIndex = _nodes.size();
+    _nodes.push_back(Node());
+
+    // find the extents of the boxes and of their centers
+    TVecDbl lower( std::numeric_limits<double>::infinity());
+    TVecDbl upper(-std::numeric_limits<double>::infinity());
+    TVecDbl centerLower( std::numeric_limits<double>::infinity());
+    TVecDbl centerUpper(-std::numeric_limits<double>::infinity());
+
+    for (unsigned int i = begin; i < end; ++i) {
+        const unsigned int boxIndex = _indices[i];
+        for (int d = 0; d < 3; ++d) {
+            lower[d] = std::min(lower[d], _lower[boxIndex][d]);
+            upper[d] = std::max(upper[d], _upper[boxIndex][d]);
+            centerLower[d] = std::min(centerLower[d], centers[boxIndex][d]);
+            centerUpper[d] = std::max(centerUpper[d], centers[boxIndex][d]);
+        }
+    }
+
+    _nodes[nodeIndex].lower = lower;
+    _nodes[nodeIndex].upper = upper;
+
+    if (end - begin <= MAX_LEAF_SIZE) {
+        _nodes[nodeIndex].first = begin;
+        _nodes[nodeIndex].count = end - begin;
+        return;
+    }
+
+    // split at the median center along the longest axis
+    unsigned int axis = 0;
+    for (unsigned int d = 1; d < 3; ++d) {
+        if (centerUpper[d] - centerLower[d]
+                > centerUpper[axis] - centerLower[axis])
+            axis = d;
+    }
+
+    const unsigned int middle = begin + (end - begin) / 2;
+    std::nth_element(_indices.begin() + begin,
+                     _indices.begin() + middle,
+                     _indices.begin() + end,
+                     CenterLess(centers, axis));
+
+    // left child is next in line; the right one goes after it
+    _buildNode(begin, middle, centers, depth + 1);
+
+    _nodes[nodeIndex].first = _nodes.size();
+    _nodes[nodeIndex].count = 0;
+
+    _buildNode(middle, end, centers, depth + 1);
+}
+
+/*============================================================================*/
+} // end namespace mcGeometry
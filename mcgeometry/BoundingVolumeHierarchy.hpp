@@ -0,0 +1,181 @@
+/*!
+ * \file   BoundingVolumeHierarchy.hpp
+ * \brief  Contains interface for BoundingVolumeHierarchy class
+ * \author Seth R. Johnson
+ */
+#ifndef MCG_BOUNDINGVOLUMEHIERARCHY_HPP
+#define MCG_BOUNDINGVOLUMEHIERARCHY_HPP
+/*----------------------------------------------------------------------------*/
+
+#include <vector>
+
+#include <blitz/tinyvec.h>
+
+#include "transupport/dbc.hpp"
+
+namespace mcGeometry {
+/*============================================================================*/
+
+/*!
+ * \class BoundingVolumeHierarchy
+ * \brief Binary tree of axis-aligned boxes for finding what contains a point.
+ *
+ * The tree is built once over a list of boxes (e.g. conservative cell
+ * bounds), splitting at the median along the longest axis, and is stored as
+ * a flat array of nodes. Queries walk only the branches whose boxes contain
+ * the point, so they take roughly logarithmic time in the number of boxes.
+ *
+ * Boxes that are infinite in any direction would contain nearly every node
+ * they were put in, so they are kept aside and checked after the tree.
+ *
+ * Queries don't modify anything, so any number of threads may run them at
+ * once.
+ */
+class BoundingVolumeHierarchy {
+public:
+    //! Blitz++ TinyVector of length D stores position/direction/etc.
+    typedef blitz::TinyVector<double, 3> TVecDbl;
+    //! Vector of box corners.
+    typedef std::vector<TVecDbl> TVecDblVec;
+
+    //! Create an empty hierarchy.
+    BoundingVolumeHierarchy() { /* * */ }
+
+    /*!
+     * \brief Build the tree over the given boxes.
+     *
+     * Box \c i is from \c lower[i] to \c upper[i]; the boxes are grown by a
+     * small tolerance so that points on their faces are found. This replaces
+     * any existing tree.
+     */
+    void build(const TVecDblVec& lower, const TVecDblVec& upper);
+
+    /*!
+     * \brief Find the first box containing a point that passes a test.
+     *
+     * Calls <tt>predicate(i)</tt> for each box \c i that contains \c point,
+     * stopping as soon as it returns true. Returns whether one did; if so,
+     * its index is put in \c index.
+     */
+    template<typename Predicate>
+    bool findFirst(const TVecDbl& point,
+                   const Predicate& predicate,
+                   unsigned int& index) const;
+
+    //! Whether there are no boxes.
+    bool empty() const {
+        return (_nodes.empty() && _unbounded.empty());
+    }
+
+    //! Number of nodes in the tree.
+    unsigned int getNumNodes() const {
+        return _nodes.size();
+    }
+
+private:
+    //! Node in the flattened tree.
+    struct Node {
+        //! Lower corner of everything in this node
+        TVecDbl      lower;
+        //! Upper corner of everything in this node
+        TVecDbl      upper;
+        //! Start of a leaf's boxes in _indices, or an interior node's right
+        //! child (the left child immediately follows its parent)
+        unsigned int first;
+        //! Number of boxes in a leaf, or zero for an interior node
+        unsigned int count;
+    };
+
+    //! Most boxes to put in a leaf
+    enum { MAX_LEAF_SIZE = 4 };
+
+    //! Deepest tree that can be traversed (median splits never approach it)
+    enum { MAX_DEPTH = 64 };
+
+    //! Recursively build nodes over _indices[begin, end).
+    void _buildNode(const unsigned int begin,
+                    const unsigned int end,
+                    const TVecDblVec& centers,
+                    const unsigned int depth);
+
+    //! Whether a point lies in a box.
+    static bool _contains(const TVecDbl& lower,
+                          const TVecDbl& upper,
+                          const TVecDbl& point)
+    {
+        return (   point[0] >= lower[0] && point[0] <= upper[0]
+                && point[1] >= lower[1] && point[1] <= upper[1]
+                && point[2] >= lower[2] && point[2] <= upper[2]);
+    }
+
+    //! Tree nodes; the root is first.
+    std::vector<Node> _nodes;
+
+    //! Box indices, grouped by leaf.
+    std::vector<unsigned int> _indices;
+
+    //! Lower corners of the (grown) boxes, by box index.
+    TVecDblVec _lower;
+
+    //! Upper corners of the (grown) boxes, by box index.
+    TVecDblVec _upper;
+
+    //! Boxes with an infinite side, which are always checked last.
+    std::vector<unsigned int> _unbounded;
+};
+
+/*----------------------------------------------------------------------------*/
+template<typename Predicate>
+bool BoundingVolumeHierarchy::findFirst(
+        const TVecDbl& point,
+        const Predicate& predicate,
+        unsigned int& index) const
+{
+    if (!_nodes.empty()) {
+        unsigned int stack[MAX_DEPTH];
+        int stackSize = 0;
+
+        stack[stackSize++] = 0;
+
+        while (stackSize > 0) {
+            const Node& node = _nodes[stack[--stackSize]];
+
+            if (!_contains(node.lower, node.upper, point))
+                continue;
+
+            if (node.count == 0) {
+                Check(stackSize + 2 <= MAX_DEPTH);
+                // visit the left child first
+                stack[stackSize++] = node.first;
+                stack[stackSize++] = (&node - &_nodes[0]) + 1;
+                continue;
+            }
+
+            for (unsigned int i = node.first; i < node.first + node.count; ++i)
+            {
+                const unsigned int boxIndex = _indices[i];
+                if (_contains(_lower[boxIndex], _upper[boxIndex], point)
+                        && predicate(boxIndex))
+                {
+                    index = boxIndex;
+                    return true;
+                }
+            }
+        }
+    }
+
+    for (std::vector<unsigned int>::const_iterator it  = _unbounded.begin();
+                                                   it != _unbounded.end(); ++it)
+    {
+        if (_contains(_lower[*it], _upper[*it], point) && predicate(*it)) {
+            index = *it;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/*============================================================================*/
+} // end namespace mcGeometry
+#endif
@@ -9,15 +9,48 @@
 
 #include <utility>
 #include <limits>
+#include <algorithm>
+#include <cmath>
 
 #include <blitz/tinyvec.h>
 #include "transupport/dbc.hpp"
+#include "transupport/blitzStuff.hpp"
 
 //#include <iostream>
 //using std::cout;
 //using std::endl;
 
 namespace mcGeometry {
+//! \cond
+namespace {
+/*----------------------------------------------------------------------------*/
+//! Relative cost of finding the sense of each type of surface (about the
+//! number of floating point operations in its kernel in SurfaceKernels.hpp)
+const double SENSE_COST[Surface::NUM_SURFACE_TYPES] = {
+    11.0, // PLANE
+    1.0,  // PLANE_X
+    1.0,  // PLANE_Y
+    1.0,  // PLANE_Z
+    10.0, // SPHERE
+    7.0,  // SPHERE_O
+    19.0, // CYLINDER
+    7.0,  // CYLINDER_X
+    7.0,  // CYLINDER_Y
+    7.0   // CYLINDER_Z
+};
+
+//! How worthwhile a surface is to check, and its place among the shapes
+typedef std::pair<double, unsigned int> CheckPriority;
+
+//! Order for checking surfaces: most worthwhile first
+bool isMoreWorthwhile(const CheckPriority& a, const CheckPriority& b)
+{
+    return a.first > b.first;
+}
+/*----------------------------------------------------------------------------*/
+} // end anonymous namespace
+//! \endcond
+
 /*----------------------------------------------------------------------------*/
 //! Static function to make flag generation easier.
 Cell::CellFlags Cell::generateFlags(
@@ -36,43 +69,272 @@ Cell::CellFlags Cell::generateFlags(
 //! constructor requires an immutable bounding surface
 Cell::Cell(
         const SASVec& boundingSurfaces,
-        const UserCellIdType userId,
         const unsigned int internalIndex,
         const CellFlags flags) :
-    _boundingSurfaces(boundingSurfaces),
-    _userId(userId),
+    _codesBegin(NULL),
+    _codesEnd(NULL),
+    _surfaceRows(NULL),
+    _shapeTypes(NULL),
+    _shapeParameters(NULL),
+    _planeCoefficients(NULL),
+    _checkOrder(NULL),
+    _checkCounts(NULL),
+    _hood(NULL),
+    _flags(flags),
+    _numPackedPlanes(0),
+    _internalIndex(internalIndex),
+    _isUsingTables(false),
+    _own(new OwnSurfaces)
+{
+    Require(boundingSurfaces.size() > 0);
+
+    _own->surfaces.resize(boundingSurfaces.size());
+    _own->codes.resize(boundingSurfaces.size());
+    for (unsigned int i = 0; i < boundingSurfaces.size(); ++i) {
+        _own->surfaces[i] = boundingSurfaces[i].first;
+        _own->codes[i] = encodeSurface(boundingSurfaces[i].first->getIndex(),
+                                       boundingSurfaces[i].second);
+    }
+
+    _codesBegin  = &_own->codes[0];
+    _codesEnd    = _codesBegin + _own->codes.size();
+    _surfaceRows = &_own->surfaces[0];
+
+    _initNeighborhood();
+    _packSurfaces();
+}
+/*----------------------------------------------------------------------------*/
+//! constructor with surface codes in someone else's storage
+Cell::Cell(
+        const SurfaceCode* codesBegin,
+        const SurfaceCode* codesEnd,
+        Surface* const* surfaceTable,
+        const unsigned int internalIndex,
+        const CellFlags flags) :
+    _codesBegin(codesBegin),
+    _codesEnd(codesEnd),
+    _surfaceRows(NULL),
+    _shapeTypes(NULL),
+    _shapeParameters(NULL),
+    _planeCoefficients(NULL),
+    _checkOrder(NULL),
+    _checkCounts(NULL),
+    _hood(NULL),
+    _flags(flags),
+    _numPackedPlanes(0),
     _internalIndex(internalIndex),
-    _flags(flags)
+    _isUsingTables(false),
+    _own(new OwnSurfaces)
+{
+    Require(codesBegin != NULL);
+    Require(codesEnd > codesBegin);
+    Require(surfaceTable != NULL);
+
+    _own->surfaces.reserve(codesEnd - codesBegin);
+    for (const SurfaceCode* code = codesBegin; code != codesEnd; ++code) {
+        Surface* surface = surfaceTable[getCodeIndex(*code)];
+
+        Check(surface->getIndex() == getCodeIndex(*code));
+        _own->surfaces.push_back(surface);
+    }
+    _surfaceRows = &_own->surfaces[0];
+
+    _initNeighborhood();
+    _packSurfaces();
+}
+/*----------------------------------------------------------------------------*/
+Cell::~Cell()
+{
+    delete[] _planeCoefficients;
+    delete[] _checkOrder;
+    delete[] _checkCounts;
+    delete[] _hood;
+    delete _own;
+}
+/*----------------------------------------------------------------------------*/
+void Cell::_initNeighborhood()
+{
+    // make sure no surface is repeated
+    std::vector<const Surface*> surfaces(_own->surfaces.begin(),
+                                         _own->surfaces.end());
+
+    std::sort(surfaces.begin(), surfaces.end());
+    Insist(std::adjacent_find(surfaces.begin(), surfaces.end())
+                == surfaces.end(),
+           "Duplicate surface in this cell.");
+
+    // create an empty neighborhood list for each surface
+    _hood = new CellContainer[getNumBoundingSurfaces()];
+}
+/*----------------------------------------------------------------------------*/
+void Cell::_packSurfaces()
+{
+    const unsigned int numSurfaces = getNumBoundingSurfaces();
+
+    bool isAllPlanes = (numSurfaces <= MAX_PACKED_PLANES);
+    for (unsigned int i = 0; i < numSurfaces; ++i) {
+        const Surface::SurfaceType type = _getSurface(i)->getType();
+        if (type != Surface::PLANE   && type != Surface::PLANE_X
+         && type != Surface::PLANE_Y && type != Surface::PLANE_Z)
+            isAllPlanes = false;
+    }
+
+    if (!isAllPlanes) {
+        std::vector<unsigned char>& types = _own->shapeTypes;
+        std::vector<double>& parameters   = _own->shapeParameters;
+
+        types.resize(numSurfaces);
+        parameters.assign(numSurfaces * Surface::MAX_PARAMETERS, 0.0);
+        _checkOrder = new unsigned int[numSurfaces];
+        for (unsigned int i = 0; i < numSurfaces; ++i) {
+            types[i] = _getSurface(i)->getType();
+            _getSurface(i)->getParameters(
+                    &parameters[i * Surface::MAX_PARAMETERS]);
+            _checkOrder[i] = i;
+        }
+        _shapeTypes      = &types[0];
+        _shapeParameters = &parameters[0];
+        return;
+    }
+
+    _numPackedPlanes = numSurfaces;
+    _planeCoefficients = new double[NUM_PLANE_ROWS * numSurfaces]();
+
+    double* row[NUM_PLANE_ROWS];
+    for (unsigned int r = 0; r < NUM_PLANE_ROWS; ++r)
+        row[r] = &_planeCoefficients[r * numSurfaces];
+
+    // write every plane as a general one; for axis-aligned planes the zero
+    // components drop out exactly, so the arithmetic matches PlaneNormal's
+    for (unsigned int i = 0; i < numSurfaces; ++i) {
+        const Surface& surface = *_getSurface(i);
+
+        double parameters[Surface::MAX_PARAMETERS];
+        surface.getParameters(parameters);
+
+        if (surface.getType() == Surface::PLANE) {
+            for (unsigned int d = 0; d < 3; ++d) {
+                row[NORMAL_X + d][i] = parameters[d];
+                row[POINT_X + d][i]  = parameters[3 + d];
+            }
+        }
+        else {
+            const unsigned int axis = surface.getType() - Surface::PLANE_X;
+            row[NORMAL_X + axis][i] = 1.0;
+            row[POINT_X + axis][i]  = parameters[0];
+        }
+
+        row[NORMAL_DOT_POINT][i] = row[NORMAL_X][i] * row[POINT_X][i]
+                                 + row[NORMAL_Y][i] * row[POINT_Y][i]
+                                 + row[NORMAL_Z][i] * row[POINT_Z][i];
+        row[HEADING_SIGN][i] = (getCodeSense(_codesBegin[i]) ? -1.0 : 1.0);
+    }
+}
+/*----------------------------------------------------------------------------*/
+Cell::SurfaceCode* Cell::relocateSurfaceCodes(SurfaceCode* storage)
+{
+    Require(storage != NULL);
+
+    SurfaceCode* storageEnd = std::copy(_codesBegin, _codesEnd, storage);
+
+    _codesBegin = storage;
+    _codesEnd   = storageEnd;
+
+    // release our own copy (if we still have it)
+    if (_own != NULL)
+        std::vector<SurfaceCode>().swap(_own->codes);
+
+    return storageEnd;
+}
+/*----------------------------------------------------------------------------*/
+void Cell::useSurfaceTables(
+        Surface* const* surfaces,
+        const unsigned char* types,
+        const double* parameters)
 {
-    typedef std::pair<HoodMap::iterator, bool> ReturnedPair;
-    Require(_boundingSurfaces.size() > 0);
+    Require(surfaces != NULL);
+    Require(types != NULL);
+    Require(parameters != NULL);
 
-    // initialize hood map
-    SASVec::const_iterator bsIt = _boundingSurfaces.begin();
+    if (_isUsingTables)
+        return;
 
-    // create empty neighborhood map, one entry for each surface
-    while (bsIt != _boundingSurfaces.end()) {
-        ReturnedPair result =
-            _hood.insert(std::make_pair(bsIt->first, CellContainer()));
+    // our codes must no longer be in our own storage
+    Require(_own->codes.empty());
 
-        Insist(result.second == true, "Duplicate surface in this cell.");
-        ++bsIt;
+    IfDbc(for (unsigned int i = 0; i < getNumBoundingSurfaces(); ++i)
+              Check(surfaces[getCodeIndex(_codesBegin[i])]
+                        == _own->surfaces[i]);)
+
+    // packed planes have their own coefficients
+    if (_numPackedPlanes == 0) {
+        IfDbc(for (unsigned int i = 0; i < getNumBoundingSurfaces(); ++i)
+                  Check(types[getCodeIndex(_codesBegin[i])]
+                            == _own->shapeTypes[i]);)
+
+        _shapeTypes      = types;
+        _shapeParameters = parameters;
     }
+    _surfaceRows   = surfaces;
+    _isUsingTables = true;
+
+    // release our own copies
+    delete _own;
+    _own = NULL;
+}
+/*----------------------------------------------------------------------------*/
+bool Cell::addNeighbor(
+        const Surface* surface,
+        Cell* neighbor)
+{
+    Require(neighbor != NULL);
+
+    const unsigned int i = _findBoundingSurface(surface);
+
+    // a global search may connect us through a surface that isn't ours
+    if (i == getNumBoundingSurfaces())
+        return false;
+
+    bool wasFirst = false;
+    _hood[i].insertUnique(neighbor, &wasFirst);
+
+    return wasFirst;
+}
+/*----------------------------------------------------------------------------*/
+void Cell::sortNeighbors()
+{
+    for (unsigned int i = 0; i < getNumBoundingSurfaces(); ++i)
+        _hood[i].sortByHits();
 }
 /*----------------------------------------------------------------------------*/
 bool Cell::isPointInside(
         const TVecDbl& position,
-        const Surface* surfaceToSkip) const
+        const Surface* surfaceToSkip,
+        const SurfaceSenses* knownSenses) const
 {
+    IfCounters(++GeometryCounters::getThreadCounters().pointInsideCalls;)
+
+    const unsigned int skipIndex = _findBoundingSurface(surfaceToSkip);
+
+    if (_numPackedPlanes > 0)
+        return _isPointInsidePlanes(position, skipIndex);
+
+    const double point[3] = {position[0], position[1], position[2]};
+    const unsigned int numSurfaces = getNumBoundingSurfaces();
+
+    if (_checkCounts != NULL)
+        return _isPointInsideProfiled(point, skipIndex, knownSenses);
+
     if (_flags & NEGATED) {
         // the negated flag makes the whole cell greedy:
         //  ANYWHERE that disagrees with one of the specified faces is
         //  considered part of the negated cell.
-        for (SASVec::const_iterator it  = _boundingSurfaces.begin();
-                                    it != _boundingSurfaces.end(); ++it)
+        for (unsigned int j = 0; j < numSurfaces; ++j)
         {
-            if (it->first != surfaceToSkip) {
-                if ( it->first->hasPosSense(position) != it->second ) {
+            const unsigned int i = _checkOrder[j];
+            if (i != skipIndex) {
+                if ( _hasPosSense(i, point, knownSenses)
+                        != getCodeSense(_codesBegin[i]) ) {
                     return true;
                 }
             }
@@ -86,39 +348,22 @@ bool Cell::isPointInside(
     }
     else
     {
-//        cout << "Checking for whether " << position << " is inside cell UID"
-//             << _userId << endl;
         // loop over all surfaces
-        for (SASVec::const_iterator it  = _boundingSurfaces.begin();
-                                    it != _boundingSurfaces.end(); ++it)
+        for (unsigned int j = 0; j < numSurfaces; ++j)
         {
-            // it->first is the pointer to the Surface object
-            // it->second is the surface sense
+            const unsigned int i = _checkOrder[j];
 
             // if we need to check it
-            if (it->first != surfaceToSkip)
+            if (i != skipIndex)
             {
-               if ( it->first->hasPosSense(position) != it->second ) {
-//                   cout << "Looks like cell UID " << _userId
-//                        << " has the WRONG sense wrt "
-//                        << "surface UID " << it->first->getUserId()
-//                        << endl;
+               if ( _hasPosSense(i, point, knownSenses)
+                       != getCodeSense(_codesBegin[i]) ) {
                    // if the surface reports that the sense of the point is
                    // NOT the same sense as we know this cell is defined, then
                    // it is not inside.
                    return false;
                }
-//               else {
-//                   cout << "Looks like cell UID " << _userId
-//                        << " has the correct sense wrt "
-//                        << "surface UID " << it->first->getUserId()
-//                        << endl;
-//               }
             }
-//            else {
-//                cout << "Skipping surface " << surfaceToSkip->getUserId()
-//                     << endl;
-//            }
         }
     }
     // we only get to this point if the point has the correct sense wrt every
@@ -126,59 +371,360 @@ bool Cell::isPointInside(
     return true;
 }
 /*----------------------------------------------------------------------------*/
+bool Cell::recordSenses(SurfaceSenses& senses,
+                        const Surface* crossedSurface) const
+{
+    if (_numPackedPlanes > 0 || (_flags & NEGATED))
+        return false;
+
+    // they're the same every time we leave
+    if (senses.holdsCell(_internalIndex))
+        return true;
+
+    // the crossed surface is never looked up, so if it's the only one worth
+    // it, keep whatever cell's senses are there (we may be going back in)
+    const unsigned int numSurfaces = getNumBoundingSurfaces();
+    unsigned int crossedIndex = numSurfaces;
+    bool isStarted = false;
+    for (unsigned int i = 0; i < numSurfaces; ++i) {
+        if (!_isWorthLookingUp(_getShape(i).type))
+            continue;
+
+        if (!isStarted) {
+            if (_getSurface(i) == crossedSurface
+                    && crossedIndex == numSurfaces) {
+                crossedIndex = i;
+                continue;
+            }
+            senses.startCell(_internalIndex);
+            isStarted = true;
+            if (crossedIndex < numSurfaces)
+                senses.set(getCodeIndex(_codesBegin[crossedIndex]),
+                           getCodeSense(_codesBegin[crossedIndex]));
+        }
+        senses.set(getCodeIndex(_codesBegin[i]), getCodeSense(_codesBegin[i]));
+    }
+    return isStarted;
+}
+/*----------------------------------------------------------------------------*/
+void Cell::startCheckProfile()
+{
+    // packed planes are all evaluated at once, so their order doesn't matter
+    if (_numPackedPlanes > 0)
+        return;
+
+    delete[] _checkCounts;
+    _checkCounts = new CheckCounts[getNumBoundingSurfaces()]();
+}
+/*----------------------------------------------------------------------------*/
+void Cell::sortSurfaceChecks()
+{
+    if (_checkCounts == NULL)
+        return;
+
+    const unsigned int numSurfaces = getNumBoundingSurfaces();
+    std::vector<CheckPriority> priorities(numSurfaces);
+
+    for (unsigned int i = 0; i < numSurfaces; ++i) {
+        // chance of deciding, pulled toward one half when there are few
+        // checks, so that surfaces never reached aren't ranked last or first
+        const double chance = (_checkCounts[i].decisions + 1.0)
+                            / (_checkCounts[i].checks + 2.0);
+
+        priorities[i].first  = chance / SENSE_COST[_getShape(i).type];
+        priorities[i].second = i;
+    }
+
+    std::stable_sort(priorities.begin(), priorities.end(), &isMoreWorthwhile);
+
+    for (unsigned int j = 0; j < numSurfaces; ++j)
+        _checkOrder[j] = priorities[j].second;
+
+    delete[] _checkCounts;
+    _checkCounts = NULL;
+}
+/*----------------------------------------------------------------------------*/
 void Cell::intersect(
         const TVecDbl& position,
         const TVecDbl& direction,
         Surface*& hitSurface,
         bool&     quadricSense,
-        double&   distance) const
+        double&   distance,
+        const double maxDistance,
+        const Surface* onSurface) const
 {
-    hitSurface   = NULL;
-    quadricSense = false;
-    distance     = std::numeric_limits<double>::infinity();
+    Require(tranSupport::checkDirectionVector(direction));
+    Require(maxDistance >= 0.0);
+
+    const unsigned int onIndex = _findBoundingSurface(onSurface);
+
+    if (_numPackedPlanes > 0) {
+        _intersectPlanes(position, direction, hitSurface, quadricSense,
+                         distance, maxDistance, onIndex);
+        return;
+    }
+
+    distance = std::numeric_limits<double>::infinity();
+
+    const double point[3] = {position[0], position[1], position[2]};
+    const double heading[3] = {direction[0], direction[1], direction[2]};
+    const unsigned int numSurfaces = getNumBoundingSurfaces();
+
+    unsigned int nearest = numSurfaces;
+    IfCounters(GeometryCounters& counters
+                    = GeometryCounters::getThreadCounters();)
 
-//    cout << "Doing intersect in cell " << getUserId() << endl;
     // loop over all surfaces
-    for (SASVec::const_iterator it =  _boundingSurfaces.begin();
-                                it != _boundingSurfaces.end(); ++it)
+    for (unsigned int i = 0; i < numSurfaces; ++i)
     {
-        bool thisHit;
+        const bool         sense = getCodeSense(_codesBegin[i]);
+        const SurfaceShape shape = _getShape(i);
+
+        // find the distance to the surface given our sense of it (infinite
+        // if it isn't hit before the nearest one so far)
         double thisDistance;
+        if (i == onIndex) {
+            thisDistance = shape.distanceFromSurface(point, heading,
+                                    sense, std::min(distance, maxDistance));
+        }
+        else {
+            thisDistance = shape.distance(point, heading, sense,
+                                          std::min(distance, maxDistance));
+        }
+        IfCounters(++counters.intersections[shape.type];)
+
+        // if it's a smaller distance
+        if (thisDistance < distance && thisDistance <= maxDistance)
+        {
+            distance = thisDistance;
+            nearest  = i;
+        }
+    }
+
+    // only now look up which surface that was
+    if (nearest < numSurfaces) {
+        hitSurface   = _getSurface(nearest);
+        quadricSense = getCodeSense(_codesBegin[nearest]);
+    }
+    else {
+        hitSurface   = NULL;
+        quadricSense = false;
+    }
+
+    // really do this? yes, if intersect is only called if isInsideCell is a
+    // certainty (and there's no limit)
+    Ensure(hitSurface != NULL
+            || maxDistance != std::numeric_limits<double>::infinity());
+    Ensure((hitSurface == NULL)
+            == (distance == std::numeric_limits<double>::infinity()));
+}
+
+/*----------------------------------------------------------------------------*/
+double Cell::safetyDistance(const TVecDbl& position) const
+{
+    if (_numPackedPlanes > 0)
+        return _safetyDistancePlanes(position);
+
+    const double point[3] = {position[0], position[1], position[2]};
+    const unsigned int numSurfaces = getNumBoundingSurfaces();
+
+    double safety = std::numeric_limits<double>::infinity();
+    for (unsigned int i = 0; i < numSurfaces; ++i)
+        safety = std::min(safety, _getShape(i).safetyDistance(point));
+
+    Ensure(safety >= 0.0);
+    return safety;
+}
+
+/*----------------------------------------------------------------------------*/
+bool Cell::_isPointInsidePlanes(
+        const TVecDbl& position,
+        const unsigned int skipIndex) const
+{
+    const unsigned int n = _numPackedPlanes;
+    const double* nx  = &_planeCoefficients[NORMAL_X * n];
+    const double* ny  = &_planeCoefficients[NORMAL_Y * n];
+    const double* nz  = &_planeCoefficients[NORMAL_Z * n];
+    const double* nDotP = &_planeCoefficients[NORMAL_DOT_POINT * n];
+
+    const double x = position[0];
+    const double y = position[1];
+    const double z = position[2];
+
+    // count the planes whose sense disagrees with ours
+    bool         isPositive[MAX_PACKED_PLANES];
+    unsigned int numWrong = 0;
+
+    for (unsigned int i = 0; i < n; ++i) {
+        // same test as Plane::hasPosSense
+        isPositive[i] = ((nx[i] * x + ny[i] * y + nz[i] * z) - nDotP[i] >= 0);
+    }
+    IfCounters(for (unsigned int i = 0; i < n; ++i)
+                   ++GeometryCounters::getThreadCounters()
+                        .senseEvaluations[_getSurface(i)->getType()];)
+
+    for (unsigned int i = 0; i < n; ++i) {
+        if (i != skipIndex)
+            numWrong += (isPositive[i] != getCodeSense(_codesBegin[i]));
+    }
+    const bool isSkipped = (skipIndex < n);
+
+    if (_flags & NEGATED) {
+        // anywhere outside one of our faces (including the one we just
+        // crossed) is inside a negated cell
+        return (numWrong > 0 || isSkipped);
+    }
 
-        // call "intersect" on the quadric, also passing our sense
-        // of the quadric (it->second)
-        it->first->intersect(position, direction, it->second,
-                             thisHit, thisDistance); //(return results)
+    return (numWrong == 0);
+}
+
+/*----------------------------------------------------------------------------*/
+bool Cell::_isPointInsideProfiled(
+        const double* point,
+        const unsigned int skipIndex,
+        const SurfaceSenses* knownSenses) const
+{
+    // a disagreeing surface (or, for a negated cell, the one we crossed)
+    // decides the answer: outside, or inside a negated cell
+    const bool isNegated = (_flags & NEGATED);
+    const unsigned int numSurfaces = getNumBoundingSurfaces();
+
+    for (unsigned int j = 0; j < numSurfaces; ++j) {
+        const unsigned int i = _checkOrder[j];
 
-//        if (thisHit) {
-//            cout << "Calculated an intersection (distance " << thisDistance
-//                 << ") with " << *(it->first) << endl;
-//        } else {
-//            cout << "No intersection with " << *(it->first) << endl;
-//        }
+        if (i == skipIndex) {
+            if (isNegated)
+                return true;
+            continue;
+        }
 
+        _checkCounts[i].checks.fetch_add(1, std::memory_order_relaxed);
 
-        if (thisHit) // if it hits, and if it's a smaller distance
+        if (_hasPosSense(i, point, knownSenses)
+                != getCodeSense(_codesBegin[i]))
         {
-            if (thisDistance < distance)
-            {
-                distance     = thisDistance;
-                hitSurface   = it->first;
-                quadricSense = it->second;
-            }
-//            else if (thisDistance == distance) {
-//                cout << "@@@@@@@ Two surfaces at the same distance!" << endl;
-//                return;
-//                hitSurface   = it->first;
-//                quadricSense = it->second;
-//            }
+            _checkCounts[i].decisions.fetch_add(1,
+                                                std::memory_order_relaxed);
+            return isNegated;
         }
     }
 
-    // really do this? yes, if intersect is only called if isInsideCell is a
-    // certainty
-    Ensure(hitSurface != NULL);
-    Ensure(distance   != std::numeric_limits<double>::infinity());
+    return !isNegated;
+}
+
+/*----------------------------------------------------------------------------*/
+void Cell::_intersectPlanes(
+        const TVecDbl& position,
+        const TVecDbl& direction,
+        Surface*& hitSurface,
+        bool&     hitSense,
+        double&   distance,
+        const double maxDistance,
+        const unsigned int onIndex) const
+{
+    const unsigned int n = _numPackedPlanes;
+    const double* nx   = &_planeCoefficients[NORMAL_X * n];
+    const double* ny   = &_planeCoefficients[NORMAL_Y * n];
+    const double* nz   = &_planeCoefficients[NORMAL_Z * n];
+    const double* px   = &_planeCoefficients[POINT_X * n];
+    const double* py   = &_planeCoefficients[POINT_Y * n];
+    const double* pz   = &_planeCoefficients[POINT_Z * n];
+    const double* sign = &_planeCoefficients[HEADING_SIGN * n];
+
+    const double x  = position[0];
+    const double y  = position[1];
+    const double z  = position[2];
+    const double dx = direction[0];
+    const double dy = direction[1];
+    const double dz = direction[2];
+
+    const double infinity = std::numeric_limits<double>::infinity();
+
+    // distance to every plane, without branching (same arithmetic as
+    // Plane::intersect; planes we're headed away from are infinitely far)
+    double planeDistance[MAX_PACKED_PLANES];
+
+    for (unsigned int i = 0; i < n; ++i) {
+        const double cosine = nx[i] * dx + ny[i] * dy + nz[i] * dz;
+        const double toPlane = nx[i] * (px[i] - x)
+                             + ny[i] * (py[i] - y)
+                             + nz[i] * (pz[i] - z);
+        const double thisDistance = std::max(0.0, toPlane / cosine);
+
+        planeDistance[i] = (sign[i] * cosine > 0 ? thisDistance : infinity);
+    }
+    IfCounters(for (unsigned int i = 0; i < n; ++i)
+                   ++GeometryCounters::getThreadCounters()
+                        .intersections[_getSurface(i)->getType()];)
+
+    // sitting on a plane, we're either leaving through it now or never
+    if (onIndex < n && planeDistance[onIndex] < infinity)
+        planeDistance[onIndex] = 0.0;
+
+    // the first nearest one wins, as in the general case
+    unsigned int nearest = 0;
+    distance = infinity;
+    for (unsigned int i = 0; i < n; ++i) {
+        if (planeDistance[i] < distance) {
+            distance = planeDistance[i];
+            nearest  = i;
+        }
+    }
+
+    // planes are cheap enough that the limit only matters at the end
+    if (distance < infinity && distance <= maxDistance) {
+        hitSurface = _getSurface(nearest);
+        hitSense   = getCodeSense(_codesBegin[nearest]);
+    }
+    else {
+        hitSurface = NULL;
+        hitSense   = false;
+        distance   = infinity;
+    }
+
+    Ensure(hitSurface != NULL || maxDistance != infinity);
+}
+
+/*----------------------------------------------------------------------------*/
+double Cell::_safetyDistancePlanes(const TVecDbl& position) const
+{
+    const unsigned int n = _numPackedPlanes;
+    const double* nx    = &_planeCoefficients[NORMAL_X * n];
+    const double* ny    = &_planeCoefficients[NORMAL_Y * n];
+    const double* nz    = &_planeCoefficients[NORMAL_Z * n];
+    const double* nDotP = &_planeCoefficients[NORMAL_DOT_POINT * n];
+
+    const double x = position[0];
+    const double y = position[1];
+    const double z = position[2];
+
+    // same arithmetic as Plane::safetyDistance
+    double safety = std::numeric_limits<double>::infinity();
+    for (unsigned int i = 0; i < n; ++i) {
+        safety = std::min(safety,
+                std::fabs((nx[i] * x + ny[i] * y + nz[i] * z) - nDotP[i]));
+    }
+
+    return safety;
+}
+
+/*----------------------------------------------------------------------------*/
+void Cell::getBoundingBox(
+        TVecDbl& lower,
+        TVecDbl& upper) const
+{
+    lower = -std::numeric_limits<double>::infinity();
+    upper =  std::numeric_limits<double>::infinity();
+
+    // everything but a bounded region is unbounded
+    if (_flags & NEGATED)
+        return;
+
+    for (unsigned int i = 0; i < getNumBoundingSurfaces(); ++i)
+    {
+        _getSurface(i)->clipBoundingBox(getCodeSense(_codesBegin[i]),
+                                      lower, upper);
+    }
 }
 
 /*============================================================================*/
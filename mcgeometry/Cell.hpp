@@ -8,12 +8,18 @@
 /*----------------------------------------------------------------------------*/
 
 #include <vector>
-#include <list>
-#include <map>
 #include <utility>
+#include <limits>
+#include <atomic>
 
 #include <blitz/tinyvec.h>
 
+#include "transupport/dbc.hpp"
+#include "transupport/AtomicPointerList.hpp"
+#include "SurfaceKernels.hpp"
+#include "TrackState.hpp"
+#include "GeometryCounters.hpp"
+
 //#include <iostream>
 //using std::cout;
 //using std::endl;
@@ -31,6 +37,17 @@ class Surface;
  * connectivity. Currently it also stores a user ID number, which is only to
  * interface with the user.
  *
+ * The bounding surfaces are kept as SurfaceCode values: each is the surface's
+ * internal index, bitwise inverted if the cell is on its negative side. These
+ * are all that isPointInside() and intersect() read besides the surfaces'
+ * copied parameters; pointers to the Surface objects themselves, the user ID,
+ * and other bookkeeping are kept apart from them and only touched once an
+ * answer is found.
+ *
+ * The connectivity is learned during transport, possibly by several threads
+ * at once: each neighborhood is an append-only list that can be read without
+ * locking while another thread adds to it.
+ *
  * Using the NEGATED flag is useful for creating a dead cell on the outside of
  * a complex surface. (For example, for a cube with complex geometry inside
  * and nothing outside, it is easier to make the "outside" cell the inverse of
@@ -41,8 +58,6 @@ class Cell {
 public:
     //! Blitz++ TinyVector of length D stores position/direction/etc.
     typedef blitz::TinyVector<double, 3> TVecDbl;
-    //! User's cell IDs are unsigned ints for now.
-    typedef unsigned int UserCellIdType;
 
 public:
     //! bit flags with details about the cells
@@ -62,15 +77,17 @@ public:
     //! A vector of Surface/sense pairs (e.g. for bounding surfaces)
     typedef std::vector<SurfaceAndSense>       SASVec;
 
+    //! A surface's internal index, inverted (negative) for a negative sense
+    typedef int                                SurfaceCode;
+
     /*! \brief A container of pointers to Cells for neighborhood connectivity.
      *
-     * A std::list is used because this will be continually modified, and the
-     * cost of reallocation is high.
+     * A linked list is used because this will be continually modified, and
+     * the cost of reallocation is high; it is lock-free so that threads
+     * sharing the geometry never wait on each other to read it. The first
+     * neighbor (usually the only one) is stored inline.
      */
-    typedef std::list< Cell* > CellContainer;
-
-    //! Map our surfaces to vectors of other cells attached to that surface.
-    typedef std::map< Surface*, CellContainer > HoodMap;
+    typedef tranSupport::AtomicPointerList< Cell > CellContainer;
 
 public:
     /*******************************/
@@ -80,53 +97,174 @@ public:
 
     /*******************************/
     /*! Constructor takes a list of bounding surface/senses, and also requires
-     * a user ID to store along with MCGeometry's internal index. Finally, it
-     * uses CellFlags to determine whether it is dead, negated, etc.
+     * MCGeometry's internal index (the user ID is kept by MCGeometry).
+     * Finally, it uses CellFlags to determine whether it is dead, negated,
+     * etc.
      */
     Cell(   const SASVec& boundingSurfaces,
-            const UserCellIdType userId,
             const unsigned int internalIndex,
             const CellFlags flags = NONE);
 
-    //! The destructor doesn't have to do anything.
-    ~Cell() {
-        /* * */
+    /*! Construct with bounding surface codes that are already packed into
+     * externally owned storage (as after relocateSurfaceCodes()), which must
+     * outlive us. The surfaces are looked up by index in \c surfaceTable.
+     * This saves a copy when loading a stored geometry.
+     */
+    Cell(   const SurfaceCode* codesBegin,
+            const SurfaceCode* codesEnd,
+            Surface* const* surfaceTable,
+            const unsigned int internalIndex,
+            const CellFlags flags = NONE);
+
+    //! Free our per-surface arrays.
+    ~Cell();
+
+    //! Encode a surface's internal index and sense.
+    static SurfaceCode encodeSurface(const unsigned int index, const bool sense)
+    {
+        Require(index <= static_cast<unsigned int>(
+                                std::numeric_limits<SurfaceCode>::max()));
+        return (sense ? static_cast<SurfaceCode>(index)
+                      : ~static_cast<SurfaceCode>(index));
+    }
+
+    //! Internal index of an encoded surface.
+    static unsigned int getCodeIndex(const SurfaceCode code) {
+        return (code >= 0 ? code : ~code);
+    }
+
+    //! Sense of an encoded surface.
+    static bool getCodeSense(const SurfaceCode code) {
+        return (code >= 0);
     }
 
-    //! Get our list of bounding surfaces.
-    const SASVec& getBoundingSurfaces() const {
-        return _boundingSurfaces;
+    //! Beginning of our encoded bounding surfaces.
+    const SurfaceCode* beginSurfaceCodes() const {
+        return _codesBegin;
     }
 
-    //! Get a writeable list of known cell neighbors for a quadric.
-    CellContainer& getNeighbors(Surface* surface) {
-//        HoodMap::iterator findResult = _hood.find(surface);
-//        Require(findResult != _hood.end());
-//
-//        return findResult->second;
-        // this may create new surface connections
-        return _hood[surface];
+    //! End of our encoded bounding surfaces.
+    const SurfaceCode* endSurfaceCodes() const {
+        return _codesEnd;
     }
 
+    //! Number of bounding surfaces.
+    unsigned int getNumBoundingSurfaces() const {
+        return _codesEnd - _codesBegin;
+    }
+
+    //! One of our bounding surfaces and its sense.
+    SurfaceAndSense getBoundingSurface(const unsigned int i) const {
+        Require(i < getNumBoundingSurfaces());
+        return SurfaceAndSense(_getSurface(i), getCodeSense(_codesBegin[i]));
+    }
+
+    /*! \brief Move our surface codes into externally owned storage.
+     *
+     * MCGeometry uses this to pack every cell's codes into one contiguous
+     * array. The storage must have room for getNumBoundingSurfaces() entries
+     * and must outlive us. Returns one past the last entry written.
+     */
+    SurfaceCode* relocateSurfaceCodes(SurfaceCode* storage);
+
+    /*! \brief Look up our surfaces in a geometry's tables of them.
+     *
+     * Until this is called, we keep our own list of our surfaces and copy of
+     * their kinds and parameters. MCGeometry calls this when input is
+     * completed (after relocateSurfaceCodes()), so that a surface shared by
+     * many cells is stored once: \c surfaces and \c types have an entry for
+     * each surface index, and \c parameters has a row of
+     * Surface::MAX_PARAMETERS for each. They must all outlive us.
+     */
+    void useSurfaceTables(Surface* const* surfaces,
+                          const unsigned char* types,
+                          const double* parameters);
+
+    //! Get the list of known cell neighbors for one of our quadrics.
+    const CellContainer& getNeighbors(const Surface* surface) const {
+        const unsigned int i = _findBoundingSurface(surface);
+        Require(i < getNumBoundingSurfaces());
+
+        return _hood[i];
+    }
+
+    /*! \brief Add a cell to the neighborhood across one of our quadrics.
+     *
+     * This may be called by several threads at once, and while others are
+     * reading getNeighbors(). A cell already in the neighborhood is not added
+     * again, and a surface that does not bound us is ignored.
+     *
+     * Returns true if this is the first neighbor known across that surface.
+     */
+    bool addNeighbor(const Surface* surface, Cell* neighbor);
+
+    /*! \brief Check the neighbors found most often first.
+     *
+     * Each neighborhood is sorted by how often its cells were found across
+     * the surface (see CellContainer::recordHit). No other thread may be
+     * reading or adding neighbors meanwhile.
+     */
+    void sortNeighbors();
+
     //! Return the internal index (needed for turning "neighbor" to index).
     const unsigned int& getIndex() const {
         return _internalIndex;
     }
 
-    //! Return the user ID.
-    const UserCellIdType& getUserId() const {
-        return _userId;
-    }
-
     /*! \brief See if our cell contains the point.
      *
      * Optionally skip checking Surface::isPointInside() on one surface if we
      * know we've crossed it.
      * We check by comparing the "sense" of each of our surface to what the
      * surface says about the position's sense relative to it.
+     *
+     * The surfaces are evaluated from tables of their parameters, without
+     * virtual calls. A cell bounded only by planes checks all of them at once
+     * from packed coefficients.
+     *
+     * Other cells don't evaluate surfaces whose sense is in \c knownSenses
+     * (if given), except planes, which are no dearer to evaluate than to
+     * look up.
+     * They stop at the first surface that decides the answer, checking the
+     * surfaces in the order set by sortSurfaceChecks().
      */
     bool isPointInside(const TVecDbl& position,
-                       const Surface* surfaceToSkip = NULL) const;
+                       const Surface* surfaceToSkip = NULL,
+                       const SurfaceSenses* knownSenses = NULL) const;
+
+    /*! \brief Make the table hold the senses of a point in this cell.
+     *
+     * A point inside the cell has the cell's sense of each of its bounding
+     * surfaces, so cells sharing them needn't evaluate them. Only the ones
+     * isPointInside() would look up are recorded, and only if the table
+     * doesn't already hold them. If there is nothing worth recording
+     * besides the surface being crossed (as in a cell of planes, or a
+     * negated cell, whose senses say nothing), the table isn't touched and
+     * this returns false.
+     */
+    bool recordSenses(SurfaceSenses& senses,
+                      const Surface* crossedSurface) const;
+
+    /*! \brief Start counting which surfaces decide isPointInside().
+     *
+     * Until sortSurfaceChecks() is called, each check of a surface and each
+     * time it decides the answer is counted (atomically, so tracking threads
+     * may share the cell). Cells bounded only by planes check them all at
+     * once, so they don't count anything. This must not be called
+     * concurrently with anything.
+     */
+    void startCheckProfile();
+
+    /*! \brief Check the surfaces likeliest to decide isPointInside() first.
+     *
+     * Surfaces are ordered by the fraction of their checks that decided the
+     * answer, divided by the relative cost of evaluating their kind of
+     * surface, so that cheap planes that often reject a point go before
+     * quadrics that seldom do. This stops the profile started by
+     * startCheckProfile() (and does nothing without one). It must not be
+     * called concurrently with anything.
+     */
+    void sortSurfaceChecks();
 
     /*! \brief Find the nearest surface to a point in a given direction.
      *
@@ -135,12 +273,47 @@ public:
      * \param[out] hitSurface A pointer to the nearest surface
      * \param[out] hitSense   The surface sense of the intersected surface
      * \param[out] distance   The distance to the nearest surface
+     *
+     * \param[in] maxDistance  Farthest distance of interest
+     * \param[in] onSurface    Surface that the particle is sitting on
+     *
+     * As with isPointInside(), a cell bounded only by planes finds the
+     * distance to all of them in one loop over packed coefficients. The
+     * result is identical to calling Surface::intersect() on each.
+     *
+     * Each surface is only asked whether it's hit sooner than the nearest one
+     * so far (or \c maxDistance), which lets the quadrics skip their square
+     * roots once a nearer surface is known. If no surface is within \c
+     * maxDistance, \c hitSurface is NULL and \c distance is infinite.
+     *
+     * A particle that just crossed \c onSurface is exactly on it, so its
+     * distance comes from SurfaceShape::distanceFromSurface(): a plane can't
+     * be hit again, and a quadric only needs its far root.
      */
     void intersect( const TVecDbl& position,
                     const TVecDbl& direction,
                     Surface*& hitSurface,
                     bool&     hitSense,
-                    double&   distance) const;
+                    double&   distance,
+                    const double maxDistance
+                        = std::numeric_limits<double>::infinity(),
+                    const Surface* onSurface = NULL) const;
+
+    /*! \brief Find how far a point is from the nearest of our surfaces.
+     *
+     * A particle at \c position can move this far in any direction without
+     * leaving the cell. Since our boundary lies on our bounding surfaces,
+     * the nearest of them is never farther away than the boundary itself
+     * (and may be closer, where a surface extends beyond our faces).
+     */
+    double safetyDistance(const TVecDbl& position) const;
+
+    /*! \brief Get a conservative axis-aligned box that contains this cell.
+     *
+     * Directions in which our surfaces don't bound us (and every direction,
+     * for a negated cell) are set to plus or minus infinity.
+     */
+    void getBoundingBox(TVecDbl& lower, TVecDbl& upper) const;
 
     //! Return whether we are a dead cell.
     bool isDeadCell() const {
@@ -153,20 +326,195 @@ public:
     }
 
 private:
-    //! A vector of surfaces and senses that define this Cell.
-    const SASVec _boundingSurfaces;
+    //! Cells hold pointers into their own storage, so disallow copying.
+    Cell(const Cell&);
+    //! Cells hold pointers into their own storage, so disallow assignment.
+    Cell& operator=(const Cell&);
 
-    //! The object that we report to the user.
-    const UserCellIdType _userId;
+    //! Create an empty neighbor list for each bounding surface.
+    void _initNeighborhood();
 
-    //! This Cell's index in the primary MCGeometry Cell* array.
-    const unsigned int _internalIndex;
+    /*! \brief Position of a surface in our bounding surfaces.
+     *
+     * Returns the number of them if it isn't one (or is NULL). The codes are
+     * scanned first; a surface pointer is only read when its index matches
+     * (surfaces that don't belong to a geometry all have index zero).
+     */
+    unsigned int _findBoundingSurface(const Surface* surface) const {
+        const unsigned int numSurfaces = getNumBoundingSurfaces();
+        if (surface == NULL)
+            return numSurfaces;
+
+        const unsigned int index = surface->getIndex();
+
+        unsigned int i = 0;
+        while (i < numSurfaces && (getCodeIndex(_codesBegin[i]) != index
+                                    || _getSurface(i) != surface))
+            ++i;
+        return i;
+    }
+
+    //! Copy our bounding surfaces' kinds and parameters for evaluation.
+    void _packSurfaces();
+
+    //! Row of our surface tables for one of our surfaces.
+    unsigned int _getRow(const unsigned int i) const {
+        // our own rows follow our surfaces; the geometry's follow its own
+        return (_isUsingTables ? getCodeIndex(_codesBegin[i]) : i);
+    }
+
+    //! One of our bounding surfaces.
+    Surface* _getSurface(const unsigned int i) const {
+        return _surfaceRows[_getRow(i)];
+    }
+
+    //! Kind and parameters of one of our surfaces (unless they're packed).
+    SurfaceShape _getShape(const unsigned int i) const {
+        const unsigned int row = _getRow(i);
+        return SurfaceShape(_shapeTypes[row],
+                            _shapeParameters + row * Surface::MAX_PARAMETERS);
+    }
+
+    //! Whether a known sense may be cheaper than evaluating this kind of
+    //! surface (quadrics only).
+    static bool _isWorthLookingUp(const unsigned char type) {
+        return (type > Surface::PLANE_Z);
+    }
+
+    //! Sense of one of our surfaces at a point, unless it's already known.
+    bool _hasPosSense(const unsigned int i,
+                      const double* point,
+                      const SurfaceSenses* knownSenses) const
+    {
+        const SurfaceShape shape = _getShape(i);
+
+        bool sense;
+        if (knownSenses != NULL && _isWorthLookingUp(shape.type)
+                && knownSenses->find(getCodeIndex(_codesBegin[i]), sense))
+            return sense;
+
+        IfCounters(++GeometryCounters::getThreadCounters().senseEvaluations[
+                        shape.type];)
+        return shape.hasPosSense(point);
+    }
+
+    //! isPointInside() using the packed plane coefficients.
+    bool _isPointInsidePlanes(const TVecDbl& position,
+                              const unsigned int skipIndex) const;
+
+    //! isPointInside() while counting which surfaces decide it.
+    bool _isPointInsideProfiled(const double* point,
+                                const unsigned int skipIndex,
+                                const SurfaceSenses* knownSenses) const;
+
+    //! intersect() using the packed plane coefficients.
+    void _intersectPlanes(  const TVecDbl& position,
+                            const TVecDbl& direction,
+                            Surface*& hitSurface,
+                            bool&     hitSense,
+                            double&   distance,
+                            const double maxDistance,
+                            const unsigned int onIndex) const;
+
+    //! safetyDistance() using the packed plane coefficients.
+    double _safetyDistancePlanes(const TVecDbl& position) const;
+
+    //! Most bounding planes that we pack (more take the general path).
+    enum { MAX_PACKED_PLANES = 16 };
+
+    //! Rows of the packed plane coefficients.
+    enum PlaneRow {
+        NORMAL_X = 0,     //!< Plane normal
+        NORMAL_Y,
+        NORMAL_Z,
+        POINT_X,          //!< Point on the plane
+        POINT_Y,
+        POINT_Z,
+        NORMAL_DOT_POINT, //!< Normal dotted with the point
+        HEADING_SIGN,     //!< +1 (-1) if we're on the negative (positive) side
+        NUM_PLANE_ROWS
+    };
+
+    //! How often isPointInside() checked one of our shapes while profiling
+    struct CheckCounts {
+        std::atomic<unsigned long> checks;    //!< Times it was evaluated
+        std::atomic<unsigned long> decisions; //!< Times it decided the answer
+    };
+
+    //! What we keep of our own until we use the geometry's tables
+    struct OwnSurfaces {
+        //! Encoded surfaces that define this Cell, until they're relocated
+        std::vector<SurfaceCode>   codes;
+        //! Pointers to our bounding surfaces, parallel to the codes
+        std::vector<Surface*>      surfaces;
+        //! Kinds of our surfaces (unless they're packed planes)
+        std::vector<unsigned char> shapeTypes;
+        //! Parameters of our surfaces, Surface::MAX_PARAMETERS apiece
+        std::vector<double>        shapeParameters;
+    };
+
+    // ===== data read while tracking (every array is allocated with one
+    // entry per bounding surface, or none, so no sizes are stored)
+
+    //! Start of the encoded surfaces that define this Cell.
+    const SurfaceCode* _codesBegin;
+
+    //! End of the encoded surfaces that define this Cell.
+    const SurfaceCode* _codesEnd;
+
+    /*! \brief Our bounding surfaces, in rows like \c _shapeTypes.
+     *
+     * These point to our own copies (a row for each bounding surface) until
+     * useSurfaceTables() points them at the geometry's (a row for each
+     * surface index).
+     */
+    Surface* const* _surfaceRows;
+
+    /*! \brief Kinds of our bounding surfaces, if they aren't packed planes.
+     *
+     * With \c _shapeParameters, this lets intersect() and isPointInside()
+     * evaluate our surfaces with a switch rather than a virtual call. It is
+     * NULL for packed planes.
+     */
+    const unsigned char* _shapeTypes;
+
+    //! Parameters of our bounding surfaces, in rows like \c _shapeTypes.
+    const double* _shapeParameters;
+
+    /*! \brief Coefficients of our bounding planes, if they're all planes.
+     *
+     * Row \c r of plane \c i is at <tt>r * _numPackedPlanes + i</tt>, so each
+     * row is contiguous and every plane can be done at once in one loop.
+     */
+    double* _planeCoefficients;
+
+    //! Order in which isPointInside() checks our shapes (NULL when packed).
+    unsigned int* _checkOrder;
+
+    //! Counts for each shape (NULL unless we're profiling).
+    CheckCounts* _checkCounts;
+
+    //! Connectivity to other cells through each surface, parallel to our
+    //! bounding surfaces (the array itself is never changed after
+    //! construction, only the lists it holds).
+    CellContainer* _hood;
 
     //! Other information about this cell.
     const CellFlags _flags;
 
-    //! Connectivity to other cells through each surface.
-    HoodMap _hood;
+    //! Number of packed planes (zero if we aren't bounded only by planes).
+    unsigned int _numPackedPlanes;
+
+    //! This Cell's index in the primary MCGeometry Cell* array.
+    const unsigned int _internalIndex;
+
+    //! Whether our rows are in the geometry's tables (see _surfaceRows).
+    bool _isUsingTables;
+
+    // ===== data for setup
+
+    //! Our own surfaces, until we use the geometry's tables (then NULL).
+    OwnSurfaces* _own;
 };
 /*============================================================================*/
 } // end namespace mcGeometry
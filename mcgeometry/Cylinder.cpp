@@ -6,6 +6,8 @@
 /*----------------------------------------------------------------------------*/
 #include "Cylinder.hpp"
 
+#include <algorithm>
+#include <cmath>
 #include <ostream>
 
 #include "transupport/dbc.hpp"
@@ -33,7 +35,8 @@ void Cylinder::intersect(
         const TVecDbl& position,
         const TVecDbl& direction,
         const bool posSense,
-        bool& hit, double& distance) const
+        bool& hit, double& distance,
+        const double maxDistance) const
 {
     Require(tranSupport::checkDirectionVector(direction));
 
@@ -50,7 +53,7 @@ void Cylinder::intersect(
     temp = blitz::dot(trPos, _axis);
     double C = blitz::dot(trPos, trPos) - temp*temp - _radius*_radius;
 
-    _calcQuadraticIntersect(A, B, C, posSense, hit, distance);
+    _calcQuadraticIntersect(A, B, C, posSense, maxDistance, hit, distance);
 }
 
 /*----------------------------------------------------------------------------*/
@@ -72,6 +75,22 @@ void Cylinder::normalAtPoint(
     Ensure(tranSupport::checkDirectionVector(unitNormal));
 }
 
+/*----------------------------------------------------------------------------*/
+// With rho the distance to the axis, the distance to the cylinder is
+// |rho - R| = |rho^2 - R^2| / (rho + R).
+double Cylinder::safetyDistance(const TVecDbl& position) const
+{
+    TVecDbl trPos(position - _pointOnAxis);
+
+    double b = blitz::dot(trPos, _axis);
+
+    // (roundoff could make this slightly negative on the axis)
+    double rhoSquared = std::max(0.0, blitz::dot(trPos, trPos) - b*b);
+
+    return std::fabs(rhoSquared - _radius*_radius)
+            / (std::sqrt(rhoSquared) + _radius);
+}
+
 /*----------------------------------------------------------------------------*/
 std::ostream& Cylinder::printStream( std::ostream& os ) const
 {
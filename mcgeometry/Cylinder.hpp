@@ -7,6 +7,8 @@
 #define MCG_CYLINDER_HPP
 /*----------------------------------------------------------------------------*/
 
+#include <algorithm>
+#include <limits>
 #include <blitz/tinyvec.h>
 #include "transupport/dbc.hpp"
 #include "transupport/blitzStuff.hpp"
@@ -53,6 +55,25 @@ public:
         return new Cylinder(*this, newId);
     }
 
+    //! Create a copy of the surface in an arena.
+    Surface* clone(const UserSurfaceIdType& newId,
+                   tranSupport::Arena& arena) const
+    {
+        return new (arena.allocate< Cylinder >()) Cylinder(*this, newId);
+    }
+
+    //! Which kind of surface we are.
+    SurfaceType getType() const {
+        return CYLINDER;
+    }
+
+    //! Write a point on our axis, the axis, and our radius.
+    void getParameters(double* parameters) const {
+        std::copy(_pointOnAxis.begin(), _pointOnAxis.end(), parameters);
+        std::copy(_axis.begin(), _axis.end(), parameters + 3);
+        parameters[6] = _radius;
+    }
+
     ~Cylinder() { /* * */ }
 
     //! Calculate whether a point has a positive sense to this surface
@@ -63,11 +84,16 @@ public:
                     const TVecDbl& direction,
                     const bool PosSense,
                     bool& hit,
-                    double& distance) const;
+                    double& distance,
+                    const double maxDistance
+                        = std::numeric_limits<double>::infinity()) const;
 
     //! Calculate the surface normal at a point
     void normalAtPoint( const TVecDbl& position,
                         TVecDbl& unitNormal) const;
+
+    //! Distance from a point to the nearest point on the surface
+    double safetyDistance(const TVecDbl& position) const;
 protected:
     //! Output to a stream
     std::ostream& printStream( std::ostream& os ) const;
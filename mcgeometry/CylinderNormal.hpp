@@ -7,6 +7,8 @@
 #define mcgeometry_CylinderNormal_hpp
 /*----------------------------------------------------------------------------*/
 
+#include <algorithm>
+#include <limits>
 #include <blitz/tinyvec.h>
 #include "transupport/dbc.hpp"
 #include "transupport/blitzStuff.hpp"
@@ -35,6 +37,7 @@ public:
     CylinderNormal(const CylinderNormal<axis>& oldCylinder,
                    const UserSurfaceIdType& newId)
         : Surface(oldCylinder, newId),
+          _pointOnAxis(oldCylinder._pointOnAxis),
           _radius(oldCylinder._radius)
     { /* * */ }
 
@@ -44,6 +47,25 @@ public:
         return new CylinderNormal<axis>(*this, newId);
     }
 
+    //! Create a copy of the surface in an arena.
+    Surface* clone(const UserSurfaceIdType& newId,
+                   tranSupport::Arena& arena) const
+    {
+        void* storage = arena.allocate< CylinderNormal<axis> >();
+        return new (storage) CylinderNormal<axis>(*this, newId);
+    }
+
+    //! Which kind of surface we are.
+    SurfaceType getType() const {
+        return static_cast<SurfaceType>(CYLINDER_X + axis);
+    }
+
+    //! Write a point on our axis and our radius.
+    void getParameters(double* parameters) const {
+        std::copy(_pointOnAxis.begin(), _pointOnAxis.end(), parameters);
+        parameters[3] = _radius;
+    }
+
     ~CylinderNormal() { /* * */ }
 
     //! Calculate whether a point has a positive sense to this surface
@@ -54,11 +76,22 @@ public:
                     const TVecDbl& direction,
                     const bool PosSense,
                     bool& hit,
-                    double& distance) const;
+                    double& distance,
+                    const double maxDistance
+                        = std::numeric_limits<double>::infinity()) const;
 
     //! Calculate the surface normal at a point
     void normalAtPoint( const TVecDbl& position,
                         TVecDbl& unitNormal) const;
+
+    //! Distance from a point to the nearest point on the surface
+    double safetyDistance(const TVecDbl& position) const;
+
+    //! Shrink an axis-aligned box to one side of the surface.
+    void clipBoundingBox(   const bool posSense,
+                            TVecDbl& lower,
+                            TVecDbl& upper) const;
+
     //! output to a stream
     std::ostream& printStream( std::ostream& os ) const;
 protected:
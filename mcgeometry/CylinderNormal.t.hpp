@@ -8,6 +8,8 @@
 /*----------------------------------------------------------------------------*/
 #include "CylinderNormal.hpp"
 
+#include <algorithm>
+#include <cmath>
 #include <ostream>
 
 #include "transupport/dbc.hpp"
@@ -29,7 +31,8 @@ void CylinderNormal<axis>::intersect(
                 const TVecDbl& position,
                 const TVecDbl& direction,
                 const bool posSense,
-                bool& hit, double& distance) const
+                bool& hit, double& distance,
+                const double maxDistance) const
 {
     double A = 1 - direction[axis] * direction[axis];
 
@@ -41,7 +44,7 @@ void CylinderNormal<axis>::intersect(
 
     double C = _dotProduct(trPos, trPos) - _radius*_radius;
 
-    _calcQuadraticIntersect(A, B, C, posSense, hit, distance);
+    _calcQuadraticIntersect(A, B, C, posSense, maxDistance, hit, distance);
 }
 /*----------------------------------------------------------------------------*/
 template<unsigned int axis>
@@ -63,6 +66,38 @@ void CylinderNormal<axis>::normalAtPoint(
 }
 /*----------------------------------------------------------------------------*/
 template<unsigned int axis>
+double CylinderNormal<axis>::safetyDistance(const TVecDbl& position) const
+{
+    TVecDbl trPos(position - _pointOnAxis);
+
+    const double rhoSquared = _dotProduct(trPos, trPos);
+
+    // |rho - R|, calculated from the quadric as in Sphere::safetyDistance
+    return std::fabs(rhoSquared - _radius * _radius)
+            / (std::sqrt(rhoSquared) + _radius);
+}
+/*----------------------------------------------------------------------------*/
+template<unsigned int axis>
+void CylinderNormal<axis>::clipBoundingBox(
+                        const bool posSense,
+                        TVecDbl& lower,
+                        TVecDbl& upper) const
+{
+    // the outside of a cylinder is unbounded, and so is the inside along
+    // the axis
+    if (posSense)
+        return;
+
+    for (unsigned int i = 0; i < 3; ++i) {
+        if (i == axis)
+            continue;
+
+        lower[i] = std::max(lower[i], _pointOnAxis[i] - _radius);
+        upper[i] = std::min(upper[i], _pointOnAxis[i] + _radius);
+    }
+}
+/*----------------------------------------------------------------------------*/
+template<unsigned int axis>
 std::ostream& CylinderNormal<axis>::printStream( std::ostream& os ) const
 {
     os  << "[ CYL" << 'X' + axis
@@ -0,0 +1,137 @@
+/*!
+ * \file   GeometryCounters.cpp
+ * \brief  Contains implementation for \c GeometryCounters
+ * \author Seth R. Johnson
+ */
+/*----------------------------------------------------------------------------*/
+#include "GeometryCounters.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <ostream>
+
+namespace mcGeometry {
+//! \cond
+namespace {
+/*----------------------------------------------------------------------------*/
+//! Each thread's counts, whatever started the thread (zero-initialized, as
+//! thread storage always is, so no thread pays for a constructor)
+thread_local GeometryCounters threadCounters;
+
+//! Names of the resolutions, for printing
+const char* const RESOLUTION_NAMES[GeometryCounters::NUM_RESOLUTIONS] = {
+    "structured grid",
+    "neighborhood",
+    "surface connectivity",
+    "global search",
+    "lattice element",
+    "periodic partner",
+    "reflection"
+};
+
+//! Names of the surface types, for printing
+const char* const SURFACE_TYPE_NAMES[Surface::NUM_SURFACE_TYPES] = {
+    "Plane",
+    "PlaneX",
+    "PlaneY",
+    "PlaneZ",
+    "Sphere",
+    "SphereO",
+    "Cylinder",
+    "CylinderX",
+    "CylinderY",
+    "CylinderZ"
+};
+
+//! Add one array of counts into another
+template<unsigned int N>
+void addCounts(GeometryCounters::Count (&sum)[N],
+               const GeometryCounters::Count (&counts)[N])
+{
+    for (unsigned int i = 0; i < N; ++i)
+        sum[i] += counts[i];
+}
+/*----------------------------------------------------------------------------*/
+} // end anonymous namespace
+//! \endcond
+
+/*============================================================================*/
+void GeometryCounters::clear()
+{
+    std::fill(resolutions, resolutions + NUM_RESOLUTIONS, 0);
+    bumps            = 0;
+    lost             = 0;
+    pointInsideCalls = 0;
+    std::fill(senseEvaluations, senseEvaluations + Surface::NUM_SURFACE_TYPES,
+              0);
+    std::fill(intersections, intersections + Surface::NUM_SURFACE_TYPES, 0);
+}
+
+/*----------------------------------------------------------------------------*/
+void GeometryCounters::merge(const GeometryCounters& other)
+{
+    addCounts(resolutions, other.resolutions);
+    bumps            += other.bumps;
+    lost             += other.lost;
+    pointInsideCalls += other.pointInsideCalls;
+    addCounts(senseEvaluations, other.senseEvaluations);
+    addCounts(intersections, other.intersections);
+}
+
+/*----------------------------------------------------------------------------*/
+GeometryCounters::Count GeometryCounters::getNumCrossings() const
+{
+    Count numCrossings = lost;
+    for (unsigned int i = 0; i < NUM_RESOLUTIONS; ++i)
+        numCrossings += resolutions[i];
+    return numCrossings;
+}
+
+/*----------------------------------------------------------------------------*/
+double GeometryCounters::perCrossing(const Count count) const
+{
+    const Count numCrossings = getNumCrossings();
+    if (numCrossings == 0)
+        return 0.0;
+    return static_cast<double>(count) / numCrossings;
+}
+
+/*----------------------------------------------------------------------------*/
+std::ostream& GeometryCounters::print(std::ostream& os) const
+{
+    os << "Geometry counters";
+    if (!isEnabled())
+        os << " (not built with USE_GEOMETRY_COUNTERS)";
+    os << "\n";
+
+    os << std::setw(24) << "crossings" << std::setw(14)
+       << getNumCrossings() << "\n";
+    for (unsigned int i = 0; i < NUM_RESOLUTIONS; ++i) {
+        os << std::setw(24) << RESOLUTION_NAMES[i] << std::setw(14)
+           << resolutions[i] << "\n";
+    }
+    os << std::setw(24) << "bumps" << std::setw(14) << bumps << "\n"
+       << std::setw(24) << "lost"  << std::setw(14) << lost  << "\n";
+
+    os << std::setw(24) << "per crossing:" << std::setw(14) << "senses"
+       << std::setw(14) << "distances" << "\n";
+    os << std::setw(24) << "isPointInside" << std::setw(14)
+       << perCrossing(pointInsideCalls) << "\n";
+    for (unsigned int t = 0; t < Surface::NUM_SURFACE_TYPES; ++t) {
+        if (senseEvaluations[t] == 0 && intersections[t] == 0)
+            continue;
+        os << std::setw(24) << SURFACE_TYPE_NAMES[t]
+           << std::setw(14) << perCrossing(senseEvaluations[t])
+           << std::setw(14) << perCrossing(intersections[t]) << "\n";
+    }
+    return os;
+}
+
+/*----------------------------------------------------------------------------*/
+GeometryCounters& GeometryCounters::getThreadCounters()
+{
+    return threadCounters;
+}
+
+/*============================================================================*/
+} // end namespace mcGeometry
@@ -0,0 +1,99 @@
+/*!
+ * \file   GeometryCounters.hpp
+ * \brief  Contains interface for GeometryCounters struct
+ * \author Seth R. Johnson
+ */
+#ifndef MCG_GEOMETRYCOUNTERS_HPP
+#define MCG_GEOMETRYCOUNTERS_HPP
+/*----------------------------------------------------------------------------*/
+
+#include <iosfwd>
+
+#include "Surface.hpp"
+
+//! \brief Profiling code that only exists when geometry counters are built
+#ifdef MCG_COUNTERS
+#define IfCounters(code) code
+#else
+#define IfCounters(code)
+#endif
+
+namespace mcGeometry {
+/*============================================================================*/
+
+/*!
+ * \struct GeometryCounters
+ * \brief Tallies of what the geometry did while tracking.
+ *
+ * When the library is configured with USE_GEOMETRY_COUNTERS, MCGeometry and
+ * Cell count how each crossing found its new cell, how many particles were
+ * bumped or lost, and how many surfaces were evaluated of each type. Without
+ * it, the counting code isn't compiled at all and every count stays zero.
+ *
+ * Each thread counts into its own thread-local copy, whether it was started
+ * by OpenMP or by the caller, so nothing is shared while tracking. To see a
+ * whole run, have each thread merge() its getThreadCounters() into a total
+ * (in a critical section) and clear() it.
+ *
+ * This is a plain aggregate, so the thread-local copies start at zero
+ * without a constructor; any other instance should be cleared before use.
+ */
+struct GeometryCounters {
+    //! Ways findNewCell() can find the cell on the other side
+    enum Resolution {
+        IN_GRID = 0,        //!< The next box of a structured grid
+        IN_NEIGHBORHOOD,    //!< A neighbor the old cell already knew of
+        BY_CONNECTIVITY,    //!< A cell bounded by the crossed surface
+        BY_GLOBAL_SEARCH,   //!< Searching every cell in the universe
+        ACROSS_LATTICE,     //!< A cell in the next lattice element
+        ACROSS_PERIODIC,    //!< A cell on the periodic partner surface
+        REFLECTED_BACK,     //!< The same cell, off a reflecting surface
+        NUM_RESOLUTIONS
+    };
+
+    typedef unsigned long Count;
+
+    //! Crossings resolved each way
+    Count resolutions[NUM_RESOLUTIONS];
+    //! Crossings where the particle was nudged off a zero distance
+    Count bumps;
+    //! Crossings where the new cell couldn't be found
+    Count lost;
+    //! Calls to Cell::isPointInside()
+    Count pointInsideCalls;
+    //! Surface senses evaluated in isPointInside(), by surface type
+    Count senseEvaluations[Surface::NUM_SURFACE_TYPES];
+    //! Surface distances evaluated in Cell::intersect(), by surface type
+    Count intersections[Surface::NUM_SURFACE_TYPES];
+
+    //! Zero every count.
+    void clear();
+
+    //! Add another set of counts into this one.
+    void merge(const GeometryCounters& other);
+
+    //! Crossings of every kind, including lost ones.
+    Count getNumCrossings() const;
+
+    //! Average of a count over the crossings (zero if there weren't any).
+    double perCrossing(const Count count) const;
+
+    //! Write a table of the counts and their averages per crossing.
+    std::ostream& print(std::ostream& os) const;
+
+    //! Counts for the calling thread.
+    static GeometryCounters& getThreadCounters();
+
+    //! Whether the geometry was built to count anything.
+    static bool isEnabled() {
+#ifdef MCG_COUNTERS
+        return true;
+#else
+        return false;
+#endif
+    }
+};
+
+/*============================================================================*/
+} // end namespace mcGeometry
+#endif
@@ -0,0 +1,286 @@
+/*!
+ * \file   Lattice.cpp
+ * \brief  Contains implementation for \c Lattice
+ * \author Seth R. Johnson
+ */
+/*----------------------------------------------------------------------------*/
+#include "Lattice.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "transupport/dbc.hpp"
+
+namespace mcGeometry {
+//! \cond
+namespace {
+/*----------------------------------------------------------------------------*/
+//! Half the square root of three (height of a unit hexagon's row)
+const double SQRT3_2 = 0.86602540378443864676;
+
+//! Normals to the three pairs of sides of a hexagon, and how (q, r) changes
+//! crossing the side on the positive end of each
+const double HEX_NORMAL[3][2] = {{1.0, 0.0}, {0.5, SQRT3_2}, {-0.5, SQRT3_2}};
+const int    HEX_STEP[3][2]   = {{1, 0}, {0, 1}, {-1, 1}};
+
+//! Distance to whichever of two walls at +/- halfWidth we're heading toward
+inline double distanceToSlab(
+        const double halfWidth,
+        const double position,
+        const double cosine)
+{
+    const double wall = (cosine > 0 ? halfWidth : -halfWidth);
+    return std::max(0.0, (wall - position) / cosine);
+}
+/*----------------------------------------------------------------------------*/
+} // end anonymous namespace
+//! \endcond
+
+/*============================================================================*/
+Lattice::Lattice(
+        const TVecDbl& lowerCorner,
+        const TVecDbl& pitch,
+        const unsigned int numElements[3],
+        const std::vector<unsigned int>& universes) :
+    _type(RECTANGULAR),
+    _origin(lowerCorner),
+    _pitch(pitch),
+    _universes(universes)
+{
+    for (unsigned int a = 0; a < 3; ++a) {
+        Insist(pitch[a] > 0.0, "Lattice pitch must be positive.");
+        Insist(numElements[a] > 0, "Lattice must have elements.");
+        _size[a] = numElements[a];
+    }
+    Insist(universes.size() == static_cast<unsigned int>(
+                                    _size[0] * _size[1] * _size[2]),
+            "Wrong number of universes given for the lattice.");
+}
+
+/*----------------------------------------------------------------------------*/
+Lattice::Lattice(
+        const TVecDbl& origin,
+        const double pitch,
+        const double height,
+        const unsigned int numRings,
+        const unsigned int numLayers,
+        const std::vector<unsigned int>& universes) :
+    _type(HEXAGONAL),
+    _origin(origin),
+    _pitch(pitch, pitch, height),
+    _universes(universes)
+{
+    Insist(pitch > 0.0 && height > 0.0, "Lattice pitch must be positive.");
+    Insist(numRings > 0 && numLayers > 0, "Lattice must have elements.");
+
+    _size[0] = 2 * numRings - 1;
+    _size[1] = 2 * numRings - 1;
+    _size[2] = numLayers;
+
+    Insist(universes.size() == static_cast<unsigned int>(
+                                    _size[0] * _size[1] * _size[2]),
+            "Wrong number of universes given for the lattice.");
+}
+
+/*----------------------------------------------------------------------------*/
+bool Lattice::isInArray(const int element[3]) const
+{
+    if (element[2] < 0 || element[2] >= _size[2])
+        return false;
+
+    if (_type == RECTANGULAR) {
+        return (element[0] >= 0 && element[0] < _size[0]
+                && element[1] >= 0 && element[1] < _size[1]);
+    }
+
+    // within the rings around the center
+    const int maxRing = _size[0] / 2;
+    return (std::abs(element[0]) <= maxRing
+            && std::abs(element[1]) <= maxRing
+            && std::abs(element[0] + element[1]) <= maxRing);
+}
+
+/*----------------------------------------------------------------------------*/
+bool Lattice::findElement(const TVecDbl& position, int element[3]) const
+{
+    // layers (or boxes along z) are the same either way
+    const int lastLayer = _size[2] - 1;
+    element[2] = static_cast<int>(
+                    std::floor((position[2] - _origin[2]) / _pitch[2]));
+    element[2] = std::min(std::max(element[2], 0), lastLayer);
+
+    if (_type == RECTANGULAR) {
+        for (unsigned int a = 0; a < 2; ++a) {
+            element[a] = static_cast<int>(
+                    std::floor((position[a] - _origin[a]) / _pitch[a]));
+            element[a] = std::min(std::max(element[a], 0), _size[a] - 1);
+        }
+        return true;
+    }
+
+    // fractional axial coordinates, rounded to the nearest hexagon by
+    // rounding all three cube coordinates and fixing the worst one
+    const double r = (position[1] - _origin[1]) / (_pitch[0] * SQRT3_2);
+    const double q = (position[0] - _origin[0]) / _pitch[0] - 0.5 * r;
+    const double s = -q - r;
+
+    double roundQ = std::floor(q + 0.5);
+    double roundR = std::floor(r + 0.5);
+    double roundS = std::floor(s + 0.5);
+
+    const double errorQ = std::fabs(roundQ - q);
+    const double errorR = std::fabs(roundR - r);
+    const double errorS = std::fabs(roundS - s);
+
+    if (errorQ > errorR && errorQ > errorS)
+        roundQ = -roundR - roundS;
+    else if (errorR > errorS)
+        roundR = -roundQ - roundS;
+
+    element[0] = static_cast<int>(roundQ);
+    element[1] = static_cast<int>(roundR);
+
+    return isInArray(element);
+}
+
+/*----------------------------------------------------------------------------*/
+Lattice::TVecDbl Lattice::getCenter(const int element[3]) const
+{
+    TVecDbl center;
+    center[2] = _origin[2] + (element[2] + 0.5) * _pitch[2];
+
+    if (_type == RECTANGULAR) {
+        center[0] = _origin[0] + (element[0] + 0.5) * _pitch[0];
+        center[1] = _origin[1] + (element[1] + 0.5) * _pitch[1];
+    } else {
+        center[0] = _origin[0] + _pitch[0] * (element[0] + 0.5 * element[1]);
+        center[1] = _origin[1] + _pitch[0] * SQRT3_2 * element[1];
+    }
+    return center;
+}
+
+/*----------------------------------------------------------------------------*/
+double Lattice::findWall(
+        const TVecDbl& localPosition,
+        const TVecDbl& direction,
+        const int element[3],
+        int step[3]) const
+{
+    double distance = std::numeric_limits<double>::infinity();
+    step[0] = step[1] = step[2] = 0;
+
+    // the walls between layers (or boxes along z)
+    if (direction[2] != 0) {
+        const int next = element[2] + (direction[2] > 0 ? 1 : -1);
+        if (next >= 0 && next < _size[2]) {
+            distance = distanceToSlab(0.5 * _pitch[2], localPosition[2],
+                                      direction[2]);
+            step[2] = next - element[2];
+        }
+    }
+
+    if (_type == RECTANGULAR) {
+        for (unsigned int a = 0; a < 2; ++a) {
+            if (direction[a] == 0)
+                continue;
+
+            const int next = element[a] + (direction[a] > 0 ? 1 : -1);
+            if (next < 0 || next >= _size[a])
+                continue;
+
+            const double thisDistance = distanceToSlab(
+                    0.5 * _pitch[a], localPosition[a], direction[a]);
+
+            if (thisDistance < distance) {
+                distance = thisDistance;
+                step[0] = step[1] = step[2] = 0;
+                step[a] = next - element[a];
+            }
+        }
+        return distance;
+    }
+
+    for (unsigned int side = 0; side < 3; ++side) {
+        const double cosine = HEX_NORMAL[side][0] * direction[0]
+                            + HEX_NORMAL[side][1] * direction[1];
+        if (cosine == 0)
+            continue;
+
+        const int sign = (cosine > 0 ? 1 : -1);
+        const int next[3] = {element[0] + sign * HEX_STEP[side][0],
+                             element[1] + sign * HEX_STEP[side][1],
+                             element[2]};
+        if (!isInArray(next))
+            continue;
+
+        const double toCenter = HEX_NORMAL[side][0] * localPosition[0]
+                              + HEX_NORMAL[side][1] * localPosition[1];
+        const double thisDistance = distanceToSlab(0.5 * _pitch[0],
+                                                   toCenter, cosine);
+
+        if (thisDistance < distance) {
+            distance = thisDistance;
+            step[0] = sign * HEX_STEP[side][0];
+            step[1] = sign * HEX_STEP[side][1];
+            step[2] = 0;
+        }
+    }
+
+    return distance;
+}
+
+/*----------------------------------------------------------------------------*/
+double Lattice::findSafety(const TVecDbl& localPosition) const
+{
+    double safety = 0.5 * _pitch[2] - std::fabs(localPosition[2]);
+
+    if (_type == RECTANGULAR) {
+        for (unsigned int a = 0; a < 2; ++a) {
+            safety = std::min(safety,
+                        0.5 * _pitch[a] - std::fabs(localPosition[a]));
+        }
+    } else {
+        for (unsigned int side = 0; side < 3; ++side) {
+            const double toCenter = HEX_NORMAL[side][0] * localPosition[0]
+                                  + HEX_NORMAL[side][1] * localPosition[1];
+            safety = std::min(safety, 0.5 * _pitch[0] - std::fabs(toCenter));
+        }
+    }
+
+    return std::max(safety, 0.0);
+}
+
+/*----------------------------------------------------------------------------*/
+void Lattice::getUniverses(std::vector<unsigned int>& universes) const
+{
+    universes.clear();
+
+    const int shift = (_type == HEXAGONAL ? _size[0] / 2 : 0);
+    int element[3];
+
+    for (element[2] = 0; element[2] < _size[2]; ++element[2]) {
+        for (element[1] = -shift; element[1] < _size[1] - shift; ++element[1])
+        {
+            for (element[0] = -shift; element[0] < _size[0] - shift;
+                 ++element[0])
+            {
+                if (isInArray(element))
+                    universes.push_back(_universes[_entry(element)]);
+            }
+        }
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+unsigned int Lattice::_entry(const int element[3]) const
+{
+    // hexagonal indices are centered on zero
+    const int shift = (_type == HEXAGONAL ? _size[0] / 2 : 0);
+    return (element[0] + shift)
+         + _size[0] * ((element[1] + shift) + _size[1] * element[2]);
+}
+
+/*============================================================================*/
+} // end namespace mcGeometry
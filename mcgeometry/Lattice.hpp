@@ -0,0 +1,161 @@
+/*!
+ * \file   Lattice.hpp
+ * \brief  Contains interface for Lattice class
+ * \author Seth R. Johnson
+ */
+#ifndef MCG_LATTICE_HPP
+#define MCG_LATTICE_HPP
+/*----------------------------------------------------------------------------*/
+
+#include <vector>
+#include <blitz/tinyvec.h>
+
+#include "transupport/dbc.hpp"
+
+namespace mcGeometry {
+/*============================================================================*/
+
+/*!
+ * \class Lattice
+ * \brief A regular array of elements, each filled with a universe.
+ *
+ * A rectangular lattice is an array of boxes starting from a lower corner. A
+ * hexagonal lattice is a stack of layers of hexagonal prisms; in each layer,
+ * the hexagons form rings around a central one, with two of their sides
+ * normal to the x axis. Hexagonal elements are indexed by axial coordinates
+ * (q, r), where q counts along the x axis and r along the direction 60
+ * degrees from it, so the central hexagon is (0, 0) and ring \c n holds the
+ * hexagons with <tt>max(|q|, |r|, |q + r|) == n</tt>.
+ *
+ * Each element's universe is placed with its origin at the element's
+ * center. Universes are stored as internal indices; the lattice doesn't know
+ * anything about what's in them.
+ *
+ * The walls around the outside of the array aren't walls at all: a particle
+ * heading out of an edge element stays in it until it leaves the cell that
+ * the lattice fills. That cell should therefore lie within the array.
+ */
+class Lattice {
+public:
+    //! Blitz++ TinyVector of length D stores position/direction/etc.
+    typedef blitz::TinyVector<double, 3> TVecDbl;
+
+    //! Kinds of lattice
+    enum LatticeType {
+        RECTANGULAR = 0, //!< Boxes
+        HEXAGONAL        //!< Stacked layers of hexagonal prisms
+    };
+
+public:
+    /*!
+     * \brief Create a rectangular lattice.
+     *
+     * The universes are given with x varying fastest, then y, then z.
+     */
+    Lattice(const TVecDbl& lowerCorner,
+            const TVecDbl& pitch,
+            const unsigned int numElements[3],
+            const std::vector<unsigned int>& universes);
+
+    /*!
+     * \brief Create a hexagonal lattice.
+     *
+     * The central hexagon is centered on \c origin in x and y, and the
+     * bottom layer starts at the z coordinate of \c origin. \c pitch is the
+     * distance between the centers of neighboring hexagons (the distance
+     * across their flats). The universes are given for every (q, r) with
+     * both between <tt>-(numRings - 1)</tt> and <tt>numRings - 1</tt>, q
+     * varying fastest, then r, then the layer; the ones outside the rings
+     * are ignored.
+     */
+    Lattice(const TVecDbl& origin,
+            const double pitch,
+            const double height,
+            const unsigned int numRings,
+            const unsigned int numLayers,
+            const std::vector<unsigned int>& universes);
+
+    //! What kind of lattice we are.
+    LatticeType getType() const {
+        return _type;
+    }
+
+    //! Lower corner (rectangular) or central origin (hexagonal).
+    const TVecDbl& getOrigin() const {
+        return _origin;
+    }
+
+    //! Element size along each axis (hexagonal: across flats, unused, height).
+    const TVecDbl& getPitch() const {
+        return _pitch;
+    }
+
+    //! Entries along an axis (hexagonal: 2 * rings - 1, same, layers).
+    int getSize(const unsigned int axis) const {
+        Require(axis < 3);
+        return _size[axis];
+    }
+
+    //! Whether an element is part of the array.
+    bool isInArray(const int element[3]) const;
+
+    /*!
+     * \brief Find the element that a point is in.
+     *
+     * Points beyond the edge of a rectangular lattice are put in the nearest
+     * edge element. Returns false if a point is beyond the rings of a
+     * hexagonal lattice.
+     */
+    bool findElement(const TVecDbl& position, int element[3]) const;
+
+    //! Center of an element (its universe's origin).
+    TVecDbl getCenter(const int element[3]) const;
+
+    //! Universe filling an element.
+    unsigned int getUniverse(const int element[3]) const {
+        Require(isInArray(element));
+        return _universes[_entry(element)];
+    }
+
+    /*!
+     * \brief Find the nearest wall into another element of the array.
+     *
+     * The position is relative to the element's center. Returns the distance
+     * (infinite if the particle never leaves the array) and sets \c step to
+     * how the element index changes on crossing.
+     */
+    double findWall(const TVecDbl& localPosition,
+                    const TVecDbl& direction,
+                    const int element[3],
+                    int step[3]) const;
+
+    /*!
+     * \brief Find how far a particle can go without leaving its element.
+     *
+     * The position is relative to the element's center. This counts the
+     * walls around the outside of the array, so it may be an underestimate.
+     */
+    double findSafety(const TVecDbl& localPosition) const;
+
+    //! Universes of every element in the array (with repeats).
+    void getUniverses(std::vector<unsigned int>& universes) const;
+
+private:
+    //! Index into _universes of an element
+    unsigned int _entry(const int element[3]) const;
+
+    //! Kind of lattice
+    LatticeType  _type;
+    //! Lower corner (rectangular) or central origin (hexagonal)
+    TVecDbl      _origin;
+    //! Element size along each axis (hexagonal: across flats, unused, height)
+    TVecDbl      _pitch;
+    //! Elements along each axis (hexagonal: 2 * rings - 1, same, layers)
+    int          _size[3];
+    //! Universe in each entry
+    std::vector<unsigned int> _universes;
+};
+
+/*============================================================================*/
+} // end namespace mcGeometry
+#endif
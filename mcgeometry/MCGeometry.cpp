@@ -10,6 +10,8 @@
 #include <limits>
 #include <map>
 #include <vector>
+#include <algorithm>
+#include <cmath>
 
 #include <blitz/tinyvec-et.h>
 
@@ -18,6 +20,7 @@
 
 #include "Surface.hpp"
 #include "Cell.hpp"
+#include "GeometryCounters.hpp"
 
 #include <sstream>
 #include <iostream>
@@ -26,6 +29,9 @@ using std::cout;
 using std::endl;
 
 namespace mcGeometry {
+
+const unsigned int MCGeometry::NO_INDEX;
+
 /*============================================================================*\
  * subroutines that the user calls while running their monte carlo code
 \*============================================================================*/
@@ -33,26 +39,191 @@ void MCGeometry::findDistance(
         const TVecDbl& position,
         const TVecDbl& direction,
         const unsigned int oldCellIndex,
-        double& distanceTraveled)
+        double& distanceTraveled,
+        TrackState& state) const
+{
+    const bool hitsSurface = findDistance(position, direction, oldCellIndex,
+                                    std::numeric_limits<double>::infinity(),
+                                    distanceTraveled, state);
+
+    // without a limit, something must bound the cell
+    Insist(hitsSurface, "Particle never leaves its cell.");
+}
+
+/*----------------------------------------------------------------------------*/
+bool MCGeometry::findDistance(
+        const TVecDbl& position,
+        const TVecDbl& direction,
+        const unsigned int oldCellIndex,
+        const double maxDistance,
+        double& distanceTraveled,
+        TrackState& state) const
 {
     Require(tranSupport::checkDirectionVector(direction));
     Require(oldCellIndex < getNumCells());
+    Require(maxDistance >= 0.0);
+
+    // nested universes have a boundary at every level
+    if (_hasFills) {
+        return _findDistanceInLevels(position, direction, oldCellIndex,
+                                     maxDistance, distanceTraveled, state);
+    }
+
+    // if we haven't moved since crossing a surface, we're right on it
+    const Surface* onSurface = NULL;
+    if (state.trackSenses)
+        onSurface = state.senses.getCrossedSurface(position, 0);
+
+    // find the surface and distance that the old cell moves to
+    _intersectCell(position, direction, oldCellIndex, maxDistance,
+                   onSurface, state.useStructuredGrids,
+                   state.hitSurface, state.oldSurfaceSense, distanceTraveled);
+
+    // store variables for later
+    state.oldCellIndex = oldCellIndex;
+    state.distanceToSurface = distanceTraveled;
+    IfDbc(state.position = position; state.direction = direction;)
+
+    Ensure(distanceTraveled >= 0.0);
+    return (state.hitSurface != NULL);
+}
+
+/*----------------------------------------------------------------------------*/
+void MCGeometry::_intersectCell(
+        const TVecDbl& position,
+        const TVecDbl& direction,
+        const unsigned int cellIndex,
+        const double maxDistance,
+        const Surface* onSurface,
+        const bool useGrids,
+        Surface*& hitSurface,
+        bool& hitSense,
+        double& distance) const
+{
+    const StructuredGrid::Placement* placement = NULL;
+    if (useGrids && !_cellPlacements.empty()
+            && _cellPlacements[cellIndex].grid != StructuredGrid::NO_GRID)
+        placement = &_cellPlacements[cellIndex];
+
+    if (placement == NULL) {
+        // call intersect on the cell to find the surface and distance that
+        // it moves to
+        _cells[cellIndex]->intersect(position, direction, hitSurface,
+                                     hitSense, distance, maxDistance,
+                                     onSurface);
+        return;
+    }
+
+    // in a grid, only the three walls we're headed toward can be hit
+    const StructuredGrid& grid = _grids[placement->grid];
+
+    unsigned int axis;
+    bool         isUpper;
+    grid.findWall(placement->index, position, direction,
+                  axis, isUpper, distance);
+
+    if (distance <= maxDistance) {
+        const unsigned int plane = placement->index[axis] + (isUpper ? 1 : 0);
+        hitSurface = _surfaces[grid.getSurface(axis, plane)];
+        // we're above the lower plane and below the upper one
+        hitSense   = !isUpper;
+    } else {
+        hitSurface = NULL;
+        hitSense   = false;
+        distance   = std::numeric_limits<double>::infinity();
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+bool MCGeometry::_findDistanceInLevels(
+        const TVecDbl& position,
+        const TVecDbl& direction,
+        const unsigned int oldCellIndex,
+        const double maxDistance,
+        double& distanceTraveled,
+        TrackState& state) const
+{
+    // start over from the position if the levels are for some other cell
+    if (state.levels.empty() || state.levels.back().cellIndex != oldCellIndex)
+    {
+        state.levels.clear();
+        if (!_descend(position, state)
+                || state.levels.back().cellIndex != oldCellIndex)
+        {
+            _failGeometry("Particle's position isn't in its cell",
+                          oldCellIndex, position, direction);
+        }
+    }
+
+    double nearest = std::numeric_limits<double>::infinity();
+    state.hitSurface         = NULL;
+    state.oldSurfaceSense    = false;
+    state.crossingLevel      = 0;
+    state.crossesLatticeWall = false;
+
+    // on a tie, the boundary of the outermost level wins (and a cell's
+    // surface before the walls of the lattice filling it)
+    for (unsigned int k = 0; k < state.levels.size(); ++k) {
+        UniverseLevel& level = state.levels[k];
+        const TVecDbl  localPosition(level.localPosition(position));
+        const TVecDbl& localDirection = level.localDirection(direction);
+
+        // if we haven't moved since crossing a surface at this level, we're
+        // right on it (other levels' cells don't have it)
+        const Surface* onSurface = NULL;
+        if (state.trackSenses)
+            onSurface = state.senses.getCrossedSurface(position, k);
+
+        Surface* hitSurface;
+        bool     hitSense;
+        double   distance;
+        _intersectCell(localPosition, localDirection, level.cellIndex,
+                       std::min(nearest, maxDistance), onSurface,
+                       state.useStructuredGrids, hitSurface, hitSense,
+                       distance);
+
+        if (hitSurface != NULL && distance < nearest) {
+            nearest                  = distance;
+            state.hitSurface         = hitSurface;
+            state.oldSurfaceSense    = hitSense;
+            state.crossingLevel      = k;
+            state.crossesLatticeWall = false;
+        }
 
-    // call intersect on the old cell to find the surface and distance that it
-    // moves to
-    _cells[oldCellIndex]->intersect(
-                                position, direction,
-                                _findCache.hitSurface,
-                                _findCache.oldSurfaceSense,
-                                distanceTraveled);
+        const unsigned int fill = _cellFills[level.cellIndex];
+        if (fill == NO_INDEX || _universes[fill].lattice == NO_INDEX)
+            continue;
+
+        // the walls of the lattice element the next level is in
+        Check(k + 1 < state.levels.size());
+        UniverseLevel& element = state.levels[k + 1];
+        int step[3];
+        distance = _lattices[_universes[fill].lattice].findWall(
+                            element.localPosition(position),
+                            element.localDirection(direction),
+                            element.element, step);
+
+        if (distance < nearest && distance <= maxDistance) {
+            nearest                  = distance;
+            state.hitSurface         = NULL;
+            state.oldSurfaceSense    = false;
+            state.crossingLevel      = k;
+            state.crossesLatticeWall = true;
+            std::copy(step, step + 3, state.latticeStep);
+        }
+    }
 
-    // cache variables for later
-    _findCache.oldCellIndex = oldCellIndex;
-    _findCache.distanceToSurface = distanceTraveled;
-    IfDbc(_findCache.position = position; _findCache.direction = direction;)
+    // store variables for later
+    state.oldCellIndex      = oldCellIndex;
+    state.distanceToSurface = nearest;
+    IfDbc(state.position = position; state.direction = direction;)
+
+    distanceTraveled = nearest;
 
-    Check(_findCache.hitSurface != NULL);
     Ensure(distanceTraveled >= 0.0);
+    Ensure(nearest < std::numeric_limits<double>::infinity()
+            || maxDistance != std::numeric_limits<double>::infinity());
+    return (state.hitSurface != NULL || state.crossesLatticeWall);
 }
 
 /*----------------------------------------------------------------------------*/
@@ -61,15 +232,14 @@ void MCGeometry::findNewCell(
         const TVecDbl& direction,
         TVecDbl& newPosition,
         unsigned int& newCellIndex,
-        ReturnStatus& returnStatus)
+        ReturnStatus& returnStatus,
+        TrackState& state) const
 {
 //    cout << "unmatched surface count: " << _unMatchedSurfaces << endl;
-    Require( blitz::all(position  == _findCache.position) );
-    Require( blitz::all(direction == _findCache.direction) );
-    Require(_findCache.oldCellIndex < getNumCells());
-
-    // a reference to the pointer to the old cell
-    Cell& oldCell = *(_cells[_findCache.oldCellIndex]);
+    Require( blitz::all(position  == state.position) );
+    Require( blitz::all(direction == state.direction) );
+    Require(state.oldCellIndex < getNumCells());
+    Require(state.hitSurface != NULL || state.crossesLatticeWall);
 
     // ===== calculate transported position on the boundary of our new cell
     //  (necessary for finding which cell the point belongs to)
@@ -85,36 +255,98 @@ void MCGeometry::findNewCell(
     // This is a very minor nudge and should happen only EXTREMELY infrequently
     // (i.e. pretty much JUST on fabricated problems)
     //  THIS IS A RARE CASE OF WHAT COULD HAPPEN
-    if (_findCache.distanceToSurface == 0.0) {
-        _findCache.distanceToSurface
+    if (state.distanceToSurface == 0.0) {
+        IfCounters(++GeometryCounters::getThreadCounters().bumps;)
+
+        state.distanceToSurface
             = tranSupport::vectorNorm(position)
                 * 2 * std::numeric_limits<double>::epsilon();
-        _findCache.distanceToSurface = std::max(_findCache.distanceToSurface,
+        state.distanceToSurface = std::max(state.distanceToSurface,
                                     std::numeric_limits<double>::epsilon());
 
         std::ostringstream message;
-        message << "crossing surface ID " << _findCache.hitSurface->getUserId()
-                << " and adding |dx| = " << _findCache.distanceToSurface;
-        _warnGeometry("Bumping the particle", position, direction, &oldCell,
-                      message.str());
+        if (state.hitSurface != NULL)
+            message << "crossing surface ID " << state.hitSurface->getUserId();
+        else
+            message << "leaving a lattice element";
+        message << " and adding |dx| = " << state.distanceToSurface;
+        _warnGeometry("Bumping the particle", position, direction,
+                      _cells[state.oldCellIndex], message.str());
     }
     // transport the particle
-    newPosition = position + _findCache.distanceToSurface * direction;
+    newPosition = position + state.distanceToSurface * direction;
+    if (state.trackSenses)
+        state.senses.setCrossing(state.hitSurface, newPosition,
+                                 state.crossingLevel);
 
     // ===== if we're reflecting, just return the reflected status
-    if ( _findCache.hitSurface->isReflecting() ) {
+    if ( state.hitSurface != NULL && state.hitSurface->isReflecting() ) {
         returnStatus = REFLECTED;
+        IfCounters(++GeometryCounters::getThreadCounters().resolutions[
+                        GeometryCounters::REFLECTED_BACK];)
 
         // particle stays in the same cell
-        newCellIndex = _findCache.oldCellIndex;
+        newCellIndex = state.oldCellIndex;
+
+        return;
+    }
 
+    // ===== a periodic surface puts the particle on its partner
+    if ( state.hitSurface != NULL && state.hitSurface->isPeriodic() ) {
+        _crossPeriodic(position, direction, newPosition, newCellIndex,
+                       returnStatus, state);
         return;
     }
 
     returnStatus = NORMAL;
+
+    if (_hasFills) {
+        _findNewCellInLevels(position, direction, newPosition,
+                             newCellIndex, returnStatus, state);
+        return;
+    }
+
+    _findCellAcross(position, direction, newPosition, state.oldCellIndex,
+                    state, newCellIndex, returnStatus);
+}
+
+/*----------------------------------------------------------------------------*/
+void MCGeometry::_findCellAcross(
+        const TVecDbl& position,
+        const TVecDbl& direction,
+        const TVecDbl& newPosition,
+        const unsigned int oldCellIndex,
+        TrackState& state,
+        unsigned int& newCellIndex,
+        ReturnStatus& returnStatus) const
+{
+    // a reference to the old cell (whose neighborhood we may add to)
+    Cell& oldCell = *(_cells[oldCellIndex]);
+
+    // ===== in a structured grid, the next cell is just the next slot over
+    if (state.useStructuredGrids
+            && _findNewCellInGrid(newPosition, oldCellIndex, state,
+                                  newCellIndex))
+    {
+        IfCounters(++GeometryCounters::getThreadCounters().resolutions[
+                        GeometryCounters::IN_GRID];)
+
+        if ( _cells[newCellIndex]->isDeadCell() )
+            returnStatus = DEADCELL;
+        return;
+    }
+
+    // every surface of the old cell but the one we crossed is still on the
+    // same side (senses of other cells may not be, since a particle can
+    // cross a surface inside a cell that it doesn't bound)
+    const SurfaceSenses* knownSenses = NULL;
+    if (state.trackSenses
+            && oldCell.recordSenses(state.senses, state.hitSurface))
+        knownSenses = &state.senses;
+
     // ===== Loop over neighborhood cells
-    Cell::CellContainer& neighborhood =
-            oldCell.getNeighbors(_findCache.hitSurface);
+    const Cell::CellContainer& neighborhood =
+            oldCell.getNeighbors(state.hitSurface);
 
 
 //    // if we've completed the geometry and there is only once cell on the other
@@ -135,14 +367,18 @@ void MCGeometry::findNewCell(
 //             << " contains point " << newPosition << endl;
         // check if the point is inside (and pass _hitSurface to exclude
         // checking it)
-        if ( (*it)->isPointInside( newPosition, _findCache.hitSurface ) )
+        if ( (*it)->isPointInside(newPosition, state.hitSurface, knownSenses) )
         {
             //we have found the new cell
             newCellIndex = (*it)->getIndex();
+            if (_isProfilingNeighbors)
+                neighborhood.recordHit(it);
+            IfCounters(++GeometryCounters::getThreadCounters().resolutions[
+                            GeometryCounters::IN_NEIGHBORHOOD];)
 
 //            cout << "Found ending cell index " << newCellIndex
 //                 << " already connected to starting cell index "
-//                 << _findCache.oldCellIndex << " through hood" << endl;
+//                 << oldCellIndex << " through hood" << endl;
 
             if ( (*it)->isDeadCell() )
                 returnStatus = DEADCELL;
@@ -155,36 +391,45 @@ void MCGeometry::findNewCell(
     // surface 2, and our cell is defined as being -2, then the cell on the
     // other side has to have orientation +2
 
-    SurfaceAndSense searchQas(_findCache.hitSurface,
-                                !(_findCache.oldSurfaceSense));
+    const unsigned int* cellsBegin;
+    const unsigned int* cellsEnd;
 
-    SCConnectMap::iterator cellList
-                 = _surfToCellConnectivity.find(searchQas);
+    _getConnectedCells(state.hitSurface, !(state.oldSurfaceSense),
+                       cellsBegin, cellsEnd);
 
-    if (cellList == _surfToCellConnectivity.end()) {
+    if (cellsBegin == cellsEnd) {
         // NOTE: if position and newPosition reference the same vector,
         // this will print the new position, not the starting position
         _failGeometry("Surface connectivity not found for surface",
-                        _findCache.oldCellIndex, position, direction);
+                        oldCellIndex, position, direction);
     }
 
-    CellVec& cellsToCheck = cellList->second;
+    // a surface may bound cells in other universes, which are elsewhere
+    const unsigned int universe = _cellUniverses[oldCellIndex];
 
-    for (CellVec::iterator pNewCell  = cellsToCheck.begin();
-                           pNewCell != cellsToCheck.end(); ++pNewCell)
+    for (const unsigned int* pNewIndex  = cellsBegin;
+                             pNewIndex != cellsEnd; ++pNewIndex)
     {
-//        cout << "Checking if cell UserID " << (*pNewCell)->getUserId()
+        if (_hasFills && _cellUniverses[*pNewIndex] != universe)
+            continue;
+
+        Cell* const pNewCell = _cells[*pNewIndex];
+
+//        cout << "Checking if cell UserID " << _cellUserIds[*pNewIndex]
 //             << " contains point " << newPosition << endl;
         // check if the point is inside (and pass _hitSurface to exclude
         // checking it)
-        if ( (*pNewCell)->isPointInside( newPosition, _findCache.hitSurface ) )
+        if ( pNewCell->isPointInside(newPosition, state.hitSurface,
+                                     knownSenses) )
         {
             // we have found the new cell
-            newCellIndex = (*pNewCell)->getIndex();
+            newCellIndex = *pNewIndex;
+            IfCounters(++GeometryCounters::getThreadCounters().resolutions[
+                            GeometryCounters::BY_CONNECTIVITY];)
 
-            _updateConnectivity(&oldCell, *pNewCell, neighborhood);
+            _updateConnectivity(&oldCell, pNewCell, state.hitSurface);
 
-            if ( (*pNewCell)->isDeadCell() )
+            if ( pNewCell->isDeadCell() )
                 returnStatus = DEADCELL;
             return;
         }
@@ -193,31 +438,31 @@ void MCGeometry::findNewCell(
     // after checking cells connected to the surface, check all cells in the
     // problem to make sure it doesn't show up there
     //  THIS IS A RARE CASE OF WHAT COULD HAPPEN
-    for (unsigned int i = 0; i < _cells.size(); ++i) {
-        if (i != _findCache.oldCellIndex) {
-            if (_cells[i]->isPointInside(newPosition, _findCache.hitSurface)) {
-
-                std::ostringstream message;
-                message << "crossing surface ID "
-                        << _findCache.hitSurface->getUserId()
-                        << " into new cell index " << _cells[i]->getIndex()
-                        << " (user ID " << _cells[i]->getUserId() << ")";
+    unsigned int i = 0;
+    if (_findCellInUniverse(newPosition, universe, state.hitSurface,
+                            oldCellIndex, i))
+    {
+        std::ostringstream message;
+        message << "crossing surface ID "
+                << state.hitSurface->getUserId()
+                << " into new cell index " << _cells[i]->getIndex()
+                << " (user ID " << _cellUserIds[i] << ")";
 
-                _warnGeometry("Used global search", position, direction,
-                                &oldCell, message.str());
+        _warnGeometry("Used global search", position, direction,
+                        &oldCell, message.str());
+        IfCounters(++GeometryCounters::getThreadCounters().resolutions[
+                        GeometryCounters::BY_GLOBAL_SEARCH];)
 
-//                _unMatchedSurfaces++; // do this? or something more complicated?
+//        _unMatchedSurfaces++; // do this? or something more complicated?
 
-                _updateConnectivity(&oldCell, _cells[i], neighborhood);
+        _updateConnectivity(&oldCell, _cells[i], state.hitSurface);
 
-                newCellIndex = _cells[i]->getIndex();
+        newCellIndex = _cells[i]->getIndex();
 
-                if ( _cells[i]->isDeadCell() )
-                    returnStatus = DEADCELL;
+        if ( _cells[i]->isDeadCell() )
+            returnStatus = DEADCELL;
 
-                return;
-            }
-        }
+        return;
     }
 
 
@@ -227,11 +472,310 @@ void MCGeometry::findNewCell(
 
     // at this point, particle is LOST. We pretend it's in the same cell as it
     // was?
-    newCellIndex = _findCache.oldCellIndex;
+    newCellIndex = oldCellIndex;
     returnStatus = LOST;
+    IfCounters(++GeometryCounters::getThreadCounters().lost;)
 
     _failGeometry("Ruh-roh, new cell not found!",
-                    _findCache.oldCellIndex, position, direction);
+                    oldCellIndex, position, direction);
+}
+
+/*----------------------------------------------------------------------------*/
+void MCGeometry::_crossPeriodic(
+        const TVecDbl& position,
+        const TVecDbl& direction,
+        TVecDbl& newPosition,
+        unsigned int& newCellIndex,
+        ReturnStatus& returnStatus,
+        TrackState& state) const
+{
+    const unsigned int surfaceIndex = state.hitSurface->getIndex();
+    const Surface*     partner = _surfaces[_periodicPartners[surfaceIndex]];
+
+    // the shift is in the coordinates of the level whose cell we're leaving
+    unsigned int oldCellIndex = state.oldCellIndex;
+    TVecDbl      localPosition;
+    if (_hasFills) {
+        const UniverseLevel& level = state.levels[state.crossingLevel];
+        oldCellIndex   = level.cellIndex;
+        newPosition   += level.globalVector(_periodicShifts[surfaceIndex]);
+        localPosition  = level.localPosition(newPosition);
+    } else {
+        newPosition   += _periodicShifts[surfaceIndex];
+        localPosition  = newPosition;
+    }
+
+    // we're now sitting on the partner surface
+    if (state.trackSenses)
+        state.senses.setCrossing(partner, newPosition, state.crossingLevel);
+
+    const Cell& oldCell = *_cells[oldCellIndex];
+    bool found = false;
+
+    // look through the cells found for this face when input was completed
+    if (!_periodicOffsets.empty()) {
+        const Cell::SurfaceCode* code = oldCell.beginSurfaceCodes();
+        while (Cell::getCodeIndex(*code) != surfaceIndex)
+            ++code;
+        const unsigned int face = code - &_packedSurfaceCodes[0];
+
+        for (unsigned int i  = _periodicOffsets[face];
+                          i != _periodicOffsets[face + 1]; ++i)
+        {
+            if (_cells[_periodicCells[i]]->isPointInside(localPosition,
+                                                         partner))
+            {
+                newCellIndex = _periodicCells[i];
+                found = true;
+                IfCounters(++GeometryCounters::getThreadCounters().resolutions[
+                                GeometryCounters::ACROSS_PERIODIC];)
+                break;
+            }
+        }
+    }
+
+    if (!found) {
+        found = _findCellInUniverse(localPosition,
+                                    _cellUniverses[oldCellIndex], partner,
+                                    NO_INDEX, newCellIndex);
+
+        if (found && _isCompleted) {
+            std::ostringstream message;
+            message << "crossing periodic surface ID "
+                    << state.hitSurface->getUserId()
+                    << " into new cell index " << newCellIndex;
+            _warnGeometry("Used global search", position, direction,
+                          &oldCell, message.str());
+        }
+        IfCounters(if (found) ++GeometryCounters::getThreadCounters()
+                        .resolutions[GeometryCounters::BY_GLOBAL_SEARCH];)
+    }
+
+    if (!found) {
+        newCellIndex = state.oldCellIndex;
+        returnStatus = LOST;
+        IfCounters(++GeometryCounters::getThreadCounters().lost;)
+        _failGeometry("Nothing across the periodic partner surface!",
+                      state.oldCellIndex, position, direction);
+    }
+
+    // whatever fills the new cell takes over below it
+    if (_hasFills) {
+        state.levels.resize(state.crossingLevel + 1);
+        state.levels.back().cellIndex = newCellIndex;
+
+        if (!_descend(newPosition, state)) {
+            newCellIndex = state.oldCellIndex;
+            returnStatus = LOST;
+            _failGeometry("Nothing in the universe filling the new cell!",
+                          state.oldCellIndex, position, direction);
+        }
+        newCellIndex = state.levels.back().cellIndex;
+    }
+
+    returnStatus = (_cells[newCellIndex]->isDeadCell() ? DEADCELL : PERIODIC);
+}
+
+/*----------------------------------------------------------------------------*/
+void MCGeometry::_findNewCellInLevels(
+        const TVecDbl& position,
+        const TVecDbl& direction,
+        const TVecDbl& newPosition,
+        unsigned int& newCellIndex,
+        ReturnStatus& returnStatus,
+        TrackState& state) const
+{
+    const unsigned int k = state.crossingLevel;
+    Check(k < state.levels.size());
+
+    if (state.crossesLatticeWall) {
+        // step to the next element, and find what's there in its universe
+        Check(k + 1 < state.levels.size());
+        const UniverseLevel& parent = state.levels[k];
+        const Lattice& lattice = _lattices[
+                        _universes[_cellFills[parent.cellIndex]].lattice];
+
+        int element[3];
+        for (unsigned int a = 0; a < 3; ++a)
+            element[a] = state.levels[k + 1].element[a] + state.latticeStep[a];
+
+        UniverseLevel level;
+        _enterFill(parent, level);
+        level.origin += level.globalVector(lattice.getCenter(element));
+        std::copy(element, element + 3, level.element);
+
+        state.levels.resize(k + 1);
+
+        if (!_findCellInUniverse(level.localPosition(newPosition),
+                                 lattice.getUniverse(level.element),
+                                 NULL, NO_INDEX, level.cellIndex))
+        {
+            newCellIndex = state.oldCellIndex;
+            returnStatus = LOST;
+            IfCounters(++GeometryCounters::getThreadCounters().lost;)
+            _failGeometry("Nothing in the next lattice element!",
+                          state.oldCellIndex, position, direction);
+        }
+        state.levels.push_back(level);
+        IfCounters(++GeometryCounters::getThreadCounters().resolutions[
+                        GeometryCounters::ACROSS_LATTICE];)
+    } else {
+        // cross the surface in this level's coordinates
+        const TVecDbl localPosition(
+                            state.levels[k].localPosition(newPosition));
+
+        unsigned int crossedCellIndex;
+        _findCellAcross(position, direction, localPosition,
+                        state.levels[k].cellIndex, state, crossedCellIndex,
+                        returnStatus);
+
+        if (returnStatus == LOST) {
+            newCellIndex = state.oldCellIndex;
+            return;
+        }
+
+        state.levels.resize(k + 1);
+        state.levels[k].cellIndex = crossedCellIndex;
+    }
+
+    // whatever fills the new cell takes over below it
+    if (!_descend(newPosition, state)) {
+        newCellIndex = state.oldCellIndex;
+        returnStatus = LOST;
+        _failGeometry("Nothing in the universe filling the new cell!",
+                      state.oldCellIndex, position, direction);
+    }
+
+    newCellIndex = state.levels.back().cellIndex;
+    returnStatus = (_cells[newCellIndex]->isDeadCell() ? DEADCELL : NORMAL);
+}
+
+/*----------------------------------------------------------------------------*/
+void MCGeometry::_enterFill(
+        const UniverseLevel& parent,
+        UniverseLevel& level) const
+{
+    level.origin        = parent.origin;
+    level.element[0]    = level.element[1] = level.element[2] = 0;
+    level.isRotated     = parent.isRotated;
+    level.lastDirection = 0.0;
+    for (unsigned int i = 0; i < 3; ++i)
+        level.axes[i] = parent.axes[i];
+
+    const unsigned int transformIndex
+        = _cellFillTransforms[parent.cellIndex];
+    if (transformIndex == NO_INDEX)
+        return;
+
+    // the transform is given in the parent's coordinates
+    const FillTransform& transform = _fillTransforms[transformIndex];
+    level.origin += parent.globalVector(transform.translation);
+
+    if (transform.isRotated) {
+        for (unsigned int i = 0; i < 3; ++i)
+            level.axes[i] = parent.globalVector(transform.axes[i]);
+        level.isRotated = true;
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+bool MCGeometry::_descend(
+        const TVecDbl& position,
+        TrackState& state) const
+{
+    if (state.levels.empty()) {
+        UniverseLevel root;
+        root.origin = 0.0;
+        root.element[0] = root.element[1] = root.element[2] = 0;
+        root.isRotated = false;
+        root.lastDirection = 0.0;
+        for (unsigned int i = 0; i < 3; ++i) {
+            root.axes[i] = 0.0;
+            root.axes[i][i] = 1.0;
+        }
+
+        if (!_findCellInUniverse(position, 0, NULL, NO_INDEX, root.cellIndex))
+            return false;
+        state.levels.push_back(root);
+    }
+
+    for (;;) {
+        const UniverseLevel& parent = state.levels.back();
+        const unsigned int fill = _cellFills[parent.cellIndex];
+        if (fill == NO_INDEX)
+            return true;
+
+        UniverseLevel level;
+        _enterFill(parent, level);
+
+        unsigned int universe = fill;
+        if (_universes[fill].lattice != NO_INDEX) {
+            const Lattice& lattice = _lattices[_universes[fill].lattice];
+            if (!lattice.findElement(level.localPosition(position),
+                                     level.element))
+                return false;
+
+            level.origin += level.globalVector(
+                                    lattice.getCenter(level.element));
+            universe = lattice.getUniverse(level.element);
+        }
+
+        if (!_findCellInUniverse(level.localPosition(position), universe,
+                                 NULL, NO_INDEX, level.cellIndex))
+            return false;
+
+        state.levels.push_back(level);
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+bool MCGeometry::_findNewCellInGrid(
+        const TVecDbl& newPosition,
+        const unsigned int oldCellIndex,
+        const TrackState& state,
+        unsigned int& newCellIndex) const
+{
+    if (_cellPlacements.empty())
+        return false;
+
+    const StructuredGrid::Placement& placement
+        = _cellPlacements[oldCellIndex];
+    if (placement.grid == StructuredGrid::NO_GRID)
+        return false;
+
+    const StructuredGrid& grid = _grids[placement.grid];
+    const unsigned int hitIndex = state.hitSurface->getIndex();
+
+    // find which wall of the slot we crossed
+    unsigned int index[3] = {placement.index[0], placement.index[1],
+                             placement.index[2]};
+    unsigned int axis = 0;
+    for ( ; axis < 3; ++axis) {
+        if (grid.getSurface(axis, index[axis]) == hitIndex) {
+            if (index[axis] == 0)
+                return false;
+            --index[axis];
+            break;
+        }
+        if (grid.getSurface(axis, index[axis] + 1) == hitIndex) {
+            if (index[axis] + 1 == grid.getSize(axis))
+                return false;
+            ++index[axis];
+            break;
+        }
+    }
+    if (axis == 3)
+        return false;
+
+    // a particle that grazes along a wall could come out in another slot, so
+    // leave that to the general search
+    for (unsigned int a = 0; a < 3; ++a) {
+        if (a != axis && !grid.contains(a, index[a], newPosition[a]))
+            return false;
+    }
+
+    newCellIndex = grid.getCell(index);
+    return true;
 }
 
 /*----------------------------------------------------------------------------*/
@@ -239,53 +783,61 @@ void MCGeometry::findNewCell(
 void MCGeometry::_updateConnectivity(
         Cell* oldCell,
         Cell* newCell,
-        Cell::CellContainer& oldNeighborhood)
+        const Surface* crossedSurface) const
 {
     // if this is the first cell linked to this surface, we decrement
-    // the unmatched surfaces
-    if (oldNeighborhood.size() == 0)
-        _unMatchedSurfaces--;
+    // the unmatched surfaces (another thread may have linked them first, in
+    // which case addNeighbor returns false)
+    int newlyMatched = 0;
 
     // add new cell to old cell's hood connectivity
-    oldNeighborhood.push_back(newCell);
-
-    Cell::CellContainer& newNeighborhood
-        = newCell->getNeighbors(_findCache.hitSurface);
-
-    // if this is the first cell linked to this surface, we decrement
-    // the unmatched surfaces
-    if (newNeighborhood.size() == 0)
-        _unMatchedSurfaces--;
+    if (oldCell->addNeighbor(crossedSurface, newCell))
+        ++newlyMatched;
 
     // add old cell to new cell's hood connectivity
-    newNeighborhood.push_back(oldCell);
+    if (newCell->addNeighbor(crossedSurface, oldCell))
+        ++newlyMatched;
 
     //            cout << "Connected ending cell index " << newCellIndex
-    //                 << " to starting cell index " << _findCache.oldCellIndex
+    //                 << " to starting cell index " << oldCell->getIndex()
     //                 << endl;
 
-    if (_unMatchedSurfaces == 0)
-        _completedConnectivity();
+    if (newlyMatched > 0) {
+        int remaining = (_unMatchedSurfaces -= newlyMatched);
+
+        Check(remaining >= 0);
 
-    Ensure(_unMatchedSurfaces >= 0);
+        // only the thread that matched the last surface does this
+        if (remaining == 0)
+            _completedConnectivity();
+    }
 }
 
 /*----------------------------------------------------------------------------*/
 void MCGeometry::reflectDirection(
         const TVecDbl& newPosition,
         const TVecDbl& oldDirection,
-        TVecDbl& newDirection)
+        TVecDbl& newDirection,
+        const TrackState& state) const
 {
-    Require( blitz::all(oldDirection == _findCache.direction));
+    Require( blitz::all(oldDirection == state.direction));
+    Require(state.hitSurface != NULL);
     // law of reflection: omega = omega - 2 (n . omega) n
     TVecDbl surfaceNormal;
 
-    // find the surface normal at the point of intersection
-    _findCache.hitSurface->normalAtPoint(newPosition, surfaceNormal);
+    // surfaces in filled cells are in their own universe's coordinates
+    if (state.levels.empty()) {
+        state.hitSurface->normalAtPoint(newPosition, surfaceNormal);
+    } else {
+        const UniverseLevel& level = state.levels[state.crossingLevel];
+        state.hitSurface->normalAtPoint(level.localPosition(newPosition),
+                                        surfaceNormal);
+        surfaceNormal = level.globalVector(surfaceNormal);
+    }
 
     // returned normal is with respect to the "positive" sense of the
     // surface, so reverse if necessary
-    if (_findCache.oldSurfaceSense == false)
+    if (state.oldSurfaceSense == false)
     {
         surfaceNormal = -surfaceNormal;
     }
@@ -304,52 +856,263 @@ void MCGeometry::getSurfaceCrossing(
         const TVecDbl& newPosition,
         const TVecDbl& oldDirection,
         MCGeometry::UserSurfaceIdType& surfaceCrossingUserId,
-        double&       dotProduct)
+        double&       dotProduct,
+        const TrackState& state) const
 {
-    Require(blitz::all(oldDirection == _findCache.direction));
+    Require(blitz::all(oldDirection == state.direction));
     Require(tranSupport::checkDirectionVector(oldDirection));
+    Insist(state.hitSurface != NULL, "Lattice walls aren't surfaces.");
 
     TVecDbl surfaceNormal;
 
-    // find the surface normal at the point of intersection
-    _findCache.hitSurface->normalAtPoint(newPosition, surfaceNormal);
+    // surfaces in filled cells are in their own universe's coordinates
+    if (state.levels.empty()) {
+        state.hitSurface->normalAtPoint(newPosition, surfaceNormal);
+    } else {
+        const UniverseLevel& level = state.levels[state.crossingLevel];
+        state.hitSurface->normalAtPoint(level.localPosition(newPosition),
+                                        surfaceNormal);
+        surfaceNormal = level.globalVector(surfaceNormal);
+    }
 
     // returned normal is with respect to the "positive" sense of the
     // surface, so reverse if necessary
-    if (_findCache.oldSurfaceSense == false)
+    if (state.oldSurfaceSense == false)
     {
         surfaceNormal = -surfaceNormal;
     }
 
-    surfaceCrossingUserId = _findCache.hitSurface->getUserId();
+    surfaceCrossingUserId = state.hitSurface->getUserId();
     dotProduct = blitz::dot(oldDirection, surfaceNormal);
 
     Ensure(tranSupport::checkDirectionVector(surfaceNormal));
 }
 
 /*----------------------------------------------------------------------------*/
-unsigned int MCGeometry::findCell( const TVecDbl& position) const
+double MCGeometry::findSafetyDistance(
+        const TVecDbl& position,
+        const unsigned int cellIndex) const
+{
+    Require(cellIndex < getNumCells());
+
+    // with fills, find every level from the position
+    if (_hasFills)
+        return findSafetyDistance(position, cellIndex, TrackState());
+
+    Require(_cells[cellIndex]->isPointInside(position));
+    return _cells[cellIndex]->safetyDistance(position);
+}
+
+/*----------------------------------------------------------------------------*/
+double MCGeometry::findSafetyDistance(
+        const TVecDbl& position,
+        const unsigned int cellIndex,
+        const TrackState& state) const
+{
+    Require(cellIndex < getNumCells());
+
+    if (!_hasFills) {
+        Require(_cells[cellIndex]->isPointInside(position));
+        return _cells[cellIndex]->safetyDistance(position);
+    }
+
+    if (!state.levels.empty() && state.levels.back().cellIndex == cellIndex)
+        return _findSafetyInLevels(position, state.levels);
+
+    // start over from the position if the levels are for some other cell
+    TrackState newState;
+    if (!_descend(position, newState)
+            || newState.levels.back().cellIndex != cellIndex)
+    {
+        _failGeometry("Particle's position isn't in its cell",
+                      cellIndex, position, TVecDbl(0.0));
+    }
+    return _findSafetyInLevels(position, newState.levels);
+}
+
+/*----------------------------------------------------------------------------*/
+double MCGeometry::_findSafetyInLevels(
+        const TVecDbl& position,
+        const std::vector<UniverseLevel>& levels) const
+{
+    // the particle can't reach the boundary at any level
+    double safety = std::numeric_limits<double>::infinity();
+    for (unsigned int k = 0; k < levels.size(); ++k) {
+        const UniverseLevel& level = levels[k];
+        const TVecDbl localPosition(level.localPosition(position));
+
+        safety = std::min(safety,
+                    _cells[level.cellIndex]->safetyDistance(localPosition));
+
+        const unsigned int fill = _cellFills[level.cellIndex];
+        if (fill != NO_INDEX && _universes[fill].lattice != NO_INDEX) {
+            Check(k + 1 < levels.size());
+            const UniverseLevel& element = levels[k + 1];
+            safety = std::min(safety,
+                        _lattices[_universes[fill].lattice].findSafety(
+                            element.localPosition(position)));
+        }
+    }
+    return safety;
+}
+
+/*----------------------------------------------------------------------------*/
+void MCGeometry::findDistances(
+        const unsigned int numParticles,
+        const double* const position[3],
+        const double* const direction[3],
+        const unsigned int* cellIndex,
+        double* distance,
+        TrackState* state) const
 {
-  //  // loop through all cells in problem
-  //  for (CellVec::const_iterator itCel = _cells.begin();
-  //                               itCel != _cells.end();  ++itCel)
-  //  {
-  //      if ((*itCel)->isPointInside(position))  {
-  //          return itCel - _cells.begin(); // maybe valid?
-  //      }
-  //  }
-    // that might be faster than this:
-    for (unsigned int i = 0; i < _cells.size(); ++i) {
-        if (_cells[i]->isPointInside(position)) {
-            return i;
+    Insist(_isCompleted,
+            "Geometry input must be completed before batched transport.");
+
+    const int numToTrack = numParticles;
+    int numLost = 0;
+
+#pragma omp parallel for schedule(dynamic, 64) reduction(+:numLost)
+    for (int i = 0; i < numToTrack; ++i) {
+        Require(cellIndex[i] < getNumCells());
+
+        if (!findDistance(
+                TVecDbl(position[0][i], position[1][i], position[2][i]),
+                TVecDbl(direction[0][i], direction[1][i], direction[2][i]),
+                cellIndex[i], std::numeric_limits<double>::infinity(),
+                distance[i], state[i]))
+        {
+            ++numLost;
         }
     }
 
+    // without a limit, something must bound every particle's cell (this is
+    // checked outside the loop so that the error can be caught)
+    Insist(numLost == 0, "Particle never leaves its cell.");
+}
+
+/*----------------------------------------------------------------------------*/
+void MCGeometry::findNewCells(
+        const unsigned int numParticles,
+        const double* const position[3],
+        const double* const direction[3],
+        double* const newPosition[3],
+        unsigned int* newCellIndex,
+        ReturnStatus* returnStatus,
+        TrackState* state) const
+{
+    const int numToTrack = numParticles;
+
+#pragma omp parallel for schedule(dynamic, 64)
+    for (int i = 0; i < numToTrack; ++i) {
+        const TVecDbl particlePosition(
+                position[0][i], position[1][i], position[2][i]);
+        const TVecDbl particleDirection(
+                direction[0][i], direction[1][i], direction[2][i]);
+        TVecDbl particleNewPosition;
+
+        findNewCell(particlePosition, particleDirection, particleNewPosition,
+                    newCellIndex[i], returnStatus[i], state[i]);
+
+        for (int d = 0; d < 3; ++d)
+            newPosition[d][i] = particleNewPosition[d];
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+//! \cond
+namespace {
+//! Whether a point is inside a universe's cell, for searching its hierarchy
+class PointInCell {
+public:
+    PointInCell(const std::vector<Cell*>& cells,
+                const std::vector<unsigned int>& universeCells,
+                const blitz::TinyVector<double, 3>& position,
+                const Surface* surfaceToSkip,
+                const unsigned int cellToSkip)
+        : _cells(cells), _universeCells(universeCells), _position(position),
+          _surfaceToSkip(surfaceToSkip), _cellToSkip(cellToSkip)
+    { /* * */ }
+
+    bool operator()(const unsigned int i) const {
+        const unsigned int cellIndex = _universeCells[i];
+        return (cellIndex != _cellToSkip
+                && _cells[cellIndex]->isPointInside(_position, _surfaceToSkip));
+    }
+
+private:
+    const std::vector<Cell*>&           _cells;
+    const std::vector<unsigned int>&    _universeCells;
+    const blitz::TinyVector<double, 3>& _position;
+    const Surface*                      _surfaceToSkip;
+    const unsigned int                  _cellToSkip;
+};
+} // end anonymous namespace
+//! \endcond
+
+/*----------------------------------------------------------------------------*/
+unsigned int MCGeometry::findCell( const TVecDbl& position) const
+{
+    if (_hasFills) {
+        TrackState state;
+        return findCell(position, state);
+    }
+
+    unsigned int cellIndex = 0;
+    if (_findCellInUniverse(position, 0, NULL, NO_INDEX, cellIndex))
+        return cellIndex;
+
     // return a status value or something instead of failing miserably?
-    _failGeometry("Could not find cell!", 0, position, TVecDbl());
+    _failGeometry("Could not find cell!", 0, position, TVecDbl(0.0));
     return 0;
 }
 /*----------------------------------------------------------------------------*/
+unsigned int MCGeometry::findCell(
+        const TVecDbl& position,
+        TrackState& state) const
+{
+    state.levels.clear();
+
+    if (!_hasFills)
+        return findCell(position);
+
+    if (!_descend(position, state))
+        _failGeometry("Could not find cell!", 0, position, TVecDbl(0.0));
+
+    return state.levels.back().cellIndex;
+}
+/*----------------------------------------------------------------------------*/
+bool MCGeometry::_findCellInUniverse(
+        const TVecDbl& position,
+        const unsigned int universe,
+        const Surface* surfaceToSkip,
+        const unsigned int cellToSkip,
+        unsigned int& cellIndex) const
+{
+    Require(universe < _universes.size());
+    const std::vector<unsigned int>& cells = _universes[universe].cells;
+
+    PointInCell isInside(_cells, cells, position, surfaceToSkip, cellToSkip);
+
+    unsigned int i = 0;
+    bool found = false;
+
+    if (_isCompleted) {
+        found = _universes[universe].hierarchy.findFirst(position, isInside,
+                                                         i);
+    } else {
+        for ( ; i < cells.size(); ++i) {
+            if (isInside(i)) {
+                found = true;
+                break;
+            }
+        }
+    }
+
+    if (found)
+        cellIndex = cells[i];
+    return found;
+}
+/*----------------------------------------------------------------------------*/
 bool MCGeometry::isDeadCell(const unsigned int cellIndex) const
 {
     Require(cellIndex < getNumCells() );
@@ -358,7 +1121,194 @@ bool MCGeometry::isDeadCell(const unsigned int cellIndex) const
 /*============================================================================*\
  * other internal-use code
 \*============================================================================*/
-void MCGeometry::_completedConnectivity()
+void MCGeometry::_getConnectedCells(
+        const Surface* surface,
+        const bool sense,
+        const unsigned int*& cellsBegin,
+        const unsigned int*& cellsEnd) const
+{
+    if (_isCompleted) {
+        // look up the compiled offsets directly
+        unsigned int key = 2 * surface->getIndex() + (sense ? 1 : 0);
+        Check(key + 1 < _connectOffsets.size());
+
+        cellsBegin = _connectCells.begin() + _connectOffsets[key];
+        cellsEnd   = _connectCells.begin() + _connectOffsets[key + 1];
+        return;
+    }
+
+    SCConnectMap::const_iterator cellList = _surfToCellConnectivity.find(
+            SurfaceAndSense(const_cast<Surface*>(surface), sense));
+
+    if (cellList == _surfToCellConnectivity.end()) {
+        cellsBegin = cellsEnd = NULL;
+        return;
+    }
+
+    // (a list is only made when a cell is added to it)
+    cellsBegin = &cellList->second[0];
+    cellsEnd   = cellsBegin + cellList->second.size();
+}
+
+/*----------------------------------------------------------------------------*/
+//! \cond
+namespace {
+//! Relative tolerance for deciding whether two boxes merely touch
+const double BOX_TOLERANCE = 1.0e-12;
+
+//! Tolerance for comparing box coordinates near the given values
+inline double boxTolerance(const double a, const double b)
+{
+    double scale = 1.0;
+    if (std::fabs(a) < std::numeric_limits<double>::infinity())
+        scale = std::max(scale, std::fabs(a));
+    if (std::fabs(b) < std::numeric_limits<double>::infinity())
+        scale = std::max(scale, std::fabs(b));
+    return BOX_TOLERANCE * scale;
+}
+
+/*!
+ * \brief Whether two boxes can share a patch of surface.
+ *
+ * The boxes must overlap (or touch) in every direction, and they may only
+ * touch (i.e. have zero-width overlap) in at most one direction; boxes that
+ * meet only along an edge or a corner can't share a face.
+ */
+bool boxesCanShareFace(
+        const blitz::TinyVector<double, 3>& lowerA,
+        const blitz::TinyVector<double, 3>& upperA,
+        const blitz::TinyVector<double, 3>& lowerB,
+        const blitz::TinyVector<double, 3>& upperB)
+{
+    int numTouching = 0;
+
+    for (int i = 0; i < 3; ++i) {
+        const double lower = std::max(lowerA[i], lowerB[i]);
+        const double upper = std::min(upperA[i], upperB[i]);
+        const double tol   = boxTolerance(lower, upper);
+
+        if (upper - lower > tol)
+            continue;
+
+        if (upper - lower < -tol)
+            return false;
+
+        ++numTouching;
+    }
+
+    return (numTouching <= 1);
+}
+
+//! A cell on one side of a surface, sorted by the start of its box
+struct SweepItem {
+    double       lower;
+    unsigned int cellIndex;
+    bool         side;
+
+    bool operator<(const SweepItem& other) const {
+        return (lower < other.lower);
+    }
+};
+} // end anonymous namespace
+//! \endcond
+
+/*----------------------------------------------------------------------------*/
+void MCGeometry::_connectAcrossSurface(const Surface* surface)
+{
+    // whatever is on the other side of a periodic surface isn't reached
+    if (surface->isPeriodic())
+        return;
+
+    const std::vector<TVecDbl>& lowerBounds = _cellLowerBounds;
+    const std::vector<TVecDbl>& upperBounds = _cellUpperBounds;
+
+    const unsigned int* cellsBegin[2];
+    const unsigned int* cellsEnd[2];
+
+    _getConnectedCells(surface, false, cellsBegin[0], cellsEnd[0]);
+    _getConnectedCells(surface, true,  cellsBegin[1], cellsEnd[1]);
+
+    if (cellsBegin[0] == cellsEnd[0] || cellsBegin[1] == cellsEnd[1])
+        return;
+
+    // sweep along the axis where the cells are most spread out
+    TVecDbl minLower( std::numeric_limits<double>::infinity());
+    TVecDbl maxLower(-std::numeric_limits<double>::infinity());
+
+    std::vector<SweepItem> items;
+    for (int side = 0; side < 2; ++side) {
+        for (const unsigned int* it  = cellsBegin[side];
+                                 it != cellsEnd[side]; ++it)
+        {
+            const TVecDbl& lower = lowerBounds[*it];
+            for (int i = 0; i < 3; ++i) {
+                if (lower[i] == -std::numeric_limits<double>::infinity())
+                    continue;
+                minLower[i] = std::min(minLower[i], lower[i]);
+                maxLower[i] = std::max(maxLower[i], lower[i]);
+            }
+
+            SweepItem item;
+            item.cellIndex = *it;
+            item.side      = (side == 1);
+            items.push_back(item);
+        }
+    }
+
+    int axis = 0;
+    for (int i = 1; i < 3; ++i) {
+        if (maxLower[i] - minLower[i] > maxLower[axis] - minLower[axis])
+            axis = i;
+    }
+
+    for (std::vector<SweepItem>::iterator it  = items.begin();
+                                          it != items.end(); ++it)
+    {
+        it->lower = lowerBounds[it->cellIndex][axis];
+    }
+    std::sort(items.begin(), items.end());
+
+    // compare each box to the boxes on the other side that it overlaps along
+    // the sweep axis
+    std::vector<unsigned int> active[2];
+
+    for (std::vector<SweepItem>::const_iterator it  = items.begin();
+                                                it != items.end(); ++it)
+    {
+        const double tol = boxTolerance(it->lower, it->lower);
+
+        // drop boxes that end before this one starts
+        for (int side = 0; side < 2; ++side) {
+            std::vector<unsigned int>& sideActive = active[side];
+            unsigned int numKept = 0;
+            for (unsigned int j = 0; j < sideActive.size(); ++j) {
+                if (upperBounds[sideActive[j]][axis] >= it->lower - tol)
+                    sideActive[numKept++] = sideActive[j];
+            }
+            sideActive.resize(numKept);
+        }
+
+        const std::vector<unsigned int>& otherActive = active[!it->side];
+        for (std::vector<unsigned int>::const_iterator
+                other = otherActive.begin(); other != otherActive.end();
+                ++other)
+        {
+            if (_cellUniverses[it->cellIndex] == _cellUniverses[*other]
+                    && boxesCanShareFace(
+                        lowerBounds[it->cellIndex], upperBounds[it->cellIndex],
+                        lowerBounds[*other],        upperBounds[*other]))
+            {
+                _updateConnectivity(_cells[it->cellIndex], _cells[*other],
+                                    surface);
+            }
+        }
+
+        active[it->side].push_back(it->cellIndex);
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+void MCGeometry::_completedConnectivity() const
 {
     // THIS CODE IS ALMOST ALWAYS VALID
     //  difficulties: transporting across negative-sense surfaces into corners
@@ -378,14 +1328,15 @@ unsigned int MCGeometry::addSurface(
 {
     // this is ONLY if we are using MCNP-type input definitions
     Insist(userSurfaceId > 0, "Things will break if surfaceId = 0 is allowed.");
+    Insist(!_isCompleted, "Tried to add a surface after completing input.");
 
-    // "clone" calls a routine in the quadric which allocates new memory
-    // WE ARE NOW RESPONSIBLE FOR THIS MEMORY (and must delete it when
-    // appropriate)
-    Surface* newSurface = inSurface.clone(userSurfaceId);
+    // "clone" copies the quadric into our arena, right after the last one
+    // WE ARE NOW RESPONSIBLE FOR DESTROYING IT (the arena frees the memory)
+    Surface* newSurface = inSurface.clone(userSurfaceId, _surfaceArena);
 
     _surfaces.push_back(newSurface);
     unsigned int newSurfaceIndex = _surfaces.size() - 1;
+    newSurface->_index = newSurfaceIndex;
 
     // add the reverse mapping and
     // verify that this surface has not been added already (i.e. the
@@ -411,8 +1362,15 @@ unsigned int MCGeometry::addSurface(
 unsigned int MCGeometry::addCell(
         const UserCellIdType& userCellId,
         const IntVec& surfaceIds,
-        const Cell::CellFlags flags)
+        const Cell::CellFlags flags,
+        const UserUniverseIdType userUniverseId)
 {
+    Insist(!_isCompleted, "Tried to add a cell after completing input.");
+
+    const unsigned int universe = _getUniverseIndex(userUniverseId);
+    Insist(_universes[universe].lattice == NO_INDEX,
+            "Tried to add a cell to a universe that is a lattice.");
+
     Cell::SASVec boundingSurfaces;
 
     // bounding surfaces should have same length as input list of surface IDs
@@ -447,7 +1405,15 @@ unsigned int MCGeometry::addCell(
     Check(surfaceIds.size() == boundingSurfaces.size());
 
     // call our internal function to do stuff to the parsed list of pointers
-    return _addCell(userCellId, boundingSurfaces, flags);
+    const unsigned int newCellIndex
+        = _addCell(userCellId, boundingSurfaces, flags);
+
+    _universes[universe].cells.push_back(newCellIndex);
+    _cellUniverses.push_back(universe);
+    _cellFills.push_back(NO_INDEX);
+    _cellFillTransforms.push_back(NO_INDEX);
+
+    return newCellIndex;
 }
 /*----------------------------------------------------------------------------*/
 //! add a cell based on a surface/sense vector
@@ -462,9 +1428,10 @@ unsigned int MCGeometry::_addCell(
     //====== add cell to the internal cell vector
     unsigned int newCellIndex = _cells.size();
 
-    Cell* newCell = new Cell(boundingSurfaces, userCellId, newCellIndex,
-                               flags);
+    Cell* newCell = new (_cellArena.allocate<Cell>())
+                        Cell(boundingSurfaces, newCellIndex, flags);
     _cells.push_back(newCell);
+    _cellUserIds.push_back(userCellId);
 
 //    cout << "Added cell with ID " << userCellId
 //         << "that has index " << newCellIndex << endl;
@@ -495,22 +1462,623 @@ unsigned int MCGeometry::_addCell(
         // key, and it will either automatically initialize an empty vector or
         // return the vector that is already
         // see C++ Standard Library pp. 182-183
-        _surfToCellConnectivity[newQandS].push_back(newCell);
+        _surfToCellConnectivity[newQandS].push_back(newCellIndex);
     }
 
     return newCellIndex;
 }
 
+/*----------------------------------------------------------------------------*/
+void MCGeometry::fillCell(
+        const UserCellIdType userCellId,
+        const UserUniverseIdType userUniverseId)
+{
+    Insist(!_isCompleted, "Tried to fill a cell after completing input.");
+    Insist(userUniverseId != 0, "The root universe can't fill a cell.");
+
+    const unsigned int cellIndex = getCellIndexFromUserId(userCellId);
+    Insist(_cellFills[cellIndex] == NO_INDEX,
+            "Tried to fill a cell that was already filled.");
+    Insist(!_cells[cellIndex]->isDeadCell(), "Tried to fill a dead cell.");
+
+    const unsigned int universe = _getUniverseIndex(userUniverseId);
+    Insist(universe != _cellUniverses[cellIndex],
+            "Tried to fill a cell with its own universe.");
+
+    _cellFills[cellIndex] = universe;
+    _hasFills = true;
+}
+
+/*----------------------------------------------------------------------------*/
+void MCGeometry::fillCell(
+        const UserCellIdType userCellId,
+        const UserUniverseIdType userUniverseId,
+        const TVecDbl& translation)
+{
+    const TVecDbl axes[3] = {TVecDbl(1.0, 0.0, 0.0),
+                             TVecDbl(0.0, 1.0, 0.0),
+                             TVecDbl(0.0, 0.0, 1.0)};
+    fillCell(userCellId, userUniverseId, translation, axes);
+}
+
+/*----------------------------------------------------------------------------*/
+void MCGeometry::fillCell(
+        const UserCellIdType userCellId,
+        const UserUniverseIdType userUniverseId,
+        const TVecDbl& translation,
+        const TVecDbl axes[3])
+{
+    FillTransform transform;
+    transform.translation = translation;
+    transform.isRotated   = false;
+
+    for (unsigned int i = 0; i < 3; ++i) {
+        transform.axes[i] = axes[i];
+
+        for (unsigned int j = 0; j < 3; ++j) {
+            const double expected = (i == j ? 1.0 : 0.0);
+            Insist(std::fabs(blitz::dot(axes[i], axes[j]) - expected) < 1.e-10,
+                    "Fill axes must be orthonormal.");
+
+            if (axes[i][j] != expected)
+                transform.isRotated = true;
+        }
+    }
+
+    fillCell(userCellId, userUniverseId);
+
+    const unsigned int cellIndex = getCellIndexFromUserId(userCellId);
+    _cellFillTransforms[cellIndex] = _fillTransforms.size();
+    _fillTransforms.push_back(transform);
+}
+
+/*----------------------------------------------------------------------------*/
+void MCGeometry::addRectangularLattice(
+        const UserUniverseIdType userUniverseId,
+        const TVecDbl& lowerCorner,
+        const TVecDbl& pitch,
+        const unsigned int numElements[3],
+        const UniverseIdVec& elementUniverses)
+{
+    Insist(!_isCompleted, "Tried to add a lattice after completing input.");
+
+    const unsigned int universe = _getUniverseIndex(userUniverseId);
+    Insist(universe != 0, "The root universe can't be a lattice.");
+    Insist(_universes[universe].cells.empty()
+                && _universes[universe].lattice == NO_INDEX,
+            "Tried to add a lattice to a universe that was already defined.");
+
+    std::vector<unsigned int> elements(elementUniverses.size());
+    for (unsigned int i = 0; i < elementUniverses.size(); ++i)
+        elements[i] = _getUniverseIndex(elementUniverses[i]);
+
+    _lattices.push_back(Lattice(lowerCorner, pitch, numElements, elements));
+    _universes[universe].lattice = _lattices.size() - 1;
+}
+
+/*----------------------------------------------------------------------------*/
+void MCGeometry::addHexagonalLattice(
+        const UserUniverseIdType userUniverseId,
+        const TVecDbl& origin,
+        const double pitch,
+        const double height,
+        const unsigned int numRings,
+        const unsigned int numLayers,
+        const UniverseIdVec& elementUniverses)
+{
+    Insist(!_isCompleted, "Tried to add a lattice after completing input.");
+
+    const unsigned int universe = _getUniverseIndex(userUniverseId);
+    Insist(universe != 0, "The root universe can't be a lattice.");
+    Insist(_universes[universe].cells.empty()
+                && _universes[universe].lattice == NO_INDEX,
+            "Tried to add a lattice to a universe that was already defined.");
+
+    std::vector<unsigned int> elements(elementUniverses.size());
+    for (unsigned int i = 0; i < elementUniverses.size(); ++i)
+        elements[i] = _getUniverseIndex(elementUniverses[i]);
+
+    _lattices.push_back(Lattice(origin, pitch, height, numRings, numLayers,
+                                elements));
+    _universes[universe].lattice = _lattices.size() - 1;
+}
+
+/*----------------------------------------------------------------------------*/
+unsigned int MCGeometry::_getUniverseIndex(
+        const UserUniverseIdType userUniverseId)
+{
+    UniverseRevIDMap::const_iterator it
+        = _universeRevUserIds.find(userUniverseId);
+    if (it != _universeRevUserIds.end())
+        return it->second;
+
+    const unsigned int newUniverseIndex = _universes.size();
+
+    Universe universe;
+    universe.userId  = userUniverseId;
+    universe.lattice = NO_INDEX;
+    _universes.push_back(universe);
+
+    _universeRevUserIds.insert(
+            std::make_pair(userUniverseId, newUniverseIndex));
+
+    return newUniverseIndex;
+}
+
+/*----------------------------------------------------------------------------*/
+void MCGeometry::_checkUniverses() const
+{
+    const unsigned int numUniverses = _universes.size();
+
+    // universes directly inside each universe
+    std::vector< std::vector<unsigned int> > children(numUniverses);
+    for (unsigned int i = 0; i < _cellFills.size(); ++i) {
+        if (_cellFills[i] != NO_INDEX)
+            children[_cellUniverses[i]].push_back(_cellFills[i]);
+    }
+    for (unsigned int u = 0; u < numUniverses; ++u) {
+        if (_universes[u].lattice == NO_INDEX)
+            continue;
+
+        _lattices[_universes[u].lattice].getUniverses(children[u]);
+
+        for (unsigned int i = 0; i < children[u].size(); ++i) {
+            Insist(_universes[children[u][i]].lattice == NO_INDEX,
+                    "Lattice elements must be filled by universes of cells.");
+        }
+    }
+
+    // depth-first search from the root for undefined universes and cycles
+    enum {UNVISITED, IN_PROGRESS, DONE};
+    std::vector<int> status(numUniverses, UNVISITED);
+    std::vector< std::pair<unsigned int, unsigned int> > stack;
+
+    stack.push_back(std::make_pair(0u, 0u));
+    status[0] = IN_PROGRESS;
+
+    while (!stack.empty()) {
+        const unsigned int u    = stack.back().first;
+        const unsigned int next = stack.back().second;
+
+        if (next == children[u].size()) {
+            status[u] = DONE;
+            stack.pop_back();
+            continue;
+        }
+        ++stack.back().second;
+
+        const unsigned int child = children[u][next];
+        Insist(status[child] != IN_PROGRESS,
+                "A universe is filled by a universe containing itself.");
+
+        if (status[child] == UNVISITED) {
+            Insist(!_universes[child].cells.empty()
+                        || _universes[child].lattice != NO_INDEX,
+                    "A cell is filled by a universe that was never defined.");
+            status[child] = IN_PROGRESS;
+            stack.push_back(std::make_pair(child, 0u));
+        }
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+void MCGeometry::addPeriodicPair(
+        const UserSurfaceIdType firstUserSurfaceId,
+        const UserSurfaceIdType secondUserSurfaceId)
+{
+    Insist(!_isCompleted,
+            "Tried to add periodic surfaces after completing input.");
+
+    const unsigned int pair[2]
+        = {getSurfaceIndexFromUserId(firstUserSurfaceId),
+           getSurfaceIndexFromUserId(secondUserSurfaceId)};
+    Surface* surfaces[2] = {_surfaces[pair[0]], _surfaces[pair[1]]};
+
+    Insist(pair[0] != pair[1], "A surface can't be periodic with itself.");
+
+    double parameters[2][Surface::MAX_PARAMETERS];
+    for (unsigned int i = 0; i < 2; ++i) {
+        Insist(!surfaces[i]->isPeriodic() && !surfaces[i]->isReflecting(),
+                "Periodic surfaces can't be reflecting or already paired.");
+        surfaces[i]->getParameters(parameters[i]);
+    }
+
+    // how far a particle on the first surface moves to get to the second
+    const unsigned int type = surfaces[0]->getType();
+    Insist(surfaces[1]->getType() == type,
+            "Periodic surfaces must be the same kind of plane.");
+
+    TVecDbl shift(0.0);
+    if (type >= Surface::PLANE_X && type <= Surface::PLANE_Z) {
+        shift[type - Surface::PLANE_X] = parameters[1][0] - parameters[0][0];
+    } else {
+        Insist(type == Surface::PLANE, "Periodic surfaces must be planes.");
+
+        const TVecDbl normal(parameters[0][0], parameters[0][1],
+                             parameters[0][2]);
+        const TVecDbl otherNormal(parameters[1][0], parameters[1][1],
+                                  parameters[1][2]);
+        Insist(blitz::dot(normal, otherNormal) > 1.0 - 1.e-12,
+                "Periodic planes must have the same normal.");
+
+        const TVecDbl separation(parameters[1][3] - parameters[0][3],
+                                 parameters[1][4] - parameters[0][4],
+                                 parameters[1][5] - parameters[0][5]);
+        shift = blitz::dot(normal, separation) * normal;
+    }
+    Insist(blitz::dot(shift, shift) > 0.0,
+            "Periodic surfaces can't be in the same place.");
+
+    _periodicPartners.resize(getNumSurfaces(), NO_INDEX);
+    _periodicShifts.resize(getNumSurfaces(), TVecDbl(0.0));
+
+    for (unsigned int i = 0; i < 2; ++i) {
+        surfaces[i]->_flags = static_cast<Surface::SurfaceFlags>(
+                                    surfaces[i]->_flags | Surface::PERIODIC);
+        _periodicPartners[pair[i]] = pair[1 - i];
+    }
+    _periodicShifts[pair[0]] =  shift;
+    _periodicShifts[pair[1]] = -shift;
+}
+
 /*----------------------------------------------------------------------------*/
 void MCGeometry::completedGeometryInput()
 {
+    Insist(!_isCompleted, "Geometry input was already completed.");
+
+    _checkUniverses();
+
     // resize all vectors so that no space is wasted
+    SurfaceVec(_surfaces).swap(_surfaces);
+    CellVec(_cells).swap(_cells);
+
+    //====== flatten surface-to-cell connectivity into CSR form
+    const unsigned int numKeys = 2 * getNumSurfaces();
+
+    std::vector<unsigned int> connectOffsets(numKeys + 1, 0);
 
-    // prevent new cells/surfaces from being added?
+    // count the cells for each surface/sense (shifted by one)
+    for (SCConnectMap::const_iterator it  = _surfToCellConnectivity.begin();
+                                      it != _surfToCellConnectivity.end(); ++it)
+    {
+        unsigned int key = 2 * it->first.first->getIndex()
+                            + (it->first.second ? 1 : 0);
+        connectOffsets[key + 1] = it->second.size();
+    }
+
+    // turn the counts into offsets
+    for (unsigned int key = 0; key < numKeys; ++key) {
+        connectOffsets[key + 1] += connectOffsets[key];
+    }
 
-    // make sure SCConnectMap is not empty for anything?
+    std::vector<unsigned int> connectCells(connectOffsets[numKeys]);
 
-    cout << "This doesn't do anything yet." << endl;
+    for (SCConnectMap::const_iterator it  = _surfToCellConnectivity.begin();
+                                      it != _surfToCellConnectivity.end(); ++it)
+    {
+        unsigned int key = 2 * it->first.first->getIndex()
+                            + (it->first.second ? 1 : 0);
+        std::copy(it->second.begin(), it->second.end(),
+                  connectCells.begin() + connectOffsets[key]);
+    }
+
+    _connectOffsets.adopt(connectOffsets);
+    _connectCells.adopt(connectCells);
+
+    // we don't need the map any more
+    SCConnectMap().swap(_surfToCellConnectivity);
+
+    //====== pack all the cells' encoded bounding surfaces together
+    unsigned int numBoundingSurfaces = 0;
+    for (CellVec::const_iterator cellIt  = _cells.begin();
+                                 cellIt != _cells.end(); ++cellIt)
+    {
+        numBoundingSurfaces += (*cellIt)->getNumBoundingSurfaces();
+    }
+
+    std::vector<Cell::SurfaceCode> packedSurfaceCodes(numBoundingSurfaces);
+
+    if (numBoundingSurfaces > 0) {
+        Cell::SurfaceCode* storage = &packedSurfaceCodes[0];
+        for (CellVec::iterator cellIt  = _cells.begin();
+                               cellIt != _cells.end(); ++cellIt)
+        {
+            storage = (*cellIt)->relocateSurfaceCodes(storage);
+        }
+        Check(storage == &packedSurfaceCodes[0] + numBoundingSurfaces);
+    }
+
+    // (taking over the vector leaves the codes where the cells point)
+    _packedSurfaceCodes.adopt(packedSurfaceCodes);
+
+    _buildCellHierarchy();
+    _buildSurfaceTables();
+    _buildStructuredGrids();
+
+    _isCompleted = true;
+
+    // (this looks up cells in the compiled connectivity)
+    _buildPeriodicPartners();
+}
+
+/*----------------------------------------------------------------------------*/
+void MCGeometry::_buildCellHierarchy()
+{
+    const int numCells = getNumCells();
+
+    _cellLowerBounds.resize(numCells);
+    _cellUpperBounds.resize(numCells);
+
+#pragma omp parallel for
+    for (int i = 0; i < numCells; ++i) {
+        _cells[i]->getBoundingBox(_cellLowerBounds[i], _cellUpperBounds[i]);
+    }
+
+    // each universe has its own tree over its own cells
+    std::vector<TVecDbl> lower;
+    std::vector<TVecDbl> upper;
+
+    for (std::vector<Universe>::iterator it  = _universes.begin();
+                                         it != _universes.end(); ++it)
+    {
+        lower.resize(it->cells.size());
+        upper.resize(it->cells.size());
+
+        for (unsigned int i = 0; i < it->cells.size(); ++i) {
+            lower[i] = _cellLowerBounds[it->cells[i]];
+            upper[i] = _cellUpperBounds[it->cells[i]];
+        }
+
+        it->hierarchy.build(lower, upper);
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+void MCGeometry::_buildSurfaceTables()
+{
+    const unsigned int numSurfaces = getNumSurfaces();
+
+    std::vector<unsigned char> surfaceTypes(numSurfaces);
+    std::vector<double> surfaceParameters(
+            numSurfaces * Surface::MAX_PARAMETERS, 0.0);
+
+    for (unsigned int i = 0; i < numSurfaces; ++i) {
+        surfaceTypes[i] = _surfaces[i]->getType();
+        _surfaces[i]->getParameters(
+                &surfaceParameters[i * Surface::MAX_PARAMETERS]);
+    }
+
+    _surfaceTypes.adopt(surfaceTypes);
+    _surfaceParameters.adopt(surfaceParameters);
+
+    _useSurfaceTables();
+}
+
+/*----------------------------------------------------------------------------*/
+void MCGeometry::_useSurfaceTables()
+{
+    Require(_surfaceTypes.size() == getNumSurfaces());
+    Require(_surfaceParameters.size()
+                == getNumSurfaces() * Surface::MAX_PARAMETERS);
+
+    // cells evaluate their surfaces from here instead of their own copies
+    if (getNumSurfaces() > 0) {
+        for (CellVec::iterator cellIt  = _cells.begin();
+                               cellIt != _cells.end(); ++cellIt)
+        {
+            (*cellIt)->useSurfaceTables(&_surfaces[0],
+                                        &_surfaceTypes[0],
+                                        &_surfaceParameters[0]);
+        }
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+void MCGeometry::_buildStructuredGrids()
+{
+    _grids.clear();
+    std::vector<StructuredGrid::Placement> cellPlacements;
+
+    // a grid can't mix cells from different universes
+    for (std::vector<Universe>::const_iterator
+            universeIt = _universes.begin(); universeIt != _universes.end();
+            ++universeIt)
+    {
+        _buildStructuredGrids(universeIt->cells, cellPlacements);
+    }
+
+    _cellPlacements.adopt(cellPlacements);
+}
+
+/*----------------------------------------------------------------------------*/
+void MCGeometry::_buildStructuredGrids(
+        const std::vector<unsigned int>& cells,
+        std::vector<StructuredGrid::Placement>& cellPlacements)
+{
+    std::vector<StructuredGrid::Box> boxes;
+
+    for (std::vector<unsigned int>::const_iterator it  = cells.begin();
+                                                   it != cells.end(); ++it)
+    {
+        const Cell& cell = *_cells[*it];
+        if (cell.isNegated() || cell.getNumBoundingSurfaces() != 6)
+            continue;
+
+        // each axis needs one plane below (positive sense) and one above
+        StructuredGrid::Box box;
+        box.cell = cell.getIndex();
+        unsigned int numLower[3] = {0, 0, 0};
+        unsigned int numUpper[3] = {0, 0, 0};
+        bool isBox = true;
+
+        for (const Cell::SurfaceCode* code  = cell.beginSurfaceCodes();
+                                      code != cell.endSurfaceCodes(); ++code)
+        {
+            const unsigned int surfaceIndex = Cell::getCodeIndex(*code);
+            const unsigned int type = _surfaceTypes[surfaceIndex];
+
+            if (type < Surface::PLANE_X || type > Surface::PLANE_Z) {
+                isBox = false;
+                break;
+            }
+
+            const unsigned int axis = type - Surface::PLANE_X;
+            const double coordinate
+                = _surfaceParameters[surfaceIndex * Surface::MAX_PARAMETERS];
+
+            if (Cell::getCodeSense(*code)) {
+                ++numLower[axis];
+                box.lowerSurface[axis] = surfaceIndex;
+                box.lower[axis]        = coordinate;
+            } else {
+                ++numUpper[axis];
+                box.upperSurface[axis] = surfaceIndex;
+                box.upper[axis]        = coordinate;
+            }
+        }
+
+        for (unsigned int a = 0; a < 3 && isBox; ++a) {
+            if (numLower[a] != 1 || numUpper[a] != 1
+                    || !(box.lower[a] < box.upper[a]))
+                isBox = false;
+        }
+
+        if (isBox)
+            boxes.push_back(box);
+    }
+
+    const unsigned int numOldGrids = _grids.size();
+    std::vector<StructuredGrid::Placement> boxPlacements;
+    StructuredGrid::findGrids(boxes, _grids, boxPlacements);
+
+    // only keep the placements if anything is in a grid
+    if (_grids.size() == numOldGrids)
+        return;
+
+    if (cellPlacements.empty()) {
+        StructuredGrid::Placement noPlacement;
+        noPlacement.grid = StructuredGrid::NO_GRID;
+        noPlacement.index[0] = noPlacement.index[1] = noPlacement.index[2] = 0;
+        cellPlacements.assign(getNumCells(), noPlacement);
+    }
+
+    for (unsigned int i = 0; i < boxes.size(); ++i)
+        cellPlacements[boxes[i].cell] = boxPlacements[i];
+}
+
+/*----------------------------------------------------------------------------*/
+void MCGeometry::_buildPeriodicPartners()
+{
+    _periodicOffsets.clear();
+    _periodicCells.clear();
+
+    if (_periodicPartners.empty())
+        return;
+
+    _periodicPartners.resize(getNumSurfaces(), NO_INDEX);
+    _periodicShifts.resize(getNumSurfaces(), TVecDbl(0.0));
+
+    // a face on one surface can only meet cells on the far side of the
+    // partner whose bounds, moved back across, touch its cell's bounds
+    _periodicOffsets.assign(_packedSurfaceCodes.size() + 1, 0);
+    const Cell::SurfaceCode* const packedBegin = &_packedSurfaceCodes[0];
+
+    for (CellVec::const_iterator it = _cells.begin(); it != _cells.end(); ++it)
+    {
+        const Cell& cell = **it;
+        const unsigned int cellIndex = cell.getIndex();
+
+        for (const Cell::SurfaceCode* code  = cell.beginSurfaceCodes();
+                                      code != cell.endSurfaceCodes(); ++code)
+        {
+            const unsigned int surfaceIndex = Cell::getCodeIndex(*code);
+            const unsigned int partner = _periodicPartners[surfaceIndex];
+
+            if (partner != NO_INDEX) {
+                const TVecDbl& shift = _periodicShifts[surfaceIndex];
+                const TVecDbl lower(_cellLowerBounds[cellIndex] + shift);
+                const TVecDbl upper(_cellUpperBounds[cellIndex] + shift);
+
+                // the side of the surface the cell is on, as it's connected
+                const bool sense
+                    = (Cell::getCodeSense(*code) != cell.isNegated());
+
+                const unsigned int* cellsBegin;
+                const unsigned int* cellsEnd;
+                _getConnectedCells(_surfaces[partner], !sense,
+                                   cellsBegin, cellsEnd);
+
+                for (const unsigned int* other  = cellsBegin;
+                                         other != cellsEnd; ++other)
+                {
+                    const unsigned int otherIndex = *other;
+                    if (_cellUniverses[otherIndex] == _cellUniverses[cellIndex]
+                            && boxesCanShareFace(lower, upper,
+                                    _cellLowerBounds[otherIndex],
+                                    _cellUpperBounds[otherIndex]))
+                    {
+                        _periodicCells.push_back(otherIndex);
+                    }
+                }
+            }
+
+            _periodicOffsets[code - packedBegin + 1] = _periodicCells.size();
+        }
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+void MCGeometry::findAllConnectivity()
+{
+    Insist(_isCompleted,
+            "Geometry input must be completed before finding connectivity.");
+
+    const int numSurfaces = getNumSurfaces();
+
+    // each surface touches a different list in every cell's neighborhood, so
+    // the surfaces can be connected independently
+#pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < numSurfaces; ++i) {
+        _connectAcrossSurface(_surfaces[i]);
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+void MCGeometry::startNeighborProfile()
+{
+    _isProfilingNeighbors = true;
+}
+
+/*----------------------------------------------------------------------------*/
+void MCGeometry::sortNeighborhoods()
+{
+    _isProfilingNeighbors = false;
+
+    const int numCells = getNumCells();
+
+    // every cell owns its neighborhoods, so they can be sorted independently
+#pragma omp parallel for schedule(dynamic, 64)
+    for (int i = 0; i < numCells; ++i) {
+        _cells[i]->sortNeighbors();
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+void MCGeometry::startCheckProfile()
+{
+    for (CellVec::iterator it = _cells.begin(); it != _cells.end(); ++it)
+        (*it)->startCheckProfile();
+}
+
+/*----------------------------------------------------------------------------*/
+void MCGeometry::sortSurfaceChecks()
+{
+    const int numCells = getNumCells();
+
+#pragma omp parallel for schedule(dynamic, 64)
+    for (int i = 0; i < numCells; ++i) {
+        _cells[i]->sortSurfaceChecks();
+    }
 }
 
 /*----------------------------------------------------------------------------*/
@@ -520,7 +2088,7 @@ MCGeometry::UserCellIdType MCGeometry::getUserIdFromCellIndex(
 {
     Require( index < getNumCells() );
 
-    return _cells[index]->getUserId();
+    return _cellUserIds[index];
 }
 
 /*----------------------------------------------------------------------------*/
@@ -585,7 +2153,7 @@ void MCGeometry::_warnGeometry( const std::string& shortMessage,
          << "       DIRECTION:  " << direction << "\n"
          << std::setprecision(6)
          << "       CELL INDEX: " << oldCell->getIndex()
-         << "       (user ID "    << oldCell->getUserId() << ") \n"
+         << "       (user ID "    << _cellUserIds[oldCell->getIndex()] << ") \n"
          << "       " << longMessage << "\n"
          << "      ****************************************************"
          << endl;
@@ -606,27 +2174,27 @@ void MCGeometry::_failGeometry(
 
     Require(currentCellIndex < getNumCells());
 
-    cout << "user ID [" << _cells[currentCellIndex]->getUserId() << "]"
+    cout << "user ID [" << _cellUserIds[currentCellIndex] << "]"
          << endl;
     cout << "Known cell connectivity: ";
 
-    const SASVec& boundingSurfaces
-            = _cells[currentCellIndex]->getBoundingSurfaces();
+    const Cell& currentCell = *(_cells[currentCellIndex]);
 
-    for (SASVec::const_iterator bsIt = boundingSurfaces.begin();
-                                bsIt != boundingSurfaces.end(); bsIt++)
+    for (unsigned int i = 0; i < currentCell.getNumBoundingSurfaces(); ++i)
     {
-        cout << *bsIt << ":[";
+        const SurfaceAndSense surfAndSense
+            = currentCell.getBoundingSurface(i);
+        cout << surfAndSense << ":[";
 
         const Cell::CellContainer& otherCells =
-            _cells[currentCellIndex]->getNeighbors(bsIt->first);
+            currentCell.getNeighbors(surfAndSense.first);
 
         for (Cell::CellContainer::const_iterator
                                      outCelIt = otherCells.begin();
                                      outCelIt != otherCells.end();
                                      ++outCelIt)
         {
-            cout << (*outCelIt)->getUserId() << " ";
+            cout << _cellUserIds[(*outCelIt)->getIndex()] << " ";
         }
         cout << "] ";
     }
@@ -651,6 +2219,8 @@ void MCGeometry::debugPrint() const
 
         if ( (*surfIt)->isReflecting() )
             cout << " <REFLECTING>";
+        if ( (*surfIt)->isPeriodic() )
+            cout << " <PERIODIC>";
 
         cout << endl;
     }
@@ -661,16 +2231,12 @@ void MCGeometry::debugPrint() const
     for (CellVec::const_iterator cellIt = _cells.begin();
                                  cellIt != _cells.end(); ++cellIt)
     {
-        cout << " CELL " << (*cellIt)->getUserId() << ": ";
+        cout << " CELL " << _cellUserIds[(*cellIt)->getIndex()] << ": ";
 
         // query cell for surface pointers
-        const Cell::SASVec& boundingSurfaces =
-                        (*cellIt)->getBoundingSurfaces();
-
-        for (Cell::SASVec::const_iterator bsIt  = boundingSurfaces.begin();
-                                        bsIt != boundingSurfaces.end(); ++bsIt)
+        for (unsigned int i = 0; i < (*cellIt)->getNumBoundingSurfaces(); ++i)
         {
-            cout << *bsIt << " ";
+            cout << (*cellIt)->getBoundingSurface(i) << " ";
         }
 
         if ( (*cellIt)->isNegated() )
@@ -685,21 +2251,25 @@ void MCGeometry::debugPrint() const
     //-------------- PRINT SURFACES TO CELLS ----------------//
     cout << "SURFACES TO CELLS: " << endl;
 
-    for (SCConnectMap::const_iterator
-            surfToCellIt = _surfToCellConnectivity.begin();
-            surfToCellIt != _surfToCellConnectivity.end();
-            ++surfToCellIt)
+    for (unsigned int key = 0; key < 2 * getNumSurfaces(); ++key)
     {
+        SurfaceAndSense surfAndSense(_surfaces[key / 2], (key % 2 == 1));
+
+        const unsigned int* cellsBegin;
+        const unsigned int* cellsEnd;
+        _getConnectedCells(surfAndSense.first, surfAndSense.second,
+                           cellsBegin, cellsEnd);
+
+        if (cellsBegin == cellsEnd)
+            continue;
+
         // print the surface and orientation
-        cout << " " << surfToCellIt->first << ": ";
+        cout << " " << surfAndSense << ": ";
 
         // print the cells
-        const CellVec& theCells = surfToCellIt->second;
-
-        for (CellVec::const_iterator cIt = theCells.begin();
-                                     cIt != theCells.end(); ++cIt)
+        for (const unsigned int* cIt = cellsBegin; cIt != cellsEnd; ++cIt)
         {
-            cout << (*cIt)->getUserId() << " ";
+            cout << _cellUserIds[*cIt] << " ";
         }
 
         cout << endl;
@@ -710,26 +2280,24 @@ void MCGeometry::debugPrint() const
     for (CellVec::const_iterator cellIt = _cells.begin();
                                  cellIt != _cells.end(); ++cellIt)
     {
-        cout << " CELL " << (*cellIt)->getUserId() << ": ";
+        cout << " CELL " << _cellUserIds[(*cellIt)->getIndex()] << ": ";
 
         // query cell for surface pointers
-        const Cell::SASVec& boundingSurfaces
-                    = (*cellIt)->getBoundingSurfaces();
-
-        for (Cell::SASVec::const_iterator bsIt = boundingSurfaces.begin();
-                                    bsIt != boundingSurfaces.end(); bsIt++)
+        for (unsigned int i = 0; i < (*cellIt)->getNumBoundingSurfaces(); ++i)
         {
-            cout << *bsIt << ":{";
+            const SurfaceAndSense surfAndSense
+                = (*cellIt)->getBoundingSurface(i);
+            cout << surfAndSense << ":{";
 
             const Cell::CellContainer& otherCells =
-                (*cellIt)->getNeighbors(bsIt->first);
+                (*cellIt)->getNeighbors(surfAndSense.first);
 
             for (Cell::CellContainer::const_iterator
                                         outCelIt = otherCells.begin();
                                         outCelIt != otherCells.end();
                                         ++outCelIt)
             {
-                cout << (*outCelIt)->getUserId() << " ";
+                cout << _cellUserIds[(*outCelIt)->getIndex()] << " ";
             }
             cout << "} ";
         }
@@ -740,29 +2308,34 @@ void MCGeometry::debugPrint() const
 
 /*----------------------------------------------------------------------------*/
 // creation
-MCGeometry::MCGeometry() :
+MCGeometry::MCGeometry(const tranSupport::Arena::PageKind pages) :
+    _surfaceArena(pages),
+    _cellArena(pages),
+    _isCompleted(false),
+    _hasFills(false),
+    _isProfilingNeighbors(false),
     _unMatchedSurfaces(0)
 {
-    /* * */
+    // the root universe is always first
+    _getUniverseIndex(0);
 }
 
 /*----------------------------------------------------------------------------*/
 // clean up after ourselves
 MCGeometry::~MCGeometry()
 {
-    // map iterators act as a pointer to (key, value) pair
+    // the objects live in our arenas, which free all their memory at once;
+    // only their destructors have to be called here
     for (SurfaceVec::iterator surfIt = _surfaces.begin();
                               surfIt != _surfaces.end(); ++surfIt)
     {
-        // dereferenced iterator is a pointer to the surface we need to delete
-        delete (*surfIt);
+        (*surfIt)->~Surface();
     }
 
     for (CellVec::iterator cellIt = _cells.begin();
                            cellIt != _cells.end(); ++cellIt)
     {
-        // dereferenced iterator is a pointer to the cell we need to delete
-        delete (*cellIt);
+        (*cellIt)->~Cell();
     }
 }
 
@@ -41,10 +41,18 @@
 #include <vector>
 #include <utility>
 #include <string>
+#include <atomic>
 #include <blitz/tinyvec.h>
 
 #include "Cell.hpp"
+#include "BoundingVolumeHierarchy.hpp"
+#include "StructuredGrid.hpp"
+#include "Lattice.hpp"
+#include "TrackState.hpp"
 #include "transupport/dbc.hpp"
+#include "transupport/Arena.hpp"
+#include "transupport/FlatArray.hpp"
+#include "transupport/MappedFile.hpp"
 
 namespace mcGeometry {
 /*============================================================================*/
@@ -85,6 +93,12 @@ public:
     //! User's cell IDs are unsigned ints for now. (Maybe templated later.)
     typedef unsigned int UserCellIdType;
 
+    //! User's universe IDs are unsigned ints; universe 0 is the root.
+    typedef unsigned int UserUniverseIdType;
+
+    //! Vector of universe user IDs filling the elements of a lattice.
+    typedef std::vector<UserUniverseIdType>        UniverseIdVec;
+
     //! Blitz++ TinyVector of length D stores position/direction/etc.
     typedef blitz::TinyVector<double, 3> TVecDbl;
 
@@ -97,6 +111,7 @@ public:
         NORMAL    = 0,  //!< Business as usual in the particle world
         DEADCELL,       //!< New cell is a dead cell
         REFLECTED,      //!< Particle hit a reflecting surface
+        PERIODIC,       //!< Particle was moved to a periodic partner surface
         LOST            //!< God help us all if this is ever returned!
     };
 
@@ -117,15 +132,239 @@ public:
      * and add the new cell.
      *
      * Return INTERNAL index of the surface (0 to N_cell - 1).
+     *
+     * The cell belongs to the root universe unless another is given; cells
+     * in other universes only matter where those universes fill a cell.
      */
     unsigned int addCell(const UserCellIdType& userCellId,
                          const IntVec& surfaces,
-                         const Cell::CellFlags flags = Cell::NONE);
+                         const Cell::CellFlags flags = Cell::NONE,
+                         const UserUniverseIdType userUniverseId = 0);
+
+    /*!
+     * \brief Fill a cell with a universe or lattice.
+     *
+     * The universe's origin is placed at the origin of the cell's own
+     * coordinates. A particle in the cell is really in whichever of the
+     * universe's cells contains it (which may be filled in turn), and that
+     * innermost cell is the one that findCell() and findNewCell() report.
+     * Repeated structures are therefore defined once, however many times
+     * they're placed. Universes may be referred to before their cells are
+     * added, but must have some by the time input is completed.
+     */
+    void fillCell(const UserCellIdType userCellId,
+                  const UserUniverseIdType userUniverseId);
+
+    /*!
+     * \brief Fill a cell with a translated copy of a universe.
+     *
+     * The universe's origin is placed at \c translation in the cell's
+     * coordinates.
+     */
+    void fillCell(const UserCellIdType userCellId,
+                  const UserUniverseIdType userUniverseId,
+                  const TVecDbl& translation);
+
+    /*!
+     * \brief Fill a cell with a translated and rotated copy of a universe.
+     *
+     * \c axes are the directions of the universe's x, y, and z axes in the
+     * cell's coordinates, and must be orthonormal. The universe's surfaces
+     * aren't copied: particles are transformed into the universe's
+     * coordinates as they enter it, so axis-aligned surfaces there keep
+     * their fast distance calculations.
+     */
+    void fillCell(const UserCellIdType userCellId,
+                  const UserUniverseIdType userUniverseId,
+                  const TVecDbl& translation,
+                  const TVecDbl axes[3]);
 
-    //! Do optimization after input is finished, check geometry for duplicate
-    //! surfaces, etc.
+    /*!
+     * \brief Define a universe as a rectangular lattice of other universes.
+     *
+     * Each box of the lattice is filled by the universe given for it, x
+     * varying fastest (see Lattice). The elements must be universes made of
+     * cells, not lattices themselves.
+     */
+    void addRectangularLattice(const UserUniverseIdType userUniverseId,
+                               const TVecDbl& lowerCorner,
+                               const TVecDbl& pitch,
+                               const unsigned int numElements[3],
+                               const UniverseIdVec& elementUniverses);
+
+    /*!
+     * \brief Define a universe as a hexagonal lattice of other universes.
+     *
+     * The hexagonal prisms form \c numRings rings around the one centered on
+     * \c origin, in \c numLayers layers of the given height; see Lattice
+     * for how the elements are ordered.
+     */
+    void addHexagonalLattice(const UserUniverseIdType userUniverseId,
+                             const TVecDbl& origin,
+                             const double pitch,
+                             const double height,
+                             const unsigned int numRings,
+                             const unsigned int numLayers,
+                             const UniverseIdVec& elementUniverses);
+
+    /*!
+     * \brief Make two parallel planes periodic with each other.
+     *
+     * A particle leaving through either one comes back in through the other,
+     * moved by the distance between them, so a single unit cell can stand in
+     * for an infinite array of copies. The planes must have the same normal
+     * (two of PlaneX, PlaneY, or PlaneZ, or two Planes), and neither can be
+     * reflecting.
+     */
+    void addPeriodicPair(const UserSurfaceIdType firstUserSurfaceId,
+                         const UserSurfaceIdType secondUserSurfaceId);
+
+    /*!
+     * \brief Compile the geometry into its final, immutable form.
+     *
+     * Call this once all surfaces and cells have been added. The
+     * surface-to-cell connectivity is flattened into a compressed sparse row
+     * array indexed by <tt>2 * surfaceIndex + sense</tt>, and the bounding
+     * surfaces of every cell are packed into one contiguous array, so
+     * findNewCell does no map lookups when searching for a new cell. No
+     * surfaces or cells may be added afterward.
+     *
+     * Transport works without calling this, but more slowly.
+     */
     void completedGeometryInput();
 
+    /*!
+     * \brief Fill in every cell's neighborhood before transport starts.
+     *
+     * Without this, the neighborhoods are learned during transport, which
+     * makes the first pass through a large geometry far slower than later
+     * ones. Here, for each surface, cells on one side are connected to cells
+     * on the other side whose bounding boxes share a patch of the surface.
+     * This finds every direct neighbor and, because the boxes are
+     * conservative, possibly a few cells that aren't; those only cost an
+     * extra Cell::isPointInside() check. Surfaces are processed in parallel
+     * when OpenMP is enabled.
+     *
+     * This may only be called after completedGeometryInput().
+     */
+    void findAllConnectivity();
+
+    /*!
+     * \brief Start counting which neighbor each crossing ends up in.
+     *
+     * findNewCell checks a cell's neighbors across a surface in the order
+     * they were found. While profiling, it also counts (atomically, in
+     * counters shared by every thread) which neighbor the particle entered,
+     * so it's meant for a warm-up batch; otherwise nothing is written while
+     * reading the neighborhoods. No other thread may be tracking while this
+     * runs.
+     */
+    void startNeighborProfile();
+
+    /*!
+     * \brief Reorder neighborhoods so the likeliest neighbor is checked first.
+     *
+     * This sorts every neighborhood by the counts from
+     * startNeighborProfile(), then halves them so that a later profile can
+     * adapt the order to changes (e.g. in the source), and stops profiling.
+     * This cuts the Cell::isPointInside() checks on surfaces shared by many
+     * cells.
+     *
+     * No other thread may be tracking while this runs.
+     */
+    void sortNeighborhoods();
+
+    /*!
+     * \brief Start profiling which surfaces decide Cell::isPointInside().
+     *
+     * Every cell that isn't bounded only by planes counts how often each of
+     * its surfaces is checked and how often it rejects the point. This costs
+     * two atomic increments per surface checked, so it's meant for a
+     * warm-up batch. No other thread may be tracking while this runs.
+     */
+    void startCheckProfile();
+
+    /*!
+     * \brief Reorder each cell's surface checks using the profile.
+     *
+     * Each cell checks first the surfaces that most often decide
+     * isPointInside() for the least cost (see Cell::sortSurfaceChecks), so
+     * a candidate cell the particle isn't in is rejected sooner. Profiling
+     * stops. No other thread may be tracking while this runs.
+     */
+    void sortSurfaceChecks();
+
+    /*!
+     * \brief Fingerprint of the geometry definition.
+     *
+     * This hashes every surface (type, parameters, user ID, and reflecting
+     * flag) and every cell (user ID, flags, and bounding surfaces with their
+     * senses), in input order, along with the universes: which one each cell
+     * belongs to, what fills it and how that fill is placed, every lattice,
+     * and the periodic surface pairs. Two geometries built from the same
+     * input have the same hash, so it identifies which model a saved
+     * connectivity file belongs to.
+     */
+    unsigned long long getGeometryHash() const;
+
+    /*!
+     * \brief Save every cell's learned neighborhood to a binary file.
+     *
+     * The file is tagged with getGeometryHash(), so it can only be read back
+     * into the same geometry. Neighborhoods learned during transport are
+     * saved as well as those from findAllConnectivity(), so a production run
+     * can pass its warm-up along to later runs of the same model.
+     *
+     * This may only be called after completedGeometryInput().
+     */
+    void writeConnectivity(const std::string& fileName) const;
+
+    /*!
+     * \brief Load neighborhoods saved by writeConnectivity().
+     *
+     * Returns false, leaving the geometry unchanged, if the file doesn't
+     * exist or was written for a different geometry. Loaded neighbors are
+     * added to any that are already known.
+     *
+     * This may only be called after completedGeometryInput().
+     */
+    bool readConnectivity(const std::string& fileName);
+
+    /*!
+     * \brief Save the whole compiled geometry to a binary file.
+     *
+     * The file holds the surfaces, cells, user IDs, compiled surface-to-cell
+     * connectivity, and every neighborhood learned so far, as flat
+     * fixed-size records in native byte order. The layout is versioned.
+     *
+     * This may only be called after completedGeometryInput().
+     */
+    void writeBinaryGeometry(const std::string& fileName) const;
+
+    /*!
+     * \brief Build this geometry from a file saved by writeBinaryGeometry().
+     *
+     * The file is memory-mapped read-only and stays mapped as long as the
+     * geometry. The flat arrays read while tracking (the cells' packed
+     * bounding surfaces, the surface kinds and parameters, and the compiled
+     * connectivity) are used where they are in the mapping, so their pages
+     * are shared with every other process that loads the same file. The
+     * surfaces and cells themselves are created directly in their final
+     * form, and the user ID maps are built from sorted lists. So the cost of
+     * addSurface(), addCell(), and completedGeometryInput() is never paid.
+     * The result is a completed geometry.
+     *
+     * Returns false, leaving the geometry empty, if the file doesn't exist
+     * or isn't a binary geometry of this version and byte order. A corrupt
+     * file is an error. This may only be called on an empty geometry.
+     */
+    bool readBinaryGeometry(const std::string& fileName);
+
+    //! Whether completedGeometryInput() has been called.
+    bool isCompleted() const {
+        return _isCompleted;
+    }
+
     //\}
     /*------------------------------------------------------------*/
     //! \name Particle transport
@@ -134,26 +373,60 @@ public:
     /*!
      * \brief Find the distance to the closest geometry interaction.
      *
-     *  Given a current position, location, and cell this also caches the hit
-     *  surface so we don't have to re-calculate the intersected surface, etc.
+     *  Given a current position, location, and cell this also stores the hit
+     *  surface in a caller-owned TrackState so we don't have to re-calculate
+     *  the intersected surface, etc.
      *  \param[in]  position     Current particle position.
      *  \param[in]  direction    Current particle direction.
      *  \param[in]  oldCellIndex Current particle internal cell index.
      *  \param[out] distance     Distance to intersecting a surface.
+     *  \param[out] state        Intersection information for findNewCell.
      *
      *  This function loops over every surface inside the old cell, and finds
-     *  the surface that is the smallest distance away. It caches this closest
-     *  surface and distance for later, and returns to the user the closest
-     *  distance.
+     *  the surface that is the smallest distance away. It saves this closest
+     *  surface and distance in \c state for later, and returns to the user
+     *  the closest distance.
      *
      *  If the geometry is completely defined (i.e. there are no missing gaps
      *  and the outside is properly defined with "dead cells"), it will always
      *  return a finite distance.
+     *
+     *  Nothing in the geometry is modified, so any number of threads may call
+     *  this at once as long as each uses its own \c state.
      */
     void findDistance(      const TVecDbl& position,
                             const TVecDbl& direction,
                             const unsigned int oldCellIndex,
-                            double& distance);
+                            double& distance,
+                            TrackState& state) const;
+
+    /*!
+     * \brief Find the distance to the closest surface, if it's within reach.
+     *
+     *  \param[in]  position     Current particle position.
+     *  \param[in]  direction    Current particle direction.
+     *  \param[in]  oldCellIndex Current particle internal cell index.
+     *  \param[in]  maxDistance  Farthest the particle will go (e.g. to its
+     *                           next collision).
+     *  \param[out] distance     Distance to intersecting a surface.
+     *  \param[out] state        Intersection information for findNewCell.
+     *
+     *  This is findDistance() for a particle that already knows it won't go
+     *  farther than \c maxDistance. Surfaces beyond that are ruled out as
+     *  early as possible: the quadrics check cheap bounds before taking a
+     *  square root, and every surface after the nearest one found so far
+     *  only has to beat it.
+     *
+     *  Returns false if no surface is within \c maxDistance, in which case
+     *  \c distance is infinite and findNewCell() must not be called.
+     *  Otherwise the result is the same as findDistance().
+     */
+    bool findDistance(      const TVecDbl& position,
+                            const TVecDbl& direction,
+                            const unsigned int oldCellIndex,
+                            const double maxDistance,
+                            double& distance,
+                            TrackState& state) const;
 
     /*!
      * \brief Go ahead and find the next cell after finding the distance.
@@ -163,8 +436,9 @@ public:
      *  \param[out] newPosition  Particle's new position at the surface.
      *  \param[out] newCellIndex Internal cell index of the new cell.
      *  \param[out] returnStatus Extra information about the transport.
+     *  \param[in,out] state     Intersection information from findDistance.
      *
-     *  Using the cached \c oldCellIndex and \c hitSurface from \c
+     *  Using the \c oldCellIndex and \c hitSurface stored in \c state by \c
      *  findDistance(),  we find the cell on the other side of the hit surface.
      *
      *  First, we
@@ -172,6 +446,11 @@ public:
      *  work is necessary, and we set the returnStatus to
      *  \c MCGeometry::REFLECTED .
      *
+     *  If it's periodic, \c newPosition is moved onto the partner surface,
+     *  the new cell is looked up in the list found for that face of the old
+     *  cell when the geometry was completed, and the returnStatus is
+     *  \c MCGeometry::PERIODIC .
+     *
      *  Next, we ask the old cell for the "neighborhood" of cells that it knows
      *  are on the other side of that surface. We loop for each of those,
      *  calling \c Cell::isPointInside(), passing the surface that the
@@ -204,17 +483,23 @@ public:
      *  If that turns up nothing, then the user's geometry is most certainly
      *  flawed.
      *
-     *  This function is ONLY valid after calling findDistance to calculate the
-     *  surface crossing in a given transport iteration. The position and
-     *  direction are expected to be unchanged between calling findDistance and
-     *  findNewCell. Although this is checked when \c DBC is 7, it is not
-     *  checked with debug code off.
+     *  This function is ONLY valid after calling findDistance with the same
+     *  \c state to calculate the surface crossing in a given transport
+     *  iteration. The position and direction are expected to be unchanged
+     *  between calling findDistance and findNewCell. Although this is checked
+     *  when \c DBC is 7, it is not checked with debug code off.
+     *
+     *  The particle's own data live entirely in \c state. The cell
+     *  neighborhoods are a cache that is still learned here, but they are
+     *  lock-free and append-only, so any number of threads may call this at
+     *  once as long as each uses its own \c state.
      */
     void findNewCell(       const TVecDbl& position,
                             const TVecDbl& direction,
                             TVecDbl& newPosition,
                             unsigned int& newCellIndex,
-                            ReturnStatus& returnStatus);
+                            ReturnStatus& returnStatus,
+                            TrackState& state) const;
 
     //!\brief Calculate distance to next cell *and* do the next-cell calculation
     //! in one go.
@@ -224,11 +509,13 @@ public:
                             TVecDbl& newPosition,
                             unsigned int& newCellIndex,
                             double& distanceTraveled,
-                            ReturnStatus& returnStatus)
+                            ReturnStatus& returnStatus,
+                            TrackState& state) const
     {
-        findDistance(position, direction, oldCellIndex, distanceTraveled);
+        findDistance(position, direction, oldCellIndex, distanceTraveled,
+                     state);
         findNewCell(position, direction, newPosition,
-                    newCellIndex, returnStatus);
+                    newCellIndex, returnStatus, state);
     }
 
      /*!
@@ -238,12 +525,14 @@ public:
      *  \param[in]  newPosition  Particle position after transporting
      *  \param[in]  oldDirection Particle direction before reflecting
      *  \param[out] newDirection Direction after reflecting
+     *  \param[in]  state        Intersection information from findDistance
      *
      *  This function is ONLY valid after calling findDistance.
      */
     void reflectDirection(  const TVecDbl& newPosition,
                             const TVecDbl& oldDirection,
-                            TVecDbl& newDirection);
+                            TVecDbl& newDirection,
+                            const TrackState& state) const;
 
     /*!
      * \brief Return information about a crossed surface.
@@ -254,24 +543,204 @@ public:
      *  \param[out] surfaceCrossingUserId User ID of the surface that was
      *                      crossed
      *  \param[out] dotProduct   Omega dot n (use for surface current tally)
+     *  \param[in]  state        Intersection information from findDistance
+     *
+     */
+    void getSurfaceCrossing(    const TVecDbl& newPosition,
+                                const TVecDbl& oldDirection,
+                                UserSurfaceIdType& surfaceCrossingUserId,
+                                double&       dotProduct,
+                                const TrackState& state) const;
+
+    /*!
+     * \brief Find how far a particle can go in any direction inside its cell.
+     *
+     *  \param[in] position  Particle position.
+     *  \param[in] cellIndex Internal index of the cell containing it.
+     *
+     *  This is the distance to the nearest of the cell's bounding surfaces,
+     *  which never exceeds the distance to the cell's boundary. A particle
+     *  whose next collision is closer than this stays in its cell whichever
+     *  way it's headed, so findDistance() can be skipped entirely.
+     *
+     *  Nothing in the geometry is modified, and no TrackState is needed;
+     *  with filled cells, though, this has to find the cell at every level
+     *  from the root universe down.
+     */
+    double findSafetyDistance(  const TVecDbl& position,
+                                const unsigned int cellIndex) const;
+
+    /*!
+     * \brief Find how far a particle can go inside its cell at every level.
+     *
+     *  This is the same as findSafetyDistance() above, but with filled cells
+     *  it uses the levels in \c state (from findCell() or findNewCell()) if
+     *  they end in \c cellIndex, instead of finding them again.
+     */
+    double findSafetyDistance(  const TVecDbl& position,
+                                const unsigned int cellIndex,
+                                const TrackState& state) const;
+
+    //\}
+    /*------------------------------------------------------------*/
+    //! \name Batched transport
+    //
+    // These process many particles at once, stored as structure-of-arrays:
+    // \c position[0][i], \c position[1][i], and \c position[2][i] are the
+    // coordinates of particle \c i, and likewise for directions. Each
+    // particle has its own TrackState, exactly as from the single-particle
+    // calls, and gets the same cell, surface, and distance as it would from
+    // calling those in turn.
+    //\{
+
+    /*!
+     * \brief Find the distance to the closest interaction for many particles.
+     *
+     *  \param[in]  numParticles Number of particles in each array.
+     *  \param[in]  position     Particle positions, one array per axis.
+     *  \param[in]  direction    Particle directions, one array per axis.
+     *  \param[in]  cellIndex    Internal index of each particle's cell.
+     *  \param[out] distance     Distance to each particle's next surface.
+     *  \param[out] state        Intersection information for each particle.
+     *
+     *  Particles are handed to findDistance() independently, in parallel
+     *  when OpenMP is enabled. As there, a particle that never leaves its
+     *  cell is an error.
+     *
+     *  This may only be called after completedGeometryInput().
+     */
+    void findDistances(     const unsigned int numParticles,
+                            const double* const position[3],
+                            const double* const direction[3],
+                            const unsigned int* cellIndex,
+                            double* distance,
+                            TrackState* state) const;
+
+    /*!
+     * \brief Find the next cell for many particles after findDistances().
+     *
+     *  \param[in]  numParticles Number of particles in each array.
+     *  \param[in]  position     Particle positions, one array per axis.
+     *  \param[in]  direction    Particle directions, one array per axis.
+     *  \param[out] newPosition  Positions at the surface, one array per axis.
+     *  \param[out] newCellIndex Internal index of each particle's new cell.
+     *  \param[out] returnStatus Extra information about each particle.
+     *  \param[in,out] state     Intersection information from findDistances.
      *
+     *  Particles are handed to findNewCell() independently, in parallel
+     *  when OpenMP is enabled.
      */
+    void findNewCells(      const unsigned int numParticles,
+                            const double* const position[3],
+                            const double* const direction[3],
+                            double* const newPosition[3],
+                            unsigned int* newCellIndex,
+                            ReturnStatus* returnStatus,
+                            TrackState* state) const;
+
+    //\}
+    /*------------------------------------------------------------*/
+    //! \name Single-particle transport
+    //
+    // These use a TrackState stored inside MCGeometry, so only one particle
+    // at a time may be in flight between findDistance and findNewCell.
+    //\{
+
+    //! Find the distance to the closest geometry interaction.
+    void findDistance(      const TVecDbl& position,
+                            const TVecDbl& direction,
+                            const unsigned int oldCellIndex,
+                            double& distance)
+    {
+        findDistance(position, direction, oldCellIndex, distance, _findCache);
+    }
+
+    //! Find the next cell after finding the distance.
+    void findNewCell(       const TVecDbl& position,
+                            const TVecDbl& direction,
+                            TVecDbl& newPosition,
+                            unsigned int& newCellIndex,
+                            ReturnStatus& returnStatus)
+    {
+        findNewCell(position, direction, newPosition, newCellIndex,
+                    returnStatus, _findCache);
+    }
+
+    //!\brief Calculate distance to next cell *and* do the next-cell calculation
+    //! in one go.
+    void findNewCell(       const TVecDbl& position,
+                            const TVecDbl& direction,
+                            const unsigned int oldCellIndex,
+                            TVecDbl& newPosition,
+                            unsigned int& newCellIndex,
+                            double& distanceTraveled,
+                            ReturnStatus& returnStatus)
+    {
+        findNewCell(position, direction, oldCellIndex, newPosition,
+                    newCellIndex, distanceTraveled, returnStatus, _findCache);
+    }
+
+    //! If we found that the surface was reflecting, change the direction.
+    void reflectDirection(  const TVecDbl& newPosition,
+                            const TVecDbl& oldDirection,
+                            TVecDbl& newDirection) const
+    {
+        reflectDirection(newPosition, oldDirection, newDirection, _findCache);
+    }
+
+    //! Return information about a crossed surface.
     void getSurfaceCrossing(    const TVecDbl& newPosition,
                                 const TVecDbl& oldDirection,
                                 UserSurfaceIdType& surfaceCrossingUserId,
-                                double&       dotProduct);
+                                double&       dotProduct) const
+    {
+        getSurfaceCrossing(newPosition, oldDirection, surfaceCrossingUserId,
+                           dotProduct, _findCache);
+    }
 
     //\}
     /*------------------------------------------------------------*/
     //! \name Problem information
     //\{
 
-    //! Find a cell given an arbitrary point in the problem.
+    /*!
+     * \brief Find a cell given an arbitrary point in the problem.
+     *
+     * Once the geometry is completed, this only checks the cells whose
+     * bounding boxes contain the point, using a bounding volume hierarchy.
+     * Before that, it checks every cell.
+     */
     unsigned int findCell(const TVecDbl& position) const;
 
+    /*!
+     * \brief Find a cell and start tracking a particle from it.
+     *
+     * When cells are filled with universes, this records the cell the
+     * particle is in at every level, so findDistance() can follow it from
+     * there; starting from an empty track state, the particle's levels are
+     * found from its position alone, which is ambiguous on a boundary.
+     */
+    unsigned int findCell(const TVecDbl& position, TrackState& state) const;
+
     //! See whether a given cell is a dead cell.
     bool isDeadCell(const unsigned int cellIndex) const;
 
+    /*!
+     * \brief Return the number of structured grids that were found.
+     *
+     * When the geometry is completed, cells bounded by one PlaneNormal on
+     * either side along each axis that fit together into a rectilinear grid
+     * are tracked through by index (see TrackState::useStructuredGrids).
+     */
+    unsigned int getNumStructuredGrids() const {
+        return _grids.size();
+    }
+
+    //! Return the number of universes (including the root and lattices).
+    unsigned int getNumUniverses() const {
+        return _universes.size();
+    }
+
     //! Return the number of cells we have stored.
     unsigned int getNumCells() const {
         return _cells.size();
@@ -310,10 +779,16 @@ public:
     //\}
     /*------------------------------------------------------------*/
 
-    //! Constructor.
-    MCGeometry();
+    /*! \brief Constructor.
+     *
+     * Surfaces and cells are placed one after another in arenas that the
+     * geometry owns; \c pages chooses whether those are backed by huge
+     * pages, which helps large models.
+     */
+    explicit MCGeometry(const tranSupport::Arena::PageKind pages
+                            = tranSupport::Arena::NORMAL_PAGES);
 
-    //! Destructor must delete actual surfaces and cell memory.
+    //! Destructor must destroy actual surfaces and cells.
     ~MCGeometry();
 
 private:
@@ -327,13 +802,41 @@ private:
     //! Vector of pointers to cells
     typedef std::vector< Cell* >                 CellVec;
 
-    //! Connect surface-and-senses to a vector of cells on the other side
-    typedef std::map< SurfaceAndSense, CellVec >  SCConnectMap;
+    //! Connect surface-and-senses to the indices of the cells on that side
+    typedef std::map< SurfaceAndSense, std::vector<unsigned int> >
+                                                  SCConnectMap;
 
     //! Map user surface IDs to surface internal index
     typedef std::map< UserSurfaceIdType, unsigned int >   SurfaceRevIDMap;
     //! Map user cell IDs to cell internal index
     typedef std::map< UserCellIdType, unsigned int >      CellRevIDMap;
+    //! Map user universe IDs to universe internal index
+    typedef std::map< UserUniverseIdType, unsigned int >  UniverseRevIDMap;
+
+    //! Marks a cell that isn't filled, or a universe that isn't a lattice.
+    static const unsigned int NO_INDEX = static_cast<unsigned int>(-1);
+
+    //! The cells that make up one universe, or the lattice that does.
+    struct Universe {
+        //! User's ID for the universe
+        UserUniverseIdType        userId;
+        //! Internal indices of its cells
+        std::vector<unsigned int> cells;
+        //! Index into _lattices, or NO_INDEX
+        unsigned int              lattice;
+        //! Tree of its cells' bounds
+        BoundingVolumeHierarchy   hierarchy;
+    };
+
+    //! Where a universe filling a cell is placed in the cell's coordinates.
+    struct FillTransform {
+        //! Universe's origin
+        TVecDbl translation;
+        //! Whether it's rotated at all
+        bool    isRotated;
+        //! Universe's axes
+        TVecDbl axes[3];
+    };
 
     //====== INTERNAL ASSOCIATIVE VECTORS AND MAPS ======//
     // These use pointers and unsigned index values that handle
@@ -349,9 +852,98 @@ private:
     //! representation of them
     CellVec    _cells;
 
-    //! What cells connect to a surface with a particular sense.
+    //! User ID of each cell, indexed like _cells.
+    std::vector<UserCellIdType> _cellUserIds;
+
+    //! Storage for the surfaces, in the order they were added.
+    tranSupport::Arena _surfaceArena;
+
+    //! Storage for the cells, in the order they were added.
+    tranSupport::Arena _cellArena;
+
+    //! What cells connect to a surface with a particular sense (only used
+    //! while the geometry is being built).
     SCConnectMap _surfToCellConnectivity;
 
+    //====== COMPILED GEOMETRY (after completedGeometryInput) ======//
+
+    //! Whether the geometry has been compiled.
+    bool _isCompleted;
+
+    //! The binary geometry file we were read from, if any; the flat arrays
+    //! below may point into it.
+    tranSupport::MappedFile _mappedFile;
+
+    //! Start of each surface/sense's cells in _connectCells, indexed by
+    //! 2 * surface index + sense (with one extra entry at the end).
+    tranSupport::FlatArray<unsigned int> _connectOffsets;
+
+    //! Indices of the cells that connect to each surface/sense, packed
+    //! contiguously.
+    tranSupport::FlatArray<unsigned int> _connectCells;
+
+    //! Encoded bounding surfaces of every cell, packed contiguously.
+    tranSupport::FlatArray<Cell::SurfaceCode> _packedSurfaceCodes;
+
+    //! Conservative lower corner of each cell.
+    std::vector<TVecDbl> _cellLowerBounds;
+
+    //! Conservative upper corner of each cell.
+    std::vector<TVecDbl> _cellUpperBounds;
+
+
+    //! Kind of each surface, for the cells and batched distance kernels.
+    tranSupport::FlatArray<unsigned char> _surfaceTypes;
+
+    //! Parameters of each surface (Surface::MAX_PARAMETERS apiece).
+    tranSupport::FlatArray<double> _surfaceParameters;
+
+    //! Grids of box cells that can be tracked through by index.
+    std::vector<StructuredGrid> _grids;
+
+    //! Which grid each cell is in, and where (empty if there are no grids).
+    tranSupport::FlatArray<StructuredGrid::Placement> _cellPlacements;
+
+    //====== UNIVERSES ======//
+
+    //! Every universe; the root is first.
+    std::vector<Universe> _universes;
+
+    //! Lattices that define universes.
+    std::vector<Lattice> _lattices;
+
+    //! Universe that each cell belongs to.
+    std::vector<unsigned int> _cellUniverses;
+
+    //! Universe that fills each cell, or NO_INDEX.
+    std::vector<unsigned int> _cellFills;
+
+    //! Index into _fillTransforms for each cell, or NO_INDEX if untransformed.
+    std::vector<unsigned int> _cellFillTransforms;
+
+    //! Transforms of the universes filling cells.
+    std::vector<FillTransform> _fillTransforms;
+
+    //====== PERIODIC SURFACES ======//
+
+    //! Index of each surface's periodic partner, or NO_INDEX.
+    std::vector<unsigned int> _periodicPartners;
+
+    //! How a particle crossing each periodic surface is moved.
+    std::vector<TVecDbl> _periodicShifts;
+
+    //! Where each packed bounding surface's partner cells start.
+    std::vector<unsigned int> _periodicOffsets;
+
+    //! Cells that may be across each periodic face, from its partner.
+    std::vector<unsigned int> _periodicCells;
+
+    //! Whether any cell is filled (so particles are tracked by level).
+    bool _hasFills;
+
+    //! Whether findNewCell counts which neighbors it finds.
+    bool _isProfilingNeighbors;
+
     //======     USER ASSOCIATIVE MAPS     ======//
     // These associate the user input (i.e. cell IDs and surface IDs)
     // to our internal index values. This is used ONLY when the user inputs
@@ -364,6 +956,9 @@ private:
     //! translate user IDs to internal surface indices
     SurfaceRevIDMap _surfaceRevUserIds;
 
+    //! translate user IDs to internal universe indices
+    UniverseRevIDMap _universeRevUserIds;
+
     /* NOTE re: SCConnectMap:
      * using a pair as a key value should be legit, because when a pair
      * searches by testing for "less than" or "greater than" it tests the first
@@ -377,21 +972,14 @@ private:
      *
      *  When this reaches zero, connectivity is complete.
      *  Unmatched surfaces are from the cell's point of view, i.e. surfaces may
-     *  be and probably will be double-counted.
+     *  be and probably will be double-counted. It is decremented by whichever
+     *  thread learns a connection, so it has to be atomic.
      */
-    int _unMatchedSurfaces;
+    mutable std::atomic<int> _unMatchedSurfaces;
 
     /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
-    //! Cache for storing intersection information from findDistance
-    struct {
-        unsigned int    oldCellIndex;
-        Surface*        hitSurface;
-        bool            oldSurfaceSense;
-        double          distanceToSurface;
-
-        IfDbc(TVecDbl position; TVecDbl direction;)
-
-    } _findCache;
+    //! Intersection information for the single-particle interface
+    TrackState _findCache;
 
     /* * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * * */
 
@@ -399,7 +987,128 @@ private:
     void _updateConnectivity(
                 Cell* oldCell,
                 Cell* newCell,
-                Cell::CellContainer& oldNeighborhood);
+                const Surface* crossedSurface) const;
+
+    //! Get the indices of the cells that are connected to a surface with a
+    //! given sense.
+    void _getConnectedCells(        const Surface* surface,
+                                    const bool sense,
+                                    const unsigned int*& cellsBegin,
+                                    const unsigned int*& cellsEnd) const;
+
+    /*!
+     * \brief Find a cell of a universe containing a point without using
+     * connectivity.
+     *
+     * Once the geometry is completed this only checks cells whose bounding
+     * boxes contain the point; before that, it checks every cell of the
+     * universe. The given surface is ignored when checking each cell, and
+     * the given cell is skipped.
+     */
+    bool _findCellInUniverse(       const TVecDbl& position,
+                                    const unsigned int universe,
+                                    const Surface* surfaceToSkip,
+                                    const unsigned int cellToSkip,
+                                    unsigned int& cellIndex) const;
+
+    //! Get the internal index of a universe, creating it if it's new.
+    unsigned int _getUniverseIndex( const UserUniverseIdType userUniverseId);
+
+    //! Check that the universes are all defined and don't contain themselves.
+    void _checkUniverses() const;
+
+    //! Find the nearest surface of a cell (using its grid if it has one).
+    void _intersectCell(            const TVecDbl& position,
+                                    const TVecDbl& direction,
+                                    const unsigned int cellIndex,
+                                    const double maxDistance,
+                                    const Surface* onSurface,
+                                    const bool useGrids,
+                                    Surface*& hitSurface,
+                                    bool& hitSense,
+                                    double& distance) const;
+
+    //! Find how far a point is from the boundary of its cell at every level.
+    double _findSafetyInLevels(     const TVecDbl& position,
+                                    const std::vector<UniverseLevel>& levels)
+                                    const;
+
+    //! Find the cell across the surface in state from a cell, in its universe.
+    void _findCellAcross(           const TVecDbl& position,
+                                    const TVecDbl& direction,
+                                    const TVecDbl& newPosition,
+                                    const unsigned int oldCellIndex,
+                                    TrackState& state,
+                                    unsigned int& newCellIndex,
+                                    ReturnStatus& returnStatus) const;
+
+    //! Move a particle across a periodic surface into its partner's cell.
+    void _crossPeriodic(            const TVecDbl& position,
+                                    const TVecDbl& direction,
+                                    TVecDbl& newPosition,
+                                    unsigned int& newCellIndex,
+                                    ReturnStatus& returnStatus,
+                                    TrackState& state) const;
+
+    //! Find the cells that may be across each face on a periodic surface.
+    void _buildPeriodicPartners();
+
+    //! Start a level in the coordinates of what fills a level's cell.
+    void _enterFill(                const UniverseLevel& parent,
+                                    UniverseLevel& level) const;
+
+    /*!
+     * \brief Fill in the levels below the last one in a track state.
+     *
+     * Returns false if some filled cell has no cell of its universe (or no
+     * lattice element) at the position.
+     */
+    bool _descend(                  const TVecDbl& position,
+                                    TrackState& state) const;
+
+    //! Find the distance to the nearest boundary at any level.
+    bool _findDistanceInLevels(     const TVecDbl& position,
+                                    const TVecDbl& direction,
+                                    const unsigned int oldCellIndex,
+                                    const double maxDistance,
+                                    double& distance,
+                                    TrackState& state) const;
+
+    //! Cross the boundary found by _findDistanceInLevels.
+    void _findNewCellInLevels(      const TVecDbl& position,
+                                    const TVecDbl& direction,
+                                    const TVecDbl& newPosition,
+                                    unsigned int& newCellIndex,
+                                    ReturnStatus& returnStatus,
+                                    TrackState& state) const;
+
+    //! Find each cell's bounds and build each universe's tree over them.
+    void _buildCellHierarchy();
+
+    //! Copy every surface's kind and parameters into flat tables, and
+    //! have the cells look up their surfaces in them.
+    void _buildSurfaceTables();
+
+    //! Have the cells look up their surfaces in the surface tables.
+    void _useSurfaceTables();
+
+    //! Find the box cells that tile structured grids.
+    void _buildStructuredGrids();
+
+    //! Find the structured grids among some cells (all in one universe),
+    //! placing the cells that are in them.
+    void _buildStructuredGrids(
+            const std::vector<unsigned int>& cells,
+            std::vector<StructuredGrid::Placement>& cellPlacements);
+
+    //! Step to the next cell of a grid, if the crossing stays in it.
+    bool _findNewCellInGrid(        const TVecDbl& newPosition,
+                                    const unsigned int oldCellIndex,
+                                    const TrackState& state,
+                                    unsigned int& newCellIndex) const;
+
+    //! Connect the cells on either side of one surface using their bounds.
+    void _connectAcrossSurface(     const Surface* surface);
 
     //! Internal mechanism to add a cell based on a list of surface/senses.
     unsigned int _addCell(          const UserCellIdType&  userCellId,
@@ -407,7 +1116,7 @@ private:
                                     const Cell::CellFlags flags);
 
     //! Do optimization whenever the last surface is linked.
-    void _completedConnectivity();
+    void _completedConnectivity() const;
 
     //! Print some kind of warning during findNewCell.
     void _warnGeometry(             const std::string& shortMessage,
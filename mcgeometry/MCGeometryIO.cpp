@@ -0,0 +1,836 @@
+/*!
+ * \file   MCGeometryIO.cpp
+ * \brief  Saving and loading \c MCGeometry data to and from files
+ * \author Seth R. Johnson
+ */
+/*----------------------------------------------------------------------------*/
+#include "MCGeometry.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "transupport/dbc.hpp"
+#include "transupport/MappedFile.hpp"
+
+#include "Surface.hpp"
+#include "Cell.hpp"
+
+namespace mcGeometry {
+/*============================================================================*/
+//! \cond
+namespace {
+//! Identifies a connectivity file (and its layout version)
+const char CONNECTIVITY_MAGIC[8] = {'M', 'C', 'G', 'H', 'O', 'O', 'D', '2'};
+
+//! 64-bit FNV-1a hash of a stream of bytes
+class GeometryHasher {
+public:
+    GeometryHasher() : _hash(14695981039346656037ULL)
+    { /* * */ }
+
+    void addBytes(const void* data, std::size_t length) {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (std::size_t i = 0; i < length; ++i) {
+            _hash ^= bytes[i];
+            _hash *= 1099511628211ULL;
+        }
+    }
+
+    void addUnsigned(const uint32_t value) {
+        addBytes(&value, sizeof(value));
+    }
+
+    void addDouble(const double value) {
+        addBytes(&value, sizeof(value));
+    }
+
+    void addVector(const blitz::TinyVector<double, 3>& value) {
+        for (int i = 0; i < 3; ++i)
+            addDouble(value[i]);
+    }
+
+    void addIndices(const std::vector<unsigned int>& values) {
+        addUnsigned(values.size());
+        for (std::size_t i = 0; i < values.size(); ++i)
+            addUnsigned(values[i]);
+    }
+
+    void addString(const std::string& value) {
+        addUnsigned(value.size());
+        addBytes(value.data(), value.size());
+    }
+
+    unsigned long long getHash() const {
+        return _hash;
+    }
+
+private:
+    unsigned long long _hash;
+};
+
+//! Write a plain value to a binary stream
+template<typename T>
+inline void writeBinary(std::ostream& os, const T& value)
+{
+    os.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+//! Read a plain value from a binary stream
+template<typename T>
+inline void readBinary(std::istream& is, T& value)
+{
+    is.read(reinterpret_cast<char*>(&value), sizeof(T));
+}
+
+//! Identifies a binary geometry file
+const char GEOMETRY_MAGIC[8] = {'M', 'C', 'G', 'E', 'O', 'B', 'I', 'N'};
+//! Layout version of binary geometry files (3: flat arrays used in place,
+//! and structured grids saved)
+const uint32_t GEOMETRY_VERSION = 3;
+//! Written in native byte order so a file from another platform is rejected
+const uint32_t BYTE_ORDER_MARK = 0x01020304;
+//! Every section starts on a multiple of this many bytes
+const std::size_t SECTION_ALIGNMENT = 8;
+
+/*!
+ * \brief Start of a binary geometry file; the sections follow in order.
+ *
+ * The surface tables, packed bounding surfaces, compiled connectivity, and
+ * structured grid placements are stored exactly as MCGeometry holds them in
+ * memory, so a loaded geometry can use them where they are in the mapped
+ * file. The grids themselves are saved because finding them again takes
+ * longer than the rest of the load put together.
+ */
+struct GeometryFileHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t byteOrderMark;
+    uint32_t numSurfaces;
+    uint32_t numCells;
+    uint32_t numBoundingSurfaces;
+    uint32_t numConnectCells;
+    uint32_t numNeighbors;
+    uint32_t numParameters;
+    uint32_t numGrids;
+    uint32_t numGridPlanes;
+    uint32_t numGridCells;
+    uint32_t numPlacements;
+    uint64_t geometryHash;
+};
+
+//! What a surface has besides its kind and parameters
+struct SurfaceRecord {
+    uint32_t userId;
+    uint32_t flags;
+};
+
+//! One cell, whose bounding surfaces are a range of the packed array
+struct CellRecord {
+    uint32_t userId;
+    uint32_t flags;
+    uint32_t boundingBegin;
+    uint32_t boundingEnd;
+};
+
+//! Bytes of padding needed to start the next section
+inline std::size_t getSectionPadding(const std::size_t offset)
+{
+    return (SECTION_ALIGNMENT - offset % SECTION_ALIGNMENT)
+            % SECTION_ALIGNMENT;
+}
+
+/*!
+ * \brief Get the next section of \c count objects, and advance the offset.
+ *
+ * Fails if the file is too short to hold them.
+ */
+template<typename T>
+const T* getSection(
+        const tranSupport::MappedFile& file,
+        std::size_t& offset,
+        const std::size_t count)
+{
+    offset += getSectionPadding(offset);
+
+    Insist(offset <= file.size()
+                && count <= (file.size() - offset) / sizeof(T),
+            "Binary geometry file is truncated.");
+    const T* section = reinterpret_cast<const T*>(file.data() + offset);
+    offset += count * sizeof(T);
+    return section;
+}
+
+//! Write a section of a binary geometry file, padded to start the next one
+template<typename T>
+inline void writeSection(std::ostream& os, const T* begin, const T* end)
+{
+    const std::size_t bytes = (end - begin) * sizeof(T);
+    const char padding[SECTION_ALIGNMENT] = {0};
+
+    if (bytes > 0)
+        os.write(reinterpret_cast<const char*>(begin), bytes);
+    os.write(padding, getSectionPadding(bytes));
+}
+
+//! Write a vector as a section of a binary geometry file
+template<typename T>
+inline void writeSection(std::ostream& os, const std::vector<T>& values)
+{
+    if (values.empty())
+        writeSection<T>(os, NULL, NULL);
+    else
+        writeSection(os, &values[0], &values[0] + values.size());
+}
+
+//! Map each key to its position in the list, failing on duplicate keys
+template<typename MapT>
+void buildReverseMap(
+        const std::vector<typename MapT::key_type>& keys,
+        MapT& result,
+        const char* duplicateMessage)
+{
+    std::vector< std::pair<typename MapT::key_type, unsigned int> > pairs;
+    pairs.reserve(keys.size());
+    for (unsigned int i = 0; i < keys.size(); ++i)
+        pairs.push_back(std::make_pair(keys[i], i));
+
+    std::sort(pairs.begin(), pairs.end());
+
+    for (unsigned int i = 1; i < pairs.size(); ++i) {
+        Insist(pairs[i - 1].first != pairs[i].first, duplicateMessage);
+    }
+
+    // construction from a sorted range takes linear time
+    MapT(pairs.begin(), pairs.end()).swap(result);
+}
+} // end anonymous namespace
+//! \endcond
+
+/*----------------------------------------------------------------------------*/
+unsigned long long MCGeometry::getGeometryHash() const
+{
+    GeometryHasher hasher;
+
+    hasher.addUnsigned(_surfaces.size());
+    for (SurfaceVec::const_iterator it  = _surfaces.begin();
+                                    it != _surfaces.end(); ++it)
+    {
+        // the printed surface has its type and all its parameters
+        std::ostringstream surfaceDescription;
+        surfaceDescription << std::setprecision(17) << **it;
+
+        hasher.addUnsigned((*it)->getUserId());
+        hasher.addUnsigned((*it)->isReflecting());
+        hasher.addString(surfaceDescription.str());
+    }
+
+    hasher.addUnsigned(_cells.size());
+    for (CellVec::const_iterator it = _cells.begin(); it != _cells.end(); ++it)
+    {
+        const Cell& cell = **it;
+
+        hasher.addUnsigned(_cellUserIds[cell.getIndex()]);
+        hasher.addUnsigned(cell.isDeadCell());
+        hasher.addUnsigned(cell.isNegated());
+        hasher.addUnsigned(cell.getNumBoundingSurfaces());
+
+        for (const Cell::SurfaceCode* code = cell.beginSurfaceCodes();
+                                      code != cell.endSurfaceCodes(); ++code)
+        {
+            hasher.addUnsigned(Cell::getCodeIndex(*code));
+            hasher.addUnsigned(Cell::getCodeSense(*code));
+        }
+    }
+
+    // which universe each cell is in and what fills it decide which cells
+    // can be neighbors, as much as the surfaces do
+    hasher.addUnsigned(_universes.size());
+    for (std::vector<Universe>::const_iterator it  = _universes.begin();
+                                               it != _universes.end(); ++it)
+    {
+        hasher.addUnsigned(it->userId);
+        hasher.addUnsigned(it->lattice);
+    }
+    hasher.addIndices(_cellUniverses);
+    hasher.addIndices(_cellFills);
+    hasher.addIndices(_cellFillTransforms);
+
+    hasher.addUnsigned(_fillTransforms.size());
+    for (std::vector<FillTransform>::const_iterator
+            it = _fillTransforms.begin(); it != _fillTransforms.end(); ++it)
+    {
+        hasher.addVector(it->translation);
+        hasher.addUnsigned(it->isRotated);
+        for (int axis = 0; axis < 3; ++axis)
+            hasher.addVector(it->axes[axis]);
+    }
+
+    hasher.addUnsigned(_lattices.size());
+    for (std::vector<Lattice>::const_iterator it  = _lattices.begin();
+                                              it != _lattices.end(); ++it)
+    {
+        std::vector<unsigned int> elementUniverses;
+        it->getUniverses(elementUniverses);
+
+        hasher.addUnsigned(it->getType());
+        hasher.addVector(it->getOrigin());
+        hasher.addVector(it->getPitch());
+        for (unsigned int axis = 0; axis < 3; ++axis)
+            hasher.addUnsigned(it->getSize(axis));
+        hasher.addIndices(elementUniverses);
+    }
+
+    hasher.addIndices(_periodicPartners);
+    hasher.addUnsigned(_periodicShifts.size());
+    for (std::vector<TVecDbl>::const_iterator it  = _periodicShifts.begin();
+                                              it != _periodicShifts.end(); ++it)
+    {
+        hasher.addVector(*it);
+    }
+
+    return hasher.getHash();
+}
+
+/*----------------------------------------------------------------------------*/
+void MCGeometry::writeConnectivity(const std::string& fileName) const
+{
+    Insist(_isCompleted,
+            "Geometry input must be completed before saving connectivity.");
+
+    std::ofstream outFile(fileName.c_str(),
+                          std::ios::out | std::ios::binary | std::ios::trunc);
+    Insist(outFile, "Couldn't open connectivity file for writing.");
+
+    const uint64_t geometryHash = getGeometryHash();
+    const uint32_t numCells     = _cells.size();
+
+    outFile.write(CONNECTIVITY_MAGIC, sizeof(CONNECTIVITY_MAGIC));
+    writeBinary(outFile, geometryHash);
+    writeBinary(outFile, numCells);
+
+    // for every cell, for every bounding surface in order: the number of
+    // neighbors followed by their indices
+    for (CellVec::const_iterator it = _cells.begin(); it != _cells.end(); ++it)
+    {
+        const Cell& cell = **it;
+
+        for (unsigned int i = 0; i < cell.getNumBoundingSurfaces(); ++i)
+        {
+            const Cell::CellContainer& neighbors
+                = cell.getNeighbors(cell.getBoundingSurface(i).first);
+
+            // the list may grow under us if other threads are transporting,
+            // so don't trust size()
+            std::vector<uint32_t> neighborIndices;
+            for (Cell::CellContainer::const_iterator
+                    nIt = neighbors.begin(); nIt != neighbors.end(); ++nIt)
+            {
+                neighborIndices.push_back((*nIt)->getIndex());
+            }
+
+            writeBinary(outFile, static_cast<uint32_t>(neighborIndices.size()));
+            if (!neighborIndices.empty()) {
+                outFile.write(
+                        reinterpret_cast<const char*>(&neighborIndices[0]),
+                        neighborIndices.size() * sizeof(uint32_t));
+            }
+        }
+    }
+
+    Insist(outFile, "Failed while writing connectivity file.");
+}
+
+/*----------------------------------------------------------------------------*/
+bool MCGeometry::readConnectivity(const std::string& fileName)
+{
+    Insist(_isCompleted,
+            "Geometry input must be completed before loading connectivity.");
+
+    std::ifstream inFile(fileName.c_str(), std::ios::in | std::ios::binary);
+    if (!inFile)
+        return false;
+
+    char     magic[sizeof(CONNECTIVITY_MAGIC)];
+    uint64_t geometryHash = 0;
+    uint32_t numCells     = 0;
+
+    inFile.read(magic, sizeof(magic));
+    readBinary(inFile, geometryHash);
+    readBinary(inFile, numCells);
+
+    if (!inFile
+            || std::memcmp(magic, CONNECTIVITY_MAGIC, sizeof(magic)) != 0
+            || geometryHash != getGeometryHash()
+            || numCells != _cells.size())
+    {
+        return false;
+    }
+
+    // read everything before changing anything, so a truncated file leaves
+    // the geometry alone
+    std::vector<uint32_t> neighborCounts(_packedSurfaceCodes.size());
+    std::vector<uint32_t> neighborIndices;
+
+    for (unsigned int i = 0; i < neighborCounts.size(); ++i) {
+        readBinary(inFile, neighborCounts[i]);
+        Insist(inFile && neighborCounts[i] <= numCells,
+                "Corrupt connectivity file.");
+
+        const unsigned int start = neighborIndices.size();
+        neighborIndices.resize(start + neighborCounts[i]);
+        if (neighborCounts[i] > 0) {
+            inFile.read(reinterpret_cast<char*>(&neighborIndices[start]),
+                        neighborCounts[i] * sizeof(uint32_t));
+        }
+        Insist(inFile, "Corrupt connectivity file.");
+
+        for (unsigned int j = start; j < neighborIndices.size(); ++j) {
+            Insist(neighborIndices[j] < numCells,
+                    "Corrupt connectivity file.");
+        }
+    }
+
+    std::vector<uint32_t>::const_iterator indexIt = neighborIndices.begin();
+    std::vector<uint32_t>::const_iterator countIt = neighborCounts.begin();
+
+    // add each neighbor only to its own list (the file has both directions)
+    // so that the saved order is kept
+    int newlyMatched = 0;
+
+    for (CellVec::const_iterator it = _cells.begin(); it != _cells.end(); ++it)
+    {
+        for (unsigned int i = 0; i < (*it)->getNumBoundingSurfaces(); ++i)
+        {
+            const Surface* surface = (*it)->getBoundingSurface(i).first;
+
+            for (uint32_t n = 0; n < *countIt; ++n, ++indexIt) {
+                if ((*it)->addNeighbor(surface, _cells[*indexIt]))
+                    ++newlyMatched;
+            }
+            ++countIt;
+        }
+    }
+
+    if (newlyMatched > 0) {
+        int remaining = (_unMatchedSurfaces -= newlyMatched);
+
+        Check(remaining >= 0);
+
+        if (remaining == 0)
+            _completedConnectivity();
+    }
+
+    return true;
+}
+
+/*----------------------------------------------------------------------------*/
+void MCGeometry::writeBinaryGeometry(const std::string& fileName) const
+{
+    Insist(_isCompleted,
+            "Geometry input must be completed before saving it.");
+    Insist(_universes.size() == 1,
+            "Binary geometry files can't hold universes or lattices.");
+    Insist(_periodicPartners.empty(),
+            "Binary geometry files can't hold periodic surfaces.");
+
+    const Cell::SurfaceCode* packedBegin = _packedSurfaceCodes.begin();
+
+    //====== snapshot the neighborhoods first, since other threads may be
+    // adding to them
+    std::vector<uint32_t> hoodOffsets(1, 0);
+    std::vector<uint32_t> hoodCells;
+
+    hoodOffsets.reserve(_packedSurfaceCodes.size() + 1);
+
+    for (CellVec::const_iterator it = _cells.begin(); it != _cells.end(); ++it)
+    {
+        const Cell& cell = **it;
+
+        for (unsigned int i = 0; i < cell.getNumBoundingSurfaces(); ++i)
+        {
+            const Cell::CellContainer& neighbors
+                = cell.getNeighbors(cell.getBoundingSurface(i).first);
+
+            for (Cell::CellContainer::const_iterator
+                    nIt = neighbors.begin(); nIt != neighbors.end(); ++nIt)
+            {
+                hoodCells.push_back((*nIt)->getIndex());
+            }
+            hoodOffsets.push_back(hoodCells.size());
+        }
+    }
+
+    //====== header
+    GeometryFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+
+    std::memcpy(header.magic, GEOMETRY_MAGIC, sizeof(header.magic));
+    header.version             = GEOMETRY_VERSION;
+    header.byteOrderMark       = BYTE_ORDER_MARK;
+    header.numSurfaces         = _surfaces.size();
+    header.numCells            = _cells.size();
+    header.numBoundingSurfaces = _packedSurfaceCodes.size();
+    header.numConnectCells     = _connectCells.size();
+    header.numNeighbors        = hoodCells.size();
+    header.numParameters       = Surface::MAX_PARAMETERS;
+    header.geometryHash        = getGeometryHash();
+
+    //====== structured grids: the size of each along each axis, then all
+    // their planes and all their cells
+    std::vector<uint32_t> gridSizes;
+    std::vector<double>   gridCoordinates;
+    std::vector<uint32_t> gridSurfaces;
+    std::vector<uint32_t> gridCells;
+
+    for (std::vector<StructuredGrid>::const_iterator it  = _grids.begin();
+                                                     it != _grids.end(); ++it)
+    {
+        for (unsigned int axis = 0; axis < 3; ++axis) {
+            gridSizes.push_back(it->getSize(axis));
+            gridCoordinates.insert(gridCoordinates.end(),
+                                   it->getCoordinates(axis).begin(),
+                                   it->getCoordinates(axis).end());
+            gridSurfaces.insert(gridSurfaces.end(),
+                                it->getSurfaces(axis).begin(),
+                                it->getSurfaces(axis).end());
+        }
+        gridCells.insert(gridCells.end(),
+                         it->getCells().begin(), it->getCells().end());
+    }
+
+    header.numGrids      = _grids.size();
+    header.numGridPlanes = gridCoordinates.size();
+    header.numGridCells  = gridCells.size();
+    header.numPlacements = _cellPlacements.size();
+
+    //====== surfaces (their kinds and parameters are in the tables)
+    std::vector<SurfaceRecord> surfaceRecords(_surfaces.size());
+
+    for (unsigned int i = 0; i < _surfaces.size(); ++i) {
+        surfaceRecords[i].userId = _surfaces[i]->getUserId();
+        surfaceRecords[i].flags  = _surfaces[i]->_flags;
+    }
+
+    //====== cells
+    std::vector<CellRecord> cellRecords(_cells.size());
+
+    for (unsigned int i = 0; i < _cells.size(); ++i) {
+        const Cell& cell = *_cells[i];
+        CellRecord& record = cellRecords[i];
+
+        record.userId        = _cellUserIds[i];
+        record.flags         = Cell::generateFlags(cell.isDeadCell(),
+                                                   cell.isNegated());
+        record.boundingBegin = cell.beginSurfaceCodes() - packedBegin;
+        record.boundingEnd   = cell.endSurfaceCodes()   - packedBegin;
+    }
+
+    //====== write it all out; the flat arrays go as they are
+    std::ofstream outFile(fileName.c_str(),
+                          std::ios::out | std::ios::binary | std::ios::trunc);
+    Insist(outFile, "Couldn't open binary geometry file for writing.");
+
+    writeBinary(outFile, header);
+    writeSection(outFile, surfaceRecords);
+    writeSection(outFile, _surfaceTypes.begin(), _surfaceTypes.end());
+    writeSection(outFile, _surfaceParameters.begin(),
+                          _surfaceParameters.end());
+    writeSection(outFile, cellRecords);
+    writeSection(outFile, _packedSurfaceCodes.begin(),
+                          _packedSurfaceCodes.end());
+    writeSection(outFile, _connectOffsets.begin(), _connectOffsets.end());
+    writeSection(outFile, _connectCells.begin(), _connectCells.end());
+    writeSection(outFile, hoodOffsets);
+    writeSection(outFile, hoodCells);
+    writeSection(outFile, gridSizes);
+    writeSection(outFile, gridCoordinates);
+    writeSection(outFile, gridSurfaces);
+    writeSection(outFile, gridCells);
+    writeSection(outFile, _cellPlacements.begin(), _cellPlacements.end());
+
+    Insist(outFile, "Failed while writing binary geometry file.");
+}
+
+/*----------------------------------------------------------------------------*/
+bool MCGeometry::readBinaryGeometry(const std::string& fileName)
+{
+    Insist(_surfaces.empty() && _cells.empty() && !_isCompleted,
+            "A binary geometry can only be read into an empty geometry.");
+
+    // the file stays mapped for as long as we use its arrays
+    if (!_mappedFile.open(fileName))
+        return false;
+
+    const tranSupport::MappedFile& file = _mappedFile;
+    std::size_t offset = 0;
+
+    if (file.size() < sizeof(GeometryFileHeader)) {
+        _mappedFile.close();
+        return false;
+    }
+
+    const GeometryFileHeader& header
+        = *getSection<GeometryFileHeader>(file, offset, 1);
+
+    if (std::memcmp(header.magic, GEOMETRY_MAGIC, sizeof(header.magic)) != 0
+            || header.version != GEOMETRY_VERSION
+            || header.byteOrderMark != BYTE_ORDER_MARK
+            || header.numParameters != Surface::MAX_PARAMETERS)
+    {
+        _mappedFile.close();
+        return false;
+    }
+
+    const unsigned int numSurfaces = header.numSurfaces;
+    const unsigned int numCells    = header.numCells;
+    const unsigned int numBounding = header.numBoundingSurfaces;
+    const unsigned int numKeys     = 2 * numSurfaces;
+
+    const SurfaceRecord* surfaceRecords
+        = getSection<SurfaceRecord>(file, offset, numSurfaces);
+    const unsigned char* surfaceTypes
+        = getSection<unsigned char>(file, offset, numSurfaces);
+    const double* surfaceParameters = getSection<double>(
+            file, offset, numSurfaces * Surface::MAX_PARAMETERS);
+    const CellRecord* cellRecords
+        = getSection<CellRecord>(file, offset, numCells);
+    const Cell::SurfaceCode* packedSurfaceCodes
+        = getSection<Cell::SurfaceCode>(file, offset, numBounding);
+    const unsigned int* connectOffsets
+        = getSection<unsigned int>(file, offset, numKeys + 1);
+    const unsigned int* connectCells
+        = getSection<unsigned int>(file, offset, header.numConnectCells);
+    const uint32_t* hoodOffsets
+        = getSection<uint32_t>(file, offset, numBounding + 1);
+    const uint32_t* hoodCells
+        = getSection<uint32_t>(file, offset, header.numNeighbors);
+    const uint32_t* gridSizes
+        = getSection<uint32_t>(file, offset, 3 * header.numGrids);
+    const double* gridCoordinates
+        = getSection<double>(file, offset, header.numGridPlanes);
+    const uint32_t* gridSurfaces
+        = getSection<uint32_t>(file, offset, header.numGridPlanes);
+    const uint32_t* gridCells
+        = getSection<uint32_t>(file, offset, header.numGridCells);
+    const StructuredGrid::Placement* cellPlacements
+        = getSection<StructuredGrid::Placement>(file, offset,
+                                                header.numPlacements);
+
+    //====== surfaces, built from the tables that they'll be evaluated from
+    _surfaces.reserve(numSurfaces);
+    std::vector<UserSurfaceIdType> surfaceIds(numSurfaces);
+
+    for (unsigned int i = 0; i < numSurfaces; ++i) {
+        const SurfaceRecord& record = surfaceRecords[i];
+
+        Insist(surfaceTypes[i] < Surface::NUM_SURFACE_TYPES,
+                "Unknown surface type in binary geometry file.");
+
+        Surface* newSurface = Surface::create(
+                static_cast<Surface::SurfaceType>(surfaceTypes[i]),
+                surfaceParameters + i * Surface::MAX_PARAMETERS,
+                record.userId, &_surfaceArena);
+        newSurface->_index = i;
+        if (record.flags & Surface::REFLECTING)
+            newSurface->setReflecting();
+
+        _surfaces.push_back(newSurface);
+        surfaceIds[i] = record.userId;
+    }
+
+    buildReverseMap(surfaceIds, _surfaceRevUserIds,
+            "Tried to add a surface with an ID that was already there.");
+
+    _surfaceTypes.refer(surfaceTypes, surfaceTypes + numSurfaces);
+    _surfaceParameters.refer(surfaceParameters, surfaceParameters
+                                + numSurfaces * Surface::MAX_PARAMETERS);
+
+    //====== bounding surfaces, all packed together
+    for (unsigned int i = 0; i < numBounding; ++i) {
+        Insist(Cell::getCodeIndex(packedSurfaceCodes[i]) < numSurfaces,
+                "Corrupt binary geometry file.");
+    }
+    _packedSurfaceCodes.refer(packedSurfaceCodes,
+                              packedSurfaceCodes + numBounding);
+
+    //====== cells, which point into the packed surfaces
+    _cells.reserve(numCells);
+    _cellUserIds.resize(numCells);
+
+    unsigned int expectedBegin = 0;
+    for (unsigned int i = 0; i < numCells; ++i) {
+        const CellRecord& record = cellRecords[i];
+
+        Insist(record.boundingBegin == expectedBegin
+                && record.boundingEnd > record.boundingBegin
+                && record.boundingEnd <= numBounding,
+                "Corrupt binary geometry file.");
+        expectedBegin = record.boundingEnd;
+
+        _cells.push_back(new (_cellArena.allocate<Cell>()) Cell(
+                    packedSurfaceCodes + record.boundingBegin,
+                    packedSurfaceCodes + record.boundingEnd,
+                    &_surfaces[0],
+                    i,
+                    Cell::generateFlags(record.flags & Cell::DEADCELL,
+                                        record.flags & Cell::NEGATED)));
+        _cellUserIds[i] = record.userId;
+    }
+    Insist(expectedBegin == numBounding, "Corrupt binary geometry file.");
+
+    buildReverseMap(_cellUserIds, _cellRevUserIds,
+            "Tried to add a cell with an ID that was already there.");
+
+    _unMatchedSurfaces += numBounding;
+
+    //====== compiled surface-to-cell connectivity
+    Insist(connectOffsets[0] == 0
+            && connectOffsets[numKeys] == header.numConnectCells
+            && std::adjacent_find(connectOffsets,
+                                  connectOffsets + numKeys + 1,
+                                  std::greater<unsigned int>())
+                == connectOffsets + numKeys + 1,
+            "Corrupt binary geometry file.");
+    for (unsigned int i = 0; i < header.numConnectCells; ++i) {
+        Insist(connectCells[i] < numCells, "Corrupt binary geometry file.");
+    }
+
+    _connectOffsets.refer(connectOffsets, connectOffsets + numKeys + 1);
+    _connectCells.refer(connectCells,
+                        connectCells + header.numConnectCells);
+
+    //====== everything is in the root universe
+    _cellUniverses.assign(numCells, 0);
+    _cellFills.assign(numCells, NO_INDEX);
+    _cellFillTransforms.assign(numCells, NO_INDEX);
+    _universes[0].cells.resize(numCells);
+    for (unsigned int i = 0; i < numCells; ++i)
+        _universes[0].cells[i] = i;
+
+    _buildCellHierarchy();
+    _useSurfaceTables();
+
+    //====== structured grids, rebuilt from their planes and cells
+    Insist(header.numPlacements == (header.numGrids > 0 ? numCells : 0),
+            "Corrupt binary geometry file.");
+
+    _grids.reserve(header.numGrids);
+    unsigned int planeBegin = 0;
+    unsigned int cellBegin  = 0;
+
+    for (unsigned int g = 0; g < header.numGrids; ++g) {
+        std::vector<double>       coordinates[3];
+        std::vector<unsigned int> surfaces[3];
+        unsigned int numSlots = 1;
+
+        for (unsigned int axis = 0; axis < 3; ++axis) {
+            const uint32_t size = gridSizes[3 * g + axis];
+
+            Insist(size > 0 && size < header.numGridPlanes
+                    && planeBegin < header.numGridPlanes - size,
+                    "Corrupt binary geometry file.");
+
+            const unsigned int planeEnd = planeBegin + size + 1;
+            for (unsigned int p = planeBegin; p < planeEnd; ++p) {
+                Insist(gridSurfaces[p] < numSurfaces,
+                        "Corrupt binary geometry file.");
+            }
+
+            coordinates[axis].assign(gridCoordinates + planeBegin,
+                                     gridCoordinates + planeEnd);
+            surfaces[axis].assign(gridSurfaces + planeBegin,
+                                  gridSurfaces + planeEnd);
+            planeBegin = planeEnd;
+            numSlots  *= size;
+
+            Insist(numSlots <= header.numGridCells,
+                    "Corrupt binary geometry file.");
+        }
+
+        Insist(cellBegin <= header.numGridCells - numSlots,
+                "Corrupt binary geometry file.");
+
+        const unsigned int cellEnd = cellBegin + numSlots;
+        for (unsigned int i = cellBegin; i < cellEnd; ++i) {
+            Insist(gridCells[i] < numCells, "Corrupt binary geometry file.");
+        }
+
+        _grids.push_back(StructuredGrid(coordinates, surfaces,
+                    std::vector<unsigned int>(gridCells + cellBegin,
+                                              gridCells + cellEnd)));
+        cellBegin = cellEnd;
+    }
+    Insist(planeBegin == header.numGridPlanes
+                && cellBegin == header.numGridCells,
+            "Corrupt binary geometry file.");
+
+    for (unsigned int i = 0; i < header.numPlacements; ++i) {
+        const StructuredGrid::Placement& placement = cellPlacements[i];
+        if (placement.grid == StructuredGrid::NO_GRID)
+            continue;
+
+        Insist(placement.grid < header.numGrids
+                && placement.index[0] < _grids[placement.grid].getSize(0)
+                && placement.index[1] < _grids[placement.grid].getSize(1)
+                && placement.index[2] < _grids[placement.grid].getSize(2)
+                && _grids[placement.grid].getCell(placement.index) == i,
+                "Corrupt binary geometry file.");
+    }
+    _cellPlacements.refer(cellPlacements,
+                          cellPlacements + header.numPlacements);
+
+    _isCompleted = true;
+
+    //====== neighborhoods, in the order they were saved
+    Insist(hoodOffsets[0] == 0 && hoodOffsets[numBounding]
+                                    == header.numNeighbors,
+            "Corrupt binary geometry file.");
+
+    int newlyMatched = 0;
+    unsigned int boundingIndex = 0;
+
+    for (CellVec::const_iterator it = _cells.begin(); it != _cells.end(); ++it)
+    {
+        for (unsigned int i = 0; i < (*it)->getNumBoundingSurfaces();
+                                 ++i, ++boundingIndex)
+        {
+            const Surface* surface = (*it)->getBoundingSurface(i).first;
+
+            const uint32_t hoodBegin = hoodOffsets[boundingIndex];
+            const uint32_t hoodEnd   = hoodOffsets[boundingIndex + 1];
+
+            Insist(hoodBegin <= hoodEnd, "Corrupt binary geometry file.");
+
+            for (uint32_t n = hoodBegin; n < hoodEnd; ++n) {
+                Insist(hoodCells[n] < numCells,
+                        "Corrupt binary geometry file.");
+                if ((*it)->addNeighbor(surface, _cells[hoodCells[n]]))
+                    ++newlyMatched;
+            }
+        }
+    }
+
+    if (newlyMatched > 0) {
+        int remaining = (_unMatchedSurfaces -= newlyMatched);
+
+        Check(remaining >= 0);
+
+        if (remaining == 0)
+            _completedConnectivity();
+    }
+
+    Insist(getGeometryHash() == header.geometryHash,
+            "Binary geometry file does not match its own hash.");
+
+    return true;
+}
+
+/*============================================================================*/
+} // end namespace mcGeometry
@@ -7,6 +7,7 @@
 #include "Plane.hpp"
 
 #include <algorithm>
+#include <cmath>
 #include <ostream>
 
 #include <blitz/tinyvec-et.h>
@@ -22,7 +23,8 @@ void Plane::intersect(
                 const TVecDbl& position,
                 const TVecDbl& direction,
                 const bool posSense,
-                bool& hit, double& distance) const
+                bool& hit, double& distance,
+                const double maxDistance) const
 {
     Require(tranSupport::checkDirectionVector(direction));
 
@@ -39,6 +41,12 @@ void Plane::intersect(
         hit = true;
         distance = blitz::sum(_normal*(_coordinate - position));
         distance = std::max(0.0, distance/cosine);
+
+        // but not soon enough
+        if (distance > maxDistance) {
+            hit = false;
+            distance = 0.0;
+        }
     }
 }
 
@@ -64,6 +72,15 @@ void Plane::normalAtPoint(
     unitNormal = _normal;
 }
 
+/*----------------------------------------------------------------------------*/
+// Since the normal is a unit vector, the plane equation evaluated at a point
+// is the signed distance to it.
+double Plane::safetyDistance(const TVecDbl& position) const
+{
+    return std::fabs(blitz::dot(_normal, position)
+                     - blitz::dot(_normal, _coordinate));
+}
+
 /*----------------------------------------------------------------------------*/
 std::ostream& Plane::printStream( std::ostream& os ) const
 {
@@ -9,6 +9,8 @@
 /*----------------------------------------------------------------------------*/
 #include "Surface.hpp"
 
+#include <algorithm>
+#include <limits>
 #include <blitz/tinyvec.h>
 
 #include "transupport/dbc.hpp"
@@ -47,6 +49,24 @@ public:
         return new Plane(*this, newId);
     }
 
+    //! Create a copy of the surface in an arena.
+    Surface* clone(const UserSurfaceIdType& newId,
+                   tranSupport::Arena& arena) const
+    {
+        return new (arena.allocate< Plane >()) Plane(*this, newId);
+    }
+
+    //! Which kind of surface we are.
+    SurfaceType getType() const {
+        return PLANE;
+    }
+
+    //! Write our normal and the point we pass through.
+    void getParameters(double* parameters) const {
+        std::copy(_normal.begin(), _normal.end(), parameters);
+        std::copy(_coordinate.begin(), _coordinate.end(), parameters + 3);
+    }
+
     ~Plane() { /* * */}
 
     bool hasPosSense(const TVecDbl& position) const;
@@ -55,10 +75,14 @@ public:
                     const TVecDbl& direction,
                     const bool PosSense,
                     bool& hit,
-                    double& distance) const;
+                    double& distance,
+                    const double maxDistance
+                        = std::numeric_limits<double>::infinity()) const;
 
     void normalAtPoint( const TVecDbl& position,
                         TVecDbl& unitNormal) const;
+
+    double safetyDistance(const TVecDbl& position) const;
 protected:
     //! output to a stream
     std::ostream& printStream( std::ostream& os ) const;
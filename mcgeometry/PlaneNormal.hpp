@@ -8,6 +8,8 @@
 /*----------------------------------------------------------------------------*/
 #include "Surface.hpp"
 
+#include <algorithm>
+#include <limits>
 #include <blitz/tinyvec.h>
 
 #include "transupport/dbc.hpp"
@@ -44,6 +46,24 @@ public:
         return new PlaneNormal<axis>(*this, newId);
     }
 
+    //! Create a copy of the surface in an arena.
+    Surface* clone(const UserSurfaceIdType& newId,
+                   tranSupport::Arena& arena) const
+    {
+        void* storage = arena.allocate< PlaneNormal<axis> >();
+        return new (storage) PlaneNormal<axis>(*this, newId);
+    }
+
+    //! Which kind of surface we are.
+    SurfaceType getType() const {
+        return static_cast<SurfaceType>(PLANE_X + axis);
+    }
+
+    //! Write the coordinate along our axis.
+    void getParameters(double* parameters) const {
+        parameters[0] = _coordinate;
+    }
+
     ~PlaneNormal() { /* * */}
 
     //! Calculate whether a point has a positive sense to this surface
@@ -55,13 +75,24 @@ public:
             const TVecDbl& direction,
             const bool posSense,
             bool& hit,
-            double& distance) const;
+            double& distance,
+            const double maxDistance
+                = std::numeric_limits<double>::infinity()) const;
 
     //! Calculate the surface normal at a point
     void normalAtPoint(
             const TVecDbl& position,
             TVecDbl& unitNormal) const;
 
+    //! Distance from a point to the nearest point on the surface
+    double safetyDistance(const TVecDbl& position) const;
+
+    //! Shrink an axis-aligned box to one side of the surface.
+    void clipBoundingBox(
+            const bool posSense,
+            TVecDbl& lower,
+            TVecDbl& upper) const;
+
     //! return the index along which we are oriented
     unsigned int getAxis() const {
         return axis;
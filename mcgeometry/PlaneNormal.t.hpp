@@ -9,6 +9,7 @@
 #include "PlaneNormal.hpp"
 
 #include <algorithm>
+#include <cmath>
 #include <ostream>
 
 #include <blitz/tinyvec-et.h>
@@ -32,7 +33,8 @@ void PlaneNormal<axis>::intersect(
         const TVecDbl& direction,
         const bool posSense,
         bool& hit,
-        double& distance) const
+        double& distance,
+        const double maxDistance) const
 {
     Require(tranSupport::checkDirectionVector(direction));
 
@@ -47,6 +49,12 @@ void PlaneNormal<axis>::intersect(
         hit = true;
         distance = (_coordinate - position[axis]) / direction[axis];
         distance = std::max(0.0, distance);
+
+        // but not soon enough
+        if (distance > maxDistance) {
+            hit = false;
+            distance = 0.0;
+        }
     }
 }
 /*----------------------------------------------------------------------------*/
@@ -59,6 +67,27 @@ void PlaneNormal<axis>::normalAtPoint(
     unitNormal[axis] = 1.0;
 }
 
+/*----------------------------------------------------------------------------*/
+template<unsigned int axis>
+double PlaneNormal<axis>::safetyDistance(
+        const TVecDbl& position) const
+{
+    return std::fabs(position[axis] - _coordinate);
+}
+
+/*----------------------------------------------------------------------------*/
+template<unsigned int axis>
+void PlaneNormal<axis>::clipBoundingBox(
+        const bool posSense,
+        TVecDbl& lower,
+        TVecDbl& upper) const
+{
+    if (posSense)
+        lower[axis] = std::max(lower[axis], _coordinate);
+    else
+        upper[axis] = std::min(upper[axis], _coordinate);
+}
+
 /*----------------------------------------------------------------------------*/
 template<unsigned int axis>
 std::ostream& PlaneNormal<axis>::printStream( std::ostream& os ) const
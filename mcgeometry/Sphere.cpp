@@ -6,6 +6,8 @@
 /*----------------------------------------------------------------------------*/
 #include "Sphere.hpp"
 
+#include <algorithm>
+#include <cmath>
 #include <ostream>
 #include <blitz/tinyvec-et.h>
 
@@ -42,7 +44,8 @@ bool Sphere::hasPosSense(const TVecDbl& position) const
 void Sphere::intersect(
         const TVecDbl& position,
         const TVecDbl& direction, const bool posSense,
-        bool& hit, double& distance ) const
+        bool& hit, double& distance,
+        const double maxDistance) const
 {
     Require(tranSupport::checkDirectionVector(direction));
 
@@ -54,6 +57,7 @@ void Sphere::intersect(
             blitz::dot(trLoc, direction),  // B
             (blitz::dot(trLoc, trLoc) - _radius * _radius), //C
             posSense,
+            maxDistance,
             hit, distance
             );
 }
@@ -76,6 +80,35 @@ void Sphere::normalAtPoint(
     Ensure(tranSupport::checkDirectionVector(unitNormal));
 }
 
+/*----------------------------------------------------------------------------*/
+// With r the distance to the center, the distance to the sphere is
+// |r - R| = |r^2 - R^2| / (r + R); using the quadric's value keeps the answer
+// accurate (and zero exactly where the sense changes) near the surface.
+double Sphere::safetyDistance(const TVecDbl& position) const
+{
+    TVecDbl trLoc(position - _center);
+    const double rSquared = blitz::dot(trLoc, trLoc);
+
+    return std::fabs(rSquared - _radius * _radius)
+            / (std::sqrt(rSquared) + _radius);
+}
+
+/*----------------------------------------------------------------------------*/
+void Sphere::clipBoundingBox(
+        const bool posSense,
+        TVecDbl& lower,
+        TVecDbl& upper ) const
+{
+    // the outside of a sphere is unbounded
+    if (posSense)
+        return;
+
+    for (int i = 0; i < 3; ++i) {
+        lower[i] = std::max(lower[i], _center[i] - _radius);
+        upper[i] = std::min(upper[i], _center[i] + _radius);
+    }
+}
+
 /*----------------------------------------------------------------------------*/
 //! output a stream which prints the Sphere's characteristics
 std::ostream& Sphere::printStream( std::ostream& os ) const
@@ -103,7 +136,8 @@ bool SphereO::hasPosSense(
 void SphereO::intersect(
         const TVecDbl& position,
         const TVecDbl& direction, const bool posSense,
-        bool& hit, double& distance ) const
+        bool& hit, double& distance,
+        const double maxDistance) const
 {
     Require(tranSupport::checkDirectionVector(direction));
 
@@ -113,6 +147,7 @@ void SphereO::intersect(
             blitz::dot(position, direction),  // B
             (blitz::dot(position, position) - _radius * _radius), //C
             posSense,
+            maxDistance,
             hit, distance
             );
 }
@@ -129,6 +164,31 @@ void SphereO::normalAtPoint(
     // make sure it actually is a normal vector
     Ensure(tranSupport::checkDirectionVector(unitNormal));
 }
+/*----------------------------------------------------------------------------*/
+// Same as for Sphere, but centered at the origin.
+double SphereO::safetyDistance(const TVecDbl& position) const
+{
+    const double rSquared = blitz::dot(position, position);
+
+    return std::fabs(rSquared - _radius * _radius)
+            / (std::sqrt(rSquared) + _radius);
+}
+/*----------------------------------------------------------------------------*/
+void SphereO::clipBoundingBox(
+        const bool posSense,
+        TVecDbl& lower,
+        TVecDbl& upper ) const
+{
+    // the outside of a sphere is unbounded
+    if (posSense)
+        return;
+
+    for (int i = 0; i < 3; ++i) {
+        lower[i] = std::max(lower[i], -_radius);
+        upper[i] = std::min(upper[i],  _radius);
+    }
+}
+
 /*----------------------------------------------------------------------------*/
 //! output a stream which prints the SphereO's characteristics
 std::ostream& SphereO::printStream( std::ostream& os ) const
@@ -9,7 +9,9 @@
 /*----------------------------------------------------------------------------*/
 #include "Surface.hpp"
 
+#include <algorithm>
 #include <cmath>
+#include <limits>
 #include <blitz/tinyvec.h>
 #include "transupport/dbc.hpp"
 
@@ -28,7 +30,7 @@ public:
 
 public:
     //! User-called constructor.
-    Sphere(TVecDbl& C, double R)
+    Sphere(const TVecDbl& C, double R)
         : _center(C), _radius(R)
     {
         Insist(R > 0, "Sphere must have positive radius.");
@@ -46,6 +48,24 @@ public:
         return new Sphere(*this, newId);
     }
 
+    //! Create a copy of the surface in an arena.
+    Surface* clone(const UserSurfaceIdType& newId,
+                   tranSupport::Arena& arena) const
+    {
+        return new (arena.allocate< Sphere >()) Sphere(*this, newId);
+    }
+
+    //! Which kind of surface we are.
+    SurfaceType getType() const {
+        return SPHERE;
+    }
+
+    //! Write our center and radius.
+    void getParameters(double* parameters) const {
+        std::copy(_center.begin(), _center.end(), parameters);
+        parameters[3] = _radius;
+    }
+
     //! Calculate whether a point has a positive sense to this surface
     bool hasPosSense(const TVecDbl& position) const;
 
@@ -54,12 +74,22 @@ public:
                     const TVecDbl& direction,
                     const bool PosSense,
                     bool& hit,
-                    double& distance) const;
+                    double& distance,
+                    const double maxDistance
+                        = std::numeric_limits<double>::infinity()) const;
 
     //! Calculate the surface normal at a point
     void normalAtPoint( const TVecDbl& position,
                         TVecDbl& unitNormal) const;
 
+    //! Distance from a point to the nearest point on the surface
+    double safetyDistance(const TVecDbl& position) const;
+
+    //! Shrink an axis-aligned box to one side of the surface.
+    void clipBoundingBox(   const bool posSense,
+                            TVecDbl& lower,
+                            TVecDbl& upper) const;
+
     ~Sphere() { /* * */ };
 
 protected:
@@ -99,6 +129,23 @@ public:
         return new SphereO(*this, newId);
     }
 
+    //! Create a copy of the surface in an arena.
+    Surface* clone(const UserSurfaceIdType& newId,
+                   tranSupport::Arena& arena) const
+    {
+        return new (arena.allocate< SphereO >()) SphereO(*this, newId);
+    }
+
+    //! Which kind of surface we are.
+    SurfaceType getType() const {
+        return SPHERE_O;
+    }
+
+    //! Write our radius.
+    void getParameters(double* parameters) const {
+        parameters[0] = _radius;
+    }
+
     //! Calculate whether a point has a positive sense to this surface
     bool hasPosSense(const TVecDbl& position) const;
 
@@ -107,12 +154,22 @@ public:
                     const TVecDbl& direction,
                     const bool PosSense,
                     bool& hit,
-                    double& distance) const;
+                    double& distance,
+                    const double maxDistance
+                        = std::numeric_limits<double>::infinity()) const;
 
     //! Calculate the surface normal at a point
     void normalAtPoint( const TVecDbl& position,
                         TVecDbl& unitNormal) const;
 
+    //! Distance from a point to the nearest point on the surface
+    double safetyDistance(const TVecDbl& position) const;
+
+    //! Shrink an axis-aligned box to one side of the surface.
+    void clipBoundingBox(   const bool posSense,
+                            TVecDbl& lower,
+                            TVecDbl& upper) const;
+
     ~SphereO() { /* * */ };
 
 protected:
@@ -0,0 +1,241 @@
+/*!
+ * \file   StructuredGrid.cpp
+ * \brief  Contains implementation for \c StructuredGrid
+ * \author Seth R. Johnson
+ */
+/*----------------------------------------------------------------------------*/
+#include "StructuredGrid.hpp"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include "transupport/dbc.hpp"
+
+namespace mcGeometry {
+//! \cond
+namespace {
+/*----------------------------------------------------------------------------*/
+//! A face of a box: the plane it's on and the four planes around it
+struct FaceKey {
+    unsigned int planes[6];
+
+    bool operator<(const FaceKey& other) const {
+        return std::lexicographical_compare(planes, planes + 6,
+                                            other.planes, other.planes + 6);
+    }
+    bool operator==(const FaceKey& other) const {
+        return std::equal(planes, planes + 6, other.planes);
+    }
+};
+
+//! Key for the lower or upper face of a box along an axis
+FaceKey makeFaceKey(
+        const StructuredGrid::Box& box,
+        const unsigned int axis,
+        const bool isUpper)
+{
+    FaceKey key;
+    key.planes[0] = axis;
+    key.planes[1] = (isUpper ? box.upperSurface[axis]
+                             : box.lowerSurface[axis]);
+
+    unsigned int i = 2;
+    for (unsigned int a = 0; a < 3; ++a) {
+        if (a == axis)
+            continue;
+        key.planes[i++] = box.lowerSurface[a];
+        key.planes[i++] = box.upperSurface[a];
+    }
+    return key;
+}
+
+//! Root of a box's group (halving the path on the way)
+unsigned int findRoot(std::vector<unsigned int>& parent, unsigned int i)
+{
+    while (parent[i] != i) {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+//! Plane coordinate and surface index, ordered by coordinate
+typedef std::pair<double, unsigned int> PlaneEntry;
+/*----------------------------------------------------------------------------*/
+} // end anonymous namespace
+//! \endcond
+
+/*============================================================================*/
+const unsigned int StructuredGrid::NO_GRID;
+
+/*----------------------------------------------------------------------------*/
+StructuredGrid::StructuredGrid(
+        const std::vector<double>       coordinates[3],
+        const std::vector<unsigned int> surfaces[3],
+        const std::vector<unsigned int>& cells) :
+    _cells(cells)
+{
+    for (unsigned int a = 0; a < 3; ++a) {
+        Require(coordinates[a].size() >= 2);
+        Require(surfaces[a].size() == coordinates[a].size());
+
+        _coordinates[a] = coordinates[a];
+        _surfaces[a]    = surfaces[a];
+    }
+    Require(cells.size() == getSize(0) * getSize(1) * getSize(2));
+}
+
+/*----------------------------------------------------------------------------*/
+void StructuredGrid::findGrids(
+        const std::vector<Box>&        boxes,
+        std::vector<StructuredGrid>&   grids,
+        std::vector<Placement>&        placements)
+{
+    const unsigned int numBoxes = boxes.size();
+
+    Placement noPlacement;
+    noPlacement.grid = NO_GRID;
+    noPlacement.index[0] = noPlacement.index[1] = noPlacement.index[2] = 0;
+    placements.assign(numBoxes, noPlacement);
+
+    //====== join boxes that share a face
+    std::vector<std::pair<FaceKey, unsigned int> > lowerFaces;
+    lowerFaces.reserve(3 * numBoxes);
+
+    for (unsigned int i = 0; i < numBoxes; ++i) {
+        for (unsigned int a = 0; a < 3; ++a) {
+            lowerFaces.push_back(
+                    std::make_pair(makeFaceKey(boxes[i], a, false), i));
+        }
+    }
+    std::sort(lowerFaces.begin(), lowerFaces.end());
+
+    std::vector<unsigned int> parent(numBoxes);
+    for (unsigned int i = 0; i < numBoxes; ++i)
+        parent[i] = i;
+
+    for (unsigned int i = 0; i < numBoxes; ++i) {
+        for (unsigned int a = 0; a < 3; ++a) {
+            const std::pair<FaceKey, unsigned int> upperFace(
+                    makeFaceKey(boxes[i], a, true), 0);
+
+            std::vector<std::pair<FaceKey, unsigned int> >::const_iterator
+                match = std::lower_bound(lowerFaces.begin(), lowerFaces.end(),
+                                         upperFace);
+
+            if (match != lowerFaces.end() && match->first == upperFace.first)
+                parent[findRoot(parent, i)] = findRoot(parent, match->second);
+        }
+    }
+
+    //====== gather the groups
+    std::vector<std::pair<unsigned int, unsigned int> > groups(numBoxes);
+    for (unsigned int i = 0; i < numBoxes; ++i)
+        groups[i] = std::make_pair(findRoot(parent, i), i);
+    std::sort(groups.begin(), groups.end());
+
+    unsigned int groupBegin = 0;
+    while (groupBegin < numBoxes) {
+        unsigned int groupEnd = groupBegin + 1;
+        while (groupEnd < numBoxes
+                && groups[groupEnd].first == groups[groupBegin].first)
+            ++groupEnd;
+
+        const unsigned int numInGroup = groupEnd - groupBegin;
+        const unsigned int begin      = groupBegin;
+        groupBegin = groupEnd;
+
+        if (numInGroup < 2)
+            continue;
+
+        //====== the planes along each axis must be at distinct coordinates
+        StructuredGrid grid;
+        std::vector<std::pair<unsigned int, unsigned int> > planeOf[3];
+        unsigned int numSlots = 1;
+        bool isGrid = true;
+
+        for (unsigned int a = 0; a < 3 && isGrid; ++a) {
+            std::vector<PlaneEntry> planes;
+            planes.reserve(2 * numInGroup);
+
+            for (unsigned int g = begin; g < groupEnd; ++g) {
+                const Box& box = boxes[groups[g].second];
+                planes.push_back(PlaneEntry(box.lower[a],
+                                            box.lowerSurface[a]));
+                planes.push_back(PlaneEntry(box.upper[a],
+                                            box.upperSurface[a]));
+            }
+            std::sort(planes.begin(), planes.end());
+            planes.erase(std::unique(planes.begin(), planes.end()),
+                         planes.end());
+
+            for (unsigned int p = 0; p < planes.size(); ++p) {
+                if (p > 0 && !(planes[p - 1].first < planes[p].first))
+                    isGrid = false;
+
+                grid._coordinates[a].push_back(planes[p].first);
+                grid._surfaces[a].push_back(planes[p].second);
+                planeOf[a].push_back(std::make_pair(planes[p].second, p));
+            }
+            std::sort(planeOf[a].begin(), planeOf[a].end());
+
+            // more slots than boxes means a hole (checked as we go so the
+            // count can't overflow)
+            numSlots *= (planes.size() - 1);
+            if (numSlots > numInGroup)
+                isGrid = false;
+        }
+
+        if (!isGrid || numSlots != numInGroup)
+            continue;
+
+        //====== each box fills one slot
+        grid._cells.assign(numSlots, NO_GRID);
+        const unsigned int gridIndex = grids.size();
+
+        for (unsigned int g = begin; g < groupEnd && isGrid; ++g) {
+            const unsigned int boxIndex = groups[g].second;
+            const Box& box = boxes[boxIndex];
+            Placement& placement = placements[boxIndex];
+
+            for (unsigned int a = 0; a < 3; ++a) {
+                // every plane is in the list, since it was built from them
+                const unsigned int lowerPlane = std::lower_bound(
+                        planeOf[a].begin(), planeOf[a].end(),
+                        std::make_pair(box.lowerSurface[a], 0u))->second;
+                const unsigned int upperPlane = std::lower_bound(
+                        planeOf[a].begin(), planeOf[a].end(),
+                        std::make_pair(box.upperSurface[a], 0u))->second;
+
+                if (upperPlane != lowerPlane + 1)
+                    isGrid = false;
+                placement.index[a] = lowerPlane;
+            }
+            if (!isGrid)
+                break;
+
+            const unsigned int slot = placement.index[0]
+                + grid.getSize(0) * (placement.index[1]
+                                     + grid.getSize(1) * placement.index[2]);
+
+            if (grid._cells[slot] != NO_GRID)
+                isGrid = false;
+
+            grid._cells[slot] = box.cell;
+            placement.grid    = gridIndex;
+        }
+
+        if (!isGrid) {
+            // forget the boxes we placed
+            for (unsigned int g = begin; g < groupEnd; ++g)
+                placements[groups[g].second] = noPlacement;
+            continue;
+        }
+
+        grids.push_back(grid);
+    }
+}
+
+/*============================================================================*/
+} // end namespace mcGeometry
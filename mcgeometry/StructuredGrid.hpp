@@ -0,0 +1,216 @@
+/*!
+ * \file   StructuredGrid.hpp
+ * \brief  Contains interface for StructuredGrid class
+ * \author Seth R. Johnson
+ */
+#ifndef MCG_STRUCTUREDGRID_HPP
+#define MCG_STRUCTUREDGRID_HPP
+/*----------------------------------------------------------------------------*/
+
+#include <vector>
+#include <limits>
+#include <algorithm>
+
+#include <blitz/tinyvec.h>
+
+#include "transupport/dbc.hpp"
+
+namespace mcGeometry {
+/*============================================================================*/
+
+/*!
+ * \class StructuredGrid
+ * \brief Box cells that tile a rectilinear grid, found by index.
+ *
+ * A mesh of cells that are each bounded by two planes normal to each axis
+ * (as meshes are usually built) can be tracked through without searching:
+ * the wall a particle hits is one of three, and the cell on the other side
+ * is the next one along that axis.
+ *
+ * findGrids() looks through a list of such boxes for groups joined face to
+ * face that fill a complete grid. Each grid keeps its plane coordinates and
+ * surface indices along each axis, and the cell in each slot, so callers can
+ * still report the user's cells and surfaces.
+ */
+class StructuredGrid {
+public:
+    //! Blitz++ TinyVector of length D stores position/direction/etc.
+    typedef blitz::TinyVector<double, 3> TVecDbl;
+
+    //! Marks a cell that isn't in any grid.
+    static const unsigned int NO_GRID = static_cast<unsigned int>(-1);
+
+    //! A cell bounded by one plane on each side along each axis
+    struct Box {
+        //! Cell index
+        unsigned int cell;
+        //! Surface index of the lower plane along each axis
+        unsigned int lowerSurface[3];
+        //! Surface index of the upper plane along each axis
+        unsigned int upperSurface[3];
+        //! Coordinate of the lower plane along each axis
+        double       lower[3];
+        //! Coordinate of the upper plane along each axis
+        double       upper[3];
+    };
+
+    //! Where a box ended up
+    struct Placement {
+        //! Which grid it's in (or NO_GRID)
+        unsigned int grid;
+        //! Its position along each axis of the grid
+        unsigned int index[3];
+    };
+
+public:
+    //! Create an empty grid (for findGrids() to fill in).
+    StructuredGrid() { /* * */ }
+
+    /*!
+     * \brief Recreate a grid from its planes and cells.
+     *
+     * Along each axis, \c coordinates and \c surfaces have one more entry
+     * than the grid has cells; \c cells has a cell index for each slot,
+     * with x varying fastest. These are the same as a grid found by
+     * findGrids() reports through getCoordinates(), getSurfaces(), and
+     * getCells().
+     */
+    StructuredGrid(const std::vector<double>       coordinates[3],
+                   const std::vector<unsigned int> surfaces[3],
+                   const std::vector<unsigned int>& cells);
+
+    /*!
+     * \brief Find the complete grids among a list of boxes.
+     *
+     * Boxes are grouped by shared faces: the upper plane of one along an axis
+     * is the lower plane of the other, and their other four planes are the
+     * same. A group becomes a grid if it has more than one box, its planes
+     * along each axis are at distinct coordinates, and every slot between
+     * them holds exactly one box.
+     *
+     * On return, \c placements parallels \c boxes; any existing grids are
+     * kept, and new ones are appended.
+     */
+    static void findGrids(
+            const std::vector<Box>&        boxes,
+            std::vector<StructuredGrid>&   grids,
+            std::vector<Placement>&        placements);
+
+    //! Number of cells along an axis.
+    unsigned int getSize(const unsigned int axis) const {
+        Require(axis < 3);
+        return _coordinates[axis].size() - 1;
+    }
+
+    //! Total number of cells.
+    unsigned int getNumCells() const {
+        return _cells.size();
+    }
+
+    //! Cell index in a slot.
+    unsigned int getCell(const unsigned int index[3]) const {
+        Require(index[0] < getSize(0));
+        Require(index[1] < getSize(1));
+        Require(index[2] < getSize(2));
+        return _cells[index[0] + getSize(0) * (index[1]
+                                             + getSize(1) * index[2])];
+    }
+
+    //! Plane coordinates along an axis, increasing.
+    const std::vector<double>& getCoordinates(const unsigned int axis) const {
+        Require(axis < 3);
+        return _coordinates[axis];
+    }
+
+    //! Surface indices of the planes along an axis.
+    const std::vector<unsigned int>& getSurfaces(const unsigned int axis) const
+    {
+        Require(axis < 3);
+        return _surfaces[axis];
+    }
+
+    //! Cell index in each slot, with x varying fastest.
+    const std::vector<unsigned int>& getCells() const {
+        return _cells;
+    }
+
+    //! Surface index of one of the planes along an axis.
+    unsigned int getSurface(const unsigned int axis,
+                            const unsigned int plane) const
+    {
+        Require(axis < 3);
+        Require(plane < _surfaces[axis].size());
+        return _surfaces[axis][plane];
+    }
+
+    /*!
+     * \brief Find the wall of a slot that a ray hits first.
+     *
+     * This uses the same arithmetic as Cell::intersect() on the six planes,
+     * so the distances are identical; exact ties go to the first axis.
+     */
+    void findWall(const unsigned int index[3],
+                  const TVecDbl&     position,
+                  const TVecDbl&     direction,
+                  unsigned int&      axis,
+                  bool&              isUpper,
+                  double&            distance) const;
+
+    /*!
+     * \brief Whether a coordinate is between the planes of a slot.
+     *
+     * This uses the same senses as the planes themselves: a point on the
+     * lower plane is inside, and one on the upper plane is not.
+     */
+    bool contains(const unsigned int axis,
+                  const unsigned int index,
+                  const double coordinate) const
+    {
+        return (coordinate - _coordinates[axis][index] >= 0
+                && coordinate - _coordinates[axis][index + 1] < 0);
+    }
+
+private:
+    //! Plane coordinates along each axis, increasing
+    std::vector<double>       _coordinates[3];
+    //! Surface index of each plane along each axis
+    std::vector<unsigned int> _surfaces[3];
+    //! Cell index in each slot, with x varying fastest
+    std::vector<unsigned int> _cells;
+};
+
+/*----------------------------------------------------------------------------*/
+inline void StructuredGrid::findWall(
+        const unsigned int index[3],
+        const TVecDbl&     position,
+        const TVecDbl&     direction,
+        unsigned int&      axis,
+        bool&              isUpper,
+        double&            distance) const
+{
+    distance = std::numeric_limits<double>::infinity();
+    axis     = 0;
+    isUpper  = false;
+
+    for (unsigned int a = 0; a < 3; ++a) {
+        // only the plane we're headed toward along this axis can be hit
+        const bool         upper = (direction[a] > 0);
+        const unsigned int plane = (upper ? index[a] + 1 : index[a]);
+
+        if (direction[a] == 0)
+            continue;
+
+        const double thisDistance = std::max(0.0,
+                (_coordinates[a][plane] - position[a]) / direction[a]);
+
+        if (thisDistance < distance) {
+            distance = thisDistance;
+            axis     = a;
+            isUpper  = upper;
+        }
+    }
+}
+
+/*============================================================================*/
+} // end namespace mcGeometry
+#endif
@@ -10,56 +10,97 @@
 #include <ostream>
 #include "transupport/dbc.hpp"
 
+#include "Plane.hpp"
+#include "PlaneNormal.hpp"
+#include "Sphere.hpp"
+#include "Cylinder.hpp"
+#include "CylinderNormal.hpp"
+#include "SurfaceKernels.hpp"
+
 namespace mcGeometry {
+//! \cond
+namespace {
+/*----------------------------------------------------------------------------*/
+//! Copy a surface to the heap or into an arena.
+Surface* place(
+        const Surface& surface,
+        const Surface::UserSurfaceIdType& userId,
+        tranSupport::Arena* arena)
+{
+    if (arena != NULL)
+        return surface.clone(userId, *arena);
+    return surface.clone(userId);
+}
+/*----------------------------------------------------------------------------*/
+} // end anonymous namespace
+//! \endcond
+
 /*============================================================================*/
+Surface* Surface::create(
+        const SurfaceType type,
+        const double* p,
+        const UserSurfaceIdType& userId,
+        tranSupport::Arena* arena)
+{
+    typedef Surface::TVecDbl TVecDbl;
+
+    switch (type) {
+        case PLANE:
+            return place(Plane(TVecDbl(p[0], p[1], p[2]),
+                               TVecDbl(p[3], p[4], p[5])), userId, arena);
+        case PLANE_X:
+            return place(PlaneX(p[0]), userId, arena);
+        case PLANE_Y:
+            return place(PlaneY(p[0]), userId, arena);
+        case PLANE_Z:
+            return place(PlaneZ(p[0]), userId, arena);
+        case SPHERE:
+            return place(Sphere(TVecDbl(p[0], p[1], p[2]), p[3]),
+                         userId, arena);
+        case SPHERE_O:
+            return place(SphereO(p[0]), userId, arena);
+        case CYLINDER:
+            return place(Cylinder(TVecDbl(p[0], p[1], p[2]),
+                                  TVecDbl(p[3], p[4], p[5]), p[6]),
+                         userId, arena);
+        case CYLINDER_X:
+            return place(CylinderX(TVecDbl(p[0], p[1], p[2]), p[3]),
+                         userId, arena);
+        case CYLINDER_Y:
+            return place(CylinderY(TVecDbl(p[0], p[1], p[2]), p[3]),
+                         userId, arena);
+        case CYLINDER_Z:
+            return place(CylinderZ(TVecDbl(p[0], p[1], p[2]), p[3]),
+                         userId, arena);
+        default:
+            break;
+    }
+
+    Insist(0, "Unknown surface type.");
+    return NULL;
+}
+
+/*----------------------------------------------------------------------------*/
 void Surface::_calcQuadraticIntersect(
         const double A, const double B, const double C, const bool posSense,
+        const double maxDistance,
         bool& particleHitsSurface, double& distanceToIntercept) const
 {
-    double Q = B*B - A*C;
-
-    if (Q < 0) {
-        particleHitsSurface = false;
-        distanceToIntercept = 0.0;
-    }
-    else {
-        if (not posSense) { //inside the surface (negative orientation)
-            if (B <= 0) {   // headed away from the surface
-                if (A > 0) {    // surface is curving upward
-                    particleHitsSurface = true;
-                    distanceToIntercept = (std::sqrt(Q) - B)/A;
-                }
-                else {  // surface curving away and headed in, never hits it
-                    particleHitsSurface = false;
-                    distanceToIntercept = 0.0;
-                }
-            }
-            else {  // particle is heading toward the surface
-                particleHitsSurface = true;
-                distanceToIntercept = std::max(0.0, -C/(std::sqrt(Q) + B));
-            }
-        }
-        else {  // particle is outside
-            if (B >= 0) {   // particle headed away
-                if (A >= 0) {
-                    particleHitsSurface = false;
-                    distanceToIntercept = 0.0;
-                }
-                else {
-                    particleHitsSurface = true;
-                    distanceToIntercept = -(std::sqrt(Q) + B)/A;
-                }
-            }
-            else {
-                particleHitsSurface = true;
-                distanceToIntercept = std::max(0.0, C/(std::sqrt(Q) - B));
-            }
-        }
-    }
+    calcQuadraticIntersect(A, B, C, posSense, maxDistance,
+            particleHitsSurface, distanceToIntercept);
 
     Ensure( distanceToIntercept >= 0.0 );
 }
 
+/*----------------------------------------------------------------------------*/
+void Surface::clipBoundingBox(
+        const bool,
+        TVecDbl&,
+        TVecDbl&) const
+{
+    /* * */
+}
+
 /*============================================================================*/
 //! \brief Output a general Surface-descended surface
 // for polymorphism, we have to call a inherited method
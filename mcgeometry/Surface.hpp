@@ -7,11 +7,14 @@
 #ifndef MCG_SURFACE_HPP
 #define MCG_SURFACE_HPP
 /*----------------------------------------------------------------------------*/
+#include <new>
 #include <utility>
 #include <iosfwd>
+#include <limits>
 #include <blitz/tinyvec.h>
 
 #include "transupport/dbc.hpp"
+#include "transupport/Arena.hpp"
 
 namespace mcGeometry {
 /*============================================================================*/
@@ -36,22 +39,44 @@ public:
     //! Extra information about surfaces (i.e. is it reflecting)
     enum SurfaceFlags {
         NONE       = 0,
-        REFLECTING = 1
+        REFLECTING = 1,
+        PERIODIC   = 2  //!< Paired with another by MCGeometry
     };
 
+    //! Every concrete kind of surface, so they can be stored and rebuilt.
+    enum SurfaceType {
+        PLANE = 0,
+        PLANE_X,
+        PLANE_Y,
+        PLANE_Z,
+        SPHERE,
+        SPHERE_O,
+        CYLINDER,
+        CYLINDER_X,
+        CYLINDER_Y,
+        CYLINDER_Z,
+        NUM_SURFACE_TYPES
+    };
+
+    //! Most values that getParameters() will ever write
+    enum { MAX_PARAMETERS = 7 };
+
     /*!
      * \brief Determine distance to intersection with the surface.
      *
      * See if going from a position in a direction with a surface sense
      * intersects the surface; pass back whether it hits and what the distance
-     * is.
+     * is. A surface farther away than \c maxDistance counts as not hit, and
+     * the quadrics can often tell that without finding the distance.
      */
     virtual void intersect(
             const TVecDbl& position,
             const TVecDbl& direction,
             const bool PosSense,
             bool& hit,
-            double& distance) const = 0;
+            double& distance,
+            const double maxDistance
+                = std::numeric_limits<double>::infinity()) const = 0;
 
     //! Calculate whether a point has a positive sense to this surface without
     //!  doing all the distance calculations
@@ -65,20 +90,85 @@ public:
             const TVecDbl& position,
             TVecDbl& unitNormal) const = 0;
 
+    /*!
+     * \brief Distance from a point to the nearest point on the surface.
+     *
+     * This is the "safety distance": a particle at \c position can move this
+     * far in any direction without crossing us. It is calculated from the
+     * same quadric evaluation as hasPosSense(), so a point on the surface
+     * is at zero.
+     */
+    virtual double safetyDistance(const TVecDbl& position) const = 0;
+
+    /*!
+     * \brief Shrink an axis-aligned box to one side of the surface.
+     *
+     * On return, \c lower and \c upper still contain every point in the box
+     * that has the given sense with respect to this surface. The box is
+     * conservative: surfaces that can't cheaply bound a side (the default)
+     * leave it alone.
+     */
+    virtual void clipBoundingBox(
+            const bool posSense,
+            TVecDbl& lower,
+            TVecDbl& upper) const;
+
     //! Create a "new" copy of ourself, so that a user-created surface can be
     //! retained by MCGeometry.
     virtual Surface* clone(const UserSurfaceIdType& newId) const = 0;
 
+    /*!
+     * \brief Create a copy of ourself in an arena.
+     *
+     * The arena owns the memory; whoever uses the copy calls its destructor
+     * (rather than deleting it) when done.
+     */
+    virtual Surface* clone(const UserSurfaceIdType& newId,
+                           tranSupport::Arena& arena) const = 0;
+
+    //! Which kind of surface we are.
+    virtual SurfaceType getType() const = 0;
+
+    /*!
+     * \brief Write the values that define us, in constructor order.
+     *
+     * At most MAX_PARAMETERS values are written. Passing them back to
+     * Surface::create() with our type rebuilds an identical surface.
+     */
+    virtual void getParameters(double* parameters) const = 0;
+
+    /*!
+     * \brief Rebuild a surface from getType() and getParameters().
+     *
+     * The new surface has the given user ID. It is heap-allocated and owned
+     * by the caller, or placed in \c arena if one is given.
+     */
+    static Surface* create(
+            const SurfaceType type,
+            const double* parameters,
+            const UserSurfaceIdType& userId,
+            tranSupport::Arena* arena = NULL);
+
     //! Return the user ID associated with this surface.
     UserSurfaceIdType getUserId() const {
         return _userId;
     }
 
+    //! Return the internal index assigned by the MCGeometry that owns us.
+    unsigned int getIndex() const {
+        return _index;
+    }
+
     //! Are we a reflecting surface?
     bool isReflecting() const {
         return (_flags & REFLECTING);
     }
 
+    //! Are we one of a pair of periodic surfaces?
+    bool isPeriodic() const {
+        return (_flags & PERIODIC);
+    }
+
     //! Generic virtual distructor.
     virtual ~Surface()
     { /* * */ }
@@ -93,17 +183,18 @@ public:
 
 protected:
     //! Create a surface without any extra information
-    Surface() : _userId(), _flags(NONE)
+    Surface() : _userId(), _index(0), _flags(NONE)
     { /* * */ }
 
     //! Copy an old surface, but with a user ID
     Surface(const Surface& oldSurface, const UserSurfaceIdType& userId)
-        : _userId(userId), _flags(oldSurface._flags)
+        : _userId(userId), _index(0), _flags(oldSurface._flags)
     { /* * */ }
 
     //! Copy an old surface, and use th eold surface user ID.
     Surface(const Surface& oldSurface)
-        : _userId(oldSurface._userId), _flags(oldSurface._flags)
+        : _userId(oldSurface._userId), _index(oldSurface._index),
+          _flags(oldSurface._flags)
     { /* * */ }
 
     /*! \brief Does the evaluated quadric eq result in a pos or neg sense?
@@ -117,12 +208,18 @@ protected:
     void _calcQuadraticIntersect(
                             const double A, const double B, const double C,
                             const bool posSense,
+                            const double maxDistance,
                             bool& particleHitsSurface,
                             double& distanceToIntercept ) const;
 
 private:
+    //! MCGeometry assigns our internal index when it clones us.
+    friend class MCGeometry;
+
     //! Store the user's identification of this surface.
     UserSurfaceIdType _userId;
+    //! Index in the owning MCGeometry's surface vector.
+    unsigned int      _index;
     //! Store extra information about the surface
     SurfaceFlags      _flags;
 };
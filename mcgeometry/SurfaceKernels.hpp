@@ -0,0 +1,651 @@
+/*!
+ * \file   SurfaceKernels.hpp
+ * \brief  Inline intersection math for each kind of surface
+ * \author Seth R. Johnson
+ */
+#ifndef MCG_SURFACEKERNELS_HPP
+#define MCG_SURFACEKERNELS_HPP
+/*----------------------------------------------------------------------------*/
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "Surface.hpp"
+
+namespace mcGeometry {
+/*============================================================================*/
+/*!
+ * \brief Intersection distance from the quadratic coefficients of a surface.
+ *
+ * The distance solves \f$ A d^2 + 2 B d + C = 0 \f$ for a particle with the
+ * given sense; \c hit is false (and the distance zero) if it never gets
+ * there, or doesn't get there within \c maxDistance. Every quadric surface
+ * uses this.
+ *
+ * Our quadrics all have \f$ A \ge 0 \f$, which gives cheap bounds to rule
+ * out far surfaces before taking the square root: from outside, the distance
+ * is at least \f$ C / (-2B) \f$; from inside, the particle is still inside
+ * at \c maxDistance if the quadric is negative there.
+ */
+inline void calcQuadraticIntersect(
+        const double A, const double B, const double C,
+        const bool posSense,
+        const double maxDistance,
+        bool& particleHitsSurface,
+        double& distanceToIntercept)
+{
+    double Q = B*B - A*C;
+
+    particleHitsSurface = false;
+    distanceToIntercept = 0.0;
+
+    if (Q < 0)
+        return;
+
+    double distance;
+
+    if (!posSense) { //inside the surface (negative orientation)
+        // still inside at the limit
+        if (A >= 0 && C <= 0
+                && (A * maxDistance + 2 * B) * maxDistance + C < 0)
+            return;
+
+        if (B <= 0) {   // headed away from the surface
+            if (A > 0) {    // surface is curving upward
+                distance = (std::sqrt(Q) - B)/A;
+            }
+            else {
+                // otherwise surface curving away and headed in, never hits it
+                return;
+            }
+        }
+        else {  // particle is heading toward the surface
+            distance = std::max(0.0, -C/(std::sqrt(Q) + B));
+        }
+    }
+    else {  // particle is outside
+        if (B >= 0) {   // particle headed away
+            if (A < 0) {
+                distance = -(std::sqrt(Q) + B)/A;
+            }
+            else {
+                return;
+            }
+        }
+        else {
+            // too far away to get there in time
+            if (A >= 0 && C > -2 * B * maxDistance)
+                return;
+
+            distance = std::max(0.0, C/(std::sqrt(Q) - B));
+        }
+    }
+
+    if (distance > maxDistance)
+        return;
+
+    particleHitsSurface = true;
+    distanceToIntercept = distance;
+}
+
+/*----------------------------------------------------------------------------*/
+/*!
+ * \name Surface distance kernels
+ *
+ * Each of these takes a surface's parameters (as written by
+ * Surface::getParameters()), a position, a direction, the particle's
+ * sense with respect to the surface, and the farthest distance of interest.
+ * It returns the distance to the surface, or infinity if the particle
+ * doesn't hit it within that distance, using exactly the same arithmetic as
+ * that surface's \c intersect method. Being small, inline, and
+ * free of virtual calls, they can be run over many particles in tight loops.
+ */
+//\{
+
+//! Convert a hit flag and distance into a kernel result.
+inline double kernelDistance(const bool hit, const double distance)
+{
+    return (hit ? distance : std::numeric_limits<double>::infinity());
+}
+
+//! A plane's distance, or infinity if it's beyond the limit.
+inline double limitDistance(const double distance, const double maxDistance)
+{
+    return (distance <= maxDistance ? distance
+                                    : std::numeric_limits<double>::infinity());
+}
+
+//! Distance to a Plane.
+inline double planeDistance(
+        const double* p,
+        const double* position,
+        const double* direction,
+        const bool posSense,
+        const double maxDistance)
+{
+    const double cosine = p[0] * direction[0] + p[1] * direction[1]
+                        + p[2] * direction[2];
+
+    if ( ((posSense == false) && (cosine > 0))
+         || ((posSense == true) && (cosine < 0)) )
+    {
+        const double distance = p[0] * (p[3] - position[0])
+                              + p[1] * (p[4] - position[1])
+                              + p[2] * (p[5] - position[2]);
+        return limitDistance(std::max(0.0, distance/cosine), maxDistance);
+    }
+    return std::numeric_limits<double>::infinity();
+}
+
+//! Distance to a PlaneNormal.
+template<unsigned int axis>
+inline double planeNormalDistance(
+        const double* p,
+        const double* position,
+        const double* direction,
+        const bool posSense,
+        const double maxDistance)
+{
+    if (    ((posSense == false) && (direction[axis] > 0))
+         || ((posSense == true)  && (direction[axis] < 0)) )
+    {
+        return limitDistance(
+                std::max(0.0, (p[0] - position[axis]) / direction[axis]),
+                maxDistance);
+    }
+    return std::numeric_limits<double>::infinity();
+}
+
+//! Distance to a Sphere.
+inline double sphereDistance(
+        const double* p,
+        const double* position,
+        const double* direction,
+        const bool posSense,
+        const double maxDistance)
+{
+    const double tr0 = position[0] - p[0];
+    const double tr1 = position[1] - p[1];
+    const double tr2 = position[2] - p[2];
+
+    bool hit;
+    double distance;
+    calcQuadraticIntersect(
+            1,
+            tr0 * direction[0] + tr1 * direction[1] + tr2 * direction[2],
+            (tr0 * tr0 + tr1 * tr1 + tr2 * tr2) - p[3] * p[3],
+            posSense, maxDistance, hit, distance);
+    return kernelDistance(hit, distance);
+}
+
+//! Distance to a SphereO.
+inline double sphereODistance(
+        const double* p,
+        const double* position,
+        const double* direction,
+        const bool posSense,
+        const double maxDistance)
+{
+    bool hit;
+    double distance;
+    calcQuadraticIntersect(
+            1,
+            position[0] * direction[0] + position[1] * direction[1]
+                + position[2] * direction[2],
+            (position[0] * position[0] + position[1] * position[1]
+                + position[2] * position[2]) - p[0] * p[0],
+            posSense, maxDistance, hit, distance);
+    return kernelDistance(hit, distance);
+}
+
+//! Distance to a Cylinder.
+inline double cylinderDistance(
+        const double* p,
+        const double* position,
+        const double* direction,
+        const bool posSense,
+        const double maxDistance)
+{
+    const double* axis = p + 3;
+
+    double temp = direction[0] * axis[0] + direction[1] * axis[1]
+                + direction[2] * axis[2];
+    const double A = 1 - temp * temp;
+
+    const double tr0 = position[0] - p[0];
+    const double tr1 = position[1] - p[1];
+    const double tr2 = position[2] - p[2];
+
+    const double trDotAxis = tr0 * axis[0] + tr1 * axis[1] + tr2 * axis[2];
+
+    const double B = direction[0] * (tr0 - axis[0] * trDotAxis)
+                   + direction[1] * (tr1 - axis[1] * trDotAxis)
+                   + direction[2] * (tr2 - axis[2] * trDotAxis);
+
+    const double C = (tr0 * tr0 + tr1 * tr1 + tr2 * tr2)
+                   - trDotAxis * trDotAxis - p[6] * p[6];
+
+    bool hit;
+    double distance;
+    calcQuadraticIntersect(A, B, C, posSense, maxDistance, hit, distance);
+    return kernelDistance(hit, distance);
+}
+
+//! Distance to a CylinderNormal.
+template<unsigned int axis>
+inline double cylinderNormalDistance(
+        const double* p,
+        const double* position,
+        const double* direction,
+        const bool posSense,
+        const double maxDistance)
+{
+    // the two axes perpendicular to the cylinder
+    const unsigned int i = (axis == 0 ? 1 : 0);
+    const unsigned int j = (axis == 2 ? 1 : 2);
+
+    const double A = 1 - direction[axis] * direction[axis];
+
+    const double tri = position[i] - p[i];
+    const double trj = position[j] - p[j];
+
+    const double B = direction[i] * tri + direction[j] * trj;
+    const double C = (tri * tri + trj * trj) - p[3] * p[3];
+
+    bool hit;
+    double distance;
+    calcQuadraticIntersect(A, B, C, posSense, maxDistance, hit, distance);
+    return kernelDistance(hit, distance);
+}
+//\}
+
+/*----------------------------------------------------------------------------*/
+/*!
+ * \brief Distance to a quadric for a particle sitting on it.
+ *
+ * On the surface \f$ C = 0 \f$, so the quadric \f$ A d^2 + 2 B d \f$ is
+ * zero again at \f$ d = -2B/A \f$. This is what calcQuadraticIntersect()
+ * finds with \c C exactly zero, without the square root, and without the
+ * roundoff in \c C that can make a surface just crossed look a hair away.
+ */
+inline double onQuadricDistance(
+        const double A, const double B,
+        const bool posSense,
+        const double maxDistance)
+{
+    double distance = std::numeric_limits<double>::infinity();
+
+    if (!posSense) {
+        if (B > 0)          // leaving right away
+            distance = 0.0;
+        else if (A > 0)     // out the other side
+            distance = -2 * B / A;
+    }
+    else {
+        if (B < 0)
+            distance = 0.0;
+        else if (A < 0)
+            distance = -2 * B / A;
+    }
+
+    return limitDistance(distance, maxDistance);
+}
+
+/*----------------------------------------------------------------------------*/
+/*!
+ * \name Surface sense kernels
+ *
+ * These take a surface's parameters and a position, and return whether the
+ * position has a positive sense with respect to the surface, with the same
+ * arithmetic as that surface's \c hasPosSense method.
+ */
+//\{
+
+//! Whether a Plane has a positive sense.
+inline bool planeSense(const double* p, const double* position)
+{
+    return ((p[0] * position[0] + p[1] * position[1] + p[2] * position[2])
+            - (p[0] * p[3] + p[1] * p[4] + p[2] * p[5]) >= 0);
+}
+
+//! Whether a PlaneNormal has a positive sense.
+template<unsigned int axis>
+inline bool planeNormalSense(const double* p, const double* position)
+{
+    return (position[axis] - p[0] >= 0);
+}
+
+//! Whether a Sphere has a positive sense.
+inline bool sphereSense(const double* p, const double* position)
+{
+    const double tr0 = position[0] - p[0];
+    const double tr1 = position[1] - p[1];
+    const double tr2 = position[2] - p[2];
+
+    return ((tr0 * tr0 + tr1 * tr1 + tr2 * tr2) - p[3] * p[3] >= 0);
+}
+
+//! Whether a SphereO has a positive sense.
+inline bool sphereOSense(const double* p, const double* position)
+{
+    return ((position[0] * position[0] + position[1] * position[1]
+                + position[2] * position[2]) - p[0] * p[0] >= 0);
+}
+
+//! Whether a Cylinder has a positive sense.
+inline bool cylinderSense(const double* p, const double* position)
+{
+    const double* axis = p + 3;
+
+    const double tr0 = position[0] - p[0];
+    const double tr1 = position[1] - p[1];
+    const double tr2 = position[2] - p[2];
+
+    const double b = tr0 * axis[0] + tr1 * axis[1] + tr2 * axis[2];
+
+    return ((tr0 * tr0 + tr1 * tr1 + tr2 * tr2) - b * b - p[6] * p[6] >= 0);
+}
+
+//! Whether a CylinderNormal has a positive sense.
+template<unsigned int axis>
+inline bool cylinderNormalSense(const double* p, const double* position)
+{
+    const unsigned int i = (axis == 0 ? 1 : 0);
+    const unsigned int j = (axis == 2 ? 1 : 2);
+
+    const double tri = position[i] - p[i];
+    const double trj = position[j] - p[j];
+
+    return ((tri * tri + trj * trj) - p[3] * p[3] >= 0);
+}
+//\}
+
+/*----------------------------------------------------------------------------*/
+/*!
+ * \name Surface safety kernels
+ *
+ * These take a surface's parameters and a position, and return the distance
+ * from the position to the nearest point on the surface, with the same
+ * arithmetic as that surface's \c safetyDistance method.
+ */
+//\{
+
+//! Distance to a sphere or cylinder from the squared distance to its center.
+inline double quadricSafety(const double rhoSquared, const double radius)
+{
+    return std::fabs(rhoSquared - radius * radius)
+            / (std::sqrt(rhoSquared) + radius);
+}
+
+//! Distance to a Plane.
+inline double planeSafety(const double* p, const double* position)
+{
+    return std::fabs(
+            (p[0] * position[0] + p[1] * position[1] + p[2] * position[2])
+            - (p[0] * p[3] + p[1] * p[4] + p[2] * p[5]));
+}
+
+//! Distance to a PlaneNormal.
+template<unsigned int axis>
+inline double planeNormalSafety(const double* p, const double* position)
+{
+    return std::fabs(position[axis] - p[0]);
+}
+
+//! Distance to a Sphere.
+inline double sphereSafety(const double* p, const double* position)
+{
+    const double tr0 = position[0] - p[0];
+    const double tr1 = position[1] - p[1];
+    const double tr2 = position[2] - p[2];
+
+    return quadricSafety(tr0 * tr0 + tr1 * tr1 + tr2 * tr2, p[3]);
+}
+
+//! Distance to a SphereO.
+inline double sphereOSafety(const double* p, const double* position)
+{
+    return quadricSafety(position[0] * position[0]
+                            + position[1] * position[1]
+                            + position[2] * position[2], p[0]);
+}
+
+//! Distance to a Cylinder.
+inline double cylinderSafety(const double* p, const double* position)
+{
+    const double* axis = p + 3;
+
+    const double tr0 = position[0] - p[0];
+    const double tr1 = position[1] - p[1];
+    const double tr2 = position[2] - p[2];
+
+    const double b = tr0 * axis[0] + tr1 * axis[1] + tr2 * axis[2];
+
+    return quadricSafety(
+            std::max(0.0, (tr0 * tr0 + tr1 * tr1 + tr2 * tr2) - b * b),
+            p[6]);
+}
+
+//! Distance to a CylinderNormal.
+template<unsigned int axis>
+inline double cylinderNormalSafety(const double* p, const double* position)
+{
+    const unsigned int i = (axis == 0 ? 1 : 0);
+    const unsigned int j = (axis == 2 ? 1 : 2);
+
+    const double tri = position[i] - p[i];
+    const double trj = position[j] - p[j];
+
+    return quadricSafety(tri * tri + trj * trj, p[3]);
+}
+//\}
+
+/*============================================================================*/
+/*!
+ * \struct SurfaceShape
+ * \brief A surface's kind and a pointer to its parameters.
+ *
+ * This is a closed set of surface types standing in for a \c Surface*: code
+ * that holds these can dispatch with a switch on \c type instead of a
+ * virtual call, so the compiler can inline each kernel into the caller's
+ * loop. The parameters stay in whatever table holds them (one row of
+ * Surface::MAX_PARAMETERS per surface), so a shape is made as it's needed.
+ */
+struct SurfaceShape {
+    //! Kind of surface (a Surface::SurfaceType).
+    unsigned char type;
+    //! Parameters as written by Surface::getParameters().
+    const double* parameters;
+
+    //! Point at a surface's row of a table.
+    SurfaceShape(const unsigned char surfaceType,
+                 const double* surfaceParameters) :
+        type(surfaceType),
+        parameters(surfaceParameters)
+    { /* * */ }
+
+    //! Distance to the surface, or infinity if it isn't hit in time.
+    double distance(const double* position,
+                    const double* direction,
+                    const bool posSense,
+                    const double maxDistance
+                        = std::numeric_limits<double>::infinity()) const;
+
+    //! Distance to the surface for a particle that's on it.
+    double distanceFromSurface(const double* position,
+                               const double* direction,
+                               const bool posSense,
+                               const double maxDistance) const;
+
+    //! Whether a point has a positive sense with respect to the surface.
+    bool hasPosSense(const double* position) const;
+
+    //! Distance from a point to the nearest point on the surface.
+    double safetyDistance(const double* position) const;
+};
+
+/*----------------------------------------------------------------------------*/
+inline double SurfaceShape::distance(
+        const double* position,
+        const double* direction,
+        const bool posSense,
+        const double maxDistance) const
+{
+    const double* p = parameters;
+
+    switch (type) {
+        case Surface::PLANE:
+            return planeDistance(p, position, direction, posSense,
+                    maxDistance);
+        case Surface::PLANE_X:
+            return planeNormalDistance<0>(p, position, direction, posSense,
+                    maxDistance);
+        case Surface::PLANE_Y:
+            return planeNormalDistance<1>(p, position, direction, posSense,
+                    maxDistance);
+        case Surface::PLANE_Z:
+            return planeNormalDistance<2>(p, position, direction, posSense,
+                    maxDistance);
+        case Surface::SPHERE:
+            return sphereDistance(p, position, direction, posSense,
+                    maxDistance);
+        case Surface::SPHERE_O:
+            return sphereODistance(p, position, direction, posSense,
+                    maxDistance);
+        case Surface::CYLINDER:
+            return cylinderDistance(p, position, direction, posSense,
+                    maxDistance);
+        case Surface::CYLINDER_X:
+            return cylinderNormalDistance<0>(p, position, direction, posSense,
+                    maxDistance);
+        case Surface::CYLINDER_Y:
+            return cylinderNormalDistance<1>(p, position, direction, posSense,
+                    maxDistance);
+        case Surface::CYLINDER_Z:
+            return cylinderNormalDistance<2>(p, position, direction, posSense,
+                    maxDistance);
+    }
+    Insist(false, "Unknown surface type.");
+    return std::numeric_limits<double>::infinity();
+}
+
+/*----------------------------------------------------------------------------*/
+inline double SurfaceShape::distanceFromSurface(
+        const double* position,
+        const double* direction,
+        const bool posSense,
+        const double maxDistance) const
+{
+    const double* p = parameters;
+
+    // planes: gone at once if headed back through, otherwise never again
+    double cosine;
+    switch (type) {
+        case Surface::PLANE:
+            cosine = p[0] * direction[0] + p[1] * direction[1]
+                   + p[2] * direction[2];
+            return ((posSense ? cosine < 0 : cosine > 0)
+                    ? 0.0 : std::numeric_limits<double>::infinity());
+        case Surface::PLANE_X:
+        case Surface::PLANE_Y:
+        case Surface::PLANE_Z:
+            cosine = direction[type - Surface::PLANE_X];
+            return ((posSense ? cosine < 0 : cosine > 0)
+                    ? 0.0 : std::numeric_limits<double>::infinity());
+        default:
+            break;
+    }
+
+    // quadrics: just the A and B coefficients
+    double A = 1.0;
+    double B = 0.0;
+    switch (type) {
+        case Surface::SPHERE:
+            B = (position[0] - p[0]) * direction[0]
+              + (position[1] - p[1]) * direction[1]
+              + (position[2] - p[2]) * direction[2];
+            break;
+        case Surface::SPHERE_O:
+            B = position[0] * direction[0] + position[1] * direction[1]
+              + position[2] * direction[2];
+            break;
+        case Surface::CYLINDER: {
+            const double* axis = p + 3;
+            const double temp = direction[0] * axis[0]
+                              + direction[1] * axis[1]
+                              + direction[2] * axis[2];
+            const double tr0 = position[0] - p[0];
+            const double tr1 = position[1] - p[1];
+            const double tr2 = position[2] - p[2];
+            const double trDotAxis = tr0 * axis[0] + tr1 * axis[1]
+                                   + tr2 * axis[2];
+            A = 1 - temp * temp;
+            B = direction[0] * (tr0 - axis[0] * trDotAxis)
+              + direction[1] * (tr1 - axis[1] * trDotAxis)
+              + direction[2] * (tr2 - axis[2] * trDotAxis);
+            break;
+        }
+        case Surface::CYLINDER_X:
+        case Surface::CYLINDER_Y:
+        case Surface::CYLINDER_Z: {
+            const unsigned int axis = type - Surface::CYLINDER_X;
+            const unsigned int i = (axis == 0 ? 1 : 0);
+            const unsigned int j = (axis == 2 ? 1 : 2);
+            A = 1 - direction[axis] * direction[axis];
+            B = direction[i] * (position[i] - p[i])
+              + direction[j] * (position[j] - p[j]);
+            break;
+        }
+        default:
+            Insist(false, "Unknown surface type.");
+    }
+
+    return onQuadricDistance(A, B, posSense, maxDistance);
+}
+
+/*----------------------------------------------------------------------------*/
+inline bool SurfaceShape::hasPosSense(const double* position) const
+{
+    const double* p = parameters;
+
+    switch (type) {
+        case Surface::PLANE:      return planeSense(p, position);
+        case Surface::PLANE_X:    return planeNormalSense<0>(p, position);
+        case Surface::PLANE_Y:    return planeNormalSense<1>(p, position);
+        case Surface::PLANE_Z:    return planeNormalSense<2>(p, position);
+        case Surface::SPHERE:     return sphereSense(p, position);
+        case Surface::SPHERE_O:   return sphereOSense(p, position);
+        case Surface::CYLINDER:   return cylinderSense(p, position);
+        case Surface::CYLINDER_X: return cylinderNormalSense<0>(p, position);
+        case Surface::CYLINDER_Y: return cylinderNormalSense<1>(p, position);
+        case Surface::CYLINDER_Z: return cylinderNormalSense<2>(p, position);
+    }
+    Insist(false, "Unknown surface type.");
+    return false;
+}
+
+/*----------------------------------------------------------------------------*/
+inline double SurfaceShape::safetyDistance(const double* position) const
+{
+    const double* p = parameters;
+
+    switch (type) {
+        case Surface::PLANE:      return planeSafety(p, position);
+        case Surface::PLANE_X:    return planeNormalSafety<0>(p, position);
+        case Surface::PLANE_Y:    return planeNormalSafety<1>(p, position);
+        case Surface::PLANE_Z:    return planeNormalSafety<2>(p, position);
+        case Surface::SPHERE:     return sphereSafety(p, position);
+        case Surface::SPHERE_O:   return sphereOSafety(p, position);
+        case Surface::CYLINDER:   return cylinderSafety(p, position);
+        case Surface::CYLINDER_X: return cylinderNormalSafety<0>(p, position);
+        case Surface::CYLINDER_Y: return cylinderNormalSafety<1>(p, position);
+        case Surface::CYLINDER_Z: return cylinderNormalSafety<2>(p, position);
+    }
+    Insist(false, "Unknown surface type.");
+    return 0.0;
+}
+
+/*============================================================================*/
+} // end namespace mcGeometry
+#endif
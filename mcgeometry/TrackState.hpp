@@ -0,0 +1,309 @@
+/*!
+ * \file   TrackState.hpp
+ * \brief  Per-particle tracking information owned by the caller
+ * \author Seth R. Johnson
+ */
+#ifndef mcgeometry_TrackState_hpp
+#define mcgeometry_TrackState_hpp
+/*----------------------------------------------------------------------------*/
+
+#include <cstddef>
+#include <vector>
+#include <blitz/tinyvec.h>
+
+#include "transupport/dbc.hpp"
+
+namespace mcGeometry {
+/*============================================================================*/
+
+class Surface;
+
+/*!
+ * \class SurfaceSenses
+ * \brief Which side of each surface a particle is known to be on.
+ *
+ * While a particle is inside a cell, its sense with respect to each of the
+ * cell's bounding surfaces is given by the cell's definition; only the one
+ * it's crossing changes. Recording these at each crossing lets the cells on
+ * the other side compare the senses of surfaces they share instead of
+ * evaluating them.
+ *
+ * Only one cell's senses are held at a time, in a small direct-mapped table
+ * keyed on surface index, so it is the same size for every particle no
+ * matter how many surfaces the geometry has. A lookup is a single probe,
+ * and forgetting every sense is just a matter of starting a new generation.
+ * A surface whose slot is taken isn't stored, and is evaluated instead.
+ *
+ * Since the senses follow from a cell's definition alone, the table
+ * remembers whose they are (so it only makes sense for cells in one
+ * geometry): when the particle leaves that cell again, they are still right
+ * and needn't be written.
+ *
+ * This also remembers the surface that was just crossed, where, and at
+ * which universe level, so that a distance calculation starting from that
+ * point knows it's on the surface.
+ */
+class SurfaceSenses {
+public:
+    //! Blitz++ TinyVector of length D stores position/direction/etc.
+    typedef blitz::TinyVector<double, 3> TVecDbl;
+
+    //! Start out knowing nothing.
+    SurfaceSenses() :
+        _generation(1),
+        _cellIndex(NO_CELL),
+        _crossedSurface(NULL),
+        _crossedLevel(0)
+    {
+        for (unsigned int i = 0; i < NUM_SLOTS; ++i)
+            _entries[i].generation = 0;
+    }
+
+    //! Forget every sense.
+    void clear() {
+        if (++_generation == 0) {
+            // wrapped around: old stamps could look current
+            for (unsigned int i = 0; i < NUM_SLOTS; ++i)
+                _entries[i].generation = 0;
+            _generation = 1;
+        }
+        _cellIndex = NO_CELL;
+    }
+
+    //! Forget every sense, to record those of a point inside a cell.
+    void startCell(const unsigned int cellIndex) {
+        clear();
+        _cellIndex = cellIndex;
+    }
+
+    //! Whether the senses recorded are those of a point inside this cell.
+    bool holdsCell(const unsigned int cellIndex) const {
+        return (_cellIndex == cellIndex);
+    }
+
+    //! Record the particle's sense with respect to a surface, if there's
+    //! room for it.
+    void set(const unsigned int surfaceIndex, const bool sense) {
+        Entry& entry = _entries[surfaceIndex & (NUM_SLOTS - 1)];
+        if (entry.generation != _generation) {
+            entry.generation = _generation;
+            entry.code       = (surfaceIndex << 1) | (sense ? 1u : 0u);
+        }
+    }
+
+    //! Look up the sense with respect to a surface, if we know it.
+    bool find(const unsigned int surfaceIndex, bool& sense) const {
+        const Entry& entry = _entries[surfaceIndex & (NUM_SLOTS - 1)];
+        if (entry.generation == _generation
+                && (entry.code >> 1) == surfaceIndex)
+        {
+            sense = (entry.code & 1u);
+            return true;
+        }
+        return false;
+    }
+
+    //! Remember that the particle crossed a surface of a cell at some
+    //! universe level (zero without fills) at this position.
+    void setCrossing(const Surface* surface, const TVecDbl& position,
+                     const unsigned int level) {
+        _crossedSurface  = surface;
+        _crossedPosition = position;
+        _crossedLevel    = level;
+    }
+
+    //! The surface that the particle is on at a universe level, if it
+    //! hasn't moved since.
+    const Surface* getCrossedSurface(const TVecDbl& position,
+                                     const unsigned int level) const {
+        if (_crossedSurface != NULL && level == _crossedLevel
+                && position[0] == _crossedPosition[0]
+                && position[1] == _crossedPosition[1]
+                && position[2] == _crossedPosition[2])
+            return _crossedSurface;
+        return NULL;
+    }
+
+private:
+    //! Number of places for surfaces (a power of two)
+    enum { NUM_SLOTS = 32 };
+    //! No cell's senses are recorded
+    static const unsigned int NO_CELL = ~0u;
+
+    //! A surface's sense
+    struct Entry {
+        //! Generation it was recorded in
+        unsigned int generation;
+        //! Surface index, shifted up one bit, with the sense in the lowest
+        unsigned int code;
+    };
+
+    //! Current generation (entries with other stamps are unknown)
+    unsigned int   _generation;
+    //! Senses of the cell's surfaces
+    Entry          _entries[NUM_SLOTS];
+    //! Cell whose senses these are
+    unsigned int   _cellIndex;
+
+    //! Surface that was just crossed
+    const Surface* _crossedSurface;
+    //! Where it was crossed
+    TVecDbl        _crossedPosition;
+    //! Universe level of the cell whose surface it was
+    unsigned int   _crossedLevel;
+};
+
+/*============================================================================*/
+/*!
+ * \struct UniverseLevel
+ * \brief The cell a particle is in at one level of nested universes.
+ *
+ * Level zero is the root universe; each level below it is the universe that
+ * fills the cell of the level above, in its own coordinates. The transform
+ * from global coordinates is worked out once, when the particle enters the
+ * level, and the particle is moved into the universe rather than the
+ * universe's surfaces being moved out to it. Unrotated levels only need a
+ * subtraction, and a rotated level keeps its particle direction until the
+ * direction changes.
+ */
+struct UniverseLevel {
+    //! Blitz++ TinyVector of length D stores position/direction/etc.
+    typedef blitz::TinyVector<double, 3> TVecDbl;
+
+    //! Internal index of the cell at this level.
+    unsigned int cellIndex;
+    //! Where this level's origin is in global coordinates.
+    TVecDbl      origin;
+    //! Lattice element of the level above that this level fills, if any.
+    int          element[3];
+    //! Whether this level's axes are rotated from the global ones.
+    bool         isRotated;
+    //! This level's axes in global coordinates, if it's rotated.
+    TVecDbl      axes[3];
+    //! Global direction that localDirection was last found for.
+    TVecDbl      lastDirection;
+    //! That direction in this level's coordinates.
+    TVecDbl      lastLocalDirection;
+
+    //! Transform a global position into this level's coordinates.
+    TVecDbl localPosition(const TVecDbl& position) const {
+        const TVecDbl relative(position - origin);
+        if (!isRotated)
+            return relative;
+        return TVecDbl(blitz::dot(axes[0], relative),
+                       blitz::dot(axes[1], relative),
+                       blitz::dot(axes[2], relative));
+    }
+
+    //! Transform a global direction into this level's coordinates.
+    const TVecDbl& localDirection(const TVecDbl& direction) {
+        if (!isRotated)
+            return direction;
+        if (!blitz::all(direction == lastDirection)) {
+            lastDirection = direction;
+            for (unsigned int i = 0; i < 3; ++i)
+                lastLocalDirection[i] = blitz::dot(axes[i], direction);
+        }
+        return lastLocalDirection;
+    }
+
+    //! Transform a vector in this level's coordinates into global ones.
+    TVecDbl globalVector(const TVecDbl& vector) const {
+        if (!isRotated)
+            return vector;
+        TVecDbl result(vector[0] * axes[0]);
+        result += vector[1] * axes[1];
+        result += vector[2] * axes[2];
+        return result;
+    }
+};
+
+/*============================================================================*/
+/*!
+ * \struct TrackState
+ * \brief Intersection information carried from findDistance to findNewCell.
+ *
+ * MCGeometry::findDistance() fills this with the cell the particle started
+ * in, the surface it will hit, and how far away that surface is;
+ * MCGeometry::findNewCell(), MCGeometry::reflectDirection() and
+ * MCGeometry::getSurfaceCrossing() read it back.
+ *
+ * Because the caller owns it (one per particle or per thread), a single
+ * MCGeometry can be queried by many particles at once without them
+ * clobbering each other's cached intersection.
+ */
+struct TrackState {
+    //! Blitz++ TinyVector of length D stores position/direction/etc.
+    typedef blitz::TinyVector<double, 3> TVecDbl;
+
+    //! Internal index of the cell the particle is leaving.
+    unsigned int    oldCellIndex;
+    //! Surface that the particle will cross.
+    Surface*        hitSurface;
+    //! Sense of the crossed surface as seen from the old cell.
+    bool            oldSurfaceSense;
+    //! Distance from the starting position to the crossed surface.
+    double          distanceToSurface;
+
+    IfDbc(TVecDbl position; TVecDbl direction;)
+
+    /*!
+     * \brief Cell at every level, from the root universe down.
+     *
+     * This is only used when the geometry has filled cells, in which case
+     * MCGeometry::findCell() with a track state fills it in. The last level
+     * holds the cell that the particle is actually in.
+     */
+    std::vector<UniverseLevel> levels;
+    //! Level whose cell (or lattice element) the particle will leave.
+    unsigned int    crossingLevel;
+    //! Whether it's leaving a lattice element rather than crossing a surface.
+    bool            crossesLatticeWall;
+    //! How the lattice element index changes when it does.
+    int             latticeStep[3];
+
+    /*!
+     * \brief Whether to carry surface senses from cell to cell.
+     *
+     * When a particle crosses into a new cell, the candidate cells look up
+     * the senses of surfaces they share with the old one rather than
+     * evaluate them, and the next distance calculation knows which surface
+     * the particle is sitting on. The cost is storing the senses of the old
+     * cell's quadrics whenever they aren't the ones already stored (cells
+     * of planes store nothing). A lookup costs about as much as evaluating
+     * a cylinder, so the senseTiming example shows this cutting evaluations
+     * by two thirds without speeding up tracking. It is off by default.
+     */
+    bool            trackSenses;
+
+    //! Senses known from the cell the particle is leaving.
+    SurfaceSenses   senses;
+
+    /*!
+     * \brief Whether to track through structured grids by index.
+     *
+     * Box cells that tile a rectilinear grid are found when the geometry is
+     * completed; inside them, the wall a particle hits and the cell beyond
+     * it are found without looking at any other cells. It is on by default,
+     * and only worth turning off to compare against the general tracking.
+     */
+    bool            useStructuredGrids;
+
+    //! Start out without any intersection information.
+    TrackState() :
+        oldCellIndex(0),
+        hitSurface(NULL),
+        oldSurfaceSense(false),
+        distanceToSurface(0.0),
+        crossingLevel(0),
+        crossesLatticeWall(false),
+        trackSenses(false),
+        useStructuredGrids(true)
+    {
+        latticeStep[0] = latticeStep[1] = latticeStep[2] = 0;
+    }
+};
+
+/*============================================================================*/
+} // end namespace mcGeometry
+#endif
@@ -0,0 +1,173 @@
+/*!
+ * \file tBoundingVolumeHierarchy.cpp
+ * \brief Unit tests for BoundingVolumeHierarchy
+ * \author Seth R. Johnson
+ */
+
+/*----------------------------------------------------------------------------*/
+
+#include "mcgeometry/BoundingVolumeHierarchy.hpp"
+
+#include <iostream>
+#include <vector>
+#include <limits>
+#include <cstdlib>
+#include "transupport/dbc.hpp"
+#include "transupport/UnitTester.hpp"
+
+using namespace mcGeometry;
+
+using std::cout;
+using std::endl;
+
+typedef blitz::TinyVector<double, 3> TVecDbl;
+typedef std::vector<TVecDbl> TVecDblVec;
+
+//! Record every box we are asked about, and never accept any
+class RecordVisits {
+public:
+    RecordVisits(std::vector<bool>& visited) : _visited(visited)
+    { /* * */ }
+
+    bool operator()(const unsigned int index) const {
+        _visited[index] = true;
+        return false;
+    }
+private:
+    std::vector<bool>& _visited;
+};
+
+//! Accept only one box
+class AcceptOnly {
+public:
+    AcceptOnly(const unsigned int index) : _index(index)
+    { /* * */ }
+
+    bool operator()(const unsigned int index) const {
+        return (index == _index);
+    }
+private:
+    const unsigned int _index;
+};
+
+//! Uniform random number in [low, high)
+double randomBetween(const double low, const double high) {
+    return low + (high - low) * (std::rand() / (RAND_MAX + 1.0));
+}
+
+bool contains(const TVecDbl& lower, const TVecDbl& upper, const TVecDbl& p) {
+    for (int d = 0; d < 3; ++d) {
+        if (p[d] < lower[d] || p[d] > upper[d])
+            return false;
+    }
+    return true;
+}
+
+/*============================================================================*/
+void testEmpty() {
+    BoundingVolumeHierarchy theTree;
+    TESTER_CHECKFORPASS(theTree.empty());
+
+    theTree.build(TVecDblVec(), TVecDblVec());
+    TESTER_CHECKFORPASS(theTree.empty());
+
+    unsigned int index = 123;
+    TESTER_CHECKFORPASS(
+            !theTree.findFirst(TVecDbl(0.0), AcceptOnly(0), index));
+    TESTER_CHECKFORPASS(index == 123);
+}
+
+/*============================================================================*/
+void testRandomBoxes() {
+    const unsigned int numBoxes  = 500;
+    const unsigned int numPoints = 500;
+    const double inf = std::numeric_limits<double>::infinity();
+
+    std::srand(1234);
+
+    TVecDblVec lower(numBoxes);
+    TVecDblVec upper(numBoxes);
+
+    for (unsigned int i = 0; i < numBoxes; ++i) {
+        for (int d = 0; d < 3; ++d) {
+            lower[i][d] = randomBetween(-10.0, 10.0);
+            upper[i][d] = lower[i][d] + randomBetween(0.0, 2.0);
+        }
+    }
+
+    // a few boxes that are unbounded in some direction
+    lower[7][0]  = -inf;
+    upper[19][2] =  inf;
+    lower[42]    = -inf;
+    upper[42]    =  inf;
+
+    BoundingVolumeHierarchy theTree;
+    theTree.build(lower, upper);
+
+    TESTER_CHECKFORPASS(!theTree.empty());
+    TESTER_CHECKFORPASS(theTree.getNumNodes() > 1);
+
+    // every box containing a point gets visited, and no others
+    bool allVisitsCorrect = true;
+    bool allFirstsCorrect = true;
+
+    for (unsigned int p = 0; p < numPoints; ++p) {
+        TVecDbl point;
+        for (int d = 0; d < 3; ++d)
+            point[d] = randomBetween(-11.0, 11.0);
+
+        std::vector<bool> visited(numBoxes, false);
+        unsigned int index = 0;
+
+        if (theTree.findFirst(point, RecordVisits(visited), index))
+            allVisitsCorrect = false;
+
+        int lastContaining = -1;
+        for (unsigned int i = 0; i < numBoxes; ++i) {
+            const bool isInside = contains(lower[i], upper[i], point);
+            if (isInside != visited[i])
+                allVisitsCorrect = false;
+            if (isInside)
+                lastContaining = i;
+        }
+
+        // searching for one particular box finds it
+        if (lastContaining >= 0) {
+            if (!theTree.findFirst(point, AcceptOnly(lastContaining), index)
+                    || index != static_cast<unsigned int>(lastContaining))
+            {
+                allFirstsCorrect = false;
+            }
+        }
+    }
+
+    TESTER_CHECKFORPASS(allVisitsCorrect);
+    TESTER_CHECKFORPASS(allFirstsCorrect);
+
+    // points exactly on faces are inside
+    unsigned int index = 0;
+    TESTER_CHECKFORPASS(theTree.findFirst(lower[3], AcceptOnly(3), index));
+    TESTER_CHECKFORPASS(theTree.findFirst(upper[3], AcceptOnly(3), index));
+}
+
+/*============================================================================*/
+int main(int, char**) {
+    TESTER_INIT("BoundingVolumeHierarchy");
+    try {
+        testEmpty();
+        testRandomBoxes();
+    }
+    catch (tranSupport::tranError &theErr) {
+        cout << "UNEXPECTED ERROR IN UNIT TEST: " << endl
+            << theErr.what() << endl;
+        TESTER_CHECKFORPASS(CAUGHT_UNEXPECTED_EXCEPTION);
+    }
+
+    TESTER_PRINTRESULT();
+
+    if (!TESTER_HASPASSED()) {
+        return 1;
+    }
+
+    return 0;
+}
@@ -9,11 +9,20 @@
 #include "mcgeometry/Cell.hpp"
 #include "mcgeometry/Plane.hpp"
 #include "mcgeometry/Sphere.hpp"
+#include "mcgeometry/PlaneNormal.hpp"
+#include "mcgeometry/Cylinder.hpp"
+#include "mcgeometry/CylinderNormal.hpp"
+#include "mcgeometry/GeometryCounters.hpp"
 
 #include <iostream>
 #include <vector>
 #include <utility>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <cstdlib>
 #include "transupport/dbc.hpp"
+#include "transupport/constants.hpp"
 #include "transupport/UnitTester.hpp"
 #include "transupport/SoftEquiv.hpp"
 
@@ -21,6 +30,7 @@ using namespace mcGeometry;
 
 using std::cout;
 using std::endl;
+using tranSupport::constants::SQRTHALF;
 
 typedef blitz::TinyVector<double, 3> TVecDbl;
 
@@ -51,8 +61,7 @@ void runTests() {
 
 
     /* * * create the cell * * */
-    Cell theCell(cellBoundaries, 211, 1);
-    TESTER_CHECKFORPASS(theCell.getUserId() == 211);
+    Cell theCell(cellBoundaries, 1);
     TESTER_CHECKFORPASS(theCell.getIndex() == 1);
     TESTER_CHECKFORPASS(theCell.isDeadCell() == false);
 
@@ -112,8 +121,7 @@ void runTests() {
     cellBoundaries.push_back(std::make_pair(&thePlane,  false));
 
     /* * * create the cell * * */
-    Cell invCell(cellBoundaries, 1337, 3, invFlags);
-    TESTER_CHECKFORPASS(invCell.getUserId() == 1337);
+    Cell invCell(cellBoundaries, 3, invFlags);
     TESTER_CHECKFORPASS(invCell.getIndex() == 3);
     TESTER_CHECKFORPASS(invCell.isDeadCell() == true);
     TESTER_CHECKFORPASS(invCell.isNegated() == true);
@@ -132,11 +140,450 @@ void runTests() {
     TESTER_CHECKFORPASS(invCell.isPointInside(particleLoc) == true);
 }
 
+/*============================================================================*/
+void testBoundingBox() {
+    const double inf = std::numeric_limits<double>::infinity();
+
+    TVecDbl center(0.0);
+    Sphere    theSphere(center, 2.0);
+    PlaneX    thePlane(1.0);
+    Plane     slantedPlane(TVecDbl(SQRTHALF, SQRTHALF, 0.0), center);
+
+    center = 0.5, 0.0, 0.0;
+    CylinderZ theCylinder(center, 1.0);
+
+    TVecDbl lower;
+    TVecDbl upper;
+
+    // inside sphere to the right of plane
+    Cell::SASVec cellBoundaries;
+    cellBoundaries.push_back(std::make_pair(&theSphere, false));
+    cellBoundaries.push_back(std::make_pair(&thePlane,  true));
+
+    Cell sphereCell(cellBoundaries, 0);
+    sphereCell.getBoundingBox(lower, upper);
+
+    TESTER_CHECKFORPASS(softEquiv(lower, TVecDbl( 1.0, -2.0, -2.0)));
+    TESTER_CHECKFORPASS(softEquiv(upper, TVecDbl( 2.0,  2.0,  2.0)));
+
+    // inside cylinder to the left of plane; unbounded along the axis
+    cellBoundaries.resize(0);
+    cellBoundaries.push_back(std::make_pair(&theCylinder, false));
+    cellBoundaries.push_back(std::make_pair(&thePlane,    false));
+
+    Cell cylinderCell(cellBoundaries, 1);
+    cylinderCell.getBoundingBox(lower, upper);
+
+    TESTER_CHECKFORPASS(softEquiv(lower[0], -0.5));
+    TESTER_CHECKFORPASS(softEquiv(lower[1], -1.0));
+    TESTER_CHECKFORPASS(lower[2] == -inf);
+    TESTER_CHECKFORPASS(softEquiv(upper[0],  1.0));
+    TESTER_CHECKFORPASS(softEquiv(upper[1],  1.0));
+    TESTER_CHECKFORPASS(upper[2] ==  inf);
+
+    // general planes don't clip, which is still conservative
+    cellBoundaries.resize(0);
+    cellBoundaries.push_back(std::make_pair(&slantedPlane, true));
+
+    Cell halfSpaceCell(cellBoundaries, 2);
+    halfSpaceCell.getBoundingBox(lower, upper);
+
+    TESTER_CHECKFORPASS(lower[0] == -inf);
+    TESTER_CHECKFORPASS(upper[0] ==  inf);
+
+    // negated cells are unbounded
+    cellBoundaries.resize(0);
+    cellBoundaries.push_back(std::make_pair(&theSphere, false));
+
+    Cell outsideCell(cellBoundaries, 3, Cell::NEGATED);
+    outsideCell.getBoundingBox(lower, upper);
+
+    TESTER_CHECKFORPASS(lower[1] == -inf);
+    TESTER_CHECKFORPASS(upper[1] ==  inf);
+}
+
+/*============================================================================*/
+//! Nearest surface by asking each surface in turn
+void intersectEachSurface(
+        const Cell::SASVec& boundaries,
+        const TVecDbl& position,
+        const TVecDbl& direction,
+        const Surface*& hitSurface,
+        double& distance)
+{
+    hitSurface = NULL;
+    distance   = std::numeric_limits<double>::infinity();
+
+    for (Cell::SASVec::const_iterator it  = boundaries.begin();
+                                      it != boundaries.end(); ++it)
+    {
+        bool   thisHit;
+        double thisDistance;
+        it->first->intersect(position, direction, it->second,
+                             thisHit, thisDistance);
+        if (thisHit && thisDistance < distance) {
+            distance   = thisDistance;
+            hitSurface = it->first;
+        }
+    }
+}
+
+//! Whether a limited intersection finds the nearest surface only if in reach
+bool limitMatches(
+        const Cell& cell,
+        const TVecDbl& position,
+        const TVecDbl& direction,
+        const Surface* hitSurface,
+        const double expectedDistance,
+        const double maxDistance)
+{
+    Surface* foundSurface;
+    bool     hitSense;
+    double   distance;
+
+    cell.intersect(position, direction, foundSurface, hitSense, distance,
+                   maxDistance);
+
+    if (expectedDistance <= maxDistance)
+        return (foundSurface == hitSurface && distance == expectedDistance);
+
+    return (foundSurface == NULL
+            && distance == std::numeric_limits<double>::infinity());
+}
+
+//! Whether a point is inside by asking each surface in turn
+bool insideEachSurface(
+        const Cell::SASVec& boundaries,
+        const TVecDbl& position,
+        const Surface* surfaceToSkip,
+        const bool isNegated)
+{
+    for (Cell::SASVec::const_iterator it  = boundaries.begin();
+                                      it != boundaries.end(); ++it)
+    {
+        // a negated cell contains whatever is across the skipped surface
+        if (it->first == surfaceToSkip) {
+            if (isNegated)
+                return true;
+            continue;
+        }
+        if (it->first->hasPosSense(position) != it->second)
+            return isNegated;
+    }
+    return !isNegated;
+}
+
+//! Safety distance by asking each surface in turn
+double safetyEachSurface(
+        const Cell::SASVec& boundaries,
+        const TVecDbl& position)
+{
+    double safety = std::numeric_limits<double>::infinity();
+
+    for (Cell::SASVec::const_iterator it  = boundaries.begin();
+                                      it != boundaries.end(); ++it)
+    {
+        safety = std::min(safety, it->first->safetyDistance(position));
+    }
+    return safety;
+}
+
+//! Whether a cell's safety distance is right and no farther than a surface
+bool safetyMatches(
+        const Cell& cell,
+        const Cell::SASVec& boundaries,
+        const TVecDbl& position,
+        const double distance)
+{
+    const double safety = cell.safetyDistance(position);
+
+    if (safety != safetyEachSurface(boundaries, position))
+        return false;
+
+    // from inside, the surface we hit is at least as far as the nearest one
+    return (!cell.isPointInside(position)
+            || safety <= distance * (1 + 1e-12));
+}
+
+/*============================================================================*/
+void testPlaneCell() {
+    PlaneX lowX(-1.0);
+    PlaneX highX(1.0);
+    PlaneY lowY(-1.0);
+    PlaneY highY(1.0);
+    PlaneZ lowZ(-1.0);
+    PlaneZ highZ(1.0);
+    Plane  corner(TVecDbl(SQRTHALF, SQRTHALF, 0.0), TVecDbl(0.5, 0.5, 0.0));
+
+    // a cube with one corner cut off
+    Cell::SASVec cellBoundaries;
+    cellBoundaries.push_back(std::make_pair(&lowX,   true));
+    cellBoundaries.push_back(std::make_pair(&highX,  false));
+    cellBoundaries.push_back(std::make_pair(&lowY,   true));
+    cellBoundaries.push_back(std::make_pair(&highY,  false));
+    cellBoundaries.push_back(std::make_pair(&lowZ,   true));
+    cellBoundaries.push_back(std::make_pair(&highZ,  false));
+    cellBoundaries.push_back(std::make_pair(&corner, false));
+
+    Cell planeCell(cellBoundaries, 0);
+    Cell negatedCell(cellBoundaries, 1, Cell::NEGATED);
+
+    // surfaces we crossed get skipped
+    TVecDbl position(1.0, -0.5, 0.0);
+    TESTER_CHECKFORPASS(planeCell.isPointInside(position, &highX));
+    TESTER_CHECKFORPASS(negatedCell.isPointInside(position, &highX));
+
+    position = 1.5, 0.0, 0.0;
+    TESTER_CHECKFORPASS(!planeCell.isPointInside(position, &highY));
+    TESTER_CHECKFORPASS(negatedCell.isPointInside(position, &highY));
+
+    // particles in a corner or on a face
+    const Surface* hitSurface;
+    bool   hitSense;
+    double distance;
+    Surface* foundSurface;
+
+    position = 1.0, 1.0, 1.0;
+    planeCell.intersect(position, TVecDbl(1.0, 0.0, 0.0),
+                        foundSurface, hitSense, distance);
+    TESTER_CHECKFORPASS(foundSurface == &highX);
+    TESTER_CHECKFORPASS(distance == 0.0);
+
+    position = 0.0, 0.0, 0.0;
+    planeCell.intersect(position, TVecDbl(SQRTHALF, SQRTHALF, 0.0),
+                        foundSurface, hitSense, distance);
+    TESTER_CHECKFORPASS(foundSurface == &corner);
+    TESTER_CHECKFORPASS(hitSense == false);
+
+    // everything agrees exactly with asking each surface
+    std::srand(2468);
+    bool intersectMatches = true;
+    bool insideMatches    = true;
+    bool safetyAgrees     = true;
+    bool limitAgrees      = true;
+
+    for (int i = 0; i < 1000; ++i) {
+        TVecDbl direction;
+        for (int d = 0; d < 3; ++d) {
+            position[d]  = 3.0 * (std::rand() / (RAND_MAX + 1.0)) - 1.5;
+            direction[d] = std::rand() / (RAND_MAX + 1.0) - 0.5;
+        }
+        direction /= std::sqrt(blitz::dot(direction, direction));
+
+        double expectedDistance;
+        planeCell.intersect(position, direction, foundSurface, hitSense,
+                            distance);
+        intersectEachSurface(cellBoundaries, position, direction,
+                             hitSurface, expectedDistance);
+
+        if (foundSurface != hitSurface || distance != expectedDistance)
+            intersectMatches = false;
+
+        if (!safetyMatches(planeCell, cellBoundaries, position, distance))
+            safetyAgrees = false;
+
+        if (!limitMatches(planeCell, position, direction, hitSurface,
+                          expectedDistance, 0.5 * (i % 5)))
+            limitAgrees = false;
+
+        const Surface* surfaceToSkip = cellBoundaries[i % 7].first;
+        if (planeCell.isPointInside(position)
+                != insideEachSurface(cellBoundaries, position, NULL, false)
+         || planeCell.isPointInside(position, surfaceToSkip)
+                != insideEachSurface(cellBoundaries, position, surfaceToSkip,
+                                     false)
+         || negatedCell.isPointInside(position, surfaceToSkip)
+                != insideEachSurface(cellBoundaries, position, surfaceToSkip,
+                                     true))
+        {
+            insideMatches = false;
+        }
+    }
+
+    TESTER_CHECKFORPASS(intersectMatches);
+    TESTER_CHECKFORPASS(insideMatches);
+    TESTER_CHECKFORPASS(safetyAgrees);
+    TESTER_CHECKFORPASS(limitAgrees);
+}
+
+/*============================================================================*/
+void testMixedCell() {
+    TVecDbl point(0.25, -0.5, 0.125);
+    TVecDbl axis(0.0, 0.6, 0.8);
+
+    Plane     slantedPlane(axis, point);
+    PlaneX    planeX(0.1);
+    PlaneY    planeY(-0.2);
+    PlaneZ    planeZ(0.3);
+    Sphere    sphere(point, 1.5);
+    SphereO   outerSphere(4.0);
+    Cylinder  cylinder(point, axis, 0.75);
+    CylinderX cylinderX(point, 1.5);
+    CylinderY cylinderY(point, 1.75);
+    CylinderZ cylinderZ(point, 1.0);
+
+    // every kind of surface, closed off by a sphere so everything hits
+    Cell::SASVec cellBoundaries;
+    cellBoundaries.push_back(std::make_pair(&slantedPlane, true));
+    cellBoundaries.push_back(std::make_pair(&planeX,       false));
+    cellBoundaries.push_back(std::make_pair(&planeY,       true));
+    cellBoundaries.push_back(std::make_pair(&planeZ,       false));
+    cellBoundaries.push_back(std::make_pair(&sphere,       true));
+    cellBoundaries.push_back(std::make_pair(&outerSphere,  false));
+    cellBoundaries.push_back(std::make_pair(&cylinder,     true));
+    cellBoundaries.push_back(std::make_pair(&cylinderX,    false));
+    cellBoundaries.push_back(std::make_pair(&cylinderY,    true));
+    cellBoundaries.push_back(std::make_pair(&cylinderZ,    false));
+
+    Cell mixedCell(cellBoundaries, 0);
+    Cell negatedCell(cellBoundaries, 1, Cell::NEGATED);
+
+    std::srand(1357);
+    bool intersectMatches = true;
+    bool insideMatches    = true;
+    bool safetyAgrees     = true;
+    bool limitAgrees      = true;
+
+    for (int i = 0; i < 2000; ++i) {
+        TVecDbl position;
+        TVecDbl direction;
+        for (int d = 0; d < 3; ++d) {
+            position[d]  = 4.0 * (std::rand() / (RAND_MAX + 1.0)) - 2.0;
+            direction[d] = std::rand() / (RAND_MAX + 1.0) - 0.5;
+        }
+        direction /= std::sqrt(blitz::dot(direction, direction));
+
+        Surface*       foundSurface;
+        const Surface* hitSurface;
+        bool   hitSense;
+        double distance;
+        double expectedDistance;
+
+        mixedCell.intersect(position, direction, foundSurface, hitSense,
+                            distance);
+        intersectEachSurface(cellBoundaries, position, direction,
+                             hitSurface, expectedDistance);
+
+        if (foundSurface != hitSurface || distance != expectedDistance)
+            intersectMatches = false;
+
+        if (!safetyMatches(mixedCell, cellBoundaries, position, distance))
+            safetyAgrees = false;
+
+        if (!limitMatches(mixedCell, position, direction, hitSurface,
+                          expectedDistance, 0.5 * (i % 5)))
+            limitAgrees = false;
+
+        const Surface* surfaceToSkip = cellBoundaries[i % 10].first;
+        if (mixedCell.isPointInside(position)
+                != insideEachSurface(cellBoundaries, position, NULL, false)
+         || mixedCell.isPointInside(position, surfaceToSkip)
+                != insideEachSurface(cellBoundaries, position, surfaceToSkip,
+                                     false)
+         || negatedCell.isPointInside(position, surfaceToSkip)
+                != insideEachSurface(cellBoundaries, position, surfaceToSkip,
+                                     true))
+        {
+            insideMatches = false;
+        }
+    }
+
+    TESTER_CHECKFORPASS(intersectMatches);
+    TESTER_CHECKFORPASS(insideMatches);
+    TESTER_CHECKFORPASS(safetyAgrees);
+    TESTER_CHECKFORPASS(limitAgrees);
+}
+
+/*============================================================================*/
+//! Total senses evaluated by this thread so far
+GeometryCounters::Count countSenseEvaluations() {
+    const GeometryCounters& counters = GeometryCounters::getThreadCounters();
+
+    GeometryCounters::Count total = 0;
+    for (unsigned int t = 0; t < Surface::NUM_SURFACE_TYPES; ++t)
+        total += counters.senseEvaluations[t];
+    return total;
+}
+
+void testSortedChecks() {
+    TVecDbl point(0.25, -0.5, 0.125);
+    TVecDbl axis(0.0, 0.6, 0.8);
+
+    Sphere    sphere(point, 1.5);
+    Cylinder  cylinder(point, axis, 0.75);
+    PlaneY    planeY(-0.2);
+    PlaneX    planeX(0.1);
+
+    // the plane that rejects most points is checked last
+    Cell::SASVec cellBoundaries;
+    cellBoundaries.push_back(std::make_pair(&sphere,   false));
+    cellBoundaries.push_back(std::make_pair(&cylinder, false));
+    cellBoundaries.push_back(std::make_pair(&planeY,   true));
+    cellBoundaries.push_back(std::make_pair(&planeX,   false));
+
+    Cell sortedCell(cellBoundaries, 0);
+    Cell negatedCell(cellBoundaries, 1, Cell::NEGATED);
+
+    std::vector<TVecDbl> positions(1000);
+    std::srand(2468);
+    for (unsigned int i = 0; i < positions.size(); ++i) {
+        positions[i][0] = 4.0 * (std::rand() / (RAND_MAX + 1.0)) - 0.5;
+        positions[i][1] = 2.0 * (std::rand() / (RAND_MAX + 1.0)) - 1.5;
+        positions[i][2] = 2.0 * (std::rand() / (RAND_MAX + 1.0)) - 1.0;
+    }
+
+    // evaluate every point before, during, and after profiling
+    GeometryCounters::Count numEvaluated[3];
+    bool insideMatches = true;
+
+    for (int pass = 0; pass < 3; ++pass) {
+        if (pass == 1) {
+            sortedCell.startCheckProfile();
+            negatedCell.startCheckProfile();
+        }
+
+        const GeometryCounters::Count startCount = countSenseEvaluations();
+
+        for (unsigned int i = 0; i < positions.size(); ++i) {
+            const Surface* surfaceToSkip = cellBoundaries[i % 4].first;
+            if (sortedCell.isPointInside(positions[i])
+                    != insideEachSurface(cellBoundaries, positions[i], NULL,
+                                         false)
+             || negatedCell.isPointInside(positions[i], surfaceToSkip)
+                    != insideEachSurface(cellBoundaries, positions[i],
+                                         surfaceToSkip, true))
+            {
+                insideMatches = false;
+            }
+        }
+
+        numEvaluated[pass] = countSenseEvaluations() - startCount;
+
+        if (pass == 1) {
+            sortedCell.sortSurfaceChecks();
+            negatedCell.sortSurfaceChecks();
+        }
+    }
+
+    TESTER_CHECKFORPASS(insideMatches);
+
+    if (GeometryCounters::isEnabled()) {
+        TESTER_CHECKFORPASS(numEvaluated[1] == numEvaluated[0]);
+        TESTER_CHECKFORPASS(numEvaluated[2] < numEvaluated[0]);
+        cout << "Senses evaluated before sorting: " << numEvaluated[0]
+             << "; after: " << numEvaluated[2] << endl;
+    }
+}
+
 /*============================================================================*/
 int main(int, char**) {
    TESTER_INIT("Cell");
    try {
       runTests();
+      testBoundingBox();
+      testPlaneCell();
+      testMixedCell();
+      testSortedChecks();
    }
    catch (tranSupport::tranError &theErr) {
       cout << "UNEXPECTED ERROR IN UNIT TEST: " << endl
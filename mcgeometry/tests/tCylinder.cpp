@@ -102,6 +102,12 @@ void runTestA() {
 
     TESTER_CHECKFORPASS(didHit == false);
     /********************/
+    // distance to the nearest point on the cylinder, from inside and outside
+    TESTER_CHECKFORPASS(softEquiv(
+            theCylinder.safetyDistance(TVecDbl(0.0, 1.0, 0.5)), 2.5));
+    TESTER_CHECKFORPASS(softEquiv(
+            theCylinder.safetyDistance(TVecDbl(7.0, 1.0, 4.0)), 1.0));
+    /********************/
     Surface* newCyl = theCylinder.clone(182);
 
     TESTER_CHECKFORPASS(newCyl->getUserId() == 182);
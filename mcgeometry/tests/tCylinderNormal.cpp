@@ -51,6 +51,12 @@ void runTestZ() {
     TESTER_CHECKFORPASS(didHit == true);
     TESTER_CHECKFORPASS(softEquiv(distance, 2.598076211353316));
 
+    // the distance to the nearest point ignores our position along the axis
+    TESTER_CHECKFORPASS(
+            softEquiv(theCylinder.safetyDistance(particleLoc), 1.5));
+    TESTER_CHECKFORPASS(softEquiv(
+            theCylinder.safetyDistance(TVecDbl(1.0, -5.0, 7.0)), 2.0));
+
     /********************/
     particleLoc = 0, -2, 0.5;
 
@@ -116,10 +122,30 @@ void runTestZ() {
 
 }
 /*============================================================================*/
+void testClone() {
+    // a cylinder whose axis is well away from the origin
+    CylinderY theCylinder(TVecDbl(5.0, 0.0, -4.0), 1.0);
+    Surface* copy = theCylinder.clone(12);
+
+    TESTER_CHECKFORPASS(copy->getUserId() == 12);
+
+    // the copy is centered on the same axis
+    TESTER_CHECKFORPASS(copy->hasPosSense(TVecDbl(5.5, 3.0, -4.0)) == false);
+    TESTER_CHECKFORPASS(copy->hasPosSense(TVecDbl(0.0, 0.0, 0.0)) == true);
+
+    double parameters[Surface::MAX_PARAMETERS];
+    copy->getParameters(parameters);
+    TESTER_CHECKFORPASS(parameters[0] == 5.0 && parameters[2] == -4.0);
+    TESTER_CHECKFORPASS(parameters[3] == 1.0);
+
+    delete copy;
+}
+/*============================================================================*/
 int main(int, char**) {
     TESTER_INIT("CylinderNormal");
     try {
         runTestZ();
+        testClone();
     }
     catch (tranSupport::tranError &theErr) {
         cout << "UNEXPECTED ERROR IN UNIT TEST: " << endl
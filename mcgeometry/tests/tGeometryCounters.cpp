@@ -0,0 +1,212 @@
+/*!
+ * \file tGeometryCounters.cpp
+ * \brief Unit tests for GeometryCounters
+ * \author Seth R. Johnson
+ */
+
+/*----------------------------------------------------------------------------*/
+
+#include "mcgeometry/GeometryCounters.hpp"
+#include "mcgeometry/MCGeometry.hpp"
+#include "mcgeometry/PlaneNormal.hpp"
+#include "mcgeometry/Sphere.hpp"
+
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include "transupport/dbc.hpp"
+#include "transupport/UnitTester.hpp"
+#include "transupport/SoftEquiv.hpp"
+
+using namespace mcGeometry;
+
+using std::cout;
+using std::endl;
+
+typedef blitz::TinyVector<double, 3> TVecDbl;
+typedef std::vector<signed int> intVec;
+
+/*============================================================================*/
+void testMerge() {
+    GeometryCounters total;
+    total.clear();
+    TESTER_CHECKFORPASS(total.getNumCrossings() == 0);
+    TESTER_CHECKFORPASS(total.perCrossing(10) == 0.0);
+
+    GeometryCounters counts;
+    counts.clear();
+    counts.resolutions[GeometryCounters::IN_NEIGHBORHOOD] = 3;
+    counts.lost = 1;
+    counts.pointInsideCalls = 6;
+    counts.senseEvaluations[Surface::SPHERE] = 2;
+
+    total.merge(counts);
+    total.merge(counts);
+
+    TESTER_CHECKFORPASS(
+            total.resolutions[GeometryCounters::IN_NEIGHBORHOOD] == 6);
+    TESTER_CHECKFORPASS(total.getNumCrossings() == 8);
+    TESTER_CHECKFORPASS(softEquiv(total.perCrossing(total.pointInsideCalls),
+                                  1.5));
+    TESTER_CHECKFORPASS(total.senseEvaluations[Surface::SPHERE] == 4);
+    TESTER_CHECKFORPASS(total.intersections[Surface::SPHERE] == 0);
+
+    std::ostringstream os;
+    total.print(os);
+    TESTER_CHECKFORPASS(os.str().find("neighborhood") != std::string::npos);
+    TESTER_CHECKFORPASS(os.str().find("Sphere") != std::string::npos);
+
+    total.clear();
+    TESTER_CHECKFORPASS(total.getNumCrossings() == 0);
+    TESTER_CHECKFORPASS(total.pointInsideCalls == 0);
+}
+
+/*============================================================================*/
+void testTracking() {
+    // left and right halves of a sphere, with the lower right bounded by a
+    // duplicate of the plane between them, so crossing into it from the left
+    // needs a global search the first time
+    MCGeometry theGeom;
+
+    TVecDbl center(0.0);
+    theGeom.addSurface(1, PlaneX(0.0));
+    theGeom.addSurface(2, PlaneY(0.0));
+    theGeom.addSurface(3, PlaneX(0.0));
+    theGeom.addSurface(5, Sphere(center, 3.0));
+
+    intVec theSurfaces(2);
+    theSurfaces[0] = -5;
+    theSurfaces[1] = -1;
+    theGeom.addCell(10, theSurfaces);
+
+    theSurfaces.resize(3);
+    theSurfaces[1] =  1;
+    theSurfaces[2] =  2;
+    theGeom.addCell(20, theSurfaces);
+
+    theSurfaces[1] =  3;
+    theSurfaces[2] = -2;
+    theGeom.addCell(30, theSurfaces);
+
+    theSurfaces.resize(1);
+    theGeom.addCell(40, theSurfaces,
+                    Cell::generateFlags(true, true));
+
+    GeometryCounters& counters = GeometryCounters::getThreadCounters();
+    counters.clear();
+
+    TVecDbl position(-0.5, -0.5, 0.0);
+    TVecDbl direction(1.0, 0.0, 0.0);
+    TVecDbl newPosition;
+    unsigned int newCellIndex;
+    double distance;
+    MCGeometry::ReturnStatus returnStatus;
+
+    for (int i = 0; i < 2; ++i) {
+        theGeom.findNewCell(position, direction, 0, newPosition,
+                            newCellIndex, distance, returnStatus);
+        TESTER_CHECKFORPASS(theGeom.getUserIdFromCellIndex(newCellIndex)
+                                == 30);
+    }
+
+    if (!GeometryCounters::isEnabled()) {
+        TESTER_CHECKFORPASS(counters.getNumCrossings() == 0);
+        TESTER_CHECKFORPASS(counters.pointInsideCalls == 0);
+        return;
+    }
+
+    // the first crossing searched, and the second found what it learned
+    TESTER_CHECKFORPASS(counters.getNumCrossings() == 2);
+    TESTER_CHECKFORPASS(
+            counters.resolutions[GeometryCounters::BY_GLOBAL_SEARCH] == 1);
+    TESTER_CHECKFORPASS(
+            counters.resolutions[GeometryCounters::IN_NEIGHBORHOOD] == 1);
+    TESTER_CHECKFORPASS(counters.lost == 0 && counters.bumps == 0);
+
+    // one distance to each of the left cell's surfaces per crossing
+    TESTER_CHECKFORPASS(counters.intersections[Surface::SPHERE] == 2);
+    TESTER_CHECKFORPASS(counters.intersections[Surface::PLANE_X] == 2);
+    TESTER_CHECKFORPASS(counters.pointInsideCalls > 2);
+    TESTER_CHECKFORPASS(counters.senseEvaluations[Surface::SPHERE] > 0);
+
+    counters.print(cout);
+}
+
+/*============================================================================*/
+//! Count one crossing on whatever thread this runs on, and save the counts
+void countOneCrossing(GeometryCounters* threadCounts) {
+    MCGeometry theGeom;
+
+    TVecDbl center(0.0);
+    theGeom.addSurface(1, PlaneX(0.0));
+    theGeom.addSurface(5, Sphere(center, 3.0));
+
+    intVec theSurfaces(2);
+    theSurfaces[0] = -5;
+    theSurfaces[1] = -1;
+    theGeom.addCell(10, theSurfaces);
+    theSurfaces[1] =  1;
+    theGeom.addCell(20, theSurfaces);
+    theSurfaces.resize(1);
+    theSurfaces[0] =  5;
+    theGeom.addCell(30, theSurfaces, Cell::generateFlags(true, false));
+
+    TVecDbl newPosition;
+    unsigned int newCellIndex;
+    double distance;
+    MCGeometry::ReturnStatus returnStatus;
+
+    theGeom.findNewCell(TVecDbl(-0.5, 0.0, 0.0), TVecDbl(1.0, 0.0, 0.0), 0,
+                        newPosition, newCellIndex, distance, returnStatus);
+
+    *threadCounts = GeometryCounters::getThreadCounters();
+}
+
+void testOtherThreads() {
+    GeometryCounters& counters = GeometryCounters::getThreadCounters();
+    counters.clear();
+
+    // threads we start ourselves count separately from this one
+    GeometryCounters first;
+    GeometryCounters second;
+    std::thread firstThread(countOneCrossing, &first);
+    std::thread secondThread(countOneCrossing, &second);
+    firstThread.join();
+    secondThread.join();
+
+    TESTER_CHECKFORPASS(counters.getNumCrossings() == 0);
+
+    const GeometryCounters::Count expected
+        = (GeometryCounters::isEnabled() ? 1 : 0);
+    TESTER_CHECKFORPASS(first.getNumCrossings() == expected);
+    TESTER_CHECKFORPASS(second.getNumCrossings() == expected);
+
+    counters.merge(first);
+    counters.merge(second);
+    TESTER_CHECKFORPASS(counters.getNumCrossings() == 2 * expected);
+    counters.clear();
+}
+
+/*============================================================================*/
+int main(int, char**) {
+    TESTER_INIT("GeometryCounters");
+    try {
+        testMerge();
+        testTracking();
+        testOtherThreads();
+    }
+    catch (tranSupport::tranError &theErr) {
+        cout << "UNEXPECTED ERROR IN UNIT TEST: " << endl
+            << theErr.what() << endl;
+        TESTER_CHECKFORPASS(CAUGHT_UNEXPECTED_EXCEPTION);
+    }
+
+    TESTER_PRINTRESULT();
+
+    if (!TESTER_HASPASSED()) {
+        return 1;
+    }
+
+    return 0;
+}
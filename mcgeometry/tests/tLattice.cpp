@@ -0,0 +1,156 @@
+/*!
+ * \file tLattice.cpp
+ * \brief Unit tests for Lattice
+ * \author Seth R. Johnson
+ */
+
+/*----------------------------------------------------------------------------*/
+
+#include "mcgeometry/Lattice.hpp"
+
+#include <iostream>
+#include <vector>
+#include <limits>
+#include "transupport/dbc.hpp"
+#include "transupport/UnitTester.hpp"
+#include "transupport/SoftEquiv.hpp"
+
+using namespace mcGeometry;
+
+using std::cout;
+using std::endl;
+
+typedef Lattice::TVecDbl TVecDbl;
+
+//! Universes numbered by their entry in the lattice
+std::vector<unsigned int> makeUniverses(const unsigned int numEntries) {
+    std::vector<unsigned int> universes(numEntries);
+    for (unsigned int i = 0; i < numEntries; ++i)
+        universes[i] = i;
+    return universes;
+}
+
+/*============================================================================*/
+void testRectangular() {
+    // 3 by 2 by 1 boxes of 1 by 2 by 3
+    const unsigned int numElements[3] = {3, 2, 1};
+    Lattice lattice(TVecDbl(0.0, 0.0, 0.0), TVecDbl(1.0, 2.0, 3.0),
+                    numElements, makeUniverses(6));
+
+    TESTER_CHECKFORPASS(lattice.getType() == Lattice::RECTANGULAR);
+
+    int element[3];
+    TESTER_CHECKFORPASS(lattice.findElement(TVecDbl(2.5, 3.0, 1.0), element));
+    TESTER_CHECKFORPASS(element[0] == 2 && element[1] == 1 && element[2] == 0);
+    TESTER_CHECKFORPASS(lattice.getUniverse(element) == 5);
+
+    const TVecDbl center = lattice.getCenter(element);
+    TESTER_CHECKFORPASS(center[0] == 2.5 && center[1] == 3.0
+                        && center[2] == 1.5);
+
+    // points outside go in the nearest edge element
+    TESTER_CHECKFORPASS(lattice.findElement(TVecDbl(-1.0, 10.0, 5.0),
+                                            element));
+    TESTER_CHECKFORPASS(element[0] == 0 && element[1] == 1 && element[2] == 0);
+
+    // walls between elements
+    const int middle[3] = {1, 0, 0};
+    int step[3];
+    double distance = lattice.findWall(TVecDbl(0.0, 0.0, 0.0),
+                            TVecDbl(1.0, 0.0, 0.0), middle, step);
+    TESTER_CHECKFORPASS(distance == 0.5);
+    TESTER_CHECKFORPASS(step[0] == 1 && step[1] == 0 && step[2] == 0);
+
+    distance = lattice.findWall(TVecDbl(0.0, 0.0, 0.0),
+                            TVecDbl(0.0, 1.0, 0.0), middle, step);
+    TESTER_CHECKFORPASS(distance == 1.0);
+    TESTER_CHECKFORPASS(step[0] == 0 && step[1] == 1 && step[2] == 0);
+
+    // the walls around the outside aren't walls
+    const int edge[3] = {2, 0, 0};
+    distance = lattice.findWall(TVecDbl(0.0, 0.0, 0.0),
+                            TVecDbl(1.0, 0.0, 0.0), edge, step);
+    TESTER_CHECKFORPASS(distance == std::numeric_limits<double>::infinity());
+
+    TESTER_CHECKFORPASS(softEquiv(lattice.findSafety(TVecDbl(0.3, 0.1, 0.0)),
+                                  0.2));
+
+    std::vector<unsigned int> universes;
+    lattice.getUniverses(universes);
+    TESTER_CHECKFORPASS(universes == makeUniverses(6));
+}
+
+/*============================================================================*/
+void testHexagonal() {
+    // two rings (seven hexagons) in one layer
+    Lattice lattice(TVecDbl(0.0, 0.0, 0.0), 1.0, 2.0, 2, 1,
+                    makeUniverses(9));
+
+    TESTER_CHECKFORPASS(lattice.getType() == Lattice::HEXAGONAL);
+
+    int element[3];
+    TESTER_CHECKFORPASS(lattice.findElement(TVecDbl(0.1, 0.0, 0.5), element));
+    TESTER_CHECKFORPASS(element[0] == 0 && element[1] == 0 && element[2] == 0);
+    TESTER_CHECKFORPASS(lattice.getUniverse(element) == 4);
+
+    TESTER_CHECKFORPASS(lattice.findElement(TVecDbl(0.55, 0.8, 0.5),
+                                            element));
+    TESTER_CHECKFORPASS(element[0] == 0 && element[1] == 1);
+    TESTER_CHECKFORPASS(lattice.getUniverse(element) == 7);
+
+    TVecDbl center = lattice.getCenter(element);
+    TESTER_CHECKFORPASS(softEquiv(center[0], 0.5));
+    TESTER_CHECKFORPASS(softEquiv(center[1], 0.86602540378443864676));
+    TESTER_CHECKFORPASS(softEquiv(center[2], 1.0));
+
+    // the corners of the array aren't in it
+    const int corner[3] = {1, 1, 0};
+    TESTER_CHECKFORPASS(!lattice.isInArray(corner));
+    TESTER_CHECKFORPASS(!lattice.findElement(TVecDbl(3.0, 0.0, 0.5),
+                                             element));
+
+    // walls between elements
+    const int middle[3] = {0, 0, 0};
+    int step[3];
+    double distance = lattice.findWall(TVecDbl(0.0, 0.0, 0.0),
+                            TVecDbl(1.0, 0.0, 0.0), middle, step);
+    TESTER_CHECKFORPASS(softEquiv(distance, 0.5));
+    TESTER_CHECKFORPASS(step[0] == 1 && step[1] == 0 && step[2] == 0);
+
+    // the walls around the outside aren't walls
+    const int edge[3] = {1, 0, 0};
+    distance = lattice.findWall(TVecDbl(0.0, 0.0, 0.0),
+                            TVecDbl(1.0, 0.0, 0.0), edge, step);
+    TESTER_CHECKFORPASS(distance == std::numeric_limits<double>::infinity());
+
+    TESTER_CHECKFORPASS(softEquiv(lattice.findSafety(TVecDbl(0.2, 0.0, 0.0)),
+                                  0.3));
+
+    // only the seven hexagons in the rings
+    std::vector<unsigned int> universes;
+    lattice.getUniverses(universes);
+    TESTER_CHECKFORPASS(universes.size() == 7);
+    TESTER_CHECKFORPASS(universes.front() == 1 && universes.back() == 7);
+}
+
+/*============================================================================*/
+int main(int, char**) {
+    TESTER_INIT("Lattice");
+    try {
+        testRectangular();
+        testHexagonal();
+    }
+    catch (tranSupport::tranError &theErr) {
+        cout << "UNEXPECTED ERROR IN UNIT TEST: " << endl
+            << theErr.what() << endl;
+        TESTER_CHECKFORPASS(CAUGHT_UNEXPECTED_EXCEPTION);
+    }
+
+    TESTER_PRINTRESULT();
+
+    if (!TESTER_HASPASSED()) {
+        return 1;
+    }
+
+    return 0;
+}
@@ -7,12 +7,21 @@
 /*----------------------------------------------------------------------------*/
 
 #include "mcgeometry/MCGeometry.hpp"
+#include "mcgeometry/GeometryCounters.hpp"
 #include "mcgeometry/Plane.hpp"
 #include "mcgeometry/PlaneNormal.hpp"
 #include "mcgeometry/Sphere.hpp"
+#include "mcgeometry/Cylinder.hpp"
+#include "mcgeometry/CylinderNormal.hpp"
 
 #include <iostream>
 #include <vector>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
 #include "transupport/dbc.hpp"
 #include "transupport/UnitTester.hpp"
 #include "transupport/SoftEquiv.hpp"
@@ -186,11 +195,16 @@ void testGeometryErrorChecking()
     }
 }
 /*============================================================================*/
-void testMainGeometry() {
+void testMainGeometry(bool completeInput) {
 
     MCGeometry theGeom;
 
     createGeometry(theGeom, true);
+
+    if (completeInput) {
+        theGeom.completedGeometryInput();
+        TESTER_CHECKFORPASS(theGeom.isCompleted());
+    }
 //    theGeom.debugPrint();
 
     // ==== test a variety of locations and directions
@@ -242,6 +256,9 @@ void testMainGeometry() {
     }
     TESTER_CHECKFORPASS(correctStartingCells);
 
+    // outside everything is the negated cell
+    TESTER_CHECKFORPASS(theGeom.findCell(TVecDbl(4.0, 0.5, -0.5)) == 5);
+
     // ==== ending cells
     unsigned int expectedEndingCells[][4]
         = { {60, 30, 60, 60},
@@ -299,6 +316,1846 @@ void testMainGeometry() {
 
 //    theGeom.debugPrint();
 }
+/*============================================================================*/
+void testCompletedGeometryErrorChecking()
+{
+    intVec theSurfaces(1, 5);
+    TVecDbl center(0.0);
+
+    Sphere aSphere(center, 2.0);
+
+    MCGeometry theGeom;
+
+    createGeometry(theGeom);
+    theGeom.completedGeometryInput();
+
+    //===== try adding a surface after completion
+    bool caughtError = false;
+    try {
+        theGeom.addSurface(100, aSphere);
+    }
+    catch (tranSupport::tranError &theErr) {
+        caughtError = true;
+    }
+    TESTER_CHECKFORPASS(caughtError);
+
+    //===== try adding a cell after completion
+    caughtError = false;
+    try {
+        theGeom.addCell(100, theSurfaces);
+    }
+    catch (tranSupport::tranError &theErr) {
+        caughtError = true;
+    }
+    TESTER_CHECKFORPASS(caughtError);
+
+    //===== try completing twice
+    caughtError = false;
+    try {
+        theGeom.completedGeometryInput();
+    }
+    catch (tranSupport::tranError &theErr) {
+        caughtError = true;
+    }
+    TESTER_CHECKFORPASS(caughtError);
+}
+/*============================================================================*/
+void testTrackState() {
+    MCGeometry theGeom;
+
+    createGeometry(theGeom);
+
+    // query distances through a const geometry
+    const MCGeometry& constGeom = theGeom;
+
+    TVecDbl positionA(0.0);
+    TVecDbl positionB(0.0);
+    TVecDbl directionA(0.0);
+    TVecDbl directionB(0.0);
+
+    // particle A in cell 50 moving in -X; particle B in cell 10 moving in +Y
+    positionA[0] = -0.5;
+    positionA[1] = -1.5;
+    directionA[0] = -1.0;
+
+    positionB[0] =  0.5;
+    positionB[1] = -0.5;
+    directionB[1] =  1.0;
+
+    TrackState stateA;
+    TrackState stateB;
+    double distanceA;
+    double distanceB;
+
+    // interleave the two particles
+    constGeom.findDistance(positionA, directionA, 4, distanceA, stateA);
+    constGeom.findDistance(positionB, directionB, 0, distanceB, stateB);
+
+    TESTER_CHECKFORPASS(stateA.oldCellIndex == 4);
+    TESTER_CHECKFORPASS(stateB.oldCellIndex == 0);
+    TESTER_CHECKFORPASS(softEquiv(distanceA, std::sqrt(9.0 - 1.5*1.5) - 0.5));
+    TESTER_CHECKFORPASS(softEquiv(distanceB, 1.5));
+
+    TVecDbl      newPosition;
+    unsigned int newCellIndex;
+    MCGeometry::ReturnStatus returnStatus;
+
+    theGeom.findNewCell(positionB, directionB, newPosition, newCellIndex,
+                        returnStatus, stateB);
+    TESTER_CHECKFORPASS(theGeom.getUserIdFromCellIndex(newCellIndex) == 40);
+    TESTER_CHECKFORPASS(returnStatus == MCGeometry::NORMAL);
+
+    unsigned int surfaceUserId;
+    double       dotProduct;
+    constGeom.getSurfaceCrossing(newPosition, directionB, surfaceUserId,
+                                 dotProduct, stateB);
+    TESTER_CHECKFORPASS(surfaceUserId == 1);
+    TESTER_CHECKFORPASS(softEquiv(dotProduct, -1.0));
+
+    theGeom.findNewCell(positionA, directionA, newPosition, newCellIndex,
+                        returnStatus, stateA);
+    TESTER_CHECKFORPASS(theGeom.getUserIdFromCellIndex(newCellIndex) == 60);
+    TESTER_CHECKFORPASS(returnStatus == MCGeometry::NORMAL);
+}
+/*============================================================================*/
+//! Count particles that end up in the wrong cell; runs in parallel.
+int countWrongCrossings(const MCGeometry& theGeom) {
+    // particles streaming in +/-X and +/-Y from each cell
+    const unsigned int numLocs = 6;
+    const double xLocs[]  = {-0.5,  0.5, -0.5, -0.5, -0.5, 0.5};
+    const double yLocs[]  = {-1.5, -0.5, -0.5,  0.5,  1.5, 1.5};
+    const unsigned int startCells[] = {4, 0, 2, 1, 3, 3};
+    const unsigned int expectedEndingCells[][4]
+        = { {60, 30, 60, 60},
+            {60, 40, 30, 50},
+            {10, 20, 60, 50},
+            {10, 40, 60, 30},
+            {60, 60, 60, 20},
+            {60, 60, 60, 10}
+        };
+
+    int numWrong = 0;
+
+#pragma omp parallel for reduction(+:numWrong)
+    for (int iter = 0; iter < 64; ++iter) {
+        TrackState   state;
+        TVecDbl      position(0.0);
+        TVecDbl      direction;
+        TVecDbl      newPosition;
+        unsigned int newCellIndex;
+        double       distance;
+        MCGeometry::ReturnStatus returnStatus;
+
+        const unsigned int loc = iter % numLocs;
+        const unsigned int dir = (iter / numLocs) % 4;
+
+        position[0] = xLocs[loc];
+        position[1] = yLocs[loc];
+
+        direction = 0.0;
+        direction[dir % 2] = (dir < 2 ? 1.0 : -1.0);
+
+        theGeom.findNewCell(position, direction, startCells[loc],
+                            newPosition, newCellIndex, distance,
+                            returnStatus, state);
+
+        if (theGeom.getUserIdFromCellIndex(newCellIndex)
+                != expectedEndingCells[loc][dir])
+            ++numWrong;
+    }
+
+    return numWrong;
+}
+/*============================================================================*/
+void testSharedGeometry() {
+    MCGeometry theGeom;
+
+    createGeometry(theGeom);
+
+    // learn connectivity from many threads at once
+    TESTER_CHECKFORPASS(countWrongCrossings(theGeom) == 0);
+}
+/*============================================================================*/
+void testPrecomputedConnectivity() {
+    MCGeometry theGeom;
+
+    createGeometry(theGeom);
+
+    // connectivity needs the compiled geometry
+    bool caughtError = false;
+    try {
+        theGeom.findAllConnectivity();
+    }
+    catch (tranSupport::tranError &theErr) {
+        caughtError = true;
+    }
+    TESTER_CHECKFORPASS(caughtError);
+
+    theGeom.completedGeometryInput();
+    theGeom.findAllConnectivity();
+
+    // doing it twice is harmless
+    theGeom.findAllConnectivity();
+
+    TESTER_CHECKFORPASS(countWrongCrossings(theGeom) == 0);
+}
+/*============================================================================*/
+void testHugePageGeometry() {
+    // the system may not grant huge pages, but the geometry must work anyway
+    MCGeometry transparentGeom(tranSupport::Arena::TRANSPARENT_HUGE_PAGES);
+    createGeometry(transparentGeom);
+    transparentGeom.completedGeometryInput();
+
+    TESTER_CHECKFORPASS(countWrongCrossings(transparentGeom) == 0);
+
+    MCGeometry explicitGeom(tranSupport::Arena::EXPLICIT_HUGE_PAGES);
+    createGeometry(explicitGeom);
+
+    TESTER_CHECKFORPASS(countWrongCrossings(explicitGeom) == 0);
+}
+/*============================================================================*/
+//! Read a whole file into a string
+std::string readFile(const char* fileName) {
+    std::ifstream inFile(fileName, std::ios::in | std::ios::binary);
+    std::ostringstream contents;
+    contents << inFile.rdbuf();
+    return contents.str();
+}
+
+void createReflectingGeometry( MCGeometry& theGeom);
+
+void testConnectivityFile() {
+    const char hoodFile[]   = "tMCGeometry_hood.bin";
+    const char reloadFile[] = "tMCGeometry_hood_reload.bin";
+
+    // learn connectivity by transporting, then save it
+    MCGeometry learnedGeom;
+    createGeometry(learnedGeom);
+    learnedGeom.completedGeometryInput();
+
+    TESTER_CHECKFORPASS(countWrongCrossings(learnedGeom) == 0);
+    learnedGeom.writeConnectivity(hoodFile);
+
+    // an identical geometry accepts the saved connectivity
+    MCGeometry loadedGeom;
+    createGeometry(loadedGeom);
+    loadedGeom.completedGeometryInput();
+
+    TESTER_CHECKFORPASS(
+            loadedGeom.getGeometryHash() == learnedGeom.getGeometryHash());
+    TESTER_CHECKFORPASS(loadedGeom.readConnectivity(hoodFile));
+
+    // what was loaded is exactly what was saved
+    loadedGeom.writeConnectivity(reloadFile);
+    TESTER_CHECKFORPASS(readFile(hoodFile) == readFile(reloadFile));
+
+    TESTER_CHECKFORPASS(countWrongCrossings(loadedGeom) == 0);
+
+    // a different geometry rejects it
+    MCGeometry otherGeom;
+    createReflectingGeometry(otherGeom);
+    otherGeom.completedGeometryInput();
+
+    TESTER_CHECKFORPASS(
+            otherGeom.getGeometryHash() != learnedGeom.getGeometryHash());
+    TESTER_CHECKFORPASS(!otherGeom.readConnectivity(hoodFile));
+
+    // so does a geometry whose surfaces differ only slightly
+    MCGeometry movedGeom;
+    createGeometry(movedGeom);
+    movedGeom.addSurface(6, PlaneX(1.0e-15));
+    movedGeom.completedGeometryInput();
+
+    TESTER_CHECKFORPASS(!movedGeom.readConnectivity(hoodFile));
+
+    // missing files are fine
+    TESTER_CHECKFORPASS(!loadedGeom.readConnectivity("nonexistent_hood.bin"));
+
+    std::remove(hoodFile);
+    std::remove(reloadFile);
+}
+/*============================================================================*/
+void testBinaryGeometry() {
+    const char geomFile[]   = "tMCGeometry_geom.bin";
+    const char reloadFile[] = "tMCGeometry_geom_reload.bin";
+
+    MCGeometry originalGeom;
+    createGeometry(originalGeom);
+    originalGeom.completedGeometryInput();
+
+    // learn some neighborhoods so they get saved too
+    TESTER_CHECKFORPASS(countWrongCrossings(originalGeom) == 0);
+    originalGeom.writeBinaryGeometry(geomFile);
+
+    MCGeometry loadedGeom;
+    TESTER_CHECKFORPASS(loadedGeom.readBinaryGeometry(geomFile));
+    TESTER_CHECKFORPASS(loadedGeom.isCompleted());
+    TESTER_CHECKFORPASS(loadedGeom.getNumCells() == originalGeom.getNumCells());
+    TESTER_CHECKFORPASS(
+            loadedGeom.getNumSurfaces() == originalGeom.getNumSurfaces());
+    TESTER_CHECKFORPASS(
+            loadedGeom.getGeometryHash() == originalGeom.getGeometryHash());
+    TESTER_CHECKFORPASS(loadedGeom.getCellIndexFromUserId(30) == 2);
+    TESTER_CHECKFORPASS(loadedGeom.getSurfaceIndexFromUserId(4) == 4);
+
+    // everything, including the neighborhoods, survives the round trip
+    loadedGeom.writeBinaryGeometry(reloadFile);
+    TESTER_CHECKFORPASS(readFile(geomFile) == readFile(reloadFile));
+
+    TESTER_CHECKFORPASS(countWrongCrossings(loadedGeom) == 0);
+
+    // can't load on top of an existing geometry
+    bool caughtError = false;
+    try {
+        loadedGeom.readBinaryGeometry(geomFile);
+    }
+    catch (tranSupport::tranError &theErr) {
+        caughtError = true;
+    }
+    TESTER_CHECKFORPASS(caughtError);
+
+    // missing and foreign files are rejected
+    MCGeometry emptyGeom;
+    TESTER_CHECKFORPASS(!emptyGeom.readBinaryGeometry("nonexistent_geom.bin"));
+
+    originalGeom.writeConnectivity(reloadFile);
+    TESTER_CHECKFORPASS(!emptyGeom.readBinaryGeometry(reloadFile));
+    TESTER_CHECKFORPASS(emptyGeom.getNumCells() == 0);
+
+    std::remove(geomFile);
+    std::remove(reloadFile);
+}
+/*----------------------------------------------------------------------------*/
+void testBinarySurfaceTypes() {
+    const char geomFile[] = "tMCGeometry_types.bin";
+
+    MCGeometry originalGeom;
+
+    TVecDbl point(0.5, -1.25, 2.0);
+    TVecDbl direction(0.0, 0.6, 0.8);
+
+    Sphere reflectingSphere(point, 1.0 / 3.0);
+    reflectingSphere.setReflecting();
+
+    originalGeom.addSurface(1,  Plane(direction, point));
+    originalGeom.addSurface(2,  PlaneX(0.1));
+    originalGeom.addSurface(3,  PlaneY(-0.2));
+    originalGeom.addSurface(4,  PlaneZ(0.3));
+    originalGeom.addSurface(5,  reflectingSphere);
+    originalGeom.addSurface(6,  SphereO(2.5));
+    originalGeom.addSurface(7,  Cylinder(point, direction, 0.75));
+    originalGeom.addSurface(8,  CylinderX(point, 1.5));
+    originalGeom.addSurface(9,  CylinderY(point, 1.75));
+    originalGeom.addSurface(10, CylinderZ(point, 1.0e-3));
+
+    intVec theSurfaces(1);
+    for (int i = 1; i <= 10; ++i) {
+        theSurfaces[0] = -i;
+        originalGeom.addCell(100 + i, theSurfaces,
+                Cell::generateFlags(i % 3 == 0, i % 2 == 0));
+    }
+    originalGeom.completedGeometryInput();
+    originalGeom.writeBinaryGeometry(geomFile);
+
+    MCGeometry loadedGeom;
+    TESTER_CHECKFORPASS(loadedGeom.readBinaryGeometry(geomFile));
+
+    // the hash covers every surface parameter, the flags, and the IDs
+    TESTER_CHECKFORPASS(
+            loadedGeom.getGeometryHash() == originalGeom.getGeometryHash());
+    TESTER_CHECKFORPASS(loadedGeom.isDeadCell(2));
+    TESTER_CHECKFORPASS(!loadedGeom.isDeadCell(3));
+    TESTER_CHECKFORPASS(loadedGeom.getUserIdFromSurfaceIndex(9) == 10);
+
+    std::remove(geomFile);
+}
+/*============================================================================*/
+void testGlobalSearch(bool completeInput) {
+    MCGeometry theGeom;
+
+    // the lower right cell is bounded by a duplicate of the plane that the
+    // left cell is bounded by, so crossing from one to the other can only be
+    // found by a global search
+    TVecDbl center(0.0);
+    theGeom.addSurface(1, PlaneX(0.0));
+    theGeom.addSurface(2, PlaneY(0.0));
+    theGeom.addSurface(3, PlaneX(0.0));
+    theGeom.addSurface(5, Sphere(center, 3.0));
+
+    intVec theSurfaces(2);
+    theSurfaces[0] = -5;
+    theSurfaces[1] = -1;
+    theGeom.addCell(10, theSurfaces);
+
+    theSurfaces.resize(3);
+    theSurfaces[1] =  1;
+    theSurfaces[2] =  2;
+    theGeom.addCell(20, theSurfaces);
+
+    theSurfaces[1] =  3;
+    theSurfaces[2] = -2;
+    theGeom.addCell(30, theSurfaces);
+
+    theSurfaces.resize(1);
+    theGeom.addCell(40, theSurfaces,
+                    Cell::generateFlags(true, true));
+
+    if (completeInput)
+        theGeom.completedGeometryInput();
+
+    TVecDbl position(-0.5, -0.5, 0.0);
+    TVecDbl direction(1.0, 0.0, 0.0);
+    TVecDbl newPosition;
+    unsigned int newCellIndex;
+    double distance;
+    MCGeometry::ReturnStatus returnStatus;
+
+    // first time uses the global search, second time uses what it learned
+    for (int i = 0; i < 2; ++i) {
+        theGeom.findNewCell(position, direction, theGeom.findCell(position),
+                            newPosition, newCellIndex, distance,
+                            returnStatus);
+
+        TESTER_CHECKFORPASS(theGeom.getUserIdFromCellIndex(newCellIndex)
+                                == 30);
+        TESTER_CHECKFORPASS(returnStatus == MCGeometry::NORMAL);
+        TESTER_CHECKFORPASS(softEquiv(distance, 0.5));
+    }
+}
+/*============================================================================*/
+//! Whether batched distances match one-at-a-time ones exactly
+bool batchMatchesScalar(
+        const MCGeometry& theGeom,
+        const std::vector<TVecDbl>& positions,
+        const std::vector<TVecDbl>& directions,
+        const std::vector<unsigned int>& cellIndices,
+        const TrackState& initialState = TrackState())
+{
+    const unsigned int numParticles = positions.size();
+
+    std::vector<double> soa(6 * numParticles);
+    double* position[3];
+    double* direction[3];
+    for (int d = 0; d < 3; ++d) {
+        position[d]  = &soa[d * numParticles];
+        direction[d] = &soa[(3 + d) * numParticles];
+        for (unsigned int i = 0; i < numParticles; ++i) {
+            position[d][i]  = positions[i][d];
+            direction[d][i] = directions[i][d];
+        }
+    }
+
+    std::vector<double>     distances(numParticles);
+    std::vector<TrackState> states(numParticles, initialState);
+
+    theGeom.findDistances(numParticles, position, direction,
+                          &cellIndices[0], &distances[0], &states[0]);
+
+    bool matches = true;
+    for (unsigned int i = 0; i < numParticles; ++i) {
+        TrackState state(initialState);
+        double     distance;
+        theGeom.findDistance(positions[i], directions[i], cellIndices[i],
+                             distance, state);
+
+        if (distance != distances[i]
+                || state.hitSurface != states[i].hitSurface
+                || state.oldSurfaceSense != states[i].oldSurfaceSense
+                || state.oldCellIndex != states[i].oldCellIndex)
+        {
+            matches = false;
+        }
+    }
+    return matches;
+}
+/*============================================================================*/
+void testSortNeighborhoods() {
+    MCGeometry theGeom;
+
+    // the right half of a sphere is split in two by the y = 0 plane
+    TVecDbl center(0.0);
+    theGeom.addSurface(1, PlaneX(0.0));
+    theGeom.addSurface(2, PlaneY(0.0));
+    theGeom.addSurface(5, Sphere(center, 3.0));
+
+    intVec theSurfaces(2);
+    theSurfaces[0] = -5;
+    theSurfaces[1] = -1;
+    theGeom.addCell(10, theSurfaces);
+
+    theSurfaces.resize(3);
+    theSurfaces[1] =  1;
+    theSurfaces[2] =  2;
+    theGeom.addCell(20, theSurfaces);
+
+    theSurfaces[2] = -2;
+    theGeom.addCell(30, theSurfaces);
+
+    theSurfaces.resize(1);
+    theGeom.addCell(40, theSurfaces,
+                    Cell::generateFlags(true, true));
+
+    theGeom.completedGeometryInput();
+
+    // the upper right is found first, but the lower right more often
+    const double yLocs[] = {0.5, -0.5, -0.5, -0.5, 0.5};
+    const unsigned int expectedEndingCells[] = {20, 30, 30, 30, 20};
+
+    TVecDbl direction(1.0, 0.0, 0.0);
+    TVecDbl newPosition;
+    unsigned int newCellIndex;
+    double distance;
+    MCGeometry::ReturnStatus returnStatus;
+
+    // learn the neighbors and check them in the order found; sorting
+    // without a profile changes nothing, and with one it reorders them
+    GeometryCounters& counters = GeometryCounters::getThreadCounters();
+    GeometryCounters::Count numChecks[5];
+
+    for (int pass = 0; pass < 5; ++pass) {
+        const GeometryCounters::Count startChecks = counters.pointInsideCalls;
+
+        for (int i = 0; i < 5; ++i) {
+            theGeom.findNewCell(TVecDbl(-0.5, yLocs[i], 0.0), direction, 0,
+                                newPosition, newCellIndex, distance,
+                                returnStatus);
+            TESTER_CHECKFORPASS(theGeom.getUserIdFromCellIndex(newCellIndex)
+                                    == expectedEndingCells[i]);
+        }
+
+        numChecks[pass] = counters.pointInsideCalls - startChecks;
+        if (pass == 1)
+            theGeom.sortNeighborhoods();
+        if (pass == 2)
+            theGeom.startNeighborProfile();
+        if (pass == 3)
+            theGeom.sortNeighborhoods();
+    }
+
+    if (GeometryCounters::isEnabled()) {
+        TESTER_CHECKFORPASS(numChecks[1] == 8);
+        TESTER_CHECKFORPASS(numChecks[2] == 8);
+        TESTER_CHECKFORPASS(numChecks[3] == 8);
+        // the lower right is now checked first
+        TESTER_CHECKFORPASS(numChecks[4] == 7);
+    }
+}
+/*============================================================================*/
+void testBatchedTransport() {
+    MCGeometry theGeom;
+    createGeometry(theGeom);
+
+    // batches need the compiled geometry
+    const unsigned int startCell = 0;
+    const double zero[1] = {0.0};
+    const double* coords[3] = {zero, zero, zero};
+    double distance;
+    TrackState state;
+    bool caughtError = false;
+    try {
+        theGeom.findDistances(1, coords, coords, &startCell, &distance,
+                              &state);
+    }
+    catch (tranSupport::tranError &theErr) {
+        caughtError = true;
+    }
+    TESTER_CHECKFORPASS(caughtError);
+
+    theGeom.completedGeometryInput();
+
+    // particles streaming in +/-X and +/-Y from each cell
+    const unsigned int numLocs = 6;
+    const double xLocs[]  = {-0.5,  0.5, -0.5, -0.5, -0.5, 0.5};
+    const double yLocs[]  = {-1.5, -0.5, -0.5,  0.5,  1.5, 1.5};
+    const unsigned int startCells[] = {4, 0, 2, 1, 3, 3};
+    const unsigned int expectedEndingCells[][4]
+        = { {60, 30, 60, 60},
+            {60, 40, 30, 50},
+            {10, 20, 60, 50},
+            {10, 40, 60, 30},
+            {60, 60, 60, 20},
+            {60, 60, 60, 10}
+        };
+
+    const unsigned int numParticles = 4 * numLocs;
+    std::vector<TVecDbl>      positions(numParticles, TVecDbl(0.0));
+    std::vector<TVecDbl>      directions(numParticles, TVecDbl(0.0));
+    std::vector<unsigned int> cellIndices(numParticles);
+
+    for (unsigned int i = 0; i < numParticles; ++i) {
+        const unsigned int loc = i % numLocs;
+        const unsigned int dir = i / numLocs;
+
+        positions[i][0] = xLocs[loc];
+        positions[i][1] = yLocs[loc];
+        directions[i][dir % 2] = (dir < 2 ? 1.0 : -1.0);
+        cellIndices[i] = startCells[loc];
+    }
+
+    TESTER_CHECKFORPASS(
+        batchMatchesScalar(theGeom, positions, directions, cellIndices));
+
+    // transport the whole batch
+    std::vector<double> soa(12 * numParticles);
+    double* position[3];
+    double* direction[3];
+    double* newPosition[3];
+    for (int d = 0; d < 3; ++d) {
+        position[d]    = &soa[d * numParticles];
+        direction[d]   = &soa[(3 + d) * numParticles];
+        newPosition[d] = &soa[(6 + d) * numParticles];
+        for (unsigned int i = 0; i < numParticles; ++i) {
+            position[d][i]  = positions[i][d];
+            direction[d][i] = directions[i][d];
+        }
+    }
+
+    std::vector<double>       distances(numParticles);
+    std::vector<TrackState>   states(numParticles);
+    std::vector<unsigned int> newCellIndices(numParticles);
+    std::vector<MCGeometry::ReturnStatus> returnStatuses(numParticles);
+
+    theGeom.findDistances(numParticles, position, direction,
+                          &cellIndices[0], &distances[0], &states[0]);
+    theGeom.findNewCells(numParticles, position, direction, newPosition,
+                         &newCellIndices[0], &returnStatuses[0], &states[0]);
+
+    bool allCorrect = true;
+    for (unsigned int i = 0; i < numParticles; ++i) {
+        const unsigned int loc = i % numLocs;
+        const unsigned int dir = i / numLocs;
+
+        if (theGeom.getUserIdFromCellIndex(newCellIndices[i])
+                    != expectedEndingCells[loc][dir]
+                || returnStatuses[i] != MCGeometry::NORMAL)
+            allCorrect = false;
+
+        for (int d = 0; d < 3; ++d) {
+            const double expected
+                = positions[i][d] + directions[i][d] * distances[i];
+            if (!softEquiv(newPosition[d][i], expected))
+                allCorrect = false;
+        }
+    }
+    TESTER_CHECKFORPASS(allCorrect);
+}
+/*============================================================================*/
+void testBatchedSurfaceTypes() {
+    MCGeometry theGeom;
+
+    TVecDbl point(0.5, -1.25, 2.0);
+    TVecDbl axis(0.0, 0.6, 0.8);
+
+    theGeom.addSurface(1,  Plane(axis, point));
+    theGeom.addSurface(2,  PlaneX(0.1));
+    theGeom.addSurface(3,  PlaneY(-0.2));
+    theGeom.addSurface(4,  PlaneZ(0.3));
+    theGeom.addSurface(5,  Sphere(point, 1.5));
+    theGeom.addSurface(6,  SphereO(2.5));
+    theGeom.addSurface(7,  Cylinder(point, axis, 0.75));
+    theGeom.addSurface(8,  CylinderX(point, 1.5));
+    theGeom.addSurface(9,  CylinderY(point, 1.75));
+    theGeom.addSurface(10, CylinderZ(point, 1.0));
+    theGeom.addSurface(11, SphereO(100.0));
+
+    // a cell on each side of each surface, closed off by a big sphere so
+    // every particle hits something
+    intVec theSurfaces(2);
+    theSurfaces[1] = -11;
+    for (int i = 1; i <= 10; ++i) {
+        theSurfaces[0] = -i;
+        theGeom.addCell(100 + i, theSurfaces);
+        theSurfaces[0] = i;
+        theGeom.addCell(200 + i, theSurfaces);
+    }
+    theGeom.completedGeometryInput();
+
+    const unsigned int numParticles = 2000;
+    std::vector<TVecDbl>      positions(numParticles);
+    std::vector<TVecDbl>      directions(numParticles);
+    std::vector<unsigned int> cellIndices(numParticles);
+
+    std::srand(4321);
+    for (unsigned int i = 0; i < numParticles; ++i) {
+        for (int d = 0; d < 3; ++d) {
+            positions[i][d]  = 8.0 * (std::rand() / (RAND_MAX + 1.0)) - 4.0;
+            directions[i][d] = std::rand() / (RAND_MAX + 1.0) - 0.5;
+        }
+        directions[i] /= std::sqrt(blitz::dot(directions[i], directions[i]));
+
+        // whether or not it's inside, the distance is well defined
+        cellIndices[i] = i % theGeom.getNumCells();
+    }
+
+    TESTER_CHECKFORPASS(
+        batchMatchesScalar(theGeom, positions, directions, cellIndices));
+}
+/*============================================================================*/
+void testBatchedGrid() {
+    MCGeometry theGeom;
+
+    // a 2 by 2 by 1 mesh of unit boxes whose cells list their z planes
+    // first, so a cell and its grid break exact ties differently
+    theGeom.addSurface(1,  PlaneX(0.0));
+    theGeom.addSurface(2,  PlaneX(1.0));
+    theGeom.addSurface(3,  PlaneX(2.0));
+    theGeom.addSurface(11, PlaneY(0.0));
+    theGeom.addSurface(12, PlaneY(1.0));
+    theGeom.addSurface(13, PlaneY(2.0));
+    theGeom.addSurface(21, PlaneZ(0.0));
+    theGeom.addSurface(22, PlaneZ(1.0));
+
+    intVec theSurfaces(6);
+    for (int j = 0; j < 2; ++j) {
+        for (int i = 0; i < 2; ++i) {
+            theSurfaces[0] =  21;
+            theSurfaces[1] = -22;
+            theSurfaces[2] =  (11 + j);
+            theSurfaces[3] = -(12 + j);
+            theSurfaces[4] =  (1 + i);
+            theSurfaces[5] = -(2 + i);
+            theGeom.addCell(100 + i + 2 * j, theSurfaces);
+        }
+    }
+
+    theSurfaces[0] =  21;
+    theSurfaces[1] = -22;
+    theSurfaces[2] =  11;
+    theSurfaces[3] = -13;
+    theSurfaces[4] =  1;
+    theSurfaces[5] = -3;
+    theGeom.addCell(1000, theSurfaces, Cell::generateFlags(true, true));
+
+    theGeom.completedGeometryInput();
+    TESTER_CHECKFORPASS(theGeom.getNumStructuredGrids() == 1);
+
+    // from the middle of each box, straight at each of its corners
+    std::vector<TVecDbl>      positions;
+    std::vector<TVecDbl>      directions;
+    std::vector<unsigned int> cellIndices;
+
+    for (int n = 0; n < 4 * 8; ++n) {
+        const int box    = n / 8;
+        const int corner = n % 8;
+        TVecDbl position(0.5 + box % 2, 0.5 + box / 2, 0.5);
+        TVecDbl direction;
+        for (int d = 0; d < 3; ++d)
+            direction[d] = ((corner >> d) & 1 ? 1.0 : -1.0);
+        direction /= std::sqrt(3.0);
+
+        positions.push_back(position);
+        directions.push_back(direction);
+        cellIndices.push_back(theGeom.findCell(position));
+
+        // and grazing an edge between x and y
+        direction[2] = 0.0;
+        direction /= std::sqrt(blitz::dot(direction, direction));
+
+        positions.push_back(position);
+        directions.push_back(direction);
+        cellIndices.push_back(cellIndices.back());
+    }
+
+    TrackState gridState;
+    TESTER_CHECKFORPASS(
+        batchMatchesScalar(theGeom, positions, directions, cellIndices,
+                           gridState));
+
+    TrackState cellState;
+    cellState.useStructuredGrids = false;
+    TESTER_CHECKFORPASS(
+        batchMatchesScalar(theGeom, positions, directions, cellIndices,
+                           cellState));
+
+    TrackState sensesState;
+    sensesState.trackSenses = true;
+    TESTER_CHECKFORPASS(
+        batchMatchesScalar(theGeom, positions, directions, cellIndices,
+                           sensesState));
+}
+/*============================================================================*/
+/*!
+ * \brief Whether following a particle with one state matches starting over.
+ *
+ * The particle is tracked until it dies with the given state (reusing
+ * distances or senses along the way) and again with a new state at every
+ * step; returns false if they ever disagree or it doesn't die.
+ */
+bool flightMatchesFresh(
+        const MCGeometry& theGeom,
+        const TVecDbl& startPosition,
+        const TVecDbl& direction,
+        TrackState& flightState,
+        unsigned int& numCrossings)
+{
+    TVecDbl      position(startPosition);
+    TVecDbl      freshPosition(startPosition);
+    unsigned int cellIndex = theGeom.findCell(startPosition);
+    unsigned int freshCellIndex = cellIndex;
+
+    bool matches = true;
+    numCrossings = 0;
+    MCGeometry::ReturnStatus returnStatus = MCGeometry::NORMAL;
+
+    while (returnStatus == MCGeometry::NORMAL && numCrossings < 100) {
+        TVecDbl      newPosition;
+        unsigned int newCellIndex;
+        double       distance;
+
+        theGeom.findNewCell(position, direction, cellIndex, newPosition,
+                            newCellIndex, distance, returnStatus,
+                            flightState);
+
+        TrackState   freshState;
+        TVecDbl      freshNewPosition;
+        unsigned int freshNewCellIndex;
+        double       freshDistance;
+        MCGeometry::ReturnStatus freshReturnStatus;
+
+        theGeom.findNewCell(freshPosition, direction, freshCellIndex,
+                            freshNewPosition, freshNewCellIndex,
+                            freshDistance, freshReturnStatus, freshState);
+
+        if (newCellIndex != freshNewCellIndex
+                || returnStatus != freshReturnStatus
+                || !softEquiv(distance, freshDistance, 1e-12)
+                || !softEquiv(newPosition, freshNewPosition, 1e-12))
+        {
+            matches = false;
+        }
+
+        position       = newPosition;
+        freshPosition  = freshNewPosition;
+        cellIndex      = newCellIndex;
+        freshCellIndex = freshNewCellIndex;
+        ++numCrossings;
+    }
+
+    return (matches && returnStatus == MCGeometry::DEADCELL);
+}
+
+/*============================================================================*/
+void testStraightFlight() {
+    MCGeometry theGeom;
+
+    // nested spheres cut in half by a plane, so a straight line goes in and
+    // back out of each sphere and the plane is shared by many cells
+    const unsigned int numShells = 4;
+    theGeom.addSurface(100, PlaneX(0.0));
+    for (unsigned int i = 1; i <= numShells; ++i)
+        theGeom.addSurface(i, SphereO(i));
+
+    intVec theSurfaces;
+    for (unsigned int i = 1; i <= numShells; ++i) {
+        theSurfaces.clear();
+        theSurfaces.push_back(-static_cast<int>(i));
+        if (i > 1)
+            theSurfaces.push_back(i - 1);
+
+        theSurfaces.push_back(-100);
+        theGeom.addCell(10 * i, theSurfaces);
+        theSurfaces.back() = 100;
+        theGeom.addCell(10 * i + 1, theSurfaces);
+    }
+    theSurfaces.clear();
+    theSurfaces.push_back(numShells);
+    theGeom.addCell(1000, theSurfaces, Cell::generateFlags(true, false));
+
+    theGeom.completedGeometryInput();
+
+    const TVecDbl startPosition(-3.5, 0.3, 0.2);
+    TVecDbl direction(1.0, 0.05, -0.02);
+    direction /= std::sqrt(blitz::dot(direction, direction));
+
+    TrackState flightState;
+    flightState.trackSenses = true;
+
+    unsigned int numCrossings = 0;
+    TESTER_CHECKFORPASS(
+            flightMatchesFresh(theGeom, startPosition, direction,
+                               flightState, numCrossings));
+    // from the outer shell in through three spheres, across the plane, and
+    // out through all four
+    TESTER_CHECKFORPASS(numCrossings == 2 * numShells);
+}
+/*============================================================================*/
+void testSensesThroughPins() {
+    MCGeometry theGeom;
+
+    // a box split in half across x, each half holding a pin but bounded by
+    // both, so a particle leaving a pin crosses into the other half with the
+    // pins' senses known, and leaves the other pin for the half it came
+    // from (the pins are also cut off by a sphere, so that they have senses
+    // worth recording)
+    theGeom.addSurface(1, PlaneX(-2.0));
+    theGeom.addSurface(2, PlaneX( 2.0));
+    theGeom.addSurface(3, PlaneY(-1.0));
+    theGeom.addSurface(4, PlaneY( 1.0));
+    theGeom.addSurface(5, PlaneZ(-1.0));
+    theGeom.addSurface(6, PlaneZ( 1.0));
+    theGeom.addSurface(7, PlaneX( 0.0));
+    theGeom.addSurface(11, CylinderZ(TVecDbl(-1.0, 0.0, 0.0), 0.5));
+    theGeom.addSurface(12, CylinderZ(TVecDbl( 1.0, 0.0, 0.0), 0.5));
+    theGeom.addSurface(13, SphereO(10.0));
+
+    intVec theSurfaces;
+    theSurfaces.push_back(-11);
+    theSurfaces.push_back(5);
+    theSurfaces.push_back(-6);
+    theSurfaces.push_back(-13);
+    theGeom.addCell(21, theSurfaces);
+    theSurfaces[0] = -12;
+    theGeom.addCell(22, theSurfaces);
+
+    theSurfaces.clear();
+    theSurfaces.push_back(3);
+    theSurfaces.push_back(-4);
+    theSurfaces.push_back(5);
+    theSurfaces.push_back(-6);
+    theSurfaces.push_back(11);
+    theSurfaces.push_back(12);
+    theSurfaces.push_back(1);
+    theSurfaces.push_back(-7);
+    theGeom.addCell(30, theSurfaces);
+    theSurfaces[6] = 7;
+    theSurfaces[7] = -2;
+    theGeom.addCell(31, theSurfaces);
+
+    theSurfaces.resize(6);
+    theSurfaces[4] = 1;
+    theSurfaces[5] = -2;
+    theGeom.addCell(40, theSurfaces, Cell::generateFlags(true, true));
+
+    theGeom.completedGeometryInput();
+
+    // one state for particles going each way, as in a particle bank
+    TrackState flightState;
+    flightState.trackSenses = true;
+
+    TVecDbl direction(1.0, 0.05, 0.02);
+    direction /= std::sqrt(blitz::dot(direction, direction));
+
+    // once every neighborhood is learned, a sense that was wrongly known
+    // would send the crossing to a search
+    GeometryCounters& counters = GeometryCounters::getThreadCounters();
+
+    for (int i = 0; i < 4; ++i) {
+        if (i == 2)
+            counters.clear();
+
+        // start in the pin behind, so its senses are the first recorded
+        const TVecDbl startPosition(direction[0] > 0 ? -1.0 : 1.0, 0.01, 0.0);
+        unsigned int numCrossings = 0;
+        TESTER_CHECKFORPASS(
+                flightMatchesFresh(theGeom, startPosition, direction,
+                                   flightState, numCrossings));
+        // out of one pin, across the middle, in and out of the other pin,
+        // and out of the box
+        TESTER_CHECKFORPASS(numCrossings == 5);
+
+        direction = -direction;
+    }
+
+    if (GeometryCounters::isEnabled()) {
+        TESTER_CHECKFORPASS(counters.getNumCrossings() > 0);
+        TESTER_CHECKFORPASS(
+                counters.resolutions[GeometryCounters::IN_NEIGHBORHOOD]
+                    == counters.getNumCrossings());
+    }
+    counters.clear();
+}
+/*============================================================================*/
+void testSafetyDistance() {
+    MCGeometry theGeom;
+
+    // a sphere inside a shell cut in half by a plane
+    theGeom.addSurface(1, SphereO(1.0));
+    theGeom.addSurface(2, SphereO(3.0));
+    theGeom.addSurface(3, PlaneZ(0.0));
+
+    intVec theSurfaces;
+    theSurfaces.push_back(-1);
+    theGeom.addCell(10, theSurfaces);
+
+    theSurfaces[0] = 1;
+    theSurfaces.push_back(-2);
+    theSurfaces.push_back(-3);
+    theGeom.addCell(20, theSurfaces);
+    theSurfaces.back() = 3;
+    theGeom.addCell(21, theSurfaces);
+
+    theSurfaces.clear();
+    theSurfaces.push_back(2);
+    theGeom.addCell(30, theSurfaces, Cell::generateFlags(true, false));
+
+    theGeom.completedGeometryInput();
+
+    TVecDbl position(0.0, 0.0, 0.25);
+    unsigned int cellIndex = theGeom.findCell(position);
+    TESTER_CHECKFORPASS(
+        softEquiv(theGeom.findSafetyDistance(position, cellIndex), 0.75));
+
+    // nearer the plane than either sphere
+    position = 1.5, 0.5, 0.25;
+    cellIndex = theGeom.findCell(position);
+    TESTER_CHECKFORPASS(theGeom.getUserIdFromCellIndex(cellIndex) == 21);
+    TESTER_CHECKFORPASS(
+        softEquiv(theGeom.findSafetyDistance(position, cellIndex), 0.25));
+
+    // no direction reaches a surface sooner
+    const double safety = theGeom.findSafetyDistance(position, cellIndex);
+    bool isSafe = true;
+
+    std::srand(4321);
+    for (int i = 0; i < 200; ++i) {
+        TVecDbl direction;
+        for (int d = 0; d < 3; ++d)
+            direction[d] = std::rand() / (RAND_MAX + 1.0) - 0.5;
+        direction /= std::sqrt(blitz::dot(direction, direction));
+
+        TrackState state;
+        double distance;
+        theGeom.findDistance(position, direction, cellIndex, distance, state);
+
+        if (distance < safety)
+            isSafe = false;
+    }
+    TESTER_CHECKFORPASS(isSafe);
+}
+/*============================================================================*/
+void testLimitedDistance() {
+    MCGeometry theGeom;
+
+    // a cylinder capped by two planes
+    theGeom.addSurface(1, CylinderZ(TVecDbl(0.0), 1.0));
+    theGeom.addSurface(2, PlaneZ(-2.0));
+    theGeom.addSurface(3, PlaneZ(2.0));
+
+    intVec theSurfaces;
+    theSurfaces.push_back(-1);
+    theSurfaces.push_back(2);
+    theSurfaces.push_back(-3);
+    theGeom.addCell(10, theSurfaces);
+
+    theGeom.addCell(20, theSurfaces, Cell::generateFlags(true, true));
+
+    theGeom.completedGeometryInput();
+
+    const TVecDbl position(0.5, 0.0, 0.0);
+    const TVecDbl direction(0.6, 0.0, 0.8);
+    const unsigned int cellIndex = theGeom.findCell(position);
+
+    TrackState state;
+    double distance;
+    theGeom.findDistance(position, direction, cellIndex, distance, state);
+    TESTER_CHECKFORPASS(softEquiv(distance, 0.5 / 0.6));
+
+    // colliding first
+    TrackState limitedState;
+    double limitedDistance;
+    TESTER_CHECKFORPASS(!theGeom.findDistance(position, direction, cellIndex,
+                                              0.5, limitedDistance,
+                                              limitedState));
+    TESTER_CHECKFORPASS(limitedState.hitSurface == NULL);
+
+    // reaching the cylinder first
+    TESTER_CHECKFORPASS(theGeom.findDistance(position, direction, cellIndex,
+                                             1.0, limitedDistance,
+                                             limitedState));
+    TESTER_CHECKFORPASS(limitedDistance == distance);
+    TESTER_CHECKFORPASS(limitedState.hitSurface == state.hitSurface);
+
+    TVecDbl      newPosition;
+    unsigned int newCellIndex;
+    MCGeometry::ReturnStatus returnStatus;
+    theGeom.findNewCell(position, direction, newPosition, newCellIndex,
+                        returnStatus, limitedState);
+    TESTER_CHECKFORPASS(returnStatus == MCGeometry::DEADCELL);
+}
+/*============================================================================*/
+void testStructuredGrid() {
+    MCGeometry theGeom;
+
+    // a mesh of boxes with uneven spacing, inside a dead cell
+    const double planes[3][4] = {{0.0, 1.0, 2.5, 3.0},
+                                 {0.0, 2.0, 3.0, 0.0},
+                                 {-1.0, 0.0, 4.0, 0.0}};
+    const unsigned int numPlanes[3] = {4, 3, 3};
+
+    for (unsigned int i = 0; i < numPlanes[0]; ++i)
+        theGeom.addSurface(1 + i, PlaneX(planes[0][i]));
+    for (unsigned int i = 0; i < numPlanes[1]; ++i)
+        theGeom.addSurface(11 + i, PlaneY(planes[1][i]));
+    for (unsigned int i = 0; i < numPlanes[2]; ++i)
+        theGeom.addSurface(21 + i, PlaneZ(planes[2][i]));
+
+    intVec theSurfaces(6);
+    for (int k = 0; k < 2; ++k) {
+        for (int j = 0; j < 2; ++j) {
+            for (int i = 0; i < 3; ++i) {
+                theSurfaces[0] =  (1 + i);
+                theSurfaces[1] = -(2 + i);
+                theSurfaces[2] =  (11 + j);
+                theSurfaces[3] = -(12 + j);
+                theSurfaces[4] =  (21 + k);
+                theSurfaces[5] = -(22 + k);
+                theGeom.addCell(100 + i + 3 * (j + 2 * k), theSurfaces);
+            }
+        }
+    }
+
+    theSurfaces[0] =  1;
+    theSurfaces[1] = -4;
+    theSurfaces[2] =  11;
+    theSurfaces[3] = -13;
+    theSurfaces[4] =  21;
+    theSurfaces[5] = -23;
+    theGeom.addCell(1000, theSurfaces, Cell::generateFlags(true, true));
+
+    TESTER_CHECKFORPASS(theGeom.getNumStructuredGrids() == 0);
+    theGeom.completedGeometryInput();
+    TESTER_CHECKFORPASS(theGeom.getNumStructuredGrids() == 1);
+
+    // tracking by index gives the same answers as the general search
+    bool matches = true;
+    bool leaves  = true;
+    unsigned int numCrossings = 0;
+
+    std::srand(2468);
+    for (int n = 0; n < 200; ++n) {
+        TVecDbl position;
+        TVecDbl direction;
+        for (int d = 0; d < 3; ++d) {
+            const double lower = planes[d][0];
+            const double upper = planes[d][numPlanes[d] - 1];
+            position[d]  = lower + (upper - lower)
+                                    * (std::rand() / (RAND_MAX + 1.0));
+            direction[d] = std::rand() / (RAND_MAX + 1.0) - 0.5;
+        }
+        direction /= std::sqrt(blitz::dot(direction, direction));
+
+        TrackState gridState;
+        TrackState generalState;
+        generalState.useStructuredGrids = false;
+
+        unsigned int cellIndex = theGeom.findCell(position);
+        MCGeometry::ReturnStatus returnStatus = MCGeometry::NORMAL;
+
+        for (int step = 0; step < 20 && returnStatus == MCGeometry::NORMAL;
+             ++step)
+        {
+            TVecDbl      newPosition;
+            unsigned int newCellIndex;
+            double       distance;
+
+            theGeom.findNewCell(position, direction, cellIndex, newPosition,
+                                newCellIndex, distance, returnStatus,
+                                gridState);
+
+            TVecDbl      generalPosition;
+            unsigned int generalCellIndex;
+            double       generalDistance;
+            MCGeometry::ReturnStatus generalStatus;
+
+            theGeom.findNewCell(position, direction, cellIndex,
+                                generalPosition, generalCellIndex,
+                                generalDistance, generalStatus, generalState);
+
+            if (newCellIndex != generalCellIndex
+                    || returnStatus != generalStatus
+                    || distance != generalDistance
+                    || gridState.hitSurface != generalState.hitSurface
+                    || !blitz::all(newPosition == generalPosition))
+            {
+                matches = false;
+            }
+
+            position  = newPosition;
+            cellIndex = newCellIndex;
+            ++numCrossings;
+        }
+
+        if (returnStatus != MCGeometry::DEADCELL)
+            leaves = false;
+    }
+
+    TESTER_CHECKFORPASS(matches);
+    TESTER_CHECKFORPASS(leaves);
+    TESTER_CHECKFORPASS(numCrossings > 400);
+
+    // limited distances stop short in the grid too
+    const TVecDbl position(0.5, 1.0, -0.5);
+    const TVecDbl direction(1.0, 0.0, 0.0);
+    const unsigned int cellIndex = theGeom.findCell(position);
+    TESTER_CHECKFORPASS(theGeom.getUserIdFromCellIndex(cellIndex) == 100);
+
+    TrackState state;
+    double distance;
+    TESTER_CHECKFORPASS(!theGeom.findDistance(position, direction, cellIndex,
+                                              0.25, distance, state));
+    TESTER_CHECKFORPASS(state.hitSurface == NULL);
+    TESTER_CHECKFORPASS(theGeom.findDistance(position, direction, cellIndex,
+                                             0.5, distance, state));
+    TESTER_CHECKFORPASS(distance == 0.5);
+    TESTER_CHECKFORPASS(state.hitSurface->getUserId() == 2);
+
+    // the grid is saved with the geometry rather than found again
+    const char geomFile[]   = "tMCGeometry_grid.bin";
+    const char reloadFile[] = "tMCGeometry_grid_reload.bin";
+    theGeom.writeBinaryGeometry(geomFile);
+
+    MCGeometry loadedGeom;
+    TESTER_CHECKFORPASS(loadedGeom.readBinaryGeometry(geomFile));
+    TESTER_CHECKFORPASS(loadedGeom.getNumStructuredGrids() == 1);
+
+    TrackState loadedState;
+    TESTER_CHECKFORPASS(loadedGeom.findDistance(position, direction,
+                                                cellIndex, 0.5, distance,
+                                                loadedState));
+    TESTER_CHECKFORPASS(distance == 0.5);
+    TESTER_CHECKFORPASS(loadedState.hitSurface->getUserId() == 2);
+
+    loadedGeom.writeBinaryGeometry(reloadFile);
+    TESTER_CHECKFORPASS(readFile(geomFile) == readFile(reloadFile));
+
+    std::remove(geomFile);
+    std::remove(reloadFile);
+}
+/*============================================================================*/
+//! A box around a 2 by 2 array of pins, as a lattice or with every pin placed
+void createPinArray( MCGeometry& theGeom, bool useLattice) {
+    theGeom.addSurface(1,  PlaneX(0.0));
+    theGeom.addSurface(3,  PlaneX(2.0));
+    theGeom.addSurface(11, PlaneY(0.0));
+    theGeom.addSurface(13, PlaneY(2.0));
+    theGeom.addSurface(21, PlaneZ(0.0));
+    theGeom.addSurface(22, PlaneZ(1.0));
+
+    intVec theSurfaces(6);
+    theSurfaces[0] =  1;
+    theSurfaces[1] = -3;
+    theSurfaces[2] =  11;
+    theSurfaces[3] = -13;
+    theSurfaces[4] =  21;
+    theSurfaces[5] = -22;
+    theGeom.addCell(1000, theSurfaces, Cell::generateFlags(true, true));
+
+    if (useLattice) {
+        theGeom.addCell(10, theSurfaces);
+        theGeom.fillCell(10, 2);
+
+        // one pin, repeated by the lattice
+        theGeom.addSurface(31, CylinderZ(TVecDbl(0.0, 0.0, 0.0), 0.3));
+        theGeom.addCell(20, intVec(1, -31), Cell::NONE, 1);
+        theGeom.addCell(21, intVec(1,  31), Cell::NONE, 1);
+
+        const unsigned int numElements[3] = {2, 2, 1};
+        theGeom.addRectangularLattice(2, TVecDbl(0.0, 0.0, 0.0),
+                TVecDbl(1.0, 1.0, 1.0), numElements,
+                MCGeometry::UniverseIdVec(4, 1));
+        return;
+    }
+
+    theGeom.addSurface(2,  PlaneX(1.0));
+    theGeom.addSurface(12, PlaneY(1.0));
+
+    for (int j = 0; j < 2; ++j) {
+        for (int i = 0; i < 2; ++i) {
+            const int pin = i + 2 * j;
+            theGeom.addSurface(31 + pin,
+                    CylinderZ(TVecDbl(0.5 + i, 0.5 + j, 0.0), 0.3));
+
+            theSurfaces.resize(3);
+            theSurfaces[0] = -(31 + pin);
+            theSurfaces[1] =  21;
+            theSurfaces[2] = -22;
+            theGeom.addCell(200 + pin, theSurfaces);
+
+            theSurfaces.resize(7);
+            theSurfaces[0] =  (1 + i);
+            theSurfaces[1] = -(2 + i);
+            theSurfaces[2] =  (11 + j);
+            theSurfaces[3] = -(12 + j);
+            theSurfaces[4] =  21;
+            theSurfaces[5] = -22;
+            theSurfaces[6] =  (31 + pin);
+            theGeom.addCell(100 + pin, theSurfaces);
+        }
+    }
+}
+
+void testLattice() {
+    MCGeometry latticeGeom;
+    MCGeometry flatGeom;
+
+    createPinArray(latticeGeom, true);
+    createPinArray(flatGeom,    false);
+
+    latticeGeom.completedGeometryInput();
+    flatGeom.completedGeometryInput();
+
+    TESTER_CHECKFORPASS(latticeGeom.getNumUniverses() == 3);
+    TESTER_CHECKFORPASS(latticeGeom.getNumCells() == 4);
+
+    // the innermost cell is the one that's found
+    TrackState state;
+    unsigned int cellIndex
+        = latticeGeom.findCell(TVecDbl(1.6, 0.4, 0.5), state);
+    TESTER_CHECKFORPASS(latticeGeom.getUserIdFromCellIndex(cellIndex) == 20);
+    TESTER_CHECKFORPASS(state.levels.size() == 2);
+    TESTER_CHECKFORPASS(state.levels[1].element[0] == 1
+                        && state.levels[1].element[1] == 0);
+    TESTER_CHECKFORPASS(softEquiv(state.levels[1].origin[0], 1.5));
+    TESTER_CHECKFORPASS(latticeGeom.getUserIdFromCellIndex(
+                latticeGeom.findCell(TVecDbl(1.1, 1.9, 0.5))) == 21);
+
+    // tracking through the lattice crosses the same boundaries as tracking
+    // through the pins placed one by one
+    bool matches = true;
+    unsigned int numCrossings = 0;
+
+    std::srand(1357);
+    for (int n = 0; n < 200; ++n) {
+        TVecDbl position;
+        TVecDbl direction;
+        for (int d = 0; d < 3; ++d) {
+            position[d]  = (d == 2 ? 1.0 : 2.0)
+                            * (std::rand() / (RAND_MAX + 1.0));
+            direction[d] = std::rand() / (RAND_MAX + 1.0) - 0.5;
+        }
+        direction /= std::sqrt(blitz::dot(direction, direction));
+
+        TrackState latticeState;
+        TrackState flatState;
+
+        unsigned int latticeCell = latticeGeom.findCell(position,
+                                                        latticeState);
+        unsigned int flatCell    = flatGeom.findCell(position);
+        TVecDbl      flatPosition(position);
+
+        MCGeometry::ReturnStatus latticeStatus = MCGeometry::NORMAL;
+        MCGeometry::ReturnStatus flatStatus    = MCGeometry::NORMAL;
+
+        for (int step = 0; step < 20 && latticeStatus == MCGeometry::NORMAL;
+             ++step)
+        {
+            // pins and moderator have the same IDs, just offset
+            const unsigned int flatId
+                = flatGeom.getUserIdFromCellIndex(flatCell);
+            const unsigned int expectedId
+                = (flatId < 1000 ? 21 - (flatId / 100 - 1) : flatId);
+            if (latticeGeom.getUserIdFromCellIndex(latticeCell) != expectedId)
+                matches = false;
+
+            TVecDbl latticeNewPosition;
+            TVecDbl flatNewPosition;
+            double  latticeDistance;
+            double  flatDistance;
+
+            latticeGeom.findNewCell(position, direction, latticeCell,
+                    latticeNewPosition, latticeCell, latticeDistance,
+                    latticeStatus, latticeState);
+            flatGeom.findNewCell(flatPosition, direction, flatCell,
+                    flatNewPosition, flatCell, flatDistance,
+                    flatStatus, flatState);
+
+            if (latticeStatus != flatStatus
+                    || std::fabs(latticeDistance - flatDistance) > 1.e-10)
+                matches = false;
+
+            position     = latticeNewPosition;
+            flatPosition = flatNewPosition;
+            ++numCrossings;
+        }
+
+        if (latticeStatus != MCGeometry::DEADCELL)
+            matches = false;
+    }
+
+    TESTER_CHECKFORPASS(matches);
+    TESTER_CHECKFORPASS(numCrossings > 400);
+
+    // a cylinder of hexagonal pins, heading out from the central one
+    MCGeometry hexGeom;
+    hexGeom.addSurface(1, CylinderZ(TVecDbl(0.0, 0.0, 0.0), 1.1));
+    hexGeom.addSurface(2, PlaneZ(0.0));
+    hexGeom.addSurface(3, PlaneZ(1.0));
+    hexGeom.addSurface(4, CylinderZ(TVecDbl(0.0, 0.0, 0.0), 0.3));
+
+    intVec theSurfaces(3);
+    theSurfaces[0] = -1;
+    theSurfaces[1] =  2;
+    theSurfaces[2] = -3;
+    hexGeom.addCell(1000, theSurfaces, Cell::generateFlags(true, true));
+    hexGeom.addCell(10, theSurfaces);
+    hexGeom.fillCell(10, 5);
+
+    hexGeom.addCell(20, intVec(1, -4), Cell::NONE, 1);
+    hexGeom.addCell(21, intVec(1,  4), Cell::NONE, 1);
+    hexGeom.addHexagonalLattice(5, TVecDbl(0.0, 0.0, 0.0), 1.0, 1.0, 2, 1,
+                                MCGeometry::UniverseIdVec(9, 1));
+    hexGeom.completedGeometryInput();
+
+    TESTER_CHECKFORPASS(hexGeom.getUserIdFromCellIndex(
+                hexGeom.findCell(TVecDbl(0.6, 0.9, 0.5))) == 20);
+
+    TrackState hexState;
+    TVecDbl position(0.0, 0.0, 0.5);
+    const TVecDbl direction(1.0, 0.0, 0.0);
+    cellIndex = hexGeom.findCell(position, hexState);
+
+    const double expectedDistances[4] = {0.3, 0.2, 0.2, 0.4};
+    const unsigned int expectedIds[4] = {21, 21, 20, 1000};
+    MCGeometry::ReturnStatus returnStatus = MCGeometry::NORMAL;
+
+    matches = true;
+    for (int step = 0; step < 4; ++step) {
+        double distance;
+        hexGeom.findNewCell(position, direction, cellIndex, position,
+                            cellIndex, distance, returnStatus, hexState);
+
+        if (!softEquiv(distance, expectedDistances[step])
+                || hexGeom.getUserIdFromCellIndex(cellIndex)
+                        != expectedIds[step])
+            matches = false;
+    }
+    TESTER_CHECKFORPASS(matches);
+    TESTER_CHECKFORPASS(returnStatus == MCGeometry::DEADCELL);
+
+    // a universe that fills a cell inside itself
+    bool caughtError = false;
+    try {
+        MCGeometry badGeom;
+        createPinArray(badGeom, true);
+        badGeom.fillCell(21, 2);
+        badGeom.completedGeometryInput();
+    }
+    catch (tranSupport::tranError &theErr) {
+        caughtError = true;
+    }
+    TESTER_CHECKFORPASS(caughtError);
+}
+
+/*============================================================================*/
+void testFillTransforms() {
+    MCGeometry theGeom;
+
+    // a box around a cell filled by a half-space universe
+    theGeom.addSurface(1,  PlaneX(-1.0));
+    theGeom.addSurface(2,  PlaneX( 1.0));
+    theGeom.addSurface(3,  PlaneY(-1.0));
+    theGeom.addSurface(4,  PlaneY( 1.0));
+    theGeom.addSurface(5,  PlaneZ(-1.0));
+    theGeom.addSurface(6,  PlaneZ( 1.0));
+    theGeom.addSurface(11, PlaneX(0.25));
+
+    intVec theSurfaces(6);
+    for (int i = 0; i < 3; ++i) {
+        theSurfaces[2 * i]     =  (1 + 2 * i);
+        theSurfaces[2 * i + 1] = -(2 + 2 * i);
+    }
+    theGeom.addCell(1000, theSurfaces, Cell::generateFlags(true, true));
+    theGeom.addCell(10, theSurfaces);
+
+    theGeom.addCell(20, intVec(1, -11), Cell::NONE, 1);
+    theGeom.addCell(21, intVec(1,  11), Cell::NONE, 1);
+
+    // the universe's x axis points along y, so its plane is at y = 0.25
+    const TVecDbl axes[3] = {TVecDbl( 0.0, 1.0, 0.0),
+                             TVecDbl(-1.0, 0.0, 0.0),
+                             TVecDbl( 0.0, 0.0, 1.0)};
+    theGeom.fillCell(10, 1, TVecDbl(0.5, 0.0, 0.0), axes);
+    theGeom.completedGeometryInput();
+
+    TESTER_CHECKFORPASS(theGeom.getUserIdFromCellIndex(
+                theGeom.findCell(TVecDbl(0.9,  0.3, 0.0))) == 21);
+    TESTER_CHECKFORPASS(theGeom.getUserIdFromCellIndex(
+                theGeom.findCell(TVecDbl(0.9,  0.2, 0.0))) == 20);
+    TESTER_CHECKFORPASS(theGeom.getUserIdFromCellIndex(
+                theGeom.findCell(TVecDbl(-0.9, 0.2, 0.0))) == 20);
+
+    TrackState state;
+    TVecDbl position(0.3, -0.5, 0.0);
+    const TVecDbl direction(0.0, 1.0, 0.0);
+    unsigned int cellIndex = theGeom.findCell(position, state);
+
+    // the box's lower y plane is nearer than the universe's plane
+    TESTER_CHECKFORPASS(
+        softEquiv(theGeom.findSafetyDistance(position, cellIndex), 0.5));
+    TESTER_CHECKFORPASS(
+        softEquiv(theGeom.findSafetyDistance(position, cellIndex, state),
+                  0.5));
+
+    // a state for some other cell is ignored, and a wrong cell found from
+    // the position is an error
+    const TVecDbl otherPosition(0.3, 0.5, 0.0);
+    const unsigned int otherCellIndex = theGeom.findCell(otherPosition);
+    TESTER_CHECKFORPASS(softEquiv(
+            theGeom.findSafetyDistance(otherPosition, otherCellIndex, state),
+            0.25));
+
+    bool caughtError = false;
+    try {
+        theGeom.findSafetyDistance(otherPosition, cellIndex, TrackState());
+    }
+    catch (tranSupport::tranError &theErr) {
+        caughtError = true;
+    }
+    TESTER_CHECKFORPASS(caughtError);
+
+    TVecDbl newPosition;
+    unsigned int newCellIndex;
+    double distance;
+    MCGeometry::ReturnStatus returnStatus;
+
+    theGeom.findNewCell(position, direction, cellIndex, newPosition,
+                        newCellIndex, distance, returnStatus, state);
+    TESTER_CHECKFORPASS(softEquiv(distance, 0.75));
+    TESTER_CHECKFORPASS(theGeom.getUserIdFromCellIndex(newCellIndex) == 21);
+
+    // the crossed surface's normal is turned back into global coordinates
+    MCGeometry::UserSurfaceIdType surfaceId;
+    double dotProduct;
+    theGeom.getSurfaceCrossing(newPosition, direction, surfaceId, dotProduct,
+                               state);
+    TESTER_CHECKFORPASS(surfaceId == 11);
+    TESTER_CHECKFORPASS(softEquiv(std::fabs(dotProduct), 1.0));
+
+    theGeom.findNewCell(newPosition, direction, newCellIndex, position,
+                        cellIndex, distance, returnStatus, state);
+    TESTER_CHECKFORPASS(softEquiv(distance, 0.75));
+    TESTER_CHECKFORPASS(returnStatus == MCGeometry::DEADCELL);
+
+    // axes have to be orthonormal
+    const TVecDbl skewedAxes[3] = {TVecDbl(1.0, 0.1, 0.0),
+                                   TVecDbl(0.0, 1.0, 0.0),
+                                   TVecDbl(0.0, 0.0, 1.0)};
+    caughtError = false;
+    try {
+        MCGeometry badGeom;
+        badGeom.addSurface(1, PlaneX(0.0));
+        badGeom.addCell(10, intVec(1, 1));
+        badGeom.addCell(20, intVec(1, 1), Cell::NONE, 1);
+        badGeom.fillCell(10, 1, TVecDbl(0.0), skewedAxes);
+    }
+    catch (tranSupport::tranError &theErr) {
+        caughtError = true;
+    }
+    TESTER_CHECKFORPASS(caughtError);
+}
+/*----------------------------------------------------------------------------*/
+void testSensesThroughFill() {
+    MCGeometry theGeom;
+
+    // a sphere filled by a shifted universe that is cut by the same sphere,
+    // so the particle is on it where it enters the filled cell, but not in
+    // the universe's coordinates
+    theGeom.addSurface(1,  PlaneX(-2.0));
+    theGeom.addSurface(2,  PlaneX( 2.0));
+    theGeom.addSurface(3,  PlaneY(-2.0));
+    theGeom.addSurface(4,  PlaneY( 2.0));
+    theGeom.addSurface(5,  PlaneZ(-2.0));
+    theGeom.addSurface(6,  PlaneZ( 2.0));
+    theGeom.addSurface(10, SphereO(1.0));
+
+    intVec theSurfaces(6);
+    for (int i = 0; i < 3; ++i) {
+        theSurfaces[2 * i]     =  (1 + 2 * i);
+        theSurfaces[2 * i + 1] = -(2 + 2 * i);
+    }
+    theGeom.addCell(1000, theSurfaces, Cell::generateFlags(true, true));
+    theSurfaces.push_back(10);
+    theGeom.addCell(11, theSurfaces);
+    theGeom.addCell(10, intVec(1, -10));
+
+    theGeom.addCell(20, intVec(1, -10), Cell::NONE, 1);
+    theGeom.addCell(21, intVec(1,  10), Cell::NONE, 1);
+    theGeom.fillCell(10, 1, TVecDbl(0.5, 0.0, 0.0));
+    theGeom.completedGeometryInput();
+
+    // follow one particle with and without tracking senses (starting over
+    // at every step would have to find the cell from a point on the sphere)
+    TrackState flightState;
+    TrackState plainState;
+    flightState.trackSenses = true;
+
+    const TVecDbl direction(1.0, 0.0, 0.0);
+    TVecDbl       position(-1.5, 0.1, 0.0);
+    TVecDbl       plainPosition(position);
+    unsigned int  cellIndex = theGeom.findCell(position, flightState);
+    unsigned int  plainCellIndex = theGeom.findCell(position, plainState);
+
+    bool matches = true;
+    unsigned int numCrossings = 0;
+    MCGeometry::ReturnStatus returnStatus = MCGeometry::NORMAL;
+
+    while (returnStatus == MCGeometry::NORMAL && numCrossings < 10) {
+        TVecDbl      newPosition;
+        unsigned int newCellIndex;
+        double       distance;
+
+        theGeom.findNewCell(position, direction, cellIndex, newPosition,
+                            newCellIndex, distance, returnStatus,
+                            flightState);
+
+        TVecDbl      plainNewPosition;
+        unsigned int plainNewCellIndex;
+        double       plainDistance;
+        MCGeometry::ReturnStatus plainReturnStatus;
+
+        theGeom.findNewCell(plainPosition, direction, plainCellIndex,
+                            plainNewPosition, plainNewCellIndex,
+                            plainDistance, plainReturnStatus, plainState);
+
+        if (newCellIndex != plainNewCellIndex
+                || returnStatus != plainReturnStatus
+                || !softEquiv(distance, plainDistance, 1e-12))
+        {
+            matches = false;
+        }
+
+        position       = newPosition;
+        plainPosition  = plainNewPosition;
+        cellIndex      = newCellIndex;
+        plainCellIndex = plainNewCellIndex;
+        ++numCrossings;
+    }
+
+    // into the sphere, into the shifted one, out of the first, and out of
+    // the box
+    TESTER_CHECKFORPASS(matches);
+    TESTER_CHECKFORPASS(returnStatus == MCGeometry::DEADCELL);
+    TESTER_CHECKFORPASS(numCrossings == 4);
+}
+
+/*============================================================================*/
+//! A box filled by one of two half-space universes (both are always defined)
+void createFilledBox( MCGeometry& theGeom, const unsigned int fill) {
+    theGeom.addSurface(1,  PlaneX(-1.0));
+    theGeom.addSurface(2,  PlaneX( 1.0));
+    theGeom.addSurface(3,  PlaneY(-1.0));
+    theGeom.addSurface(4,  PlaneY( 1.0));
+    theGeom.addSurface(5,  PlaneZ(-1.0));
+    theGeom.addSurface(6,  PlaneZ( 1.0));
+    theGeom.addSurface(11, PlaneX(0.25));
+    theGeom.addSurface(12, PlaneY(0.25));
+
+    intVec theSurfaces(6);
+    for (int i = 0; i < 3; ++i) {
+        theSurfaces[2 * i]     =  (1 + 2 * i);
+        theSurfaces[2 * i + 1] = -(2 + 2 * i);
+    }
+    theGeom.addCell(1000, theSurfaces, Cell::generateFlags(true, true));
+    theGeom.addCell(10, theSurfaces);
+
+    theGeom.addCell(20, intVec(1, -11), Cell::NONE, 1);
+    theGeom.addCell(21, intVec(1,  11), Cell::NONE, 1);
+    theGeom.addCell(30, intVec(1, -12), Cell::NONE, 2);
+    theGeom.addCell(31, intVec(1,  12), Cell::NONE, 2);
+
+    theGeom.fillCell(10, fill);
+    theGeom.completedGeometryInput();
+
+    // learn a neighbor across the universe's plane
+    TrackState state;
+    const TVecDbl position(-0.5, -0.5, 0.0);
+    const TVecDbl direction(1.0 / std::sqrt(2.0), 1.0 / std::sqrt(2.0), 0.0);
+    const unsigned int cellIndex = theGeom.findCell(position, state);
+
+    TVecDbl newPosition;
+    unsigned int newCellIndex;
+    double distance;
+    MCGeometry::ReturnStatus returnStatus;
+
+    theGeom.findNewCell(position, direction, cellIndex, newPosition,
+                        newCellIndex, distance, returnStatus, state);
+    TESTER_CHECKFORPASS(theGeom.getUserIdFromCellIndex(newCellIndex)
+                            == (fill == 1 ? 21u : 31u));
+}
+
+void testFilledConnectivityFile() {
+    const char xFillFile[] = "tMCGeometry_xfill.bin";
+    const char yFillFile[] = "tMCGeometry_yfill.bin";
+
+    MCGeometry xFillGeom;
+    createFilledBox(xFillGeom, 1);
+    xFillGeom.writeConnectivity(xFillFile);
+
+    MCGeometry yFillGeom;
+    createFilledBox(yFillGeom, 2);
+    yFillGeom.writeConnectivity(yFillFile);
+
+    // the same cells and surfaces, filled differently, are a different model
+    TESTER_CHECKFORPASS(
+            xFillGeom.getGeometryHash() != yFillGeom.getGeometryHash());
+    TESTER_CHECKFORPASS(!xFillGeom.readConnectivity(yFillFile));
+    TESTER_CHECKFORPASS(!yFillGeom.readConnectivity(xFillFile));
+
+    MCGeometry sameGeom;
+    createFilledBox(sameGeom, 1);
+    TESTER_CHECKFORPASS(
+            sameGeom.getGeometryHash() == xFillGeom.getGeometryHash());
+    TESTER_CHECKFORPASS(sameGeom.readConnectivity(xFillFile));
+
+    std::remove(xFillFile);
+    std::remove(yFillFile);
+}
+
+/*============================================================================*/
+//! Square pins of pitch one in a slab from z = 0 to 1: either one unit cell
+//! with periodic sides, or an n by n array of them starting at the origin
+void createPinSlab( MCGeometry& theGeom, const int numPins) {
+    theGeom.addSurface(1, PlaneZ(0.0));
+    theGeom.addSurface(2, PlaneZ(1.0));
+
+    intVec theSurfaces;
+    for (int i = 0; i <= numPins; ++i) {
+        theGeom.addSurface(10 + i,  PlaneX(i));
+        theGeom.addSurface(100 + i, PlaneY(i));
+    }
+
+    for (int j = 0; j < numPins; ++j) {
+        for (int i = 0; i < numPins; ++i) {
+            const int pin = i + numPins * j;
+            theGeom.addSurface(1000 + pin,
+                    CylinderZ(TVecDbl(0.5 + i, 0.5 + j, 0.0), 0.3));
+
+            theSurfaces.resize(3);
+            theSurfaces[0] = -(1000 + pin);
+            theSurfaces[1] =  1;
+            theSurfaces[2] = -2;
+            theGeom.addCell(2000 + pin, theSurfaces);
+
+            theSurfaces.resize(7);
+            theSurfaces[0] =  (10 + i);
+            theSurfaces[1] = -(11 + i);
+            theSurfaces[2] =  (100 + j);
+            theSurfaces[3] = -(101 + j);
+            theSurfaces[4] =  1;
+            theSurfaces[5] = -2;
+            theSurfaces[6] =  (1000 + pin);
+            theGeom.addCell(3000 + pin, theSurfaces);
+        }
+    }
+
+    theSurfaces.resize(6);
+    theSurfaces[0] =  10;
+    theSurfaces[1] = -(10 + numPins);
+    theSurfaces[2] =  100;
+    theSurfaces[3] = -(100 + numPins);
+    theSurfaces[4] =  1;
+    theSurfaces[5] = -2;
+    theGeom.addCell(1, theSurfaces, Cell::generateFlags(true, true));
+}
+
+void testPeriodicSurfaces() {
+    MCGeometry unitGeom;
+    createPinSlab(unitGeom, 1);
+    unitGeom.addPeriodicPair(10,  11);
+    unitGeom.addPeriodicPair(100, 101);
+    unitGeom.completedGeometryInput();
+
+    // up through the top into the bottom of the cell
+    TrackState state;
+    TVecDbl position(0.5, 0.9, 0.5);
+    const TVecDbl direction(0.0, 1.0, 0.0);
+    unsigned int cellIndex = unitGeom.findCell(position);
+
+    TVecDbl newPosition;
+    unsigned int newCellIndex;
+    double distance;
+    MCGeometry::ReturnStatus returnStatus;
+
+    unitGeom.findNewCell(position, direction, cellIndex, newPosition,
+                         newCellIndex, distance, returnStatus, state);
+    TESTER_CHECKFORPASS(softEquiv(distance, 0.1));
+    TESTER_CHECKFORPASS(returnStatus == MCGeometry::PERIODIC);
+    TESTER_CHECKFORPASS(newCellIndex == cellIndex);
+    TESTER_CHECKFORPASS(softEquiv(newPosition[1], 0.0));
+
+    unitGeom.findNewCell(newPosition, direction, newCellIndex, position,
+                         cellIndex, distance, returnStatus, state);
+    TESTER_CHECKFORPASS(softEquiv(distance, 0.2));
+    TESTER_CHECKFORPASS(unitGeom.getUserIdFromCellIndex(cellIndex) == 2000);
+
+    // the unit cell acts like a big array of pins
+    MCGeometry arrayGeom;
+    createPinSlab(arrayGeom, 9);
+    arrayGeom.completedGeometryInput();
+
+    bool matches = true;
+    unsigned int numPeriodic = 0;
+
+    std::srand(8642);
+    for (int n = 0; n < 100; ++n) {
+        TVecDbl unitPosition;
+        TVecDbl direction;
+        for (int d = 0; d < 3; ++d) {
+            unitPosition[d] = std::rand() / (RAND_MAX + 1.0);
+            direction[d]    = std::rand() / (RAND_MAX + 1.0) - 0.5;
+        }
+        // steep enough to leave the slab before the edge of the array
+        direction[2] = (direction[2] < 0 ? -0.4 : 0.4) + direction[2];
+        direction /= std::sqrt(blitz::dot(direction, direction));
+
+        TVecDbl arrayPosition(unitPosition + 4.0);
+        arrayPosition[2] = unitPosition[2];
+
+        TrackState unitState;
+        TrackState arrayState;
+        unsigned int unitCell  = unitGeom.findCell(unitPosition);
+        unsigned int arrayCell = arrayGeom.findCell(arrayPosition);
+
+        MCGeometry::ReturnStatus unitStatus  = MCGeometry::NORMAL;
+        MCGeometry::ReturnStatus arrayStatus = MCGeometry::NORMAL;
+
+        while (unitStatus == MCGeometry::NORMAL
+                || unitStatus == MCGeometry::PERIODIC)
+        {
+            // pins and moderator have the same IDs, just offset
+            if (unitGeom.getUserIdFromCellIndex(unitCell) / 1000
+                    != arrayGeom.getUserIdFromCellIndex(arrayCell) / 1000)
+                matches = false;
+
+            double unitDistance;
+            double arrayDistance;
+            unitGeom.findNewCell(unitPosition, direction, unitCell,
+                    unitPosition, unitCell, unitDistance, unitStatus,
+                    unitState);
+            arrayGeom.findNewCell(arrayPosition, direction, arrayCell,
+                    arrayPosition, arrayCell, arrayDistance, arrayStatus,
+                    arrayState);
+
+            if (std::fabs(unitDistance - arrayDistance) > 1.e-10)
+                matches = false;
+
+            if (unitStatus == MCGeometry::PERIODIC) {
+                ++numPeriodic;
+            } else if (unitStatus != arrayStatus) {
+                matches = false;
+            }
+        }
+
+        if (unitStatus != MCGeometry::DEADCELL)
+            matches = false;
+    }
+
+    TESTER_CHECKFORPASS(matches);
+    TESTER_CHECKFORPASS(numPeriodic > 20);
+
+    // periodic surfaces have to be parallel
+    bool caughtError = false;
+    try {
+        MCGeometry badGeom;
+        createPinSlab(badGeom, 1);
+        badGeom.addPeriodicPair(10, 100);
+    }
+    catch (tranSupport::tranError &theErr) {
+        caughtError = true;
+    }
+    TESTER_CHECKFORPASS(caughtError);
+}
+
 /*============================================================================*/
 void createReflectingGeometry( MCGeometry& theGeom) {
     /* * * create sphere * * */
@@ -425,7 +2282,32 @@ int main(int, char**) {
     TESTER_INIT("MCGeometry");
     try {
         testGeometryErrorChecking();
-        testMainGeometry();
+        testMainGeometry(false);
+        testMainGeometry(true);
+        testCompletedGeometryErrorChecking();
+        testTrackState();
+        testSharedGeometry();
+        testPrecomputedConnectivity();
+        testHugePageGeometry();
+        testConnectivityFile();
+        testBinaryGeometry();
+        testBinarySurfaceTypes();
+        testGlobalSearch(false);
+        testGlobalSearch(true);
+        testSortNeighborhoods();
+        testBatchedTransport();
+        testBatchedSurfaceTypes();
+        testBatchedGrid();
+        testStraightFlight();
+        testSensesThroughPins();
+        testSafetyDistance();
+        testLimitedDistance();
+        testStructuredGrid();
+        testLattice();
+        testFillTransforms();
+        testSensesThroughFill();
+        testFilledConnectivityFile();
+        testPeriodicSurfaces();
         testReflectingGeometry();
     }
     catch (tranSupport::tranError &theErr) {
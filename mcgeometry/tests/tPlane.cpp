@@ -122,6 +122,10 @@ void testReflPlane() {
     thePlane.normalAtPoint(center, returnedNormalVector);
     TESTER_CHECKFORPASS( softEquiv(returnedNormalVector, normal) );
 
+    TESTER_CHECKFORPASS( thePlane.safetyDistance(center) == 0.0 );
+    TESTER_CHECKFORPASS( softEquiv(thePlane.safetyDistance(TVecDbl(0.0)),
+                                   2 * normal[0]) );
+
     /********************/
     Surface* newPlane = thePlane.clone(223);
 
@@ -64,6 +64,10 @@ void testPlaneX() {
     TESTER_CHECKFORPASS(didHit == true);
     TESTER_CHECKFORPASS(softEquiv(distance, 0.559016994374947));
 
+    TESTER_CHECKFORPASS(softEquiv(thePlane.safetyDistance(particleLoc), 0.5));
+    particleLoc[0] = 0.25;
+    TESTER_CHECKFORPASS(softEquiv(thePlane.safetyDistance(particleLoc), 0.75));
+
     /********************/
     Surface* newPlane = thePlane.clone(123);
 
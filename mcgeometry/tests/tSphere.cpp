@@ -18,6 +18,7 @@
 #include "transupport/SoftEquiv.hpp"
 
 using mcGeometry::Sphere;
+using mcGeometry::SphereO;
 using mcGeometry::Surface;
 
 using std::cout;
@@ -89,6 +90,18 @@ void runTests() {
 
     TESTER_CHECKFORPASS(didHit == false);
 
+    /********************/
+    // distance to the nearest point on the sphere, from inside and outside
+    TESTER_CHECKFORPASS(
+        softEquiv(theSphere.safetyDistance(TVecDbl(1.5, 0.0, 0.0)), 1.5));
+    TESTER_CHECKFORPASS(
+        softEquiv(theSphere.safetyDistance(TVecDbl(1.0, 0.0, -5.0)), 3.0));
+    TESTER_CHECKFORPASS(theSphere.safetyDistance(TVecDbl(3.0, 0.0, 0.0)) == 0);
+
+    SphereO originSphere(2.0);
+    TESTER_CHECKFORPASS(
+        softEquiv(originSphere.safetyDistance(TVecDbl(0.0, 0.5, 0.0)), 1.5));
+
     /********************/
     Surface* newSphere = theSphere.clone(182);
 
@@ -0,0 +1,159 @@
+/*!
+ * \file tStructuredGrid.cpp
+ * \brief Unit tests for StructuredGrid
+ * \author Seth R. Johnson
+ */
+
+/*----------------------------------------------------------------------------*/
+
+#include "mcgeometry/StructuredGrid.hpp"
+
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include "transupport/dbc.hpp"
+#include "transupport/UnitTester.hpp"
+
+using namespace mcGeometry;
+
+using std::cout;
+using std::endl;
+
+typedef StructuredGrid::TVecDbl TVecDbl;
+typedef std::vector<StructuredGrid::Box>       BoxVec;
+typedef std::vector<StructuredGrid>            GridVec;
+typedef std::vector<StructuredGrid::Placement> PlacementVec;
+
+//! Boxes for an nx by ny by 1 grid with unit spacing; surfaces along x are
+//! numbered from 0, along y from 100, and along z from 200
+BoxVec makeBoxes(const unsigned int nx, const unsigned int ny) {
+    BoxVec boxes;
+    for (unsigned int j = 0; j < ny; ++j) {
+        for (unsigned int i = 0; i < nx; ++i) {
+            StructuredGrid::Box box;
+            box.cell = boxes.size();
+            box.lowerSurface[0] = i;
+            box.upperSurface[0] = i + 1;
+            box.lowerSurface[1] = 100 + j;
+            box.upperSurface[1] = 101 + j;
+            box.lowerSurface[2] = 200;
+            box.upperSurface[2] = 201;
+            box.lower[0] = i;
+            box.upper[0] = i + 1;
+            box.lower[1] = j;
+            box.upper[1] = j + 1;
+            box.lower[2] = 0.0;
+            box.upper[2] = 1.0;
+            boxes.push_back(box);
+        }
+    }
+    return boxes;
+}
+
+/*============================================================================*/
+void testCompleteGrid() {
+    // give them out of order
+    BoxVec boxes = makeBoxes(3, 2);
+    std::swap(boxes[0], boxes[4]);
+
+    GridVec      grids;
+    PlacementVec placements;
+    StructuredGrid::findGrids(boxes, grids, placements);
+
+    TESTER_CHECKFORPASS(grids.size() == 1);
+    TESTER_CHECKFORPASS(placements.size() == boxes.size());
+
+    const StructuredGrid& grid = grids.front();
+    TESTER_CHECKFORPASS(grid.getSize(0) == 3);
+    TESTER_CHECKFORPASS(grid.getSize(1) == 2);
+    TESTER_CHECKFORPASS(grid.getSize(2) == 1);
+    TESTER_CHECKFORPASS(grid.getNumCells() == 6);
+    TESTER_CHECKFORPASS(grid.getSurface(0, 3) == 3);
+    TESTER_CHECKFORPASS(grid.getSurface(1, 0) == 100);
+
+    bool placedCorrectly = true;
+    for (unsigned int b = 0; b < boxes.size(); ++b) {
+        const StructuredGrid::Placement& placement = placements[b];
+        if (placement.grid != 0
+                || placement.index[0] != boxes[b].lowerSurface[0]
+                || placement.index[1] != boxes[b].lowerSurface[1] - 100
+                || placement.index[2] != 0
+                || grid.getCell(placement.index) != boxes[b].cell)
+            placedCorrectly = false;
+    }
+    TESTER_CHECKFORPASS(placedCorrectly);
+
+    // the nearest wall heading up and to the left
+    const unsigned int index[3] = {1, 0, 0};
+    unsigned int axis;
+    bool isUpper;
+    double distance;
+    grid.findWall(index, TVecDbl(1.5, 0.75, 0.5), TVecDbl(-0.6, 0.8, 0.0),
+                  axis, isUpper, distance);
+    TESTER_CHECKFORPASS(axis == 1);
+    TESTER_CHECKFORPASS(isUpper);
+    TESTER_CHECKFORPASS(distance == 0.25 / 0.8);
+
+    // points on the lower plane are inside, on the upper plane are not
+    TESTER_CHECKFORPASS(grid.contains(0, 1, 1.0));
+    TESTER_CHECKFORPASS(!grid.contains(0, 1, 2.0));
+}
+
+/*============================================================================*/
+void testIncompleteGrids() {
+    GridVec      grids;
+    PlacementVec placements;
+
+    // a hole in the middle
+    BoxVec boxes = makeBoxes(3, 3);
+    boxes.erase(boxes.begin() + 4);
+    StructuredGrid::findGrids(boxes, grids, placements);
+    TESTER_CHECKFORPASS(grids.empty());
+    TESTER_CHECKFORPASS(placements.size() == boxes.size());
+    TESTER_CHECKFORPASS(placements[0].grid == StructuredGrid::NO_GRID);
+
+    // a lone box is not worth a grid
+    boxes = makeBoxes(1, 1);
+    StructuredGrid::findGrids(boxes, grids, placements);
+    TESTER_CHECKFORPASS(grids.empty());
+
+    // two separate rows are two grids
+    boxes = makeBoxes(2, 1);
+    BoxVec otherRow = makeBoxes(2, 1);
+    for (unsigned int b = 0; b < otherRow.size(); ++b) {
+        StructuredGrid::Box& box = otherRow[b];
+        box.cell += 2;
+        box.lowerSurface[2] = 300;
+        box.upperSurface[2] = 301;
+        box.lower[2] = 5.0;
+        box.upper[2] = 6.0;
+        boxes.push_back(box);
+    }
+    StructuredGrid::findGrids(boxes, grids, placements);
+    TESTER_CHECKFORPASS(grids.size() == 2);
+    TESTER_CHECKFORPASS(placements[0].grid == placements[1].grid);
+    TESTER_CHECKFORPASS(placements[2].grid == placements[3].grid);
+    TESTER_CHECKFORPASS(placements[0].grid != placements[2].grid);
+}
+
+/*============================================================================*/
+int main(int, char**) {
+    TESTER_INIT("StructuredGrid");
+    try {
+        testCompleteGrid();
+        testIncompleteGrids();
+    }
+    catch (tranSupport::tranError &theErr) {
+        cout << "UNEXPECTED ERROR IN UNIT TEST: " << endl
+            << theErr.what() << endl;
+        TESTER_CHECKFORPASS(CAUGHT_UNEXPECTED_EXCEPTION);
+    }
+
+    TESTER_PRINTRESULT();
+
+    if (!TESTER_HASPASSED()) {
+        return 1;
+    }
+
+    return 0;
+}
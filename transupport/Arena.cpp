@@ -0,0 +1,126 @@
+/*!
+ * \file Arena.cpp
+ * \brief Implementation of the bump allocator
+ * \author Seth R. Johnson
+ */
+
+#include "Arena.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#include <stdint.h>
+
+#include <sys/mman.h>
+
+#include "dbc.hpp"
+
+namespace tranSupport {
+/*----------------------------------------------------------------------------*/
+const std::size_t Arena::HUGE_PAGE_SIZE;
+
+/*----------------------------------------------------------------------------*/
+Arena::Arena(
+        const PageKind pages,
+        const std::size_t blockSize) :
+    _pages(pages),
+    _blockSize(blockSize),
+    _next(NULL),
+    _end(NULL),
+    _bytesUsed(0)
+{
+    Require(blockSize > 0);
+}
+
+/*----------------------------------------------------------------------------*/
+Arena::~Arena()
+{
+    for (std::vector<Block>::iterator it = _blocks.begin();
+                                      it != _blocks.end(); ++it)
+    {
+        if (it->isMapped)
+            munmap(it->begin, it->size);
+        else
+            std::free(it->begin);
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+void* Arena::allocate(
+        const std::size_t bytes,
+        const std::size_t alignment)
+{
+    Require(alignment > 0 && (alignment & (alignment - 1)) == 0);
+
+    // padding needed to align the next free byte
+    std::size_t padding
+        = -reinterpret_cast<uintptr_t>(_next) & (alignment - 1);
+
+    if (_next == NULL
+            || static_cast<std::size_t>(_end - _next) < padding + bytes)
+    {
+        // blocks start on at least a cache line, so worst-case padding is
+        // only needed for stricter alignments
+        _addBlock(bytes + alignment);
+        padding = -reinterpret_cast<uintptr_t>(_next) & (alignment - 1);
+    }
+
+    char* result = _next + padding;
+    _next       = result + bytes;
+    _bytesUsed += padding + bytes;
+
+    Ensure(_next <= _end);
+    return result;
+}
+
+/*----------------------------------------------------------------------------*/
+void Arena::_addBlock(const std::size_t minBytes)
+{
+    Block block;
+    block.size     = std::max(_blockSize, minBytes);
+    block.begin    = NULL;
+    block.isMapped = false;
+
+    if (_pages != NORMAL_PAGES) {
+        // huge pages come in whole pages
+        block.size = (block.size + HUGE_PAGE_SIZE - 1)
+                     / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    }
+
+#ifdef MAP_HUGETLB
+    if (_pages == EXPLICIT_HUGE_PAGES) {
+        void* address = mmap(NULL, block.size, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+                             -1, 0);
+        if (address != MAP_FAILED) {
+            block.begin    = static_cast<char*>(address);
+            block.isMapped = true;
+        }
+    }
+#endif
+
+    if (block.begin == NULL) {
+        // transparent huge pages need the block to be aligned to one
+        const std::size_t blockAlignment
+            = (_pages == NORMAL_PAGES ? 64 : HUGE_PAGE_SIZE);
+
+        void* address = NULL;
+        if (posix_memalign(&address, blockAlignment, block.size) != 0)
+            throw std::bad_alloc();
+
+        block.begin = static_cast<char*>(address);
+
+#ifdef MADV_HUGEPAGE
+        if (_pages != NORMAL_PAGES)
+            madvise(address, block.size, MADV_HUGEPAGE);
+#endif
+    }
+
+    _blocks.push_back(block);
+
+    _next = block.begin;
+    _end  = block.begin + block.size;
+}
+
+/*============================================================================*/
+} // end namespace tranSupport
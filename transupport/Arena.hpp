@@ -0,0 +1,121 @@
+/*!
+ * \file Arena.hpp
+ * \brief Bump allocator that hands out memory in insertion order
+ * \author Seth R. Johnson
+ */
+
+#ifndef TS_ARENA_HPP
+#define TS_ARENA_HPP
+/*----------------------------------------------------------------------------*/
+
+#include <cstddef>
+#include <vector>
+
+namespace tranSupport {
+/*============================================================================*/
+/*!
+ * \class Arena
+ * \brief Place many small objects contiguously and free them all at once.
+ *
+ * Memory is carved off the end of large blocks, one allocation after the
+ * other, so objects made in sequence sit next to each other in memory. There
+ * is no way to free a single allocation: all the blocks are released when
+ * the arena is destroyed. Destructors are not called; whoever constructs an
+ * object in the arena with placement new must call its destructor if it
+ * needs one.
+ *
+ * The blocks can be backed by huge pages, which lets a large model's objects
+ * be reached with far fewer TLB entries. Transparent huge pages are
+ * requested with \c madvise (the kernel may or may not grant them); explicit
+ * ones come from the \c hugetlbfs pool with \c mmap, and if that fails
+ * (usually because no pages were reserved) the block is allocated as if
+ * transparent huge pages had been requested. On systems without either,
+ * normal pages are used.
+ *
+ * An arena is not thread-safe.
+ */
+class Arena {
+public:
+    //! What kind of pages to back the blocks with
+    enum PageKind {
+        NORMAL_PAGES = 0,       //!< Whatever the system allocator gives
+        TRANSPARENT_HUGE_PAGES, //!< Ask the kernel to use huge pages
+        EXPLICIT_HUGE_PAGES     //!< Take reserved huge pages if there are any
+    };
+
+    //! Size of a huge page, and of the default block
+    static const std::size_t HUGE_PAGE_SIZE = 2u << 20;
+
+public:
+    //! Create an empty arena; no memory is allocated until it's needed.
+    explicit Arena(const PageKind pages = NORMAL_PAGES,
+                   const std::size_t blockSize = HUGE_PAGE_SIZE);
+
+    //! Release every block.
+    ~Arena();
+
+    /*!
+     * \brief Get uninitialized memory.
+     *
+     * The alignment must be a power of two. A request bigger than the block
+     * size gets a block of its own.
+     */
+    void* allocate(const std::size_t bytes, const std::size_t alignment);
+
+    //! Get uninitialized memory for one object of type T.
+    template<typename T>
+    void* allocate() {
+        return allocate(sizeof(T), alignof(T));
+    }
+
+    //! What kind of pages were asked for.
+    PageKind getPageKind() const {
+        return _pages;
+    }
+
+    //! Number of blocks allocated so far.
+    std::size_t getNumBlocks() const {
+        return _blocks.size();
+    }
+
+    //! Number of bytes handed out (including alignment padding).
+    std::size_t getBytesUsed() const {
+        return _bytesUsed;
+    }
+
+private:
+    //! Disallow copying
+    Arena(const Arena&);
+    //! Disallow assignment
+    Arena& operator=(const Arena&);
+
+    //! One piece of memory we got from the system
+    struct Block {
+        //! Start of the block
+        char*       begin;
+        //! Number of bytes in it
+        std::size_t size;
+        //! Whether it came from mmap (rather than the system allocator)
+        bool        isMapped;
+    };
+
+    //! Get a new block with room for at least this many bytes.
+    void _addBlock(const std::size_t minBytes);
+
+    //! Kind of pages to use
+    const PageKind     _pages;
+    //! Size of a new block (unless a request needs more)
+    const std::size_t  _blockSize;
+    //! Every block, in the order it was allocated
+    std::vector<Block> _blocks;
+    //! Next free byte in the newest block
+    char*              _next;
+    //! End of the newest block
+    char*              _end;
+    //! Bytes handed out so far
+    std::size_t        _bytesUsed;
+};
+
+/*============================================================================*/
+} // end namespace tranSupport
+#endif
@@ -0,0 +1,331 @@
+/*!
+ * \file AtomicPointerList.hpp
+ * \brief Append-only list of pointers that keeps the first one inline
+ * \author Seth R. Johnson
+ */
+
+#ifndef TS_ATOMICPOINTERLIST_HPP
+#define TS_ATOMICPOINTERLIST_HPP
+/*----------------------------------------------------------------------------*/
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+namespace tranSupport {
+/*============================================================================*/
+/*!
+ * \class AtomicPointerList
+ * \brief Lock-free, append-only list of unique non-null pointers.
+ *
+ * The first pointer is stored in the list itself rather than in a node on
+ * the heap. A list that only ever holds one value (the common case for cell
+ * neighborhoods) is two words, needs no allocation, and is read without
+ * chasing a pointer.
+ *
+ * Later values are appended to a singly linked chain of nodes. Readers walk
+ * it without taking any locks: every link is published with release
+ * semantics and read with acquire semantics, so a reader sees either the old
+ * end of the chain or a fully constructed new node. Writers append at the
+ * tail with a compare-and-swap, so two threads adding at once never lose a
+ * node, and a value that is already present is never added twice.
+ *
+ * The first value is claimed with a compare-and-swap on the inline slot, so
+ * it is published atomically along with the value itself; NULL marks the
+ * slot as empty and can't be stored.
+ *
+ * Each value also has a count of how often it was the one a reader was
+ * looking for, kept by recordHit(). sortByHits() uses the counts to put the
+ * likeliest values first, so a search that stops at the first match checks
+ * fewer values.
+ *
+ * Nodes are never removed until the list itself is destroyed; destruction,
+ * copying, and sorting must not overlap with any other access.
+ */
+template<typename T>
+class AtomicPointerList {
+private:
+    //! One link in the chain after the first value
+    struct Node {
+        Node(T* v) : value(v), hits(0), next(NULL)
+        { /* * */ }
+
+        T*                                 value;
+        mutable std::atomic<unsigned long> hits;
+        std::atomic<Node*>                 next;
+    };
+
+    //! A value and its count, for sorting
+    typedef std::pair<unsigned long, T*> CountedValue;
+
+public:
+    typedef T*          value_type;
+    typedef std::size_t size_type;
+
+    //! Forward iterator over the values present when each link was read.
+    class const_iterator {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef T*                        value_type;
+        typedef std::ptrdiff_t            difference_type;
+        typedef T* const*                 pointer;
+        typedef T* const&                 reference;
+
+        const_iterator() : _value(NULL), _hits(NULL), _nextLink(NULL)
+        { /* * */ }
+
+        reference operator*() const {
+            return _value;
+        }
+
+        pointer operator->() const {
+            return &_value;
+        }
+
+        const_iterator& operator++() {
+            const Node* node = _nextLink->load(std::memory_order_acquire);
+            if (node != NULL) {
+                _value    = node->value;
+                _hits     = &(node->hits);
+                _nextLink = &(node->next);
+            }
+            else {
+                _value    = NULL;
+                _hits     = NULL;
+                _nextLink = NULL;
+            }
+            return *this;
+        }
+
+        const_iterator operator++(int) {
+            const_iterator old(*this);
+            ++(*this);
+            return old;
+        }
+
+        bool operator==(const const_iterator& other) const {
+            return _nextLink == other._nextLink;
+        }
+
+        bool operator!=(const const_iterator& other) const {
+            return _nextLink != other._nextLink;
+        }
+
+    private:
+        friend class AtomicPointerList;
+
+        const_iterator(T* value,
+                       std::atomic<unsigned long>* hits,
+                       const std::atomic<Node*>* nextLink)
+            : _value(value), _hits(hits), _nextLink(nextLink)
+        { /* * */ }
+
+        //! Current value
+        T*                          _value;
+        //! Count of hits on the current value
+        std::atomic<unsigned long>* _hits;
+        //! Link to the node after the current value (NULL at the end)
+        const std::atomic<Node*>* _nextLink;
+    };
+
+public:
+    //! Create an empty list.
+    AtomicPointerList() : _first(NULL), _firstHits(0), _rest(NULL)
+    { /* * */ }
+
+    //! Deep copy of the values, without their counts (must not be called
+    //! while another thread modifies other).
+    AtomicPointerList(const AtomicPointerList& other)
+        : _first(NULL), _firstHits(0), _rest(NULL)
+    {
+        for (const_iterator it = other.begin(); it != other.end(); ++it)
+            insertUnique(*it);
+    }
+
+    //! Free all the nodes.
+    ~AtomicPointerList() {
+        clear();
+    }
+
+    //! Start of the list.
+    const_iterator begin() const {
+        T* first = _first.load(std::memory_order_acquire);
+        if (first == NULL)
+            return end();
+        return const_iterator(first, &_firstHits, &_rest);
+    }
+
+    //! One past the end of the list.
+    const_iterator end() const {
+        return const_iterator();
+    }
+
+    //! Number of values in the list (walks the list; may be stale).
+    size_type size() const {
+        size_type count = 0;
+        for (const_iterator it = begin(); it != end(); ++it)
+            ++count;
+        return count;
+    }
+
+    //! Whether the list has no values yet.
+    bool empty() const {
+        return (_first.load(std::memory_order_acquire) == NULL);
+    }
+
+    /*!
+     * \brief Add a value to the end of the list if it is not already present.
+     *
+     * Returns whether \c value was added. If \c wasFirst is given, it is set
+     * to whether this call is the one that made the list non-empty, which
+     * lets callers count filled lists without racing on size().
+     */
+    bool insertUnique(T* value, bool* wasFirst = NULL);
+
+    /*!
+     * \brief Count that the value at \c it was the one being looked for.
+     *
+     * This may be called by several threads at once, and while others are
+     * inserting. A list with only one value has nothing to reorder, so it
+     * isn't counted.
+     */
+    void recordHit(const const_iterator& it) const {
+        if (_rest.load(std::memory_order_relaxed) != NULL)
+            it._hits->fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /*!
+     * \brief Put the values with the most hits first.
+     *
+     * Values with equal counts keep their order. Every count is then halved,
+     * so that older hits matter less and the order can follow a change in
+     * which values are looked for. This must not be called concurrently with
+     * anything.
+     */
+    void sortByHits();
+
+    //! Delete all values (must not be called concurrently with anything).
+    void clear();
+
+private:
+    //! Disallow assignment
+    AtomicPointerList& operator=(const AtomicPointerList&);
+
+    //! Order for sortByHits()
+    static bool _hasMoreHits(const CountedValue& a, const CountedValue& b) {
+        return a.first > b.first;
+    }
+
+    //! First value, stored inline
+    std::atomic<T*>                    _first;
+    //! Count of hits on the first value
+    mutable std::atomic<unsigned long> _firstHits;
+    //! Node holding the second value
+    std::atomic<Node*>                 _rest;
+};
+
+/*----------------------------------------------------------------------------*/
+template<typename T>
+bool AtomicPointerList<T>::insertUnique(T* value, bool* wasFirst)
+{
+    if (wasFirst != NULL)
+        *wasFirst = false;
+
+    // try to claim the inline slot; if someone else has, see what they put
+    T* first = NULL;
+    if (_first.compare_exchange_strong(first, value,
+                                       std::memory_order_release,
+                                       std::memory_order_acquire))
+    {
+        if (wasFirst != NULL)
+            *wasFirst = true;
+        return true;
+    }
+    if (first == value)
+        return false;
+
+    Node* newNode = NULL;
+    std::atomic<Node*>* link = &_rest;
+
+    while (true) {
+        // walk to the current end of the list, checking for duplicates
+        Node* current = link->load(std::memory_order_acquire);
+        while (current != NULL) {
+            if (current->value == value) {
+                delete newNode;
+                return false;
+            }
+            link    = &(current->next);
+            current = link->load(std::memory_order_acquire);
+        }
+
+        if (newNode == NULL)
+            newNode = new Node(value);
+
+        // try to hang our node off the end; if someone beat us to it, keep
+        // walking from the node they added
+        Node* expected = NULL;
+        if (link->compare_exchange_strong(expected, newNode,
+                                          std::memory_order_release,
+                                          std::memory_order_acquire))
+        {
+            return true;
+        }
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+template<typename T>
+void AtomicPointerList<T>::sortByHits()
+{
+    Node* const rest = _rest.load(std::memory_order_relaxed);
+    if (rest == NULL)
+        return;
+
+    std::vector<CountedValue> values;
+    values.push_back(CountedValue(_firstHits.load(std::memory_order_relaxed),
+                                  _first.load(std::memory_order_relaxed)));
+    for (Node* node = rest; node != NULL;
+            node = node->next.load(std::memory_order_relaxed))
+    {
+        values.push_back(CountedValue(
+                    node->hits.load(std::memory_order_relaxed), node->value));
+    }
+
+    std::stable_sort(values.begin(), values.end(), &_hasMoreHits);
+
+    // put them back in the same slots
+    typename std::vector<CountedValue>::const_iterator it = values.begin();
+    _first.store(it->second, std::memory_order_relaxed);
+    _firstHits.store(it->first / 2, std::memory_order_relaxed);
+
+    for (Node* node = rest; node != NULL;
+            node = node->next.load(std::memory_order_relaxed))
+    {
+        ++it;
+        node->value = it->second;
+        node->hits.store(it->first / 2, std::memory_order_relaxed);
+    }
+}
+
+/*----------------------------------------------------------------------------*/
+template<typename T>
+void AtomicPointerList<T>::clear()
+{
+    Node* current = _rest.load(std::memory_order_relaxed);
+    while (current != NULL) {
+        Node* next = current->next.load(std::memory_order_relaxed);
+        delete current;
+        current = next;
+    }
+    _first.store(NULL, std::memory_order_relaxed);
+    _firstHits.store(0, std::memory_order_relaxed);
+    _rest.store(NULL, std::memory_order_relaxed);
+}
+
+/*============================================================================*/
+} // end namespace tranSupport
+#endif
@@ -0,0 +1,99 @@
+/*!
+ * \file FlatArray.hpp
+ * \brief Read-only array in its own storage or someone else's
+ * \author Seth R. Johnson
+ */
+
+#ifndef TS_FLATARRAY_HPP
+#define TS_FLATARRAY_HPP
+/*----------------------------------------------------------------------------*/
+
+#include <cstddef>
+#include <vector>
+
+namespace tranSupport {
+/*============================================================================*/
+/*!
+ * \class FlatArray
+ * \brief A contiguous, read-only array that may not own its elements.
+ *
+ * The elements are either taken over from a vector that was filled in
+ * beforehand, or left where they are in someone else's storage (such as a
+ * mapped file), which must then outlive the array or be replaced first.
+ * Either way the elements are read through the same pointers.
+ */
+template<typename T>
+class FlatArray {
+public:
+    typedef const T* const_iterator;
+
+public:
+    //! Start empty.
+    FlatArray() : _begin(NULL), _end(NULL)
+    { /* * */ }
+
+    //! Take over a vector's elements, leaving it empty.
+    void adopt(std::vector<T>& values) {
+        // swapping keeps the elements where they are
+        _owned.swap(values);
+        std::vector<T>().swap(values);
+
+        _begin = (_owned.empty() ? NULL : &_owned[0]);
+        _end   = _begin + _owned.size();
+    }
+
+    //! Read elements in someone else's storage, releasing our own.
+    void refer(const T* begin, const T* end) {
+        std::vector<T>().swap(_owned);
+
+        _begin = begin;
+        _end   = end;
+    }
+
+    //! Whether our elements are in someone else's storage.
+    bool isReferring() const {
+        return (_begin != NULL && _owned.empty());
+    }
+
+    //! Number of elements.
+    std::size_t size() const {
+        return _end - _begin;
+    }
+
+    //! Whether there are no elements.
+    bool empty() const {
+        return (_begin == _end);
+    }
+
+    //! Get one element.
+    const T& operator[](const std::size_t i) const {
+        return _begin[i];
+    }
+
+    //! First element.
+    const_iterator begin() const {
+        return _begin;
+    }
+
+    //! One past the last element.
+    const_iterator end() const {
+        return _end;
+    }
+
+private:
+    //! Disallow copying
+    FlatArray(const FlatArray&);
+    //! Disallow assignment
+    FlatArray& operator=(const FlatArray&);
+
+    //! Our own elements (empty if they're someone else's)
+    std::vector<T> _owned;
+    //! First element
+    const T*       _begin;
+    //! One past the last element
+    const T*       _end;
+};
+
+/*============================================================================*/
+} // end namespace tranSupport
+#endif
@@ -0,0 +1,51 @@
+/*!
+ * \file MappedFile.cpp
+ * \brief Implementation of read-only file mappings
+ * \author Seth R. Johnson
+ */
+
+#include "MappedFile.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace tranSupport {
+/*----------------------------------------------------------------------------*/
+bool MappedFile::open(const std::string& fileName)
+{
+    close();
+
+    int fileDescriptor = ::open(fileName.c_str(), O_RDONLY);
+    if (fileDescriptor < 0)
+        return false;
+
+    struct stat fileInfo;
+    if (fstat(fileDescriptor, &fileInfo) == 0 && fileInfo.st_size > 0) {
+        void* address = mmap(NULL, fileInfo.st_size, PROT_READ,
+                             MAP_SHARED, fileDescriptor, 0);
+        if (address != MAP_FAILED) {
+            _data = static_cast<const char*>(address);
+            _size = fileInfo.st_size;
+        }
+    }
+
+    // the mapping stays valid after the descriptor is closed
+    ::close(fileDescriptor);
+
+    return isOpen();
+}
+
+/*----------------------------------------------------------------------------*/
+void MappedFile::close()
+{
+    if (_data != NULL)
+        munmap(const_cast<char*>(_data), _size);
+
+    _data = NULL;
+    _size = 0;
+}
+
+/*----------------------------------------------------------------------------*/
+} // end namespace tranSupport
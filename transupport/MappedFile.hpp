@@ -0,0 +1,76 @@
+/*!
+ * \file MappedFile.hpp
+ * \brief Read-only view of a whole file mapped into memory
+ * \author Seth R. Johnson
+ */
+
+#ifndef TS_MAPPEDFILE_HPP
+#define TS_MAPPEDFILE_HPP
+/*----------------------------------------------------------------------------*/
+
+#include <cstddef>
+#include <string>
+
+namespace tranSupport {
+/*============================================================================*/
+/*!
+ * \class MappedFile
+ * \brief Map a whole file into memory, read-only.
+ *
+ * Pages are shared with every other process that maps the same file, and
+ * only the parts that are actually read are loaded from disk. Anything that
+ * points into the data must not outlive the mapping: it is released when
+ * the file is closed or the object is destroyed.
+ */
+class MappedFile {
+public:
+    //! Start with nothing mapped.
+    MappedFile() : _data(NULL), _size(0)
+    { /* * */ }
+
+    //! Release the mapping.
+    ~MappedFile() {
+        close();
+    }
+
+    /*!
+     * \brief Map a file, releasing whatever was mapped before.
+     *
+     * Returns false (with nothing mapped) if the file can't be opened or is
+     * empty.
+     */
+    bool open(const std::string& fileName);
+
+    //! Release the mapping (if there is one).
+    void close();
+
+    //! Whether a file is mapped.
+    bool isOpen() const {
+        return (_data != NULL);
+    }
+
+    //! Start of the file's contents.
+    const char* data() const {
+        return _data;
+    }
+
+    //! Number of bytes in the file.
+    std::size_t size() const {
+        return _size;
+    }
+
+private:
+    //! Disallow copying
+    MappedFile(const MappedFile&);
+    //! Disallow assignment
+    MappedFile& operator=(const MappedFile&);
+
+    //! Start of the mapping, or NULL
+    const char* _data;
+    //! Length of the mapping
+    std::size_t _size;
+};
+
+/*============================================================================*/
+} // end namespace tranSupport
+#endif
@@ -0,0 +1,113 @@
+/*!
+ * \file tArena.cpp
+ * \brief Unit tests for Arena
+ * \author Seth R. Johnson
+ */
+
+/*----------------------------------------------------------------------------*/
+
+#include "transupport/Arena.hpp"
+
+#include <iostream>
+#include <cstring>
+#include <stdint.h>
+#include "transupport/dbc.hpp"
+#include "transupport/UnitTester.hpp"
+
+using std::cout;
+using std::endl;
+
+using tranSupport::Arena;
+
+//! Whether a pointer has the given alignment
+bool isAligned(const void* address, const std::size_t alignment) {
+    return (reinterpret_cast<uintptr_t>(address) % alignment == 0);
+}
+
+/*============================================================================*/
+void runTests() {
+    Arena theArena(Arena::NORMAL_PAGES, 1024);
+
+    TESTER_CHECKFORPASS(theArena.getNumBlocks() == 0);
+    TESTER_CHECKFORPASS(theArena.getBytesUsed() == 0);
+
+    // ===== allocations follow each other ===== //
+    char* first  = static_cast<char*>(theArena.allocate(24, 8));
+    char* second = static_cast<char*>(theArena.allocate(24, 8));
+
+    TESTER_CHECKFORPASS(theArena.getNumBlocks() == 1);
+    TESTER_CHECKFORPASS(second == first + 24);
+    TESTER_CHECKFORPASS(theArena.getBytesUsed() == 48);
+
+    // ===== alignment is padded ===== //
+    char* third  = static_cast<char*>(theArena.allocate(1, 1));
+    char* fourth = static_cast<char*>(theArena.allocate(16, 16));
+
+    TESTER_CHECKFORPASS(third == first + 48);
+    TESTER_CHECKFORPASS(isAligned(fourth, 16));
+    TESTER_CHECKFORPASS(fourth > third);
+
+    double* aDouble = static_cast<double*>(theArena.allocate<double>());
+    TESTER_CHECKFORPASS(isAligned(aDouble, alignof(double)));
+    *aDouble = 2.0;
+
+    // ===== full blocks start a new one ===== //
+    char* bigger = static_cast<char*>(theArena.allocate(1000, 8));
+    TESTER_CHECKFORPASS(theArena.getNumBlocks() == 2);
+    std::memset(bigger, 0, 1000);
+
+    // ===== so do requests bigger than a block ===== //
+    char* huge = static_cast<char*>(theArena.allocate(5000, 64));
+    TESTER_CHECKFORPASS(theArena.getNumBlocks() == 3);
+    TESTER_CHECKFORPASS(isAligned(huge, 64));
+    std::memset(huge, 0, 5000);
+
+    // the earlier memory is untouched
+    TESTER_CHECKFORPASS(*aDouble == 2.0);
+}
+
+/*============================================================================*/
+void runHugePageTests() {
+    // whether or not the system grants huge pages, the memory must work
+    Arena::PageKind kinds[] = {Arena::TRANSPARENT_HUGE_PAGES,
+                               Arena::EXPLICIT_HUGE_PAGES};
+
+    for (unsigned int k = 0; k < 2; ++k) {
+        Arena theArena(kinds[k]);
+        TESTER_CHECKFORPASS(theArena.getPageKind() == kinds[k]);
+
+        char* first = static_cast<char*>(theArena.allocate(64, 64));
+        TESTER_CHECKFORPASS(isAligned(first, Arena::HUGE_PAGE_SIZE));
+
+        char* second = static_cast<char*>(
+                theArena.allocate(Arena::HUGE_PAGE_SIZE, 8));
+        TESTER_CHECKFORPASS(theArena.getNumBlocks() == 2);
+
+        std::memset(first,  1, 64);
+        std::memset(second, 2, Arena::HUGE_PAGE_SIZE);
+        TESTER_CHECKFORPASS(first[63] == 1);
+        TESTER_CHECKFORPASS(second[Arena::HUGE_PAGE_SIZE - 1] == 2);
+    }
+}
+
+/*============================================================================*/
+int main(int, char**) {
+    TESTER_INIT("Arena");
+    try {
+        runTests();
+        runHugePageTests();
+    }
+    catch (tranSupport::tranError &theErr) {
+        cout << "UNEXPECTED ERROR IN UNIT TEST: " << endl
+            << theErr.what() << endl;
+        TESTER_CHECKFORPASS(CAUGHT_UNEXPECTED_EXCEPTION);
+    }
+
+    TESTER_PRINTRESULT();
+
+    if (!TESTER_HASPASSED()) {
+        return 1;
+    }
+
+    return 0;
+}
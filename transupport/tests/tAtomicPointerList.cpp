@@ -0,0 +1,159 @@
+/*!
+ * \file tAtomicPointerList.cpp
+ * \brief Unit tests for AtomicPointerList
+ * \author Seth R. Johnson
+ */
+
+/*----------------------------------------------------------------------------*/
+
+#include "transupport/AtomicPointerList.hpp"
+
+#include <iostream>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "transupport/dbc.hpp"
+#include "transupport/UnitTester.hpp"
+
+using std::cout;
+using std::endl;
+
+using tranSupport::AtomicPointerList;
+
+typedef AtomicPointerList<int> IntList;
+
+//! Storage for the values that the lists point to
+int theValues[1000];
+
+/*============================================================================*/
+void runTests() {
+    IntList theList;
+
+    TESTER_CHECKFORPASS(theList.empty());
+    TESTER_CHECKFORPASS(theList.size() == 0);
+    TESTER_CHECKFORPASS(theList.begin() == theList.end());
+
+    // ===== first insertion is flagged as such ===== //
+    bool wasFirst = false;
+    TESTER_CHECKFORPASS(theList.insertUnique(&theValues[3], &wasFirst));
+    TESTER_CHECKFORPASS(wasFirst);
+    TESTER_CHECKFORPASS(!theList.empty());
+
+    // ===== a single (inline) value ===== //
+    TESTER_CHECKFORPASS(theList.size() == 1);
+    TESTER_CHECKFORPASS(*theList.begin() == &theValues[3]);
+    TESTER_CHECKFORPASS(++theList.begin() == theList.end());
+    TESTER_CHECKFORPASS(!theList.insertUnique(&theValues[3], &wasFirst));
+    TESTER_CHECKFORPASS(!wasFirst);
+
+    TESTER_CHECKFORPASS(theList.insertUnique(&theValues[1], &wasFirst));
+    TESTER_CHECKFORPASS(!wasFirst);
+
+    TESTER_CHECKFORPASS(theList.insertUnique(&theValues[4]));
+
+    // ===== duplicates are not added ===== //
+    TESTER_CHECKFORPASS(!theList.insertUnique(&theValues[1], &wasFirst));
+    TESTER_CHECKFORPASS(!wasFirst);
+    TESTER_CHECKFORPASS(theList.size() == 3);
+
+    // ===== iteration is in insertion order ===== //
+    std::vector<int*> values(theList.begin(), theList.end());
+    TESTER_CHECKFORPASS(values.size() == 3);
+    TESTER_CHECKFORPASS(values[0] == &theValues[3]);
+    TESTER_CHECKFORPASS(values[1] == &theValues[1]);
+    TESTER_CHECKFORPASS(values[2] == &theValues[4]);
+
+    // ===== the values found most often go first ===== //
+    IntList::const_iterator last = theList.begin();
+    ++(++last);
+    theList.recordHit(last);
+    theList.recordHit(last);
+    theList.recordHit(++theList.begin());
+
+    theList.sortByHits();
+    values.assign(theList.begin(), theList.end());
+    TESTER_CHECKFORPASS(values[0] == &theValues[4]);
+    TESTER_CHECKFORPASS(values[1] == &theValues[1]);
+    TESTER_CHECKFORPASS(values[2] == &theValues[3]);
+
+    // the counts were halved, so fewer new hits can move a value up
+    theList.recordHit(++theList.begin());
+    theList.recordHit(++theList.begin());
+    theList.sortByHits();
+    TESTER_CHECKFORPASS(*theList.begin() == &theValues[1]);
+
+    // ===== copies are deep ===== //
+    IntList copiedList(theList);
+    copiedList.insertUnique(&theValues[5]);
+    TESTER_CHECKFORPASS(copiedList.size() == 4);
+    TESTER_CHECKFORPASS(theList.size() == 3);
+
+    theList.clear();
+    TESTER_CHECKFORPASS(theList.empty());
+    TESTER_CHECKFORPASS(copiedList.size() == 4);
+}
+
+/*============================================================================*/
+void runThreadedTests() {
+    const int numValues = sizeof(theValues) / sizeof(theValues[0]);
+    IntList theList;
+
+    int numAdded = 0;
+    int numFirst = 0;
+
+    // every thread tries to add every value, in a different order
+#pragma omp parallel reduction(+:numAdded,numFirst)
+    {
+        int offset = 0;
+#ifdef _OPENMP
+        offset = 37 * omp_get_thread_num();
+#endif
+        for (int i = 0; i < numValues; ++i) {
+            bool wasFirst = false;
+            if (theList.insertUnique(&theValues[(i + offset) % numValues],
+                                     &wasFirst))
+                ++numAdded;
+            if (wasFirst)
+                ++numFirst;
+        }
+    }
+
+    TESTER_CHECKFORPASS(numAdded == numValues);
+    TESTER_CHECKFORPASS(numFirst == 1);
+    TESTER_CHECKFORPASS(theList.size() == static_cast<unsigned>(numValues));
+
+    std::vector<bool> found(numValues, false);
+    bool noDuplicates = true;
+    for (IntList::const_iterator it = theList.begin(); it != theList.end();
+                                                                       ++it)
+    {
+        const int index = *it - theValues;
+        if (found[index])
+            noDuplicates = false;
+        found[index] = true;
+    }
+    TESTER_CHECKFORPASS(noDuplicates);
+}
+
+/*============================================================================*/
+int main(int, char**) {
+    TESTER_INIT("AtomicPointerList");
+    try {
+        runTests();
+        runThreadedTests();
+    }
+    catch (tranSupport::tranError &theErr) {
+        cout << "UNEXPECTED ERROR IN UNIT TEST: " << endl
+            << theErr.what() << endl;
+        TESTER_CHECKFORPASS(CAUGHT_UNEXPECTED_EXCEPTION);
+    }
+
+    TESTER_PRINTRESULT();
+
+    if (!TESTER_HASPASSED()) {
+        return 1;
+    }
+
+    return 0;
+}
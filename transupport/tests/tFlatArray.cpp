@@ -0,0 +1,88 @@
+/*!
+ * \file tFlatArray.cpp
+ * \brief Unit tests for FlatArray
+ * \author Seth R. Johnson
+ */
+
+/*----------------------------------------------------------------------------*/
+
+#include "transupport/FlatArray.hpp"
+
+#include <iostream>
+#include <vector>
+#include "transupport/dbc.hpp"
+#include "transupport/UnitTester.hpp"
+
+using std::cout;
+using std::endl;
+
+using tranSupport::FlatArray;
+
+/*============================================================================*/
+void runTests() {
+    FlatArray<int> theArray;
+
+    TESTER_CHECKFORPASS(theArray.empty());
+    TESTER_CHECKFORPASS(theArray.size() == 0);
+    TESTER_CHECKFORPASS(theArray.begin() == theArray.end());
+    TESTER_CHECKFORPASS(!theArray.isReferring());
+
+    // ===== taking over a vector keeps its elements in place ===== //
+    std::vector<int> values;
+    for (int i = 0; i < 5; ++i)
+        values.push_back(10 * i);
+    const int* storage = &values[0];
+
+    theArray.adopt(values);
+
+    TESTER_CHECKFORPASS(values.empty());
+    TESTER_CHECKFORPASS(theArray.size() == 5);
+    TESTER_CHECKFORPASS(theArray.begin() == storage);
+    TESTER_CHECKFORPASS(theArray[3] == 30);
+    TESTER_CHECKFORPASS(!theArray.isReferring());
+
+    // ===== someone else's elements are read where they are ===== //
+    const int others[] = {7, 8, 9};
+
+    theArray.refer(others, others + 3);
+
+    TESTER_CHECKFORPASS(theArray.size() == 3);
+    TESTER_CHECKFORPASS(theArray.begin() == others);
+    TESTER_CHECKFORPASS(theArray.end() == others + 3);
+    TESTER_CHECKFORPASS(theArray[1] == 8);
+    TESTER_CHECKFORPASS(theArray.isReferring());
+
+    // ===== and can be replaced by our own again ===== //
+    values.assign(2, -1);
+    theArray.adopt(values);
+
+    TESTER_CHECKFORPASS(theArray.size() == 2);
+    TESTER_CHECKFORPASS(theArray[0] == -1);
+    TESTER_CHECKFORPASS(!theArray.isReferring());
+
+    // ===== an empty vector empties the array ===== //
+    theArray.adopt(values);
+
+    TESTER_CHECKFORPASS(theArray.empty());
+}
+
+/*============================================================================*/
+int main(int, char**) {
+    TESTER_INIT("FlatArray");
+    try {
+        runTests();
+    }
+    catch (tranSupport::tranError &theErr) {
+        cout << "UNEXPECTED ERROR IN UNIT TEST: " << endl
+            << theErr.what() << endl;
+        TESTER_CHECKFORPASS(CAUGHT_UNEXPECTED_EXCEPTION);
+    }
+
+    TESTER_PRINTRESULT();
+
+    if (!TESTER_HASPASSED()) {
+        return 1;
+    }
+
+    return 0;
+}
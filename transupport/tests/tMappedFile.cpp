@@ -0,0 +1,82 @@
+/*!
+ * \file tMappedFile.cpp
+ * \brief Unit tests for MappedFile
+ * \author Seth R. Johnson
+ */
+
+/*----------------------------------------------------------------------------*/
+
+#include "transupport/MappedFile.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include "transupport/dbc.hpp"
+#include "transupport/UnitTester.hpp"
+
+using std::cout;
+using std::endl;
+
+using tranSupport::MappedFile;
+
+/*============================================================================*/
+void runTests() {
+    const char* fileName = "tMappedFile.dat";
+    const char contents[] = "mapped file contents";
+
+    {
+        std::ofstream outFile(fileName, std::ios::out | std::ios::binary);
+        outFile.write(contents, sizeof(contents));
+    }
+
+    MappedFile theFile;
+    TESTER_CHECKFORPASS(!theFile.isOpen());
+    TESTER_CHECKFORPASS(theFile.data() == NULL);
+
+    // ===== the whole file is readable ===== //
+    TESTER_CHECKFORPASS(theFile.open(fileName));
+    TESTER_CHECKFORPASS(theFile.isOpen());
+    TESTER_CHECKFORPASS(theFile.size() == sizeof(contents));
+    TESTER_CHECKFORPASS(std::memcmp(theFile.data(), contents,
+                                    sizeof(contents)) == 0);
+
+    // ===== closing releases it ===== //
+    theFile.close();
+    TESTER_CHECKFORPASS(!theFile.isOpen());
+    TESTER_CHECKFORPASS(theFile.size() == 0);
+
+    // ===== a missing file leaves nothing mapped ===== //
+    TESTER_CHECKFORPASS(theFile.open(fileName));
+    TESTER_CHECKFORPASS(!theFile.open("nonexistent_file.dat"));
+    TESTER_CHECKFORPASS(!theFile.isOpen());
+
+    // ===== so does an empty one ===== //
+    {
+        std::ofstream outFile(fileName, std::ios::out | std::ios::trunc);
+    }
+    TESTER_CHECKFORPASS(!theFile.open(fileName));
+
+    std::remove(fileName);
+}
+
+/*============================================================================*/
+int main(int, char**) {
+    TESTER_INIT("MappedFile");
+    try {
+        runTests();
+    }
+    catch (tranSupport::tranError &theErr) {
+        cout << "UNEXPECTED ERROR IN UNIT TEST: " << endl
+            << theErr.what() << endl;
+        TESTER_CHECKFORPASS(CAUGHT_UNEXPECTED_EXCEPTION);
+    }
+
+    TESTER_PRINTRESULT();
+
+    if (!TESTER_HASPASSED()) {
+        return 1;
+    }
+
+    return 0;
+}